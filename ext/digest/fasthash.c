@@ -0,0 +1,715 @@
+/*
+ * fasthash.c - non-cryptographic hash functions
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * xxHash64 and XXH3 follow the xxHash specification by Yann Collet
+ * (https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md),
+ * and MurmurHash3 follows Austin Appleby's public domain reference
+ * implementation.  Multibyte words are always read in little-endian
+ * order, so the results don't depend on the platform.
+ *
+ * CRC32C uses the SSE4.2 crc32 instruction if the CPU supports it,
+ * or the slicing-by-8 table method otherwise.
+ */
+
+#include <string.h>
+#include "fasthash.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define CRC32C_HW_ENABLED 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*=================================================================
+ * Utilities
+ */
+
+static inline uint32_t read32le(const uint8_t *p)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+#else
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8)
+        | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+#endif
+}
+
+static inline uint64_t read64le(const uint8_t *p)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+#else
+    return (uint64_t)read32le(p) | ((uint64_t)read32le(p+4) << 32);
+#endif
+}
+
+static inline void write64le(uint8_t *p, uint64_t v)
+{
+    for (int i=0; i<8; i++) p[i] = (uint8_t)(v >> (i*8));
+}
+
+static inline uint32_t rotl32(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t swap64(uint64_t x)
+{
+    x = ((x & 0x00ff00ff00ff00ffULL) << 8)  | ((x >> 8)  & 0x00ff00ff00ff00ffULL);
+    x = ((x & 0x0000ffff0000ffffULL) << 16) | ((x >> 16) & 0x0000ffff0000ffffULL);
+    return (x << 32) | (x >> 32);
+}
+
+static inline uint32_t swap32(uint32_t x)
+{
+    return (x << 24) | ((x << 8) & 0xff0000) | ((x >> 8) & 0xff00) | (x >> 24);
+}
+
+/* Fold the 128bit product of LHS and RHS into 64bit by xor. */
+static inline uint64_t mul128_fold64(uint64_t lhs, uint64_t rhs)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t p = (__uint128_t)lhs * rhs;
+    return (uint64_t)p ^ (uint64_t)(p >> 64);
+#else
+    uint64_t lo_lo = (lhs & 0xffffffff) * (rhs & 0xffffffff);
+    uint64_t hi_lo = (lhs >> 32) * (rhs & 0xffffffff);
+    uint64_t lo_hi = (lhs & 0xffffffff) * (rhs >> 32);
+    uint64_t hi_hi = (lhs >> 32) * (rhs >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64_t lower = (cross << 32) | (lo_lo & 0xffffffff);
+    return lower ^ upper;
+#endif
+}
+
+#define PRIME32_1  0x9E3779B1U
+#define PRIME32_2  0x85EBCA77U
+#define PRIME32_3  0xC2B2AE3DU
+#define PRIME64_1  0x9E3779B185EBCA87ULL
+#define PRIME64_2  0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3  0x165667B19E3779F9ULL
+#define PRIME64_4  0x85EBCA77C2B2AE63ULL
+#define PRIME64_5  0x27D4EB2F165667C5ULL
+
+/*=================================================================
+ * xxHash64
+ */
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t val)
+{
+    acc ^= xxh64_round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+static inline uint64_t xxh64_avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+void Scm__XXH64Init(ScmXXH64State *st, uint64_t seed)
+{
+    memset(st, 0, sizeof(*st));
+    st->seed = seed;
+    st->v[0] = seed + PRIME64_1 + PRIME64_2;
+    st->v[1] = seed + PRIME64_2;
+    st->v[2] = seed;
+    st->v[3] = seed - PRIME64_1;
+}
+
+static const uint8_t *xxh64_stripes(uint64_t v[4], const uint8_t *p,
+                                    const uint8_t *end)
+{
+    uint64_t v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+    while (p + 32 <= end) {
+        v0 = xxh64_round(v0, read64le(p));
+        v1 = xxh64_round(v1, read64le(p+8));
+        v2 = xxh64_round(v2, read64le(p+16));
+        v3 = xxh64_round(v3, read64le(p+24));
+        p += 32;
+    }
+    v[0] = v0; v[1] = v1; v[2] = v2; v[3] = v3;
+    return p;
+}
+
+void Scm__XXH64Update(ScmXXH64State *st, const uint8_t *data, size_t len)
+{
+    const uint8_t *end = data + len;
+    st->total_len += len;
+
+    if (st->memsize + len < 32) {
+        memcpy(st->mem + st->memsize, data, len);
+        st->memsize += (uint32_t)len;
+        return;
+    }
+    if (st->memsize > 0) {
+        size_t fill = 32 - st->memsize;
+        memcpy(st->mem + st->memsize, data, fill);
+        xxh64_stripes(st->v, st->mem, st->mem + 32);
+        data += fill;
+        st->memsize = 0;
+    }
+    data = xxh64_stripes(st->v, data, end);
+    if (data < end) {
+        memcpy(st->mem, data, end - data);
+        st->memsize = (uint32_t)(end - data);
+    }
+}
+
+uint64_t Scm__XXH64Final(const ScmXXH64State *st)
+{
+    uint64_t h;
+    const uint8_t *p = st->mem, *end = st->mem + st->memsize;
+
+    if (st->total_len >= 32) {
+        h = rotl64(st->v[0], 1) + rotl64(st->v[1], 7)
+            + rotl64(st->v[2], 12) + rotl64(st->v[3], 18);
+        for (int i=0; i<4; i++) h = xxh64_merge_round(h, st->v[i]);
+    } else {
+        h = st->seed + PRIME64_5;
+    }
+    h += st->total_len;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxh64_round(0, read64le(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)read32le(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+    }
+    return xxh64_avalanche(h);
+}
+
+/*=================================================================
+ * XXH3 (64bit)
+ */
+
+#define XXH3_STRIPE_LEN          64
+#define XXH3_SECRET_CONSUME_RATE 8
+#define XXH3_STRIPES_PER_BLOCK \
+    ((SCM_XXH3_SECRET_SIZE - XXH3_STRIPE_LEN) / XXH3_SECRET_CONSUME_RATE)
+#define XXH3_SECRET_MERGEACCS_START 11
+#define XXH3_SECRET_LASTACC_START   7
+#define XXH3_MIDSIZE_MAX            240
+#define XXH3_SECRET_SIZE_MIN        136
+
+static const uint8_t xxh3_default_secret[SCM_XXH3_SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe,
+    0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+    0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78,
+    0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e,
+    0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+    0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e,
+    0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f,
+    0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3,
+    0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49,
+    0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+    0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28,
+    0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static inline uint64_t xxh3_avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t xxh3_rrmxmx(uint64_t h, uint64_t len)
+{
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= 0x9FB21C651E98DF25ULL;
+    h ^= (h >> 35) + len;
+    h *= 0x9FB21C651E98DF25ULL;
+    h ^= h >> 28;
+    return h;
+}
+
+static inline uint64_t xxh3_mix16(const uint8_t *in, const uint8_t *secret,
+                                  uint64_t seed)
+{
+    return mul128_fold64(read64le(in) ^ (read64le(secret) + seed),
+                         read64le(in+8) ^ (read64le(secret+8) - seed));
+}
+
+static uint64_t xxh3_len_0to16(const uint8_t *in, size_t len,
+                               const uint8_t *secret, uint64_t seed)
+{
+    if (len > 8) {
+        uint64_t flip1 = (read64le(secret+24) ^ read64le(secret+32)) + seed;
+        uint64_t flip2 = (read64le(secret+40) ^ read64le(secret+48)) - seed;
+        uint64_t lo = read64le(in) ^ flip1;
+        uint64_t hi = read64le(in + len - 8) ^ flip2;
+        uint64_t acc = len + swap64(lo) + hi + mul128_fold64(lo, hi);
+        return xxh3_avalanche(acc);
+    }
+    if (len >= 4) {
+        seed ^= (uint64_t)swap32((uint32_t)seed) << 32;
+        uint64_t flip = (read64le(secret+8) ^ read64le(secret+16)) - seed;
+        uint64_t in64 = read32le(in + len - 4)
+            + ((uint64_t)read32le(in) << 32);
+        return xxh3_rrmxmx(in64 ^ flip, len);
+    }
+    if (len > 0) {
+        uint32_t combined = ((uint32_t)in[0] << 16)
+            | ((uint32_t)in[len >> 1] << 24)
+            | (uint32_t)in[len - 1]
+            | ((uint32_t)len << 8);
+        uint64_t flip = (read32le(secret) ^ read32le(secret+4)) + seed;
+        return xxh64_avalanche(combined ^ flip);
+    }
+    return xxh64_avalanche(seed ^ (read64le(secret+56) ^ read64le(secret+64)));
+}
+
+static uint64_t xxh3_len_17to128(const uint8_t *in, size_t len,
+                                 const uint8_t *secret, uint64_t seed)
+{
+    uint64_t acc = len * PRIME64_1;
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                acc += xxh3_mix16(in + 48, secret + 96, seed);
+                acc += xxh3_mix16(in + len - 64, secret + 112, seed);
+            }
+            acc += xxh3_mix16(in + 32, secret + 64, seed);
+            acc += xxh3_mix16(in + len - 48, secret + 80, seed);
+        }
+        acc += xxh3_mix16(in + 16, secret + 32, seed);
+        acc += xxh3_mix16(in + len - 32, secret + 48, seed);
+    }
+    acc += xxh3_mix16(in, secret, seed);
+    acc += xxh3_mix16(in + len - 16, secret + 16, seed);
+    return xxh3_avalanche(acc);
+}
+
+static uint64_t xxh3_len_129to240(const uint8_t *in, size_t len,
+                                  const uint8_t *secret, uint64_t seed)
+{
+    uint64_t acc = len * PRIME64_1;
+    size_t nrounds = len / 16, i;
+    for (i = 0; i < 8; i++) {
+        acc += xxh3_mix16(in + 16*i, secret + 16*i, seed);
+    }
+    acc = xxh3_avalanche(acc);
+    for (; i < nrounds; i++) {
+        acc += xxh3_mix16(in + 16*i, secret + 16*(i-8) + 3, seed);
+    }
+    acc += xxh3_mix16(in + len - 16, secret + XXH3_SECRET_SIZE_MIN - 17, seed);
+    return xxh3_avalanche(acc);
+}
+
+/* Accumulate one 64-byte stripe. */
+static inline void xxh3_accumulate_512(uint64_t *acc, const uint8_t *in,
+                                       const uint8_t *secret)
+{
+#if defined(__SSE2__)
+    __m128i *xacc = (__m128i*)acc;
+    for (int i=0; i<4; i++) {
+        __m128i data = _mm_loadu_si128((const __m128i*)in + i);
+        __m128i key  = _mm_loadu_si128((const __m128i*)secret + i);
+        __m128i dk   = _mm_xor_si128(data, key);
+        __m128i dk_lo = _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i product = _mm_mul_epu32(dk, dk_lo);
+        __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128i sum = _mm_add_epi64(_mm_loadu_si128(xacc + i), swapped);
+        _mm_storeu_si128(xacc + i, _mm_add_epi64(product, sum));
+    }
+#else
+    for (int i=0; i<8; i++) {
+        uint64_t data = read64le(in + 8*i);
+        uint64_t dk = data ^ read64le(secret + 8*i);
+        acc[i ^ 1] += data;
+        acc[i] += (dk & 0xffffffff) * (dk >> 32);
+    }
+#endif
+}
+
+static inline void xxh3_scramble(uint64_t *acc, const uint8_t *secret)
+{
+    for (int i=0; i<8; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= read64le(secret + 8*i);
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+/* Consume NSTRIPES stripes from IN, where *NACC stripes of the current
+   block have already been consumed.  Scrambles at the block boundary. */
+static void xxh3_consume_stripes(uint64_t *acc, size_t *nacc,
+                                 const uint8_t *in, size_t nstripes,
+                                 const uint8_t *secret)
+{
+    while (nstripes > 0) {
+        size_t n = XXH3_STRIPES_PER_BLOCK - *nacc;
+        if (n > nstripes) n = nstripes;
+        for (size_t i = 0; i < n; i++) {
+            xxh3_accumulate_512(acc, in,
+                                secret + (*nacc + i) * XXH3_SECRET_CONSUME_RATE);
+            in += XXH3_STRIPE_LEN;
+        }
+        nstripes -= n;
+        *nacc += n;
+        if (*nacc == XXH3_STRIPES_PER_BLOCK) {
+            xxh3_scramble(acc, secret + SCM_XXH3_SECRET_SIZE - XXH3_STRIPE_LEN);
+            *nacc = 0;
+        }
+    }
+}
+
+void Scm__XXH3Init(ScmXXH3State *st, uint64_t seed)
+{
+    static const uint64_t init_acc[8] = {
+        PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+        PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+    };
+    memcpy(st->acc, init_acc, sizeof(init_acc));
+    st->total_len = 0;
+    st->seed = seed;
+    st->nstripes = 0;
+    st->buffered = 0;
+    /* Long inputs with nonzero seed use a secret derived from the seed. */
+    for (int i=0; i<SCM_XXH3_SECRET_SIZE; i+=16) {
+        write64le(st->secret + i, read64le(xxh3_default_secret + i) + seed);
+        write64le(st->secret + i + 8,
+                  read64le(xxh3_default_secret + i + 8) - seed);
+    }
+}
+
+/* We keep at least one byte buffered, so that the final stripe can be
+   taken from the buffer.  When a large input is consumed directly,
+   its last stripe is saved at the end of the buffer for the same
+   purpose (see Scm__XXH3Final). */
+void Scm__XXH3Update(ScmXXH3State *st, const uint8_t *data, size_t len)
+{
+    const size_t bufstripes = SCM_XXH3_BUFFER_SIZE / XXH3_STRIPE_LEN;
+    st->total_len += len;
+
+    if (st->buffered + len <= SCM_XXH3_BUFFER_SIZE) {
+        memcpy(st->buffer + st->buffered, data, len);
+        st->buffered += (uint32_t)len;
+        return;
+    }
+    if (st->buffered > 0) {
+        size_t fill = SCM_XXH3_BUFFER_SIZE - st->buffered;
+        memcpy(st->buffer + st->buffered, data, fill);
+        data += fill;
+        len -= fill;
+        xxh3_consume_stripes(st->acc, &st->nstripes, st->buffer, bufstripes,
+                             st->secret);
+        st->buffered = 0;
+    }
+    if (len > SCM_XXH3_BUFFER_SIZE) {
+        size_t n = (len - 1) / XXH3_STRIPE_LEN;
+        xxh3_consume_stripes(st->acc, &st->nstripes, data, n, st->secret);
+        data += n * XXH3_STRIPE_LEN;
+        len -= n * XXH3_STRIPE_LEN;
+        memcpy(st->buffer + SCM_XXH3_BUFFER_SIZE - XXH3_STRIPE_LEN,
+               data - XXH3_STRIPE_LEN, XXH3_STRIPE_LEN);
+    }
+    memcpy(st->buffer, data, len);
+    st->buffered = (uint32_t)len;
+}
+
+uint64_t Scm__XXH3Final(const ScmXXH3State *st)
+{
+    if (st->total_len <= XXH3_MIDSIZE_MAX) {
+        /* The whole input is in the buffer. */
+        const uint8_t *in = st->buffer;
+        size_t len = (size_t)st->total_len;
+        if (len <= 16) {
+            return xxh3_len_0to16(in, len, xxh3_default_secret, st->seed);
+        } else if (len <= 128) {
+            return xxh3_len_17to128(in, len, xxh3_default_secret, st->seed);
+        } else {
+            return xxh3_len_129to240(in, len, xxh3_default_secret, st->seed);
+        }
+    }
+
+    uint64_t acc[8];
+    size_t nacc = st->nstripes;
+    const uint8_t *lastacc_secret =
+        st->secret + SCM_XXH3_SECRET_SIZE - XXH3_STRIPE_LEN
+        - XXH3_SECRET_LASTACC_START;
+    memcpy(acc, st->acc, sizeof(acc));
+
+    if (st->buffered >= XXH3_STRIPE_LEN) {
+        size_t n = (st->buffered - 1) / XXH3_STRIPE_LEN;
+        xxh3_consume_stripes(acc, &nacc, st->buffer, n, st->secret);
+        xxh3_accumulate_512(acc, st->buffer + st->buffered - XXH3_STRIPE_LEN,
+                            lastacc_secret);
+    } else {
+        /* The last stripe straddles the previously consumed data. */
+        uint8_t last[XXH3_STRIPE_LEN];
+        size_t catchup = XXH3_STRIPE_LEN - st->buffered;
+        memcpy(last, st->buffer + SCM_XXH3_BUFFER_SIZE - catchup, catchup);
+        memcpy(last + catchup, st->buffer, st->buffered);
+        xxh3_accumulate_512(acc, last, lastacc_secret);
+    }
+
+    uint64_t h = st->total_len * PRIME64_1;
+    const uint8_t *s = st->secret + XXH3_SECRET_MERGEACCS_START;
+    for (int i=0; i<4; i++) {
+        h += mul128_fold64(acc[2*i] ^ read64le(s + 16*i),
+                           acc[2*i+1] ^ read64le(s + 16*i + 8));
+    }
+    return xxh3_avalanche(h);
+}
+
+/*=================================================================
+ * CRC32C
+ */
+
+#define CRC32C_POLY 0x82F63B78U  /* reflected */
+
+static uint32_t crc32c_table[8][256];
+
+static void crc32c_init_table(void)
+{
+    for (uint32_t i=0; i<256; i++) {
+        uint32_t c = i;
+        for (int k=0; k<8; k++) c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        crc32c_table[0][i] = c;
+    }
+    for (uint32_t i=0; i<256; i++) {
+        uint32_t c = crc32c_table[0][i];
+        for (int t=1; t<8; t++) {
+            c = crc32c_table[0][c & 0xff] ^ (c >> 8);
+            crc32c_table[t][i] = c;
+        }
+    }
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    for (; len > 0 && ((uintptr_t)p & 7); len--) {
+        crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    for (; len >= 8; len -= 8, p += 8) {
+        uint32_t lo = read32le(p) ^ crc;
+        uint32_t hi = read32le(p+4);
+        crc = crc32c_table[7][lo & 0xff]
+            ^ crc32c_table[6][(lo >> 8) & 0xff]
+            ^ crc32c_table[5][(lo >> 16) & 0xff]
+            ^ crc32c_table[4][lo >> 24]
+            ^ crc32c_table[3][hi & 0xff]
+            ^ crc32c_table[2][(hi >> 8) & 0xff]
+            ^ crc32c_table[1][(hi >> 16) & 0xff]
+            ^ crc32c_table[0][hi >> 24];
+    }
+    for (; len > 0; len--) {
+        crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(CRC32C_HW_ENABLED)
+
+static int crc32c_hw = 0;
+
+static int crc32c_hw_available(void)
+{
+    unsigned int a, b, c, d;
+    return __get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSE4_2);
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw_update(uint32_t crc, const uint8_t *p, size_t len)
+{
+    for (; len > 0 && ((uintptr_t)p & 7); len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+#if defined(__x86_64__)
+    uint64_t c64 = crc;
+    for (; len >= 8; len -= 8, p += 8) {
+        c64 = _mm_crc32_u64(c64, read64le(p));
+    }
+    crc = (uint32_t)c64;
+#else
+    for (; len >= 4; len -= 4, p += 4) {
+        crc = _mm_crc32_u32(crc, read32le(p));
+    }
+#endif
+    for (; len > 0; len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+
+int Scm__CRC32CHardwareSet(int enable)
+{
+    crc32c_hw = enable && crc32c_hw_available();
+    return crc32c_hw;
+}
+
+#else  /* !CRC32C_HW_ENABLED */
+
+int Scm__CRC32CHardwareSet(int enable)
+{
+    return 0;
+}
+
+#endif /* !CRC32C_HW_ENABLED */
+
+uint32_t Scm__CRC32CUpdate(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+#if defined(CRC32C_HW_ENABLED)
+    if (crc32c_hw) return ~crc32c_hw_update(crc, data, len);
+#endif
+    return ~crc32c_sw(crc, data, len);
+}
+
+/*=================================================================
+ * MurmurHash3 (x86, 32bit)
+ */
+
+#define MURMUR3_C1 0xcc9e2d51U
+#define MURMUR3_C2 0x1b873593U
+
+static inline uint32_t murmur3_mixk(uint32_t k)
+{
+    k *= MURMUR3_C1;
+    k = rotl32(k, 15);
+    return k * MURMUR3_C2;
+}
+
+static inline uint32_t murmur3_block(uint32_t h, uint32_t k)
+{
+    h ^= murmur3_mixk(k);
+    h = rotl32(h, 13);
+    return h * 5 + 0xe6546b64;
+}
+
+void Scm__Murmur3Init(ScmMurmur3State *st, uint32_t seed)
+{
+    st->h = seed;
+    st->total_len = 0;
+    st->ntail = 0;
+}
+
+void Scm__Murmur3Update(ScmMurmur3State *st, const uint8_t *data, size_t len)
+{
+    uint32_t h = st->h;
+    st->total_len += (uint32_t)len;     /* the reference uses 32bit length */
+
+    if (st->ntail > 0) {
+        while (st->ntail < 4 && len > 0) {
+            st->tail[st->ntail++] = *data++;
+            len--;
+        }
+        if (st->ntail < 4) return;
+        h = murmur3_block(h, read32le(st->tail));
+        st->ntail = 0;
+    }
+    for (; len >= 4; len -= 4, data += 4) {
+        h = murmur3_block(h, read32le(data));
+    }
+    memcpy(st->tail, data, len);
+    st->ntail = (uint32_t)len;
+    st->h = h;
+}
+
+uint32_t Scm__Murmur3Final(const ScmMurmur3State *st)
+{
+    uint32_t h = st->h, k = 0;
+    switch (st->ntail) {
+    case 3: k ^= (uint32_t)st->tail[2] << 16; /* FALLTHROUGH */
+    case 2: k ^= (uint32_t)st->tail[1] << 8;  /* FALLTHROUGH */
+    case 1: k ^= st->tail[0];
+        h ^= murmur3_mixk(k);
+    }
+    h ^= st->total_len;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+/*=================================================================
+ * Initialization
+ */
+
+void Scm__InitFastHash(void)
+{
+    crc32c_init_table();
+    Scm__CRC32CHardwareSet(1);
+}
@@ -0,0 +1,102 @@
+/*
+ * fasthash.h - non-cryptographic hash functions
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_FASTHASH_H
+#define GAUCHE_FASTHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* All functions take a streaming state, so that the data can be fed
+   in arbitrary chunks.  The results are the same as the reference
+   implementations of one-shot hashing. */
+
+/* xxHash64 */
+typedef struct ScmXXH64StateRec {
+    uint64_t v[4];
+    uint64_t total_len;
+    uint64_t seed;
+    uint8_t  mem[32];
+    uint32_t memsize;
+} ScmXXH64State;
+
+extern void     Scm__XXH64Init(ScmXXH64State *st, uint64_t seed);
+extern void     Scm__XXH64Update(ScmXXH64State *st, const uint8_t *data,
+                                 size_t len);
+extern uint64_t Scm__XXH64Final(const ScmXXH64State *st);
+
+/* XXH3, 64bit variant */
+#define SCM_XXH3_SECRET_SIZE  192
+#define SCM_XXH3_BUFFER_SIZE  256
+
+typedef struct ScmXXH3StateRec {
+    uint64_t acc[8];
+    uint8_t  secret[SCM_XXH3_SECRET_SIZE];
+    uint8_t  buffer[SCM_XXH3_BUFFER_SIZE];
+    uint64_t total_len;
+    uint64_t seed;
+    size_t   nstripes;          /* stripes consumed in the current block */
+    uint32_t buffered;
+} ScmXXH3State;
+
+extern void     Scm__XXH3Init(ScmXXH3State *st, uint64_t seed);
+extern void     Scm__XXH3Update(ScmXXH3State *st, const uint8_t *data,
+                                size_t len);
+extern uint64_t Scm__XXH3Final(const ScmXXH3State *st);
+
+/* CRC32C (Castagnoli).  Like zlib's crc32(), CRC is the checksum of
+   the preceding data (0 for the initial call).  The SSE4.2 crc32
+   instruction is used if available. */
+extern uint32_t Scm__CRC32CUpdate(uint32_t crc, const uint8_t *data,
+                                  size_t len);
+/* Enables or disables the use of the crc32 instruction; mainly for
+   testing and benchmarking.  Returns the new state. */
+extern int      Scm__CRC32CHardwareSet(int enable);
+
+/* MurmurHash3, x86 32bit variant */
+typedef struct ScmMurmur3StateRec {
+    uint32_t h;
+    uint32_t total_len;
+    uint8_t  tail[4];
+    uint32_t ntail;
+} ScmMurmur3State;
+
+extern void     Scm__Murmur3Init(ScmMurmur3State *st, uint32_t seed);
+extern void     Scm__Murmur3Update(ScmMurmur3State *st, const uint8_t *data,
+                                   size_t len);
+extern uint32_t Scm__Murmur3Final(const ScmMurmur3State *st);
+
+/* Called once at initialization; sets up tables and CPU features. */
+extern void     Scm__InitFastHash(void);
+
+#endif /* GAUCHE_FASTHASH_H */
@@ -0,0 +1,247 @@
+;;;
+;;; fasthash - non-cryptographic hash functions
+;;;
+;;;   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+
+;;; xxHash64, XXH3 (64bit), CRC32C (RFC 3720) and MurmurHash3 (x86 32bit).
+;;; These are much faster than MD5/SHA, but they're not for security.
+
+(define-module rfc.fasthash
+  (use gauche.uvector)
+  (extend util.digest)
+  (export <xxhash64> xxhash64 xxhash64-digest xxhash64-digest-string
+          <xxh3> xxh3 xxh3-digest xxh3-digest-string
+          <crc32c> crc32c crc32c-digest crc32c-digest-string
+          <murmurhash3> murmurhash3 murmurhash3-digest
+          murmurhash3-digest-string))
+(select-module rfc.fasthash)
+
+;;;
+;;;  High-level API
+;;;
+
+;; As in rfc.sha, the input is fed to the hash function directly from
+;; the string/u8vector storage or from the port buffer.
+
+(define (make-context algorithm seed)
+  (rlet1 ctx (make <fasthash-context>)
+    (%fasthash-init ctx algorithm seed)))
+
+;; Returns the hash value as an exact integer.  DATA may be a string,
+;; a u8vector or an input port.  For CRC32C, SEED is the checksum of
+;; the preceding data, as crc32 of rfc.zlib.
+(define (gen-hash algorithm)
+  (^[data :optional (seed 0)]
+    (let1 ctx (make-context algorithm seed)
+      (if (input-port? data)
+        (%fasthash-update-port ctx data)
+        (%fasthash-update ctx data))
+      (%fasthash-final ctx #f))))
+
+;; Returns the hash value as a big-endian byte sequence in an incomplete
+;; string, as the other digest procedures.
+(define (gen-digest algorithm)
+  (^[] (let1 ctx (make-context algorithm 0)
+         (%fasthash-update-port ctx (current-input-port))
+         (%fasthash-final ctx #t))))
+
+(define (gen-digest-string algorithm)
+  (^[data] (let1 ctx (make-context algorithm 0)
+             (%fasthash-update ctx data)
+             (%fasthash-final ctx #t))))
+
+(define xxhash64                 (gen-hash FASTHASH_XXH64))
+(define xxhash64-digest          (gen-digest FASTHASH_XXH64))
+(define xxhash64-digest-string   (gen-digest-string FASTHASH_XXH64))
+(define xxh3                     (gen-hash FASTHASH_XXH3))
+(define xxh3-digest              (gen-digest FASTHASH_XXH3))
+(define xxh3-digest-string       (gen-digest-string FASTHASH_XXH3))
+(define crc32c                   (gen-hash FASTHASH_CRC32C))
+(define crc32c-digest            (gen-digest FASTHASH_CRC32C))
+(define crc32c-digest-string     (gen-digest-string FASTHASH_CRC32C))
+(define murmurhash3              (gen-hash FASTHASH_MURMUR3))
+(define murmurhash3-digest       (gen-digest FASTHASH_MURMUR3))
+(define murmurhash3-digest-string (gen-digest-string FASTHASH_MURMUR3))
+
+;;;
+;;; Digest framework
+;;;
+
+;; The instances take an optional :seed initarg.
+(define-macro (define-framework name algorithm)
+  (let ([meta   (string->symbol #"<~|name|-meta>")]
+        [cls    (string->symbol #"<~|name|>")]
+        [digest (string->symbol #"~|name|-digest")]
+        [digest-string (string->symbol #"~|name|-digest-string")])
+    `(begin
+       (define-class ,meta (<message-digest-algorithm-meta>) ())
+       (define-class ,cls (<message-digest-algorithm>)
+         ((context)
+          (seed :init-keyword :seed :init-value 0))
+         :metaclass ,meta)
+       (define-method initialize ((self ,cls) initargs)
+         (next-method)
+         (slot-set! self 'context
+                    (make-context ,algorithm (slot-ref self 'seed))))
+       (define-method digest-update! ((self ,cls) data)
+         (%fasthash-update (slot-ref self 'context) data))
+       (define-method digest-final! ((self ,cls))
+         (%fasthash-final (slot-ref self 'context) #t))
+       (define-method digest ((class ,meta))
+         (,digest))
+       (define-method digest-string ((class ,meta) string)
+         (,digest-string string)))))
+
+(define-framework xxhash64    FASTHASH_XXH64)
+(define-framework xxh3        FASTHASH_XXH3)
+(define-framework crc32c      FASTHASH_CRC32C)
+(define-framework murmurhash3 FASTHASH_MURMUR3)
+
+;;;
+;;; Low-level bindings
+;;;
+
+(inline-stub
+ (declcode
+  (.include <gauche/class.h>)
+  (.include "fasthash.h")
+
+  (.define LIBGAUCHE_EXT_BODY)
+  (.include <gauche/extern.h>)      ; fix SCM_EXTERN in SCM_CLASS_DECL
+
+  (.define FASTHASH_XXH64   0)
+  (.define FASTHASH_XXH3    1)
+  (.define FASTHASH_CRC32C  2)
+  (.define FASTHASH_MURMUR3 3)
+  )
+
+ (define-enum FASTHASH_XXH64)
+ (define-enum FASTHASH_XXH3)
+ (define-enum FASTHASH_CRC32C)
+ (define-enum FASTHASH_MURMUR3)
+
+ ;; Only the state of ALGORITHM is used.
+ (define-ctype ScmFastHashContext::(.struct
+                                    (SCM_HEADER :: ""
+                                     algorithm::int
+                                     xxh64::ScmXXH64State
+                                     xxh3::ScmXXH3State
+                                     crc::uint32_t
+                                     murmur3::ScmMurmur3State)))
+
+ (define-cclass <fasthash-context> :private
+   ScmFastHashContext* "Scm_FastHashContextClass" ()
+   ()
+   [allocator
+    (let* ([ctx :: ScmFastHashContext* (SCM_NEW_INSTANCE ScmFastHashContext
+                                                         klass)])
+      (cast void initargs)              ; suppress unused var warning
+      (return (SCM_OBJ ctx)))])
+
+ (define-cproc %fasthash-init (ctx::<fasthash-context> algorithm::<int>
+                               seed::<integer>)
+   ::<void>
+   (set! (-> ctx algorithm) algorithm)
+   (case algorithm
+     [(FASTHASH_XXH64)
+      (Scm__XXH64Init (& (-> ctx xxh64)) (Scm_GetIntegerU64 seed))]
+     [(FASTHASH_XXH3)
+      (Scm__XXH3Init (& (-> ctx xxh3)) (Scm_GetIntegerU64 seed))]
+     [(FASTHASH_CRC32C)
+      (set! (-> ctx crc) (Scm_GetIntegerU32 seed))]
+     [(FASTHASH_MURMUR3)
+      (Scm__Murmur3Init (& (-> ctx murmur3))
+                        (Scm_GetIntegerU32 seed))]
+     [else (Scm_Error "unknown hash algorithm: %d" algorithm)]))
+
+ (define-cfn fasthash_update (ctx::ScmFastHashContext*
+                              data::(const uint8_t*)
+                              len::size_t)
+   ::void :static
+   (case (-> ctx algorithm)
+     [(FASTHASH_XXH64) (Scm__XXH64Update (& (-> ctx xxh64)) data len)]
+     [(FASTHASH_XXH3)  (Scm__XXH3Update (& (-> ctx xxh3)) data len)]
+     [(FASTHASH_CRC32C)
+      (set! (-> ctx crc) (Scm__CRC32CUpdate (-> ctx crc) data len))]
+     [(FASTHASH_MURMUR3) (Scm__Murmur3Update (& (-> ctx murmur3)) data len)]))
+
+ (define-cproc %fasthash-update (ctx::<fasthash-context> data) ::<void>
+   (cond
+    [(SCM_U8VECTORP data)
+     (fasthash_update ctx
+                      (cast (const uint8_t*)
+                            (SCM_UVECTOR_ELEMENTS (SCM_U8VECTOR data)))
+                      (SCM_U8VECTOR_SIZE (SCM_U8VECTOR data)))]
+    [(SCM_STRINGP data)
+     (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY data)])
+       (fasthash_update ctx
+                        (cast (const uint8_t*) (SCM_STRING_BODY_START b))
+                        (SCM_STRING_BODY_SIZE b)))]
+    [else (SCM_TYPE_ERROR data "u8vector or string")]))
+
+ ;; Read into a C buffer, as %shaN-update-port in rfc.sha.
+ (define-cproc %fasthash-update-port (ctx::<fasthash-context>
+                                      port::<input-port>)
+   ::<void>
+   (let* ([buf::(.array char [8192])])
+     (loop
+      (let* ([n::ScmSize (Scm_Getz buf (sizeof buf) port)])
+        (when (<= n 0) (break))
+        (fasthash_update ctx (cast (const uint8_t*) buf) n)))))
+
+ ;; Returns the hash value as an integer, or, if AS-STRING is true,
+ ;; as a big-endian incomplete string.  The state isn't modified.
+ (define-cproc %fasthash-final (ctx::<fasthash-context> as-string::<boolean>)
+   (let* ([v::uint64_t 0] [size::int 8])
+     (case (-> ctx algorithm)
+       [(FASTHASH_XXH64) (set! v (Scm__XXH64Final (& (-> ctx xxh64))))]
+       [(FASTHASH_XXH3)  (set! v (Scm__XXH3Final (& (-> ctx xxh3))))]
+       [(FASTHASH_CRC32C) (set! v (-> ctx crc) size 4)]
+       [(FASTHASH_MURMUR3)
+        (set! v (Scm__Murmur3Final (& (-> ctx murmur3))) size 4)])
+     (if as-string
+       (let* ([digest::(.array (unsigned char) [8])])
+         (dotimes [i size]
+           (set! (aref digest i) (logand (>> v (* 8 (- size i 1))) #xff)))
+         (return (Scm_MakeString (cast (const char*) digest) size size
+                                 (logior SCM_STRING_INCOMPLETE
+                                         SCM_STRING_COPYING))))
+       (return (Scm_MakeIntegerU64 v)))))
+
+ ;; CRC32C uses the SSE4.2 crc32 instruction if available.  This is
+ ;; mainly for testing and benchmarking; setting the flag to #t has no
+ ;; effect if the CPU doesn't support the instruction.
+ (define-cproc %crc32c-hardware-acceleration-set! (flag::<boolean>)
+   ::<boolean>
+   (return (Scm__CRC32CHardwareSet flag)))
+
+ (initcode (Scm__InitFastHash))
+ )
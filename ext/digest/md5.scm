@@ -55,22 +55,17 @@
   (next-method)
   (slot-set! self 'context (make <md5-context>)))
 
-(define-constant *md5-unit-len* 4096)
-
+;; The input is fed to MD5_Update directly from the port buffer or
+;; from the string/u8vector storage.
 (define (md5-digest)
-  (let ([md5 (make <md5-context>)]
-        [buf (make-u8vector *md5-unit-len*)])
-    (generator-for-each
-     (^x (%md5-update md5 x))
-     (^[] (let1 count (read-block! buf)
-            (cond [(eof-object? count) count]
-                  [(< count *md5-unit-len*)
-                   (uvector-alias <u8vector> buf 0 count)]
-                  [else buf]))))
+  (let1 md5 (make <md5-context>)
+    (%md5-update-port md5 (current-input-port))
     (%md5-final md5)))
 
-(define (md5-digest-string string)
-  (with-input-from-string string md5-digest))
+(define (md5-digest-string data)
+  (let1 md5 (make <md5-context>)
+    (%md5-update md5 data)
+    (%md5-final md5)))
 
 ;;;
 ;;; Digest framework
@@ -81,6 +76,8 @@
   (%md5-final (context-of self)))
 (define-method digest ((class <md5-meta>))
   (md5-digest))
+(define-method digest-string ((class <md5-meta>) string)
+  (md5-digest-string string))
 
 ;;;
 ;;; Low-level bindings
@@ -121,6 +118,13 @@
                   (SCM_STRING_BODY_SIZE b)))]
     [else (SCM_TYPE_ERROR data "u8vector or string")]))
 
+ (define-cproc %md5-update-port (md5::<md5-context> port::<input-port>) ::<void>
+   (let* ([buf::(.array char [8192])])
+     (loop
+      (let* ([n::ScmSize (Scm_Getz buf (sizeof buf) port)])
+        (when (<= n 0) (break))
+        (MD5_Update (& (-> md5 ctx)) (cast (const unsigned char*) buf) n)))))
+
  (define-cproc %md5-final (md5::<md5-context>)
    (let* ([digest::(.array (unsigned char) [16])])
      (MD5_Final digest (& (-> md5 ctx)))
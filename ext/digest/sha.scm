@@ -49,32 +49,43 @@
 ;;;  High-level API
 ;;;
 
-(define-constant *sha-unit-len* 4096)
+;; The input is fed to the digest routine directly from the port buffer
+;; or from the string/u8vector storage, without going through Scheme-level
+;; buffers (see %shaN-update-port).
 
 (define (gen-digest init update end)
-  (^[] (let ([ctx (make <sha-context>)]
-             [buf (make-u8vector *sha-unit-len*)])
+  (^[] (let1 ctx (make <sha-context>)
          (init ctx)
-         (generator-for-each
-          (^x (update ctx x))
-          (^[] (let1 count (read-block! buf)
-                 (cond [(eof-object? count) count]
-                       [(< count *sha-unit-len*)
-                        (uvector-alias <u8vector> buf 0 count)]
-                       [else buf]))))
+         (update ctx (current-input-port))
          (end ctx))))
 
-(define sha1-digest   (gen-digest %sha1-init   %sha1-update   %sha1-final))
-(define sha224-digest (gen-digest %sha224-init %sha224-update %sha224-final))
-(define sha256-digest (gen-digest %sha256-init %sha256-update %sha256-final))
-(define sha384-digest (gen-digest %sha384-init %sha384-update %sha384-final))
-(define sha512-digest (gen-digest %sha512-init %sha512-update %sha512-final))
-
-(define (sha1-digest-string s)   (with-input-from-string s sha1-digest))
-(define (sha224-digest-string s) (with-input-from-string s sha224-digest))
-(define (sha256-digest-string s) (with-input-from-string s sha256-digest))
-(define (sha384-digest-string s) (with-input-from-string s sha384-digest))
-(define (sha512-digest-string s) (with-input-from-string s sha512-digest))
+(define (gen-digest-string init update end)
+  (^[data] (let1 ctx (make <sha-context>)
+             (init ctx)
+             (update ctx data)
+             (end ctx))))
+
+(define sha1-digest
+  (gen-digest %sha1-init %sha1-update-port %sha1-final))
+(define sha224-digest
+  (gen-digest %sha224-init %sha224-update-port %sha224-final))
+(define sha256-digest
+  (gen-digest %sha256-init %sha256-update-port %sha256-final))
+(define sha384-digest
+  (gen-digest %sha384-init %sha384-update-port %sha384-final))
+(define sha512-digest
+  (gen-digest %sha512-init %sha512-update-port %sha512-final))
+
+(define sha1-digest-string
+  (gen-digest-string %sha1-init %sha1-update %sha1-final))
+(define sha224-digest-string
+  (gen-digest-string %sha224-init %sha224-update %sha224-final))
+(define sha256-digest-string
+  (gen-digest-string %sha256-init %sha256-update %sha256-final))
+(define sha384-digest-string
+  (gen-digest-string %sha384-init %sha384-update %sha384-final))
+(define sha512-digest-string
+  (gen-digest-string %sha512-init %sha512-update %sha512-final))
 
 ;;;
 ;;; Digest framework
@@ -86,7 +97,8 @@
         [init   (string->symbol #"%sha~|n|-init")]
         [update (string->symbol #"%sha~|n|-update")]
         [final  (string->symbol #"%sha~|n|-final")]
-        [digest (string->symbol #"sha~|n|-digest")])
+        [digest (string->symbol #"sha~|n|-digest")]
+        [digest-string (string->symbol #"sha~|n|-digest-string")])
     `(begin
        (define-class ,meta (<message-digest-algorithm-meta>) ())
        (define-class ,cls (<message-digest-algorithm>)
@@ -103,7 +115,9 @@
        (define-method digest-final! ((self ,cls))
          (,final (slot-ref self'context)))
        (define-method digest ((class ,meta))
-         (,digest)))))
+         (,digest))
+       (define-method digest-string ((class ,meta) string)
+         (,digest-string string)))))
 
 (define-framework 1    64)
 (define-framework 224  64)
@@ -121,6 +135,7 @@
   ;; customization for sha2.h
   (.define SHA2_USE_INTTYPES_H)         ; use uintXX_t
   (.include "sha2.h")
+  (.include "shani.h")
 
   (.define LIBGAUCHE_EXT_BODY)
   (.include <gauche/extern.h>)      ; fix SCM_EXTERN in SCM_CLASS_DECL
@@ -175,6 +190,32 @@
  (define-cproc %sha512-update (ctx::<sha-context> data) ::<void>
    (common-update SHA512_Update ctx data))
 
+ ;; Feed the rest of the input port to the digest.  We read into a C
+ ;; buffer by Scm_Getz, so that no Scheme object is allocated per chunk.
+ (define-cise-stmt common-update-port
+   [(_ update ctx port)
+    `(let* ([buf::(.array char [8192])])
+       (loop
+        (let* ([n::ScmSize (Scm_Getz buf (sizeof buf) ,port)])
+          (when (<= n 0) (break))
+          (,update (& (-> ,ctx ctx)) (cast (const unsigned char*) buf) n))))])
+
+ (define-cproc %sha1-update-port (ctx::<sha-context> port::<input-port>)
+   ::<void>
+   (common-update-port SHA1_Update ctx port))
+ (define-cproc %sha224-update-port (ctx::<sha-context> port::<input-port>)
+   ::<void>
+   (common-update-port SHA224_Update ctx port))
+ (define-cproc %sha256-update-port (ctx::<sha-context> port::<input-port>)
+   ::<void>
+   (common-update-port SHA256_Update ctx port))
+ (define-cproc %sha384-update-port (ctx::<sha-context> port::<input-port>)
+   ::<void>
+   (common-update-port SHA384_Update ctx port))
+ (define-cproc %sha512-update-port (ctx::<sha-context> port::<input-port>)
+   ::<void>
+   (common-update-port SHA512_Update ctx port))
+
  (define-cise-stmt common-final
    [(_ final ctx size)
     `(let* ([digest::(.array (unsigned char) (,size))])
@@ -194,6 +235,14 @@
    (common-final SHA384_Final ctx SHA384_DIGEST_LENGTH))
  (define-cproc %sha512-final (ctx::<sha-context>)
    (common-final SHA512_Final ctx SHA512_DIGEST_LENGTH))
+
+ ;; SHA-1 and SHA-256 use the CPU's SHA extensions if available.
+ ;; These are mainly for testing and benchmarking; setting the flag
+ ;; to #t has no effect if the CPU doesn't support the extensions.
+ (define-cproc %sha-hardware-acceleration () ::<boolean>
+   (return (Scm__SHAExtAvailable)))
+ (define-cproc %sha-hardware-acceleration-set! (flag::<boolean>) ::<boolean>
+   (return (Scm__SHAExtSet flag)))
  )
 
 
@@ -36,6 +36,7 @@
 #include <string.h>	/* memcpy()/memset() or bcopy()/bzero() */
 #include <assert.h>	/* assert() */
 #include "sha2.h"
+#include "shani.h"	/* Gauche: hardware acceleration */
 
 /*
  * ASSERT NOTE:
@@ -639,6 +640,18 @@ void SHA1_Internal_Transform(SHA_CTX* context, const sha_word32* data) {
 
 #endif /* SHA2_UNROLL_TRANSFORM */
 
+/* Gauche: process NBLOCKS blocks, using SHA extensions if available */
+static void SHA1_Internal_Blocks(SHA_CTX* context, const sha_byte *data, size_t nblocks) {
+	if (Scm__SHAExtAvailable()) {
+		Scm__SHA1ExtBlocks(context->s1.state, data, nblocks);
+		return;
+	}
+	while (nblocks-- > 0) {
+		SHA1_Internal_Transform(context, (const sha_word32*)data);
+		data += 64;
+	}
+}
+
 void SHA1_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 	unsigned int	freespace, usedspace;
 	if (len == 0) {
@@ -660,7 +673,7 @@ void SHA1_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 			context->s1.bitcount += freespace << 3;
 			len -= freespace;
 			data += freespace;
-			SHA1_Internal_Transform(context, (sha_word32*)context->s1.buffer);
+			SHA1_Internal_Blocks(context, context->s1.buffer, 1);
 		} else {
 			/* The buffer is not yet full */
 			MEMCPY_BCOPY(&context->s1.buffer[usedspace], data, len);
@@ -670,12 +683,13 @@ void SHA1_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 			return;
 		}
 	}
-	while (len >= 64) {
+	if (len >= 64) {
 		/* Process as many complete blocks as we can */
-		SHA1_Internal_Transform(context, (sha_word32*)data);
-		context->s1.bitcount += 512;
-		len -= 64;
-		data += 64;
+		size_t nblocks = len / 64;
+		SHA1_Internal_Blocks(context, data, nblocks);
+		context->s1.bitcount += (sha_word64)nblocks << 9;
+		len -= nblocks * 64;
+		data += nblocks * 64;
 	}
 	if (len > 0) {
 		/* There's left-overs, so save 'em */
@@ -979,6 +993,18 @@ void SHA256_Internal_Transform(SHA_CTX* context, const sha_word32* data) {
 
 #endif /* SHA2_UNROLL_TRANSFORM */
 
+/* Gauche: process NBLOCKS blocks, using SHA extensions if available */
+static void SHA256_Internal_Blocks(SHA_CTX* context, const sha_byte *data, size_t nblocks) {
+	if (Scm__SHAExtAvailable()) {
+		Scm__SHA256ExtBlocks(context->s256.state, data, nblocks);
+		return;
+	}
+	while (nblocks-- > 0) {
+		SHA256_Internal_Transform(context, (const sha_word32*)data);
+		data += 64;
+	}
+}
+
 void SHA256_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 	unsigned int	freespace, usedspace;
 
@@ -1001,7 +1027,7 @@ void SHA256_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 			context->s256.bitcount += freespace << 3;
 			len -= freespace;
 			data += freespace;
-			SHA256_Internal_Transform(context, (sha_word32*)context->s256.buffer);
+			SHA256_Internal_Blocks(context, context->s256.buffer, 1);
 		} else {
 			/* The buffer is not yet full */
 			MEMCPY_BCOPY(&context->s256.buffer[usedspace], data, len);
@@ -1011,12 +1037,13 @@ void SHA256_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 			return;
 		}
 	}
-	while (len >= 64) {
+	if (len >= 64) {
 		/* Process as many complete blocks as we can */
-		SHA256_Internal_Transform(context, (sha_word32*)data);
-		context->s256.bitcount += 512;
-		len -= 64;
-		data += 64;
+		size_t nblocks = len / 64;
+		SHA256_Internal_Blocks(context, data, nblocks);
+		context->s256.bitcount += (sha_word64)nblocks << 9;
+		len -= nblocks * 64;
+		data += nblocks * 64;
 	}
 	if (len > 0) {
 		/* There's left-overs, so save 'em */
@@ -0,0 +1,256 @@
+/*
+ * shani.c - SHA-1 and SHA-256 block functions using x86 SHA extensions
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The functions here process NBLOCKS 64-byte blocks of DATA and update
+ * STATE, which is the same as s1.state and s256.state of SHA_CTX.
+ * sha2.c calls them instead of its own transform functions when
+ * Scm__SHAExtAvailable() returns true.
+ *
+ * We compile the functions with the target attribute, so that we don't
+ * need special compiler flags, and check the CPU feature at runtime.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "shani.h"
+
+#if defined(SCM_SHA_EXT_ENABLED)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+/* Returns 1 if the CPU has SHA extensions (and SSSE3/SSE4.1, which we
+   also use), 0 if not.  The result is cached; the race is harmless. */
+static int sha_ext = -1;
+
+int Scm__SHAExtAvailable(void)
+{
+    if (sha_ext < 0) {
+        unsigned int a, b, c, d;
+        int r = 0;
+        if (__get_cpuid_max(0, NULL) >= 7) {
+            __cpuid(1, a, b, c, d);
+            if ((c & bit_SSSE3) && (c & bit_SSE4_1)) {
+                __cpuid_count(7, 0, a, b, c, d);
+                if (b & (1U<<29)) r = 1; /* SHA */
+            }
+        }
+        sha_ext = r;
+    }
+    return sha_ext;
+}
+
+int Scm__SHAExtSet(int enable)
+{
+    sha_ext = -1;
+    if (enable) return Scm__SHAExtAvailable();
+    sha_ext = 0;
+    return 0;
+}
+
+/*
+ * SHA-1
+ *
+ * ABCD is kept in one register with A in the highest lane, and E in the
+ * highest lane of another.  Each sha1rnds4 performs 4 rounds.  Message
+ * words W[4g..4g+3] are also kept with the first word in the highest
+ * lane, and for g >= 4,
+ *
+ *   W_g = sha1msg2(sha1msg1(W_{g-4}, W_{g-3}) ^ W_{g-2}, W_{g-1})
+ */
+
+#define SHA1_ROUNDS4(g, func)                                           \
+    do {                                                                \
+        if ((g) >= 4) {                                                 \
+            W[(g)%4] = _mm_sha1msg2_epu32(                              \
+                _mm_xor_si128(_mm_sha1msg1_epu32(W[(g)%4], W[((g)+1)%4]), \
+                              W[((g)+2)%4]),                            \
+                W[((g)+3)%4]);                                          \
+        }                                                               \
+        e = ((g) == 0)                                                  \
+            ? _mm_add_epi32(e0, W[0])                                   \
+            : _mm_sha1nexte_epu32(eprev, W[(g)%4]);                     \
+        eprev = abcd;                                                   \
+        abcd = _mm_sha1rnds4_epu32(abcd, e, func);                      \
+    } while (0)
+
+__attribute__((target("sha,sse4.1,ssse3")))
+void Scm__SHA1ExtBlocks(uint32_t state[5], const uint8_t *data,
+                        size_t nblocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+                                        0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(
+        _mm_loadu_si128((const __m128i*)state), 0x1b);
+    __m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+    while (nblocks-- > 0) {
+        __m128i abcd_save = abcd, e0_save = e0;
+        __m128i W[4], e, eprev = e0;
+
+        for (int i=0; i<4; i++) {
+            W[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i*)(data + i*16)), mask);
+        }
+        /* Explicitly unrolled, so that W[] stays in registers. */
+        SHA1_ROUNDS4(0, 0);  SHA1_ROUNDS4(1, 0);  SHA1_ROUNDS4(2, 0);
+        SHA1_ROUNDS4(3, 0);  SHA1_ROUNDS4(4, 0);
+        SHA1_ROUNDS4(5, 1);  SHA1_ROUNDS4(6, 1);  SHA1_ROUNDS4(7, 1);
+        SHA1_ROUNDS4(8, 1);  SHA1_ROUNDS4(9, 1);
+        SHA1_ROUNDS4(10, 2); SHA1_ROUNDS4(11, 2); SHA1_ROUNDS4(12, 2);
+        SHA1_ROUNDS4(13, 2); SHA1_ROUNDS4(14, 2);
+        SHA1_ROUNDS4(15, 3); SHA1_ROUNDS4(16, 3); SHA1_ROUNDS4(17, 3);
+        SHA1_ROUNDS4(18, 3); SHA1_ROUNDS4(19, 3);
+
+        e0 = _mm_sha1nexte_epu32(eprev, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+        data += 64;
+    }
+
+    _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+/*
+ * SHA-256
+ *
+ * The state is kept as ABEF and CDGH, as sha256rnds2 requires.  Each
+ * sha256rnds2 performs 2 rounds, taking W+K from the lower 64 bits.
+ * For g >= 4, message words are
+ *
+ *   W_g = sha256msg2(sha256msg1(W_{g-4}, W_{g-3})
+ *                    + alignr(W_{g-1}, W_{g-2}, 4), W_{g-1})
+ */
+
+static const uint32_t K256[64] __attribute__((aligned(16))) = {
+    0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL,
+    0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+    0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL,
+    0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
+    0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL,
+    0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+    0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL,
+    0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
+    0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL,
+    0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
+    0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL,
+    0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+    0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL,
+    0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
+    0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL,
+    0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL
+};
+
+#define SHA256_ROUNDS4(g)                                               \
+    do {                                                                \
+        if ((g) >= 4) {                                                 \
+            __m128i t = _mm_add_epi32(                                  \
+                _mm_sha256msg1_epu32(W[(g)%4], W[((g)+1)%4]),           \
+                _mm_alignr_epi8(W[((g)+3)%4], W[((g)+2)%4], 4));        \
+            W[(g)%4] = _mm_sha256msg2_epu32(t, W[((g)+3)%4]);           \
+        }                                                               \
+        __m128i m = _mm_add_epi32(                                      \
+            W[(g)%4], _mm_load_si128((const __m128i*)&K256[(g)*4]));    \
+        s1 = _mm_sha256rnds2_epu32(s1, s0, m);                          \
+        s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(m, 0x0e)); \
+    } while (0)
+
+__attribute__((target("sha,sse4.1,ssse3")))
+void Scm__SHA256ExtBlocks(uint32_t state[8], const uint8_t *data,
+                          size_t nblocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(
+        _mm_loadu_si128((const __m128i*)&state[0]), 0xb1);      /* CDAB */
+    __m128i s1 = _mm_shuffle_epi32(
+        _mm_loadu_si128((const __m128i*)&state[4]), 0x1b);      /* EFGH */
+    __m128i s0 = _mm_alignr_epi8(tmp, s1, 8);                   /* ABEF */
+    s1 = _mm_blend_epi16(s1, tmp, 0xf0);                        /* CDGH */
+
+    while (nblocks-- > 0) {
+        __m128i s0_save = s0, s1_save = s1;
+        __m128i W[4];
+
+        for (int i=0; i<4; i++) {
+            W[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i*)(data + i*16)), mask);
+        }
+        /* Explicitly unrolled, so that W[] stays in registers. */
+        SHA256_ROUNDS4(0);  SHA256_ROUNDS4(1);  SHA256_ROUNDS4(2);
+        SHA256_ROUNDS4(3);  SHA256_ROUNDS4(4);  SHA256_ROUNDS4(5);
+        SHA256_ROUNDS4(6);  SHA256_ROUNDS4(7);  SHA256_ROUNDS4(8);
+        SHA256_ROUNDS4(9);  SHA256_ROUNDS4(10); SHA256_ROUNDS4(11);
+        SHA256_ROUNDS4(12); SHA256_ROUNDS4(13); SHA256_ROUNDS4(14);
+        SHA256_ROUNDS4(15);
+
+        s0 = _mm_add_epi32(s0, s0_save);
+        s1 = _mm_add_epi32(s1, s1_save);
+        data += 64;
+    }
+
+    tmp = _mm_shuffle_epi32(s0, 0x1b);                          /* FEBA */
+    s1 = _mm_shuffle_epi32(s1, 0xb1);                           /* DCHG */
+    s0 = _mm_blend_epi16(tmp, s1, 0xf0);                        /* DCBA */
+    s1 = _mm_alignr_epi8(s1, tmp, 8);                           /* HGFE */
+    _mm_storeu_si128((__m128i*)&state[0], s0);
+    _mm_storeu_si128((__m128i*)&state[4], s1);
+}
+
+#else  /* !SCM_SHA_EXT_ENABLED */
+
+int Scm__SHAExtAvailable(void)
+{
+    return 0;
+}
+
+int Scm__SHAExtSet(int enable)
+{
+    (void)enable;
+    return 0;
+}
+
+void Scm__SHA1ExtBlocks(uint32_t state[5], const uint8_t *data,
+                        size_t nblocks)
+{
+    (void)state; (void)data; (void)nblocks;
+}
+
+void Scm__SHA256ExtBlocks(uint32_t state[8], const uint8_t *data,
+                          size_t nblocks)
+{
+    (void)state; (void)data; (void)nblocks;
+}
+
+#endif /* !SCM_SHA_EXT_ENABLED */
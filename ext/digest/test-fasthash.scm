@@ -0,0 +1,89 @@
+;;
+;; test for fasthash module
+;;
+
+(test-section "fasthash")
+(use gauche.uvector)
+
+(use rfc.fasthash)
+(test-module 'rfc.fasthash)
+
+;; (input xxhash64 xxh3 crc32c murmurhash3)
+(define *fasthash-data*
+  (let1 v (rlet1 v (make-u8vector 1000)
+            (dotimes [i 1000] (u8vector-set! v i (modulo (* i 131) 251))))
+    `(("" 17241709254077376921 3244421341483603138 0 0)
+      ("a" 15154266338359012955 16629034431890738719 3251651376 1009084850)
+      ("abc" 4952883123889572249 8696274497037089104 910901175 3017643002)
+      ("123456789" 10139926970967174787 8276685427497336319
+       3808858755 3036607362)
+      ("message digest" 463544382707905470 1589083006243345657
+       45971920 1670332777)
+      ("The quick brown fox jumps over the lazy dog"
+       802816344064684476 14879076941462221669 576848900 776992547)
+      (,v 7404468962678767007 7793587806453321595 2847037212 3721521205))))
+
+(dolist [d *fasthash-data*]
+  (let ([input (car d)]
+        [label (if (string? (car d)) (car d) "u8vector")])
+    (for-each (^[name hash expected]
+                (test* #"~name ~|label|" expected (hash input))
+                (test* #"~name port ~|label|" expected
+                       (hash (if (string? input)
+                               (open-input-string input)
+                               (open-input-string (u8vector->string input))))))
+              '(xxhash64 xxh3 crc32c murmurhash3)
+              (list xxhash64 xxh3 crc32c murmurhash3)
+              (cdr d))))
+
+(test* "xxhash64 seed" 103598618232108297 (xxhash64 "abc" 12345))
+(test* "xxh3 seed" 8178084933791286736 (xxh3 "abc" 12345))
+(test* "xxh3 seed (long)" 11376178108255328018
+       (xxh3 (car (last *fasthash-data*)) 12345))
+(test* "murmurhash3 seed" 3451355215 (murmurhash3 "abc" 12345))
+(test* "crc32c continuation" (crc32c "123456789") (crc32c "56789" (crc32c "1234")))
+(test* "xxhash64 (error)" (test-error) (xxhash64 'foo))
+
+(test* "digest-hexify" '("44bc2cf5ad770999" "78af5f94892f3950" "364b3fb7" "b3dd93fa")
+       (map (^p (digest-hexify (p "abc")))
+            (list xxhash64-digest-string xxh3-digest-string
+                  crc32c-digest-string murmurhash3-digest-string)))
+(test* "digest" '("44bc2cf5ad770999" "78af5f94892f3950" "364b3fb7" "b3dd93fa")
+       (map (^p (digest-hexify (with-input-from-string "abc" p)))
+            (list xxhash64-digest xxh3-digest crc32c-digest murmurhash3-digest)))
+
+;; Incremental update must give the same result regardless of how the
+;; input is split.  XXH3 buffers 256 bytes and scrambles every 1024 bytes,
+;; so we go beyond those.
+(let1 v (rlet1 v (make-u8vector 5000)
+          (dotimes [i 5000] (u8vector-set! v i (modulo (* i 37) 253))))
+  (define (split-hash class n step)
+    (let1 d (make class)
+      (let loop ([i 0])
+        (if (>= i n)
+          (digest-final! d)
+          (let1 e (min n (+ i step))
+            (digest-update! d (u8vector-copy v i e))
+            (loop e))))))
+  (dolist [n '(0 3 16 17 128 129 240 241 256 257 1024 1025 5000)]
+    (dolist [class (list <xxhash64> <xxh3> <crc32c> <murmurhash3>)]
+      (test* #"~(class-name class) split ~n"
+             (make-list 5 (digest-string class (u8vector-copy v 0 n)))
+             (map (cut split-hash class n <>) '(1 7 64 100 300))))))
+
+(test* "seed initarg" (xxh3 "abc" 12345)
+       (let1 d (make <xxh3> :seed 12345)
+         (digest-update! d "abc")
+         (string->number (digest-hexify (digest-final! d)) 16)))
+
+;; CRC32C must not depend on whether the crc32 instruction is used.
+(let ([hw-set! (with-module rfc.fasthash %crc32c-hardware-acceleration-set!)]
+      [v (rlet1 v (make-u8vector 1000)
+           (dotimes [i 1000] (u8vector-set! v i (modulo (* i 131) 251))))])
+  (define (crcs)
+    (map (^n (crc32c (uvector-alias <u8vector> v (modulo n 8) n)))
+         '(8 9 15 16 17 100 1000)))
+  (let* ([hw (begin (hw-set! #t) (crcs))]
+         [sw (begin (hw-set! #f) (crcs))])
+    (test* "crc32c hardware acceleration" sw hw)
+    (hw-set! #t)))
@@ -4,6 +4,7 @@
 
 (test-section "md5")
 
+(use gauche.uvector)
 (use rfc.md5)
 (test-module 'rfc.md5)
 
@@ -21,3 +22,14 @@
    ("d174ab98d277d9f5a5611c2c9f419d9f" "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789")
    ("57edf4a22be3c955ac49da2e2107b67a" "12345678901234567890123456789012345678901234567890123456789012345678901234567890")))
 
+
+;; The direct input paths must agree with each other.
+(let1 v (rlet1 v (make-u8vector 20000)
+          (dotimes [i 20000] (u8vector-set! v i (modulo (* i 131) 251))))
+  (dolist [n '(0 1 63 64 65 8191 8192 8193 20000)]
+    (let* ([u (u8vector-copy v 0 n)]
+           [s (u8vector->string u)]
+           [d (md5-digest-string s)])
+      (test* #"md5-digest-string u8vector (~n)" d (md5-digest-string u))
+      (test* #"md5-digest (~n)" d (with-input-from-string s md5-digest))
+      (test* #"digest-string u8vector (~n)" d (digest-string <md5> u)))))
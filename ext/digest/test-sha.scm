@@ -7,6 +7,7 @@
 (use srfi-42)
 (use file.util)
 (use util.match)
+(use gauche.uvector)
 
 (use rfc.sha1)
 (test-module 'rfc.sha1)
@@ -99,3 +100,47 @@
 
 (for-each test-from-file (glob "data/*.info"))
 
+;; Direct input paths and hardware acceleration.
+;; The results must not depend on how the input is given, nor on whether
+;; the SHA extensions of the CPU are used.
+(let ()
+  (define accel-set! (with-module rfc.sha %sha-hardware-acceleration-set!))
+  (define (data n)
+    (rlet1 v (make-u8vector n)
+      (dotimes [i n] (u8vector-set! v i (modulo (* i 131) 251)))))
+  (define (digests n)
+    (let* ([v (data n)]
+           [s (u8vector->string v)])
+      (map (^[digest digest-string]
+             (list (digest-string s)
+                   (digest-string v)
+                   (with-input-from-string s digest)))
+           (list sha1-digest sha224-digest sha256-digest
+                 sha384-digest sha512-digest)
+           (list sha1-digest-string sha224-digest-string sha256-digest-string
+                 sha384-digest-string sha512-digest-string))))
+  (define (incremental class n)
+    (let ([v (data n)]
+          [d (make class)])
+      (dotimes [i n (digest-final! d)]
+        (digest-update! d (u8vector-copy v i (+ i 1))))))
+
+  (let1 orig (accel-set! #t)
+    (dolist [n '(0 1 55 56 63 64 65 127 128 129 1000 8191 8192 8193 100000)]
+      (let ([hw (begin (accel-set! #t) (digests n))]
+            [sw (begin (accel-set! #f) (digests n))])
+        (test* #"input paths (~n)" #t
+               (every (^[ds] (every (cut equal? (car ds) <>) (cdr ds))) sw))
+        (test* #"hardware acceleration (~n)" sw hw)))
+    (dolist [n '(0 63 64 65 200)]
+      (test* #"incremental update (~n)"
+             (list (begin (accel-set! #f) (incremental <sha1> n))
+                   (incremental <sha256> n))
+             (list (begin (accel-set! #t) (incremental <sha1> n))
+                   (incremental <sha256> n))))
+    (accel-set! orig)))
+
+(test* "digest-string <sha256> u8vector"
+       "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+       (digest-hexify (digest-string <sha256> '#u8(97 98 99))))
+
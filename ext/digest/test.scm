@@ -11,6 +11,7 @@
 
 (include "test-md5")
 (include "test-sha")
+(include "test-fasthash")
 (include "test-hmac")
 
 (test-end)
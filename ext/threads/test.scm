@@ -504,6 +504,34 @@
          (for-each thread-join! ts)
          (atom-ref a)))
 
+;;---------------------------------------------------------------------
+(test-section "concurrent hash table")
+
+(let ([h (make-concurrent-hash-table 'eqv?)]
+      [nthreads 10]
+      [n 2000])
+  (test* "concurrent update!" (* nthreads n)
+         (let1 ts (map (^_ (make-thread
+                            (^[] (dotimes [i n]
+                                   (concurrent-hash-table-update!
+                                    h (modulo i 37) (cut + <> 1) 0)))))
+                       (iota nthreads))
+           (for-each thread-start! ts)
+           (for-each thread-join! ts)
+           (concurrent-hash-table-fold h (^[k v s] (+ v s)) 0)))
+  (test* "concurrent put! and delete!" (* nthreads (quotient n 2))
+         (let1 ts (map (^t (make-thread
+                            (^[] (dotimes [i n]
+                                   (let1 k (+ 1000 (* t n) i)
+                                     (concurrent-hash-table-put! h k i)
+                                     (when (odd? i)
+                                       (concurrent-hash-table-delete! h k)))))))
+                       (iota nthreads))
+           (concurrent-hash-table-clear! h)
+           (for-each thread-start! ts)
+           (for-each thread-join! ts)
+           (concurrent-hash-table-num-entries h))))
+
 ;;---------------------------------------------------------------------
 (test-section "threads and promise")
 
@@ -650,5 +678,49 @@
            (let1 r (list (dequeue/wait! qq) (dequeue/wait! qq))
              (list* r0 r1 r)))))
 
+;;---------------------------------------------------------------------
+(test-section "profiling threads")
+
+(use gauche.vm.profiler)
+
+(define (prof-spin n) (if (= n 0) 0 (+ 1 (prof-spin (- n 1)))))
+
+;; The worker thread is created after the profiler starts, and finishes
+;; before the result is retrieved.
+(test* "profiling all threads" #t
+       (begin
+         (profiler-start :all-threads #t :period 1000)
+         (thread-join!
+          (thread-start!
+           (make-thread (^[] (dotimes [i 20000] (prof-spin 50)))
+                        'prof-worker)))
+         (let1 stacks (profiler-get-stacks)
+           (profiler-reset)
+           (any (^s (and (string? (caar s))
+                         (#/^prof-worker\[/ (caar s))
+                         (memq 'prof-spin (car s))
+                         #t))
+                stacks))))
+
+;; Threads block SIGPROF unless they are profiled.  A thread that exists
+;; before the profiler starts unblocks it at the next safe point.
+(test* "profiling a thread started before the profiler" #t
+       (let* ([go #f]
+              [t (thread-start!
+                  (make-thread (^[]
+                                 (until go (prof-spin 50))
+                                 (dotimes [i 20000] (prof-spin 50)))
+                               'prof-early))])
+         (profiler-start :all-threads #t :period 1000)
+         (set! go #t)
+         (thread-join! t)
+         (let1 stacks (profiler-get-stacks)
+           (profiler-reset)
+           (any (^s (and (string? (caar s))
+                         (#/^prof-early\[/ (caar s))
+                         (memq 'prof-spin (car s))
+                         #t))
+                stacks))))
+
 (test-end)
 
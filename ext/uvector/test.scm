@@ -1035,6 +1035,166 @@
 (dotprod-test-generate f64 #f64(32767 -32767 32767 -32767 32767)
                        #f64(32767 -32767 32767 -32767 32767))
 
+;;-------------------------------------------------------------------
+(test-section "reductions")
+
+(define-macro (reduce-test-generate tag v sum min max argmin argmax)
+  (define (proc name) (string->symbol #"~|tag|vector-~name"))
+  `(begin
+     (test* (format #f "~svector-sum ~s" ',tag ',v) ',sum
+            (,(proc 'sum) ',v))
+     (test* (format #f "~svector-min ~s" ',tag ',v) ',min
+            (,(proc 'min) ',v))
+     (test* (format #f "~svector-max ~s" ',tag ',v) ',max
+            (,(proc 'max) ',v))
+     (test* (format #f "~svector-argmin ~s" ',tag ',v) ',argmin
+            (,(proc 'argmin) ',v))
+     (test* (format #f "~svector-argmax ~s" ',tag ',v) ',argmax
+            (,(proc 'argmax) ',v))))
+
+(reduce-test-generate s8 #s8(3 -5 2 -5 3) -2 -5 3 1 0)
+(reduce-test-generate s8 #s8(127 127 127) 381 127 127 0 0)
+(reduce-test-generate u8 #u8(255 0 255 0) 510 0 255 1 0)
+(reduce-test-generate s16 #s16(-32768 -32768 1) -65535 -32768 1 0 2)
+(reduce-test-generate u16 #u16(65535 65535) 131070 65535 65535 0 0)
+(reduce-test-generate s32 #s32(-2147483648 -2147483648 7)
+                      -4294967289 -2147483648 7 0 2)
+(reduce-test-generate u32 #u32(4294967295 4294967295 0)
+                      8589934590 0 4294967295 2 0)
+(reduce-test-generate s64 #s64(-9223372036854775808 -9223372036854775808)
+                      -18446744073709551616
+                      -9223372036854775808 -9223372036854775808 0 0)
+(reduce-test-generate u64 #u64(18446744073709551615 1 18446744073709551615)
+                      36893488147419103231 1 18446744073709551615 1 0)
+(reduce-test-generate f16 #f16(1.0 -2.0 0.5) -0.5 -2.0 1.0 1 0)
+(reduce-test-generate f32 #f32(1.0 -2.0 0.5 -2.0) -2.5 -2.0 1.0 1 0)
+(reduce-test-generate f64 #f64(1.0 -2.0 0.5 1.0) 0.5 -2.0 1.0 1 0)
+
+(test* "s32vector-sum empty" 0 (s32vector-sum #s32()))
+(test* "f64vector-sum empty" 0.0 (f64vector-sum #f64()))
+(test* "u8vector-min empty" (test-error) (u8vector-min #u8()))
+(test* "f64vector-max empty" (test-error) (f64vector-max #f64()))
+(test* "u8vector-argmin empty" #f (u8vector-argmin #u8()))
+(test* "f64vector-argmax empty" #f (f64vector-argmax #f64()))
+
+;; The first one is taken among the equal elements, and NaN wins.
+(test* "f64vector-argmax ±0" 0 (f64vector-argmax #f64(-0.0 0.0)))
+(test* "f64vector-argmin ±0" 0 (f64vector-argmin #f64(0.0 -0.0)))
+(test* "f32vector-argmax NaN" 1 (f32vector-argmax #f32(1.0 +nan.0 2.0 +nan.0)))
+(test* "f32vector-argmin NaN" 1 (f32vector-argmin #f32(1.0 +nan.0 2.0 +nan.0)))
+(test* "f64vector-max NaN" #t (nan? (f64vector-max #f64(1.0 2.0 +nan.0))))
+(test* "f64vector-min NaN" #t (nan? (f64vector-min #f64(1.0 2.0 +nan.0))))
+
+;; The flonum sum is defined to be computed with eight partial sums.
+(test* "f64vector-sum order" 2.0
+       (f64vector-sum #f64(1e100 1.0 1.0 0 0 0 0 0 -1e100)))
+
+;;-------------------------------------------------------------------
+(test-section "SIMD kernels")
+
+;; The results must be the same whichever instruction set is used.
+;; The vectors are long enough to go through the kernels, and have
+;; the lengths that leave the tails for the generic code.
+
+(define uvector-simd-set! (with-module gauche.uvector %uvector-simd-set!))
+
+(define (pseudo-random-list n seed lo hi)
+  (let loop ([i 0] [x seed] [r '()])
+    (if (= i n)
+      (reverse r)
+      (let1 x (modulo (+ (* x 6364136223846793005) 1442695040888963407)
+                      (expt 2 64))
+        (loop (+ i 1) x (cons (+ lo (modulo (ash x -16) (- hi lo -1)))
+                              r))))))
+
+(define (ref-sum xs)                    ; see ${T}VectorSum in uvector.c.tmpl
+  (let1 acc (make-vector 8 -0.0)
+    (let loop ([i 0] [xs xs])
+      (unless (null? xs)
+        (vector-set! acc (modulo i 8) (+ (vector-ref acc (modulo i 8)) (car xs)))
+        (loop (+ i 1) (cdr xs))))
+    (let1 pair (^[k] (+ (vector-ref acc k) (vector-ref acc (+ k 1))))
+      (+ (+ (pair 0) (pair 2)) (+ (pair 4) (pair 6))))))
+
+(define (ref-arg xs pred)
+  (let loop ([i 1] [k 0] [m (car xs)] [xs (cdr xs)])
+    (cond [(null? xs) k]
+          [(pred (car xs) m) (loop (+ i 1) i (car xs) (cdr xs))]
+          [else (loop (+ i 1) k m (cdr xs))])))
+
+(define (simd-tests tag lo hi flonum?)
+  (define (uvproc name)
+    (global-variable-ref (find-module 'gauche.uvector) (string->symbol name)))
+  (define (proc name) (uvproc #"~|tag|vector-~name"))
+  (define list->vec (uvproc #"list->~|tag|vector"))
+  (define ->list (uvproc #"~|tag|vector->list"))
+  (define (clamp x) (if flonum? x (max lo (min hi x))))
+  (define (in-range? x) (or flonum? (<= lo x hi)))
+
+  (dolist [level '(0 1 2)]
+    (let1 level (uvector-simd-set! level)
+      (dolist [n '(1 7 31 64 100 1001)]
+        (let* ([xs (pseudo-random-list n (+ n 1) lo hi)]
+               [ys (pseudo-random-list n (+ n 2) lo hi)]
+               [xs (if flonum? (map (cut / <> 7) xs) xs)]
+               [ys (if flonum? (map (cut / <> 3) ys) ys)]
+               [x (list->vec xs)]
+               [y (list->vec ys)]
+               [xs (->list x)]
+               [ys (->list y)]
+               [name (^[op] (format #f "~svector-~a (level ~a, ~a elements)"
+                                    tag op level n))])
+          (dolist [op `((add ,+) (sub ,-) (mul ,*))]
+            (let ([f (proc (car op))]
+                  [ref (map (cadr op) xs ys)])
+              (test* (name (car op)) (list->vec (map clamp ref))
+                     (f x y 'both))
+              (test* (name #"~(car op)!") (list->vec (map clamp ref))
+                     (let1 z (uvector-copy x)
+                       ((proc #"~(car op)!") z y 'both)
+                       z))
+              (unless (every in-range? ref)
+                (test* (name #"~(car op) error") (test-error)
+                       (f x y)))))
+          (test* (name "add to itself") (list->vec (map clamp (map + xs xs)))
+                 (let1 z (uvector-copy x)
+                   ((proc 'add!) z z 'both)
+                   z))
+          (test* (name "sum")
+                 (if flonum? (ref-sum (map inexact xs)) (apply + xs))
+                 ((proc 'sum) x))
+          (test* (name "min") (apply min xs) ((proc 'min) x))
+          (test* (name "max") (apply max xs) ((proc 'max) x))
+          (test* (name "argmin") (ref-arg xs <) ((proc 'argmin) x))
+          (test* (name "argmax") (ref-arg xs >) ((proc 'argmax) x))
+          (unless flonum?
+            (test* (name "dot") (apply + (map * xs ys))
+                   ((proc 'dot) x y)))))))
+  (uvector-simd-set! 2))
+
+(simd-tests 'u8 0 255 #f)
+(simd-tests 's32 -2147483648 2147483647 #f)
+(simd-tests 's32 -1000 1000 #f)
+(simd-tests 'f32 -1000000 1000000 #t)
+(simd-tests 'f64 -1000000 1000000 #t)
+
+;; An overflow far from the beginning must be caught
+(test* "u8vector-add overflow at the end" (test-error)
+       (u8vector-add (make-u8vector 1000 1)
+                     (rlet1 v (make-u8vector 1000 1)
+                       (u8vector-set! v 999 255))))
+(test* "s32vector-add clamp at the end" '(2 2147483647)
+       (let1 v (s32vector-add (make-s32vector 1000 1)
+                              (rlet1 v (make-s32vector 1000 1)
+                                (s32vector-set! v 999 2147483647))
+                              'high)
+         (list (s32vector-ref v 998) (s32vector-ref v 999))))
+(test* "u8vector-dot long" (* 1000000 255 255)
+       (u8vector-dot (make-u8vector 1000000 255) (make-u8vector 1000000 255)))
+(test* "s32vector-dot long" (* 100000 -2147483648 -2147483648)
+       (s32vector-dot (make-s32vector 100000 -2147483648)
+                      (make-s32vector 100000 -2147483648)))
+
 ;;-------------------------------------------------------------------
 (test-section "range-check")
 
@@ -55,6 +55,8 @@
           f16vector-ref f16vector-set! f16vector-sub f16vector-sub!
           f16vector-swap-bytes f16vector-swap-bytes!
           f16vector=? f16vector?
+          f16vector-argmax f16vector-argmin f16vector-max f16vector-min
+          f16vector-sum
 
           f32vector f32vector->list f32vector->vector
           f32vector-add f32vector-add! f32vector-append
@@ -66,6 +68,8 @@
           f32vector-ref f32vector-set! f32vector-sub f32vector-sub!
           f32vector-swap-bytes f32vector-swap-bytes!
           f32vector=? f32vector?
+          f32vector-argmax f32vector-argmin f32vector-max f32vector-min
+          f32vector-sum
 
           f64vector f64vector->list f64vector->vector f64vector-add
           f64vector-add! f64vector-append f64vector-clamp f64vector-clamp!
@@ -75,6 +79,8 @@
           f64vector-range-check f64vector-ref f64vector-set! f64vector-sub
           f64vector-sub! f64vector-swap-bytes f64vector-swap-bytes! f64vector=?
           f64vector?
+          f64vector-argmax f64vector-argmin f64vector-max f64vector-min
+          f64vector-sum
 
           get-output-uvector
 
@@ -100,6 +106,8 @@
           s16vector-range-check s16vector-ref s16vector-set! s16vector-sub
           s16vector-sub! s16vector-swap-bytes s16vector-swap-bytes!
           s16vector-xor s16vector-xor! s16vector=? s16vector?
+          s16vector-argmax s16vector-argmin s16vector-max s16vector-min
+          s16vector-sum
 
           s32vector s32vector->list s32vector->string
           s32vector->vector s32vector-add s32vector-add! s32vector-and
@@ -110,6 +118,8 @@
           s32vector-range-check s32vector-ref s32vector-set! s32vector-sub
           s32vector-sub! s32vector-swap-bytes s32vector-swap-bytes!
           s32vector-xor s32vector-xor! s32vector=? s32vector?
+          s32vector-argmax s32vector-argmin s32vector-max s32vector-min
+          s32vector-sum
 
           s64vector s64vector->list
           s64vector->vector s64vector-add s64vector-add! s64vector-and
@@ -120,6 +130,8 @@
           s64vector-range-check s64vector-ref s64vector-set! s64vector-sub
           s64vector-sub! s64vector-swap-bytes s64vector-swap-bytes!
           s64vector-xor s64vector-xor! s64vector=? s64vector?
+          s64vector-argmax s64vector-argmin s64vector-max s64vector-min
+          s64vector-sum
 
           s8vector s8vector->list s8vector->string s8vector->vector
           s8vector-add s8vector-add! s8vector-and s8vector-and! s8vector-append
@@ -128,6 +140,8 @@
           s8vector-length s8vector-mul s8vector-mul! s8vector-multi-copy!
           s8vector-range-check s8vector-ref s8vector-set! s8vector-sub
           s8vector-sub! s8vector-xor s8vector-xor! s8vector=? s8vector?
+          s8vector-argmax s8vector-argmin s8vector-max s8vector-min
+          s8vector-sum
 
           string->s32vector string->s32vector! string->s8vector
           string->s8vector! string->u32vector string->u32vector!
@@ -142,6 +156,8 @@
           u16vector-range-check u16vector-ref u16vector-set! u16vector-sub
           u16vector-sub! u16vector-swap-bytes u16vector-swap-bytes!
           u16vector-xor u16vector-xor! u16vector=? u16vector?
+          u16vector-argmax u16vector-argmin u16vector-max u16vector-min
+          u16vector-sum
 
           u32vector u32vector->list u32vector->string
           u32vector->vector u32vector-add u32vector-add! u32vector-and
@@ -152,6 +168,8 @@
           u32vector-range-check u32vector-ref u32vector-set! u32vector-sub
           u32vector-sub! u32vector-swap-bytes u32vector-swap-bytes!
           u32vector-xor u32vector-xor! u32vector=? u32vector?
+          u32vector-argmax u32vector-argmin u32vector-max u32vector-min
+          u32vector-sum
 
           u64vector u64vector->list u64vector->vector u64vector-add
           u64vector-add! u64vector-and u64vector-and! u64vector-append
@@ -162,6 +180,8 @@
           u64vector-set! u64vector-sub u64vector-sub! u64vector-swap-bytes
           u64vector-swap-bytes! u64vector-xor u64vector-xor! u64vector=?
           u64vector?
+          u64vector-argmax u64vector-argmin u64vector-max u64vector-min
+          u64vector-sum
 
           u8vector u8vector->list u8vector->string u8vector->vector
           u8vector-add u8vector-add! u8vector-and u8vector-and! u8vector-append
@@ -170,6 +190,8 @@
           u8vector-length u8vector-mul u8vector-mul! u8vector-multi-copy!
           u8vector-range-check u8vector-ref u8vector-set! u8vector-sub
           u8vector-sub! u8vector-xor u8vector-xor! u8vector=? u8vector?
+          u8vector-argmax u8vector-argmin u8vector-max u8vector-min
+          u8vector-sum
 
           uvector-alias uvector-binary-search uvector-class-element-size
           uvector-copy uvector-copy! uvector-ref uvector-set! uvector-size
@@ -201,13 +223,22 @@
   (.define EXTUVECTOR_EXPORTS)
   (.include "gauche/uvector.h")
   (.include "gauche/priv/vectorP.h")
-  (.include "uvectorP.h")))
+  (.include "uvectorP.h")
+  (.include "uvsimd.h")))
 
 ;; uvlib.scm is generated by uvlib.scm.tmpl
 (inline-stub
  (include "./uvlib.scm")
  )
 
+;; Limits the SIMD instructions used by arithmetic and reduction
+;; procedures; 0 for none, 1 for SSE2, 2 for AVX2.  Returns the level
+;; actually used.  For testing and benchmarking.
+(inline-stub
+ (define-cproc %uvector-simd-set! (level::<int>) ::<int>
+   (return (Scm__UVSimdSet level)))
+ )
+
 
 ;;;
 ;;; Generic procedures
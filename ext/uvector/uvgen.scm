@@ -303,12 +303,35 @@
 ;; Uvector opertaion generator
 ;;
 
+;; Operations that have SIMD kernels in uvsimd.c, for each element type.
+(define *simd-ops*
+  '((f32 add sub mul div sum argminmax)
+    (f64 add sub mul div sum argminmax)
+    (s32 add sub mul dot sum argminmax)
+    (u8  add sub mul dot sum argminmax)))
+
+(define (simd-op? tag op)
+  (cond [(assq tag *simd-ops*) => (^p (memq op (cdr p)))]
+        [else #f]))
+
+;; ${SIMD d s0 s1 i size} runs the SIMD kernel on the elements from i,
+;; and returns the number of elements processed.
+(define (numop-simd rule opname Opname)
+  (^[d s0 s1 i size]
+    (let ([tag (string->symbol (getval rule 't))]
+          [T (getval rule 'T)])
+      (if (simd-op? tag (string->symbol opname))
+        #"NUMOP_SIMD(Scm__UV~|T|~|Opname|, ~|T|, ~|d|, ~|s0|, ~|s1|, ~|i|, ~|size|)"
+        "0"))))
+
 (define (generate-numop)
   (for-each (^[opname Opname Sopname]
               (dolist [rule (make-rules)]
                 (for-each (cute substitute <> `((opname  ,opname)
                                                 (Opname  ,Opname)
                                                 (Sopname ,Sopname)
+                                                (SIMD ,(numop-simd rule opname
+                                                                   Opname))
                                                 ,@rule))
                           *tmpl-numop*)))
             '("add" "sub" "mul")
@@ -318,6 +341,7 @@
     (for-each (cute substitute <> `((opname  "div")
                                     (Opname  "Div")
                                     (Sopname  "Div")
+                                    (SIMD ,(numop-simd rule "div" "Div"))
                                     ,@rule))
               *tmpl-numop*)))
 
@@ -353,9 +377,53 @@
         (case tag
           [(s64 u64) #"SCM_SET_INT64_ZERO(~r)"]
           [else #"~r = 0"]))
-      (for-each (cute substitute <> `((ZERO  ,ZERO) ,@rule))
+      (define (SIMD x y sacc)
+        (if (simd-op? tag 'dot)
+          #"~|tag|dot_simd(~|x|, ~|y|, ~|sacc|)"
+          "FALSE"))
+      (for-each (cute substitute <> `((ZERO  ,ZERO) (SIMD ,SIMD) ,@rule))
                 *tmpl-dotop*))))
 
+(define (generate-reduceop)
+  (dolist [rule (make-rules)]
+    (let ([tag (string->symbol (getval rule 't))]
+          [T (getval rule 'T)])
+      (define (ZERO r)
+        (case tag
+          [(s64 u64) #"SCM_SET_INT64_ZERO(~r)"]
+          [else #"~r = 0"]))
+      ;; Partial sums of flonums start from -0.0, so that the sum of
+      ;; -0.0's is -0.0.
+      (define (SUMZERO acc k)
+        (case tag
+          [(s64 u64) #"SCM_SET_INT64_ZERO(~|acc|[~|k|])"]
+          [(f16 f32 f64) #"~|acc|[~|k|] = -0.0"]
+          [else #"~|acc|[~|k|] = 0"]))
+      (define (LT a b)
+        (case tag
+          [(s64 u64) #"INT64LT(~|a|, ~|b|)"]
+          [else      #"(~a < ~b)"]))
+      (define (NANP v)
+        (case tag
+          [(f16 f32 f64) #"SCM_IS_NAN(~v)"]
+          [else "FALSE"]))
+      (define (SIMD_SUM x r sacc)
+        (if (simd-op? tag 'sum)
+          #"~|tag|sum_simd(~|x|, ~|r|, ~|sacc|)"
+          "FALSE"))
+      (define (SIMD_ARG x size maxp k)
+        (if (simd-op? tag 'argminmax)
+          #"Scm__UV~|T|ArgMinMax(SCM_~|T|VECTOR_ELEMENTS(~|x|), ~|size|, ~|maxp|, ~|k|)"
+          "FALSE"))
+      (for-each (cute substitute <> `((ZERO ,ZERO)
+                                      (SUMZERO ,SUMZERO)
+                                      (LT ,LT)
+                                      (NANP ,NANP)
+                                      (SIMD_SUM ,SIMD_SUM)
+                                      (SIMD_ARG ,SIMD_ARG)
+                                      ,@rule))
+                *tmpl-reduceop*))))
+
 (define (generate-rangeop)
   (dolist [rule (make-rules)]
     (let ([tag (string->symbol (getval rule 't))]
@@ -0,0 +1,846 @@
+/*
+ * uvsimd.c - SIMD kernels for uniform vector arithmetic
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Each kernel has an SSE2 version and an AVX2 version, compiled with
+ * the target attribute so that we don't need special compiler flags;
+ * which one to call is decided at runtime.  The kernels give exactly
+ * the same results as the generic code in uvector.c.tmpl: flonum
+ * operations are the same IEEE operations (we never use FMA), integer
+ * results out of range are left to the generic code, and the orders of
+ * flonum additions are fixed (see uvsimd.h).
+ */
+
+#include "uvsimd.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define UVSIMD_ENABLED 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/*=================================================================
+ * Dispatch
+ */
+
+static int simd_max = -1;       /* best level of the CPU; -1 if unknown */
+static int simd_level = -1;     /* level in use */
+
+static int detect_level(void)
+{
+#if defined(UVSIMD_ENABLED)
+    unsigned int a, b, c, d;
+    int level = SCM_UVSIMD_NONE;
+
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(d & bit_SSE2)) return level;
+    level = SCM_UVSIMD_SSE2;
+    /* AVX2 also needs the OS to save ymm registers. */
+    if ((c & bit_OSXSAVE) && __get_cpuid_max(0, NULL) >= 7) {
+        unsigned int xlo, xhi;
+        __asm__ volatile ("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+        if ((xlo & 6) == 6) {
+            __cpuid_count(7, 0, a, b, c, d);
+            if (b & bit_AVX2) level = SCM_UVSIMD_AVX2;
+        }
+    }
+    return level;
+#else
+    return SCM_UVSIMD_NONE;
+#endif
+}
+
+static inline int current_level(void)
+{
+    if (simd_level < 0) {
+        simd_max = detect_level();
+        simd_level = simd_max;
+    }
+    return simd_level;
+}
+
+int Scm__UVSimdSet(int level)
+{
+    current_level();
+    if (level < SCM_UVSIMD_NONE) level = SCM_UVSIMD_NONE;
+    simd_level = (level < simd_max)? level : simd_max;
+    return simd_level;
+}
+
+/* Adds up the partial sums of flonum sums. */
+static inline double fold8(const double *acc)
+{
+    return ((acc[0] + acc[1]) + (acc[2] + acc[3]))
+        + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+}
+
+#if defined(UVSIMD_ENABLED)
+
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+#define LOAD128(p)      _mm_loadu_si128((const __m128i*)(p))
+#define STORE128(p, v)  _mm_storeu_si128((__m128i*)(p), v)
+#define LOAD256(p)      _mm256_loadu_si256((const __m256i*)(p))
+#define STORE256(p, v)  _mm256_storeu_si256((__m256i*)(p), v)
+
+/*=================================================================
+ * Element-wise flonum operations
+ */
+
+#define FLONUM_BINOP(t, ty, sfx, op)                                    \
+    TARGET_SSE2 static size_t t##_##op##_sse2(ty *d, const ty *a,       \
+                                              const ty *b, size_t n)    \
+    {                                                                   \
+        const size_t w = 16/sizeof(ty);                                 \
+        size_t i = 0;                                                   \
+        for (; i + 2*w <= n; i += 2*w) {                                \
+            __typeof__(_mm_loadu_##sfx(a)) x0, x1;                      \
+            x0 = _mm_##op##_##sfx(_mm_loadu_##sfx(a+i),                 \
+                                  _mm_loadu_##sfx(b+i));                \
+            x1 = _mm_##op##_##sfx(_mm_loadu_##sfx(a+i+w),               \
+                                  _mm_loadu_##sfx(b+i+w));              \
+            _mm_storeu_##sfx(d+i, x0);                                  \
+            _mm_storeu_##sfx(d+i+w, x1);                                \
+        }                                                               \
+        return i;                                                       \
+    }                                                                   \
+    TARGET_AVX2 static size_t t##_##op##_avx2(ty *d, const ty *a,       \
+                                              const ty *b, size_t n)    \
+    {                                                                   \
+        const size_t w = 32/sizeof(ty);                                 \
+        size_t i = 0;                                                   \
+        for (; i + 2*w <= n; i += 2*w) {                                \
+            __typeof__(_mm256_loadu_##sfx(a)) x0, x1;                   \
+            x0 = _mm256_##op##_##sfx(_mm256_loadu_##sfx(a+i),           \
+                                     _mm256_loadu_##sfx(b+i));          \
+            x1 = _mm256_##op##_##sfx(_mm256_loadu_##sfx(a+i+w),         \
+                                     _mm256_loadu_##sfx(b+i+w));        \
+            _mm256_storeu_##sfx(d+i, x0);                               \
+            _mm256_storeu_##sfx(d+i+w, x1);                             \
+        }                                                               \
+        return i;                                                       \
+    }
+
+FLONUM_BINOP(f32, float, ps, add)
+FLONUM_BINOP(f32, float, ps, sub)
+FLONUM_BINOP(f32, float, ps, mul)
+FLONUM_BINOP(f32, float, ps, div)
+FLONUM_BINOP(f64, double, pd, add)
+FLONUM_BINOP(f64, double, pd, sub)
+FLONUM_BINOP(f64, double, pd, mul)
+FLONUM_BINOP(f64, double, pd, div)
+
+/*=================================================================
+ * Element-wise s32 operations
+ */
+
+/* Overflow happens iff the operands have the same sign and the
+   result has the other. */
+TARGET_SSE2 static size_t s32_add_sse2(int32_t *d, const int32_t *a,
+                                       const int32_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = LOAD128(a+i), y = LOAD128(b+i);
+        __m128i r = _mm_add_epi32(x, y);
+        __m128i v = _mm_and_si128(_mm_xor_si128(x, r), _mm_xor_si128(y, r));
+        if (_mm_movemask_ps(_mm_castsi128_ps(v))) break;
+        STORE128(d+i, r);
+    }
+    return i;
+}
+
+TARGET_AVX2 static size_t s32_add_avx2(int32_t *d, const int32_t *a,
+                                       const int32_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = LOAD256(a+i), y = LOAD256(b+i);
+        __m256i r = _mm256_add_epi32(x, y);
+        __m256i v = _mm256_and_si256(_mm256_xor_si256(x, r),
+                                     _mm256_xor_si256(y, r));
+        if (_mm256_movemask_ps(_mm256_castsi256_ps(v))) break;
+        STORE256(d+i, r);
+    }
+    return i;
+}
+
+/* Overflow happens iff the operands have different signs and the
+   result has the sign of the subtrahend. */
+TARGET_SSE2 static size_t s32_sub_sse2(int32_t *d, const int32_t *a,
+                                       const int32_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = LOAD128(a+i), y = LOAD128(b+i);
+        __m128i r = _mm_sub_epi32(x, y);
+        __m128i v = _mm_and_si128(_mm_xor_si128(x, y), _mm_xor_si128(x, r));
+        if (_mm_movemask_ps(_mm_castsi128_ps(v))) break;
+        STORE128(d+i, r);
+    }
+    return i;
+}
+
+TARGET_AVX2 static size_t s32_sub_avx2(int32_t *d, const int32_t *a,
+                                       const int32_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = LOAD256(a+i), y = LOAD256(b+i);
+        __m256i r = _mm256_sub_epi32(x, y);
+        __m256i v = _mm256_and_si256(_mm256_xor_si256(x, y),
+                                     _mm256_xor_si256(x, r));
+        if (_mm256_movemask_ps(_mm256_castsi256_ps(v))) break;
+        STORE256(d+i, r);
+    }
+    return i;
+}
+
+/* SSE2 doesn't have signed 32x32->64 multiplication, so we only have
+   the AVX2 version.  The full products of even and odd elements are
+   computed separately, and each is checked if it equals to its
+   low 32 bits sign-extended. */
+TARGET_AVX2 static size_t s32_mul_avx2(int32_t *d, const int32_t *a,
+                                       const int32_t *b, size_t n)
+{
+    const __m256i one = _mm256_set1_epi64x(1);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = LOAD256(a+i), y = LOAD256(b+i);
+        __m256i pe = _mm256_mul_epi32(x, y);
+        __m256i po = _mm256_mul_epi32(_mm256_srli_epi64(x, 32),
+                                      _mm256_srli_epi64(y, 32));
+        __m256i ok = _mm256_and_si256(
+            _mm256_cmpeq_epi64(pe, _mm256_mul_epi32(pe, one)),
+            _mm256_cmpeq_epi64(po, _mm256_mul_epi32(po, one)));
+        if (_mm256_movemask_epi8(ok) != -1) break;
+        STORE256(d+i, _mm256_blend_epi32(pe, _mm256_slli_epi64(po, 32),
+                                         0xaa));
+    }
+    return i;
+}
+
+/*=================================================================
+ * Element-wise u8 operations
+ */
+
+/* Overflow happens iff the wrapped sum differs from the saturated one. */
+TARGET_SSE2 static size_t u8_add_sse2(uint8_t *d, const uint8_t *a,
+                                      const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = LOAD128(a+i), y = LOAD128(b+i);
+        __m128i r = _mm_add_epi8(x, y);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(r, _mm_adds_epu8(x, y)))
+            != 0xffff) break;
+        STORE128(d+i, r);
+    }
+    return i;
+}
+
+TARGET_AVX2 static size_t u8_add_avx2(uint8_t *d, const uint8_t *a,
+                                      const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = LOAD256(a+i), y = LOAD256(b+i);
+        __m256i r = _mm256_add_epi8(x, y);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(r, _mm256_adds_epu8(x, y)))
+            != -1) break;
+        STORE256(d+i, r);
+    }
+    return i;
+}
+
+/* Underflow happens iff y > x. */
+TARGET_SSE2 static size_t u8_sub_sse2(uint8_t *d, const uint8_t *a,
+                                      const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = LOAD128(a+i), y = LOAD128(b+i);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(x, y), x))
+            != 0xffff) break;
+        STORE128(d+i, _mm_sub_epi8(x, y));
+    }
+    return i;
+}
+
+TARGET_AVX2 static size_t u8_sub_avx2(uint8_t *d, const uint8_t *a,
+                                      const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = LOAD256(a+i), y = LOAD256(b+i);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(x, y), x))
+            != -1) break;
+        STORE256(d+i, _mm256_sub_epi8(x, y));
+    }
+    return i;
+}
+
+/* Multiply in 16bit and check the upper bytes of the products. */
+TARGET_SSE2 static size_t u8_mul_sse2(uint8_t *d, const uint8_t *a,
+                                      const uint8_t *b, size_t n)
+{
+    const __m128i z = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = LOAD128(a+i), y = LOAD128(b+i);
+        __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(x, z),
+                                     _mm_unpacklo_epi8(y, z));
+        __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(x, z),
+                                     _mm_unpackhi_epi8(y, z));
+        __m128i u = _mm_srli_epi16(_mm_or_si128(lo, hi), 8);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(u, z)) != 0xffff) break;
+        STORE128(d+i, _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+/* AVX2 unpack and pack work within 128bit lanes, so they match up. */
+TARGET_AVX2 static size_t u8_mul_avx2(uint8_t *d, const uint8_t *a,
+                                      const uint8_t *b, size_t n)
+{
+    const __m256i z = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = LOAD256(a+i), y = LOAD256(b+i);
+        __m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(x, z),
+                                        _mm256_unpacklo_epi8(y, z));
+        __m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(x, z),
+                                        _mm256_unpackhi_epi8(y, z));
+        __m256i u = _mm256_srli_epi16(_mm256_or_si256(lo, hi), 8);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(u, z)) != -1) break;
+        STORE256(d+i, _mm256_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+/*=================================================================
+ * Sums
+ */
+
+TARGET_SSE2 static int f64_sum_sse2(const double *a, size_t n, double *r)
+{
+    __m128d s0 = _mm_set1_pd(-0.0), s1 = s0, s2 = s0, s3 = s0;
+    double acc[8];
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm_add_pd(s0, _mm_loadu_pd(a+i));
+        s1 = _mm_add_pd(s1, _mm_loadu_pd(a+i+2));
+        s2 = _mm_add_pd(s2, _mm_loadu_pd(a+i+4));
+        s3 = _mm_add_pd(s3, _mm_loadu_pd(a+i+6));
+    }
+    _mm_storeu_pd(acc, s0);
+    _mm_storeu_pd(acc+2, s1);
+    _mm_storeu_pd(acc+4, s2);
+    _mm_storeu_pd(acc+6, s3);
+    for (int k = 0; i < n; i++, k++) acc[k] += a[i];
+    *r = fold8(acc);
+    return 1;
+}
+
+TARGET_AVX2 static int f64_sum_avx2(const double *a, size_t n, double *r)
+{
+    __m256d s0 = _mm256_set1_pd(-0.0), s1 = s0;
+    double acc[8];
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_loadu_pd(a+i));
+        s1 = _mm256_add_pd(s1, _mm256_loadu_pd(a+i+4));
+    }
+    _mm256_storeu_pd(acc, s0);
+    _mm256_storeu_pd(acc+4, s1);
+    for (int k = 0; i < n; i++, k++) acc[k] += a[i];
+    *r = fold8(acc);
+    return 1;
+}
+
+/* f32 elements are converted to double, which is exact. */
+TARGET_SSE2 static int f32_sum_sse2(const float *a, size_t n, double *r)
+{
+    __m128d s0 = _mm_set1_pd(-0.0), s1 = s0, s2 = s0, s3 = s0;
+    double acc[8];
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 x = _mm_loadu_ps(a+i), y = _mm_loadu_ps(a+i+4);
+        s0 = _mm_add_pd(s0, _mm_cvtps_pd(x));
+        s1 = _mm_add_pd(s1, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+        s2 = _mm_add_pd(s2, _mm_cvtps_pd(y));
+        s3 = _mm_add_pd(s3, _mm_cvtps_pd(_mm_movehl_ps(y, y)));
+    }
+    _mm_storeu_pd(acc, s0);
+    _mm_storeu_pd(acc+2, s1);
+    _mm_storeu_pd(acc+4, s2);
+    _mm_storeu_pd(acc+6, s3);
+    for (int k = 0; i < n; i++, k++) acc[k] += (double)a[i];
+    *r = fold8(acc);
+    return 1;
+}
+
+TARGET_AVX2 static int f32_sum_avx2(const float *a, size_t n, double *r)
+{
+    __m256d s0 = _mm256_set1_pd(-0.0), s1 = s0;
+    double acc[8];
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_cvtps_pd(_mm_loadu_ps(a+i)));
+        s1 = _mm256_add_pd(s1, _mm256_cvtps_pd(_mm_loadu_ps(a+i+4)));
+    }
+    _mm256_storeu_pd(acc, s0);
+    _mm256_storeu_pd(acc+4, s1);
+    for (int k = 0; i < n; i++, k++) acc[k] += (double)a[i];
+    *r = fold8(acc);
+    return 1;
+}
+
+/* The elements are sign-extended to 64bit.  Since the vector size fits
+   in int, the sum never overflows. */
+TARGET_SSE2 static int s32_sum_sse2(const int32_t *a, size_t n, int64_t *r)
+{
+    const __m128i z = _mm_setzero_si128();
+    __m128i s0 = z, s1 = z;
+    int64_t acc[4];
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = LOAD128(a+i);
+        __m128i sg = _mm_cmpgt_epi32(z, x);
+        s0 = _mm_add_epi64(s0, _mm_unpacklo_epi32(x, sg));
+        s1 = _mm_add_epi64(s1, _mm_unpackhi_epi32(x, sg));
+    }
+    STORE128(acc, s0);
+    STORE128(acc+2, s1);
+    int64_t s = acc[0] + acc[1] + acc[2] + acc[3];
+    for (; i < n; i++) s += a[i];
+    *r = s;
+    return 1;
+}
+
+TARGET_AVX2 static int s32_sum_avx2(const int32_t *a, size_t n, int64_t *r)
+{
+    __m256i s0 = _mm256_setzero_si256(), s1 = s0;
+    int64_t acc[8];
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_epi64(s0, _mm256_cvtepi32_epi64(LOAD128(a+i)));
+        s1 = _mm256_add_epi64(s1, _mm256_cvtepi32_epi64(LOAD128(a+i+4)));
+    }
+    STORE256(acc, s0);
+    STORE256(acc+4, s1);
+    int64_t s = 0;
+    for (int k = 0; k < 8; k++) s += acc[k];
+    for (; i < n; i++) s += a[i];
+    *r = s;
+    return 1;
+}
+
+TARGET_SSE2 static int u8_sum_sse2(const uint8_t *a, size_t n, uint64_t *r)
+{
+    const __m128i z = _mm_setzero_si128();
+    __m128i s = z;
+    uint64_t acc[2];
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        s = _mm_add_epi64(s, _mm_sad_epu8(LOAD128(a+i), z));
+    }
+    STORE128(acc, s);
+    uint64_t t = acc[0] + acc[1];
+    for (; i < n; i++) t += a[i];
+    *r = t;
+    return 1;
+}
+
+TARGET_AVX2 static int u8_sum_avx2(const uint8_t *a, size_t n, uint64_t *r)
+{
+    const __m256i z = _mm256_setzero_si256();
+    __m256i s = z;
+    uint64_t acc[4];
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        s = _mm256_add_epi64(s, _mm256_sad_epu8(LOAD256(a+i), z));
+    }
+    STORE256(acc, s);
+    uint64_t t = acc[0] + acc[1] + acc[2] + acc[3];
+    for (; i < n; i++) t += a[i];
+    *r = t;
+    return 1;
+}
+
+/*=================================================================
+ * Dot products
+ */
+
+/* The elements are widened to 16bit and multiplied-and-added pairwise
+   into 32bit lanes.  A lane gains at most 4*255*255 per iteration, so
+   we move the lanes to 64bit accumulators well before they overflow. */
+#define U8DOT_FLUSH 4096
+
+TARGET_SSE2 static int u8_dot_sse2(const uint8_t *a, const uint8_t *b,
+                                   size_t n, uint64_t *r)
+{
+    const __m128i z = _mm_setzero_si128();
+    __m128i s32 = z, s64 = z;
+    uint64_t acc[2];
+    size_t i = 0;
+    int cnt = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = LOAD128(a+i), y = LOAD128(b+i);
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(x, z),
+                                    _mm_unpacklo_epi8(y, z));
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(x, z),
+                                    _mm_unpackhi_epi8(y, z));
+        s32 = _mm_add_epi32(s32, _mm_add_epi32(lo, hi));
+        if (++cnt == U8DOT_FLUSH) {
+            s64 = _mm_add_epi64(s64, _mm_unpacklo_epi32(s32, z));
+            s64 = _mm_add_epi64(s64, _mm_unpackhi_epi32(s32, z));
+            s32 = z;
+            cnt = 0;
+        }
+    }
+    s64 = _mm_add_epi64(s64, _mm_unpacklo_epi32(s32, z));
+    s64 = _mm_add_epi64(s64, _mm_unpackhi_epi32(s32, z));
+    STORE128(acc, s64);
+    uint64_t t = acc[0] + acc[1];
+    for (; i < n; i++) t += (uint64_t)a[i] * b[i];
+    *r = t;
+    return 1;
+}
+
+TARGET_AVX2 static int u8_dot_avx2(const uint8_t *a, const uint8_t *b,
+                                   size_t n, uint64_t *r)
+{
+    const __m256i z = _mm256_setzero_si256();
+    __m256i s32 = z, s64 = z;
+    uint64_t acc[4];
+    size_t i = 0;
+    int cnt = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = LOAD256(a+i), y = LOAD256(b+i);
+        __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(x, z),
+                                       _mm256_unpacklo_epi8(y, z));
+        __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(x, z),
+                                       _mm256_unpackhi_epi8(y, z));
+        s32 = _mm256_add_epi32(s32, _mm256_add_epi32(lo, hi));
+        if (++cnt == U8DOT_FLUSH) {
+            s64 = _mm256_add_epi64(s64, _mm256_unpacklo_epi32(s32, z));
+            s64 = _mm256_add_epi64(s64, _mm256_unpackhi_epi32(s32, z));
+            s32 = z;
+            cnt = 0;
+        }
+    }
+    s64 = _mm256_add_epi64(s64, _mm256_unpacklo_epi32(s32, z));
+    s64 = _mm256_add_epi64(s64, _mm256_unpackhi_epi32(s32, z));
+    STORE256(acc, s64);
+    uint64_t t = acc[0] + acc[1] + acc[2] + acc[3];
+    for (; i < n; i++) t += (uint64_t)a[i] * b[i];
+    *r = t;
+    return 1;
+}
+
+/* The sum of s32 products can exceed 64bit.  We split each 64bit
+   product p into its low 32 bits, its high 32 bits as unsigned, and its
+   sign, so that p = lo + (hi << 32) - (sign << 64).  Each part is summed
+   in 64bit lanes without overflow, and the parts are combined into a
+   128bit integer at the end.  Only the AVX2 version is provided, for
+   SSE2 lacks signed 32x32->64 multiplication. */
+TARGET_AVX2 static int s32_dot_avx2(const int32_t *a, const int32_t *b,
+                                    size_t n, int64_t *hi, uint64_t *lo)
+{
+    const __m256i mask = _mm256_set1_epi64x(0xffffffffLL);
+    __m256i sl = _mm256_setzero_si256(), sh = sl, sn = sl;
+    uint64_t al[4], ah[4], an[4];
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = LOAD256(a+i), y = LOAD256(b+i);
+        __m256i pe = _mm256_mul_epi32(x, y);
+        __m256i po = _mm256_mul_epi32(_mm256_srli_epi64(x, 32),
+                                      _mm256_srli_epi64(y, 32));
+        sl = _mm256_add_epi64(sl, _mm256_add_epi64(_mm256_and_si256(pe, mask),
+                                                   _mm256_and_si256(po, mask)));
+        sh = _mm256_add_epi64(sh, _mm256_add_epi64(_mm256_srli_epi64(pe, 32),
+                                                   _mm256_srli_epi64(po, 32)));
+        sn = _mm256_add_epi64(sn, _mm256_add_epi64(_mm256_srli_epi64(pe, 63),
+                                                   _mm256_srli_epi64(po, 63)));
+    }
+    STORE256(al, sl);
+    STORE256(ah, sh);
+    STORE256(an, sn);
+    uint64_t l = al[0] + al[1] + al[2] + al[3];
+    uint64_t h = ah[0] + ah[1] + ah[2] + ah[3];
+    uint64_t g = an[0] + an[1] + an[2] + an[3];
+    for (; i < n; i++) {
+        uint64_t p = (uint64_t)((int64_t)a[i] * b[i]);
+        l += p & 0xffffffffULL;
+        h += p >> 32;
+        g += p >> 63;
+    }
+    uint64_t low = l + (h << 32);
+    *lo = low;
+    *hi = (int64_t)((h >> 32) + (low < l) - g);
+    return 1;
+}
+
+/*=================================================================
+ * Argmin and argmax
+ */
+
+/* The first pass finds the extreme value, watching for NaNs, and the
+   second pass finds the first element that equals to it.  Vectors
+   shorter than a register are left to the generic code. */
+#define DEF_ARGMINMAX(name, target, ty, vt, w, LOAD, STORE, MIN, MAX,   \
+                      NANACC, HASNAN, ISNAN, EQMASK, BCAST, ZERO)       \
+    target static int name(const ty *a, size_t n, int maxp, size_t *k)  \
+    {                                                                   \
+        vt m, nan = ZERO;                                               \
+        ty buf[w], best;                                                \
+        size_t i;                                                       \
+                                                                        \
+        if (n < w) return 0;                                            \
+        m = LOAD(a);                                                    \
+        nan = NANACC(nan, m);                                           \
+        if (maxp) {                                                     \
+            for (i = w; i + w <= n; i += w) {                           \
+                vt x = LOAD(a+i);                                       \
+                nan = NANACC(nan, x);                                   \
+                m = MAX(m, x);                                          \
+            }                                                           \
+        } else {                                                        \
+            for (i = w; i + w <= n; i += w) {                           \
+                vt x = LOAD(a+i);                                       \
+                nan = NANACC(nan, x);                                   \
+                m = MIN(m, x);                                          \
+            }                                                           \
+        }                                                               \
+        if (HASNAN(nan)) goto found_nan;                                \
+        STORE(buf, m);                                                  \
+        best = buf[0];                                                  \
+        for (size_t j = 1; j < w; j++) {                                \
+            if (maxp? (buf[j] > best) : (buf[j] < best)) best = buf[j]; \
+        }                                                               \
+        for (; i < n; i++) {                                            \
+            if (ISNAN(a[i])) goto found_nan;                            \
+            if (maxp? (a[i] > best) : (a[i] < best)) best = a[i];       \
+        }                                                               \
+        m = BCAST(best);                                                \
+        for (i = 0; i + w <= n; i += w) {                               \
+            unsigned int mk = (unsigned int)EQMASK(LOAD(a+i), m);       \
+            if (mk) { *k = i + __builtin_ctz(mk); return 1; }           \
+        }                                                               \
+        for (; a[i] != best; i++)                                       \
+            ;                                                           \
+        *k = i;                                                         \
+        return 1;                                                       \
+      found_nan:                                                        \
+        for (i = 0; !ISNAN(a[i]); i++)                                  \
+            ;                                                           \
+        *k = i;                                                         \
+        return 1;                                                       \
+    }
+
+#define FLO_ISNAN(x)      ((x) != (x))
+#define INT_ISNAN(x)      0
+#define INT_NANACC(acc,x) (acc)
+#define INT_HASNAN(acc)   0
+
+/* f64 */
+#define F64_NANACC128(acc, x) _mm_or_pd(acc, _mm_cmpunord_pd(x, x))
+#define F64_HASNAN128(acc)    _mm_movemask_pd(acc)
+#define F64_EQMASK128(x, y)   _mm_movemask_pd(_mm_cmpeq_pd(x, y))
+DEF_ARGMINMAX(f64_argminmax_sse2, TARGET_SSE2, double, __m128d, 2,
+              _mm_loadu_pd, _mm_storeu_pd, _mm_min_pd, _mm_max_pd,
+              F64_NANACC128, F64_HASNAN128, FLO_ISNAN, F64_EQMASK128,
+              _mm_set1_pd, _mm_setzero_pd())
+
+#define F64_NANACC256(acc, x) \
+    _mm256_or_pd(acc, _mm256_cmp_pd(x, x, _CMP_UNORD_Q))
+#define F64_HASNAN256(acc)    _mm256_movemask_pd(acc)
+#define F64_EQMASK256(x, y)   \
+    _mm256_movemask_pd(_mm256_cmp_pd(x, y, _CMP_EQ_OQ))
+DEF_ARGMINMAX(f64_argminmax_avx2, TARGET_AVX2, double, __m256d, 4,
+              _mm256_loadu_pd, _mm256_storeu_pd, _mm256_min_pd, _mm256_max_pd,
+              F64_NANACC256, F64_HASNAN256, FLO_ISNAN, F64_EQMASK256,
+              _mm256_set1_pd, _mm256_setzero_pd())
+
+/* f32 */
+#define F32_NANACC128(acc, x) _mm_or_ps(acc, _mm_cmpunord_ps(x, x))
+#define F32_HASNAN128(acc)    _mm_movemask_ps(acc)
+#define F32_EQMASK128(x, y)   _mm_movemask_ps(_mm_cmpeq_ps(x, y))
+DEF_ARGMINMAX(f32_argminmax_sse2, TARGET_SSE2, float, __m128, 4,
+              _mm_loadu_ps, _mm_storeu_ps, _mm_min_ps, _mm_max_ps,
+              F32_NANACC128, F32_HASNAN128, FLO_ISNAN, F32_EQMASK128,
+              _mm_set1_ps, _mm_setzero_ps())
+
+#define F32_NANACC256(acc, x) \
+    _mm256_or_ps(acc, _mm256_cmp_ps(x, x, _CMP_UNORD_Q))
+#define F32_HASNAN256(acc)    _mm256_movemask_ps(acc)
+#define F32_EQMASK256(x, y)   \
+    _mm256_movemask_ps(_mm256_cmp_ps(x, y, _CMP_EQ_OQ))
+DEF_ARGMINMAX(f32_argminmax_avx2, TARGET_AVX2, float, __m256, 8,
+              _mm256_loadu_ps, _mm256_storeu_ps, _mm256_min_ps, _mm256_max_ps,
+              F32_NANACC256, F32_HASNAN256, FLO_ISNAN, F32_EQMASK256,
+              _mm256_set1_ps, _mm256_setzero_ps())
+
+/* s32.  SSE2 lacks min/max of signed 32bit integers. */
+#define S32_SEL128(g, x, y) \
+    _mm_or_si128(_mm_and_si128(g, x), _mm_andnot_si128(g, y))
+#define S32_MIN128(x, y)    S32_SEL128(_mm_cmpgt_epi32(y, x), x, y)
+#define S32_MAX128(x, y)    S32_SEL128(_mm_cmpgt_epi32(x, y), x, y)
+#define S32_EQMASK128(x, y) \
+    _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, y)))
+DEF_ARGMINMAX(s32_argminmax_sse2, TARGET_SSE2, int32_t, __m128i, 4,
+              LOAD128, STORE128, S32_MIN128, S32_MAX128,
+              INT_NANACC, INT_HASNAN, INT_ISNAN, S32_EQMASK128,
+              _mm_set1_epi32, _mm_setzero_si128())
+
+#define S32_EQMASK256(x, y) \
+    _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, y)))
+DEF_ARGMINMAX(s32_argminmax_avx2, TARGET_AVX2, int32_t, __m256i, 8,
+              LOAD256, STORE256, _mm256_min_epi32, _mm256_max_epi32,
+              INT_NANACC, INT_HASNAN, INT_ISNAN, S32_EQMASK256,
+              _mm256_set1_epi32, _mm256_setzero_si256())
+
+/* u8 */
+#define U8_EQMASK128(x, y)  _mm_movemask_epi8(_mm_cmpeq_epi8(x, y))
+DEF_ARGMINMAX(u8_argminmax_sse2, TARGET_SSE2, uint8_t, __m128i, 16,
+              LOAD128, STORE128, _mm_min_epu8, _mm_max_epu8,
+              INT_NANACC, INT_HASNAN, INT_ISNAN, U8_EQMASK128,
+              _mm_set1_epi8, _mm_setzero_si128())
+
+#define U8_EQMASK256(x, y)  _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y))
+DEF_ARGMINMAX(u8_argminmax_avx2, TARGET_AVX2, uint8_t, __m256i, 32,
+              LOAD256, STORE256, _mm256_min_epu8, _mm256_max_epu8,
+              INT_NANACC, INT_HASNAN, INT_ISNAN, U8_EQMASK256,
+              _mm256_set1_epi8, _mm256_setzero_si256())
+
+#define DISPATCH(kernel, args)                                  \
+    do {                                                        \
+        switch (current_level()) {                              \
+        case SCM_UVSIMD_AVX2: return kernel##_avx2 args;        \
+        case SCM_UVSIMD_SSE2: return kernel##_sse2 args;        \
+        default: return 0;                                      \
+        }                                                       \
+    } while (0)
+
+#define DISPATCH_AVX2(kernel, args)                             \
+    do {                                                        \
+        if (current_level() >= SCM_UVSIMD_AVX2) {               \
+            return kernel##_avx2 args;                          \
+        }                                                       \
+        return 0;                                               \
+    } while (0)
+
+#else  /* !UVSIMD_ENABLED */
+
+#define DISPATCH(kernel, args)       return 0
+#define DISPATCH_AVX2(kernel, args)  return 0
+
+#endif /* !UVSIMD_ENABLED */
+
+/*=================================================================
+ * Entry points
+ */
+
+#define DEF_BINOP(Name, kernel, ty, dispatch)                           \
+    size_t Name(ty *d, const ty *a, const ty *b, size_t n)              \
+    {                                                                   \
+        dispatch(kernel, (d, a, b, n));                                 \
+    }
+
+DEF_BINOP(Scm__UVF32Add, f32_add, float, DISPATCH)
+DEF_BINOP(Scm__UVF32Sub, f32_sub, float, DISPATCH)
+DEF_BINOP(Scm__UVF32Mul, f32_mul, float, DISPATCH)
+DEF_BINOP(Scm__UVF32Div, f32_div, float, DISPATCH)
+DEF_BINOP(Scm__UVF64Add, f64_add, double, DISPATCH)
+DEF_BINOP(Scm__UVF64Sub, f64_sub, double, DISPATCH)
+DEF_BINOP(Scm__UVF64Mul, f64_mul, double, DISPATCH)
+DEF_BINOP(Scm__UVF64Div, f64_div, double, DISPATCH)
+DEF_BINOP(Scm__UVS32Add, s32_add, int32_t, DISPATCH)
+DEF_BINOP(Scm__UVS32Sub, s32_sub, int32_t, DISPATCH)
+DEF_BINOP(Scm__UVS32Mul, s32_mul, int32_t, DISPATCH_AVX2)
+DEF_BINOP(Scm__UVU8Add, u8_add, uint8_t, DISPATCH)
+DEF_BINOP(Scm__UVU8Sub, u8_sub, uint8_t, DISPATCH)
+DEF_BINOP(Scm__UVU8Mul, u8_mul, uint8_t, DISPATCH)
+
+int Scm__UVF32Sum(const float *a, size_t n, double *r)
+{
+    DISPATCH(f32_sum, (a, n, r));
+}
+
+int Scm__UVF64Sum(const double *a, size_t n, double *r)
+{
+    DISPATCH(f64_sum, (a, n, r));
+}
+
+int Scm__UVS32Sum(const int32_t *a, size_t n, int64_t *r)
+{
+    DISPATCH(s32_sum, (a, n, r));
+}
+
+int Scm__UVU8Sum(const uint8_t *a, size_t n, uint64_t *r)
+{
+    DISPATCH(u8_sum, (a, n, r));
+}
+
+int Scm__UVS32Dot(const int32_t *a, const int32_t *b, size_t n,
+                  int64_t *hi, uint64_t *lo)
+{
+    DISPATCH_AVX2(s32_dot, (a, b, n, hi, lo));
+}
+
+int Scm__UVU8Dot(const uint8_t *a, const uint8_t *b, size_t n, uint64_t *r)
+{
+    DISPATCH(u8_dot, (a, b, n, r));
+}
+
+int Scm__UVF32ArgMinMax(const float *a, size_t n, int maxp, size_t *k)
+{
+    DISPATCH(f32_argminmax, (a, n, maxp, k));
+}
+
+int Scm__UVF64ArgMinMax(const double *a, size_t n, int maxp, size_t *k)
+{
+    DISPATCH(f64_argminmax, (a, n, maxp, k));
+}
+
+int Scm__UVS32ArgMinMax(const int32_t *a, size_t n, int maxp, size_t *k)
+{
+    DISPATCH(s32_argminmax, (a, n, maxp, k));
+}
+
+int Scm__UVU8ArgMinMax(const uint8_t *a, size_t n, int maxp, size_t *k)
+{
+    DISPATCH(u8_argminmax, (a, n, maxp, k));
+}
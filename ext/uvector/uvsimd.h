@@ -0,0 +1,102 @@
+/*
+ * uvsimd.h - SIMD kernels for uniform vector arithmetic
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_UVSIMD_H
+#define GAUCHE_UVSIMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The kernels work on raw element arrays, and the callers in uvector.c
+ * fall back to the generic code for whatever the kernels leave.  On
+ * platforms without the SIMD support, every kernel returns 0 without
+ * doing anything.
+ */
+
+/* Instruction set levels.  The best one the CPU supports is chosen
+   at the first use. */
+enum {
+    SCM_UVSIMD_NONE,
+    SCM_UVSIMD_SSE2,
+    SCM_UVSIMD_AVX2
+};
+
+/* Limits the level to use, mainly for testing and benchmarking.
+   Returns the new level, which can be lower than LEVEL. */
+extern int Scm__UVSimdSet(int level);
+
+/* Element-wise d[i] = a[i] op b[i].  They process the elements from the
+   beginning, and return the number of elements processed.  The integer
+   kernels stop before a chunk with a result out of the element range,
+   leaving the clamping or the error to the caller.  D may be the same
+   array as A or B, but must not overlap them otherwise. */
+extern size_t Scm__UVF32Add(float *d, const float *a, const float *b, size_t n);
+extern size_t Scm__UVF32Sub(float *d, const float *a, const float *b, size_t n);
+extern size_t Scm__UVF32Mul(float *d, const float *a, const float *b, size_t n);
+extern size_t Scm__UVF32Div(float *d, const float *a, const float *b, size_t n);
+extern size_t Scm__UVF64Add(double *d, const double *a, const double *b, size_t n);
+extern size_t Scm__UVF64Sub(double *d, const double *a, const double *b, size_t n);
+extern size_t Scm__UVF64Mul(double *d, const double *a, const double *b, size_t n);
+extern size_t Scm__UVF64Div(double *d, const double *a, const double *b, size_t n);
+extern size_t Scm__UVS32Add(int32_t *d, const int32_t *a, const int32_t *b, size_t n);
+extern size_t Scm__UVS32Sub(int32_t *d, const int32_t *a, const int32_t *b, size_t n);
+extern size_t Scm__UVS32Mul(int32_t *d, const int32_t *a, const int32_t *b, size_t n);
+extern size_t Scm__UVU8Add(uint8_t *d, const uint8_t *a, const uint8_t *b, size_t n);
+extern size_t Scm__UVU8Sub(uint8_t *d, const uint8_t *a, const uint8_t *b, size_t n);
+extern size_t Scm__UVU8Mul(uint8_t *d, const uint8_t *a, const uint8_t *b, size_t n);
+
+/* Reductions.  They return nonzero and set the result if they've done
+   the job.  Flonum sums are computed in double with eight partial sums,
+   where the i-th element is added to the (i mod 8)-th sum, and the
+   partial sums are added pairwise at the end; the generic code in
+   uvector.c.tmpl does the same, so the result doesn't depend on the
+   level.  The s32 dot product is returned as a 128bit integer,
+   (*hi << 64) + *lo. */
+extern int Scm__UVF32Sum(const float *a, size_t n, double *r);
+extern int Scm__UVF64Sum(const double *a, size_t n, double *r);
+extern int Scm__UVS32Sum(const int32_t *a, size_t n, int64_t *r);
+extern int Scm__UVU8Sum(const uint8_t *a, size_t n, uint64_t *r);
+extern int Scm__UVS32Dot(const int32_t *a, const int32_t *b, size_t n,
+                         int64_t *hi, uint64_t *lo);
+extern int Scm__UVU8Dot(const uint8_t *a, const uint8_t *b, size_t n,
+                        uint64_t *r);
+
+/* Sets *k to the index of the first minimum (maxp == 0) or maximum
+   (maxp != 0) element.  For flonums, it is the index of the first NaN
+   if there is one.  N must be positive. */
+extern int Scm__UVF32ArgMinMax(const float *a, size_t n, int maxp, size_t *k);
+extern int Scm__UVF64ArgMinMax(const double *a, size_t n, int maxp, size_t *k);
+extern int Scm__UVS32ArgMinMax(const int32_t *a, size_t n, int maxp, size_t *k);
+extern int Scm__UVU8ArgMinMax(const uint8_t *a, size_t n, int maxp, size_t *k);
+
+#endif /* GAUCHE_UVSIMD_H */
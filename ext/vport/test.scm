@@ -269,6 +269,29 @@
          '(#t #t) (test-boport "vport.c" 0))
   )
 
+;; Many active buffered ports.  The registry of active ports used to
+;; be limited to 256 entries.
+(let ()
+  (define flushed 0)
+  (define (make-port)
+    (make <buffered-output-port>
+      :flush (^[buf force?] (inc! flushed) (u8vector-length buf))))
+  (let1 ps (map (^_ (make-port)) (iota 3000))
+    (test* "many buffered ports" 3000
+           (begin
+             (dolist [p ps] (write-char #\a p))
+             (flush-all-ports)
+             flushed))
+    (test* "many buffered ports (after closing some)" #t
+           (begin
+             (for-each close-output-port (take ps 1500))
+             (set! flushed 0)
+             (dolist [p (drop ps 1500)] (write-char #\b p))
+             (dolist [p (map (^_ (make-port)) (iota 500))] (write-char #\c p))
+             (flush-all-ports)
+             ;; the unreferenced ports may or may not have been collected
+             (>= flushed 1500)))))
+
 ;;-----------------------------------------------------------
 (test-section "uvector-input-port")
 
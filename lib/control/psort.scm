@@ -0,0 +1,210 @@
+;;;
+;;; control.psort - parallel sort
+;;;
+;;;   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+(define-module control.psort
+  (use gauche.threads)
+  (use gauche.uvector)
+  (export psort psort! psort-threads psort-threshold))
+(select-module control.psort)
+
+;; PSORT sorts a sequence with multiple threads.  The sequence is split
+;; into one chunk per thread, each chunk is sorted by stable-sort! in
+;; its own thread, then the sorted runs are merged pairwise, again in
+;; parallel, until one run remains.  As the number of merges halves at
+;; each round, each merge is split into pieces that are merged by
+;; separate threads, so that all threads are kept busy up to the last
+;; round.  Since both steps are stable and the runs are always merged in
+;; order, the result is the same as stable-sort, regardless of the
+;; number of threads.
+;;
+;; The comparison procedure and the key function are called concurrently
+;; from multiple threads, so they must not have side effects that
+;; conflict with each other.
+
+;; Number of threads.  #f to use the number of available processors.
+(define psort-threads (make-parameter #f))
+
+;; Sequences shorter than this are sorted by stable-sort! in the
+;; calling thread.
+(define psort-threshold (make-parameter 10000))
+
+(define (%num-threads)
+  (cond-expand
+   [gauche.sys.threads
+    (or (psort-threads) (sys-available-processors))]
+   [else 1]))
+
+(define (%make-less cmp)
+  (cond [(comparator? cmp) (^[a b] (< (comparator-compare cmp a b) 0))]
+        [(not cmp) (^[a b] (< (compare a b) 0))]
+        [(applicable? cmp <bottom> <bottom>) cmp]
+        [else (errorf "psort requires a comparator or a procedure that \
+                       takes two-arguments, but got: ~s" cmp)]))
+
+;; Run thunks in parallel and wait for all of them.  If any of them
+;; raised an exception, reraise it in the calling thread.
+(define (%run-parallel thunks)
+  (let1 ts (map make-thread thunks)
+    (for-each thread-start! ts)
+    (dolist [t ts]
+      (guard (e [(uncaught-exception? e) #f])
+        (thread-join! t)))
+    (dolist [t ts]
+      (guard (e [(uncaught-exception? e)
+                 (raise (uncaught-exception-reason e))])
+        (thread-join! t)))))
+
+;; Merge sorted runs src[i,m) and src[j,e) into dst starting at d, stably.
+(define (%merge! less src dst i m j e d)
+  (let loop ([i i] [j j] [d d])
+    (cond [(= i m) (vector-copy! dst d src j e)]
+          [(= j e) (vector-copy! dst d src i m)]
+          [else (let ([x (vector-ref src i)]
+                      [y (vector-ref src j)])
+                  (if (less y x)
+                    (begin (vector-set! dst d y) (loop i (+ j 1) (+ d 1)))
+                    (begin (vector-set! dst d x) (loop (+ i 1) j (+ d 1)))))])))
+
+;; When merging src[s,m) and src[m,e), returns the index i in [s,m) such
+;; that the first r elements of the result are src[s,i) and
+;; src[m,m+r-(i-s)).  Found by binary search; on ties the left run
+;; comes first, as in %merge!.
+(define (%merge-split less src s m e r)
+  (let loop ([lo (max s (- (+ s r) (- e m)))] [hi (min (+ s r) m)])
+    (let* ([i (quotient (+ lo hi) 2)]
+           [j (- (+ m r) (- i s))])
+      (cond [(and (> i s) (< j e)
+                  (less (vector-ref src j) (vector-ref src (- i 1))))
+             (loop lo (- i 1))]
+            [(and (> j m) (< i m)
+                  (not (less (vector-ref src (- j 1)) (vector-ref src i))))
+             (loop (+ i 1) hi)]
+            [else i]))))
+
+;; Returns a list of K thunks that together merge src[s,m) and src[m,e)
+;; into dst[s,e), each producing about the same number of elements.
+(define (%merge-jobs less src dst s m e k)
+  (let1 splits (map (^t (let1 r (quotient (* (- e s) t) k)
+                          (cons r (%merge-split less src s m e r))))
+                    (iota (+ k 1)))
+    (map (^[p q]
+           (let ([r0 (car p)] [i0 (cdr p)]
+                 [r1 (car q)] [i1 (cdr q)])
+             (^[] (%merge! less src dst
+                           i0 i1 (- (+ m r0) (- i0 s)) (- (+ m r1) (- i1 s))
+                           (+ s r0)))))
+         splits (cdr splits))))
+
+;; Returns a fresh vector with the sorted elements of vector V.  If KEY is
+;; given, elements of the result are (elt . key) pairs.
+(define (%psort-vector v cmp key nthreads)
+  (define n (vector-length v))
+  (define keyed? (not (memq key `(,identity ,values))))
+  (define less (let1 less (%make-less cmp)
+                 (if keyed?
+                   (^[a b] (less (cdr a) (cdr b)))
+                   less)))
+  (define bounds                        ;boundaries of the initial runs
+    (map (^i (quotient (* n i) nthreads)) (iota (+ nthreads 1))))
+  (define src (make-vector n))
+  (define dst (make-vector n))
+
+  ;; Sort each chunk into src.  Keys are computed here, so that they're
+  ;; computed in parallel as well, once per element.
+  ($ %run-parallel
+     $ map (^[s e]
+             (^[] (let1 chunk (vector-copy v s e)
+                    (when keyed?
+                      (dotimes [i (- e s)]
+                        (let1 x (vector-ref chunk i)
+                          (vector-set! chunk i (cons x (key x))))))
+                    (vector-copy! src s (if keyed?
+                                          (stable-sort! chunk cmp cdr)
+                                          (stable-sort! chunk cmp))))))
+     bounds (cdr bounds))
+
+  ;; Merge adjacent runs until one remains.  The threads are divided
+  ;; among the merges of each round.
+  (let loop ([bounds bounds] [src src] [dst dst])
+    (if (null? (cddr bounds))
+      src
+      (let ([k (max 1 (quotient nthreads (quotient (length (cdr bounds)) 2)))])
+        (let rec ([bs bounds] [jobs '()] [next '()])
+          (cond [(null? (cdr bs))
+                 (%run-parallel jobs)
+                 (loop (reverse (cons (car bs) next)) dst src)]
+                [(null? (cddr bs))      ;odd run
+                 (let ([s (car bs)] [e (cadr bs)])
+                   (rec (cdr bs)
+                        (cons (^[] (vector-copy! dst s src s e)) jobs)
+                        (cons s next)))]
+                [else
+                 (let ([s (car bs)] [m (cadr bs)] [e (caddr bs)])
+                   (rec (cddr bs)
+                        (append (%merge-jobs less src dst s m e k) jobs)
+                        (cons s next)))]))))))
+
+(define (%psort seq cmp key)
+  (let ([v (cond [(vector? seq) seq]
+                 [(uvector? seq) (uvector->vector seq)]
+                 [(and (pair? seq) (list? seq)) (list->vector seq)]
+                 [else #f])]
+        [nthreads (%num-threads)])
+    (and v
+         (>= (vector-length v) (psort-threshold))
+         (> nthreads 1)
+         (rlet1 r (%psort-vector v cmp key (min nthreads (vector-length v)))
+           (unless (memq key `(,identity ,values))
+             (vector-map! car r))))))
+
+(define (psort seq :optional (cmp #f) (key identity))
+  (if-let1 r (%psort seq cmp key)
+    (cond [(vector? seq) r]
+          [(list? seq) (vector->list r)]
+          [else (rlet1 u (uvector-copy seq)
+                  (dotimes [i (vector-length r)]
+                    (uvector-set! u i (vector-ref r i))))])
+    (stable-sort seq cmp key)))
+
+(define (psort! seq :optional (cmp #f) (key identity))
+  (if-let1 r (%psort seq cmp key)
+    (cond [(vector? seq) (vector-copy! seq 0 r) seq]
+          [(list? seq)
+           (do ([p seq (cdr p)]
+                [i 0 (+ i 1)])
+               [(null? p) seq]
+             (set-car! p (vector-ref r i)))]
+          [else (dotimes [i (vector-length r)]
+                  (uvector-set! seq i (vector-ref r i)))
+                seq])
+    (stable-sort! seq cmp key)))
@@ -234,6 +234,7 @@
    (<char-set> "ScmCharSet*" "char-set" "SCM_CHARSETP" "SCM_CHARSET")
    (<regexp> "ScmRegexp*" "regexp" "SCM_REGEXPP" "SCM_REGEXP")
    (<regmatch> "ScmRegMatch*" "regmatch" "SCM_REGMATCHP" "SCM_REGMATCH")
+   (<regexp-set> "ScmRegexpSet*" "regexp set" "SCM_REGEXP_SET_P" "SCM_REGEXP_SET")
    (<port> "ScmPort*" "port" "SCM_PORTP" "SCM_PORT")
    (<input-port> "ScmPort*" "input port" "SCM_IPORTP" "SCM_PORT")
    (<output-port> "ScmPort*" "output port" "SCM_OPORTP" "SCM_PORT")
@@ -243,6 +244,9 @@
    (<comparator> "ScmComparator*" "comparator" "SCM_COMPARATORP" "SCM_COMPARATOR")
    (<hash-table> "ScmHashTable*" "hash table" "SCM_HASH_TABLE_P" "SCM_HASH_TABLE")
    (<tree-map> "ScmTreeMap*" "tree map" "SCM_TREE_MAP_P" "SCM_TREE_MAP")
+   (<concurrent-hash-table> "ScmConcurrentHashTable*" "concurrent hash table"
+                            "SCM_CONCURRENT_HASH_TABLE_P"
+                            "SCM_CONCURRENT_HASH_TABLE")
    (<class> "ScmClass*" "class" "SCM_CLASSP" "SCM_CLASS")
    (<method> "ScmMethod*" "method" "SCM_METHODP" "SCM_METHOD")
    (<module> "ScmModule*" "module" "SCM_MODULEP" "SCM_MODULE")
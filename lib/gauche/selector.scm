@@ -1,5 +1,5 @@
 ;;;
-;;; selector - simple event loop by select()
+;;; selector - simple event loop
 ;;;
 ;;;   Copyright (c) 2000-2018  Shiro Kawai  <shiro@acm.org>
 ;;;
@@ -32,6 +32,19 @@
 ;;;
 
 
+;; A selector keeps handlers for each file descriptor, and waits for the
+;; conditions with one of the following backends.
+;;
+;;   epoll  - Linux epoll(7).  The kernel keeps the set of descriptors,
+;;            so a wakeup costs O(# of ready descriptors).
+;;   poll   - poll(2).  The array of descriptors is kept and reused, and
+;;            the number of descriptors isn't limited by FD_SETSIZE.
+;;   select - select(2) with <sys-fdset>.
+;;
+;; The first available one is used unless specified by :backend.
+;; With :edge-triggered #t, a handler is called only when the condition
+;; newly arises (epoll natively, poll by emulation).
+
 (define-module gauche.selector
   (use srfi-1)
   (export <selector> selector-add! selector-delete! selector-select)
@@ -39,14 +52,41 @@
 (select-module gauche.selector)
 
 (define-class <selector> ()
-  ((rfds :init-form #f)
-   (wfds :init-form #f)
-   (xfds :init-form #f)
-   (rhandlers :init-form '())  ; list of (port-or-fd . proc)
-   (whandlers :init-form '())  ; ditto
-   (xhandlers :init-form '())  ; ditto
+  ((backend :init-keyword :backend :init-value #f)
+   (edge-triggered :init-keyword :edge-triggered :init-value #f)
+   (poller :init-value #f)      ; <sys-poller>, for epoll and poll backend
+   (rfds :init-value #f)        ; <sys-fdset>s, for select backend
+   (wfds :init-value #f)
+   (xfds :init-value #f)
+   ;; fd -> #(r-handler w-handler x-handler), where each handler is
+   ;; (port-or-fd . proc) or #f.
+   (handlers :init-form (make-hash-table 'eqv?))
   ))
 
+(define (default-backend)
+  (cond-expand
+   [gauche.sys.epoll 'epoll]
+   [gauche.sys.poll 'poll]
+   [else 'select]))
+
+(define-method initialize ((self <selector>) initargs)
+  (next-method)
+  (let1 backend (or (~ self'backend) (default-backend))
+    (case backend
+      [(epoll poll)
+       (set! (~ self'poller)
+             (make <sys-poller> :backend backend
+                   :edge-triggered (~ self'edge-triggered)))]
+      [(select)
+       (when (~ self'edge-triggered)
+         (error "select backend doesn't support edge-triggered mode"))
+       (set! (~ self'rfds) (make <sys-fdset>))
+       (set! (~ self'wfds) (make <sys-fdset>))
+       (set! (~ self'xfds) (make <sys-fdset>))]
+      [else (errorf "invalid backend ~s, must be epoll, poll or select"
+                    backend)])
+    (set! (~ self'backend) backend)))
+
 (define (canon-flag flag)
   (case flag
     [(r read) 'r]
@@ -54,73 +94,85 @@
     [(x exception) 'x]
     [else (errorf "invalid flag ~s, must be r, w, or x" flag)]))
 
-(define (flag->fd-slot flag)
-  (case flag
-    [(r) 'rfds] [(w) 'wfds] [(x) 'xfds]))
+(define (flag->index flag)
+  (case flag [(r) 0] [(w) 1] [(x) 2]))
 
-(define (flag->handler-slot flag)
-  (case flag
-    [(r) 'rhandlers] [(w) 'whandlers] [(x) 'xhandlers]))
+(define (port-or-fd->fd port-or-fd)
+  (cond [(integer? port-or-fd) port-or-fd]
+        [(and (port? port-or-fd) (port-file-number port-or-fd))]
+        [else (error "port or file descriptor required, but got:"
+                     port-or-fd)]))
+
+;; Let the backend know the conditions to watch for fd, after the
+;; handlers of fd are changed.
+(define (update-fd! selector fd entry)
+  (let1 flags (filter-map (^[flag] (and (vector-ref entry (flag->index flag))
+                                        flag))
+                          '(r w x))
+    (if (null? flags)
+      (hash-table-delete! (~ selector'handlers) fd)
+      (hash-table-put! (~ selector'handlers) fd entry))
+    (if-let1 poller (~ selector'poller)
+      (sys-poller-set! poller fd flags)
+      (begin
+        (sys-fdset-set! (~ selector'rfds) fd (memq 'r flags))
+        (sys-fdset-set! (~ selector'wfds) fd (memq 'w flags))
+        (sys-fdset-set! (~ selector'xfds) fd (memq 'x flags))))))
 
 (define-method selector-add! ((selector <selector>) port-or-fd proc flags)
   (assume-type proc <procedure>)
   (assume-type flags <list>)
-  (dolist [flag (map canon-flag flags)]
-    (let* ([slot (flag->fd-slot flag)]
-           [fds (or (slot-ref selector slot)
-                    (rlet1 f (make <sys-fdset>)
-                      (slot-set! selector slot f)))])
-      (set! (sys-fdset-ref fds port-or-fd) #t))
-    (slot-push! selector (flag->handler-slot flag) (cons port-or-fd proc))))
+  (let* ([fd (port-or-fd->fd port-or-fd)]
+         [entry (hash-table-get (~ selector'handlers) fd
+                                (make-vector 3 #f))])
+    (dolist [flag (map canon-flag flags)]
+      (vector-set! entry (flag->index flag) (cons port-or-fd proc)))
+    (update-fd! selector fd entry)))
 
 (define-method selector-delete! ((selector <selector>) port-or-fd proc flags)
-  (let1 flags (if flags (map canon-flag flags) '(r w x))
-    (for-each (^[fds handlers]
-                (cond
-                 [port-or-fd
-                  (if-let1 p (assoc port-or-fd (slot-ref selector handlers))
-                    (when (or (not proc) (eq? proc (cdr p)))
-                      (slot-set! selector handlers
-                                 (delete p (slot-ref selector handlers)))
-                      (if-let1 fds (slot-ref selector fds)
-                        (sys-fdset-set! fds port-or-fd #f))))]
-                 [proc
-                  (let loop ([h (slot-ref selector handlers)]
-                             [newh '()])
-                    (cond [(null? h)
-                           (slot-set! selector handlers (reverse newh))]
-                          [(eq? proc (cdar h))
-                           (if-let1 fds (slot-ref selector fds)
-                             (sys-fdset-set! fds (caar h) #f))
-                           (loop (cdr h) newh)]
-                          [else
-                           (loop (cdr h) (cons (car h) newh))]))]
-                 [else
-                  (slot-set! selector fds #f)
-                  (slot-set! selector handlers '())]))
-              (map flag->fd-slot flags)
-              (map flag->handler-slot flags))))
+  (define indices
+    (map flag->index (if flags (map canon-flag flags) '(r w x))))
+  (define (delete-from! fd)
+    (and-let1 entry (hash-table-get (~ selector'handlers) fd #f)
+      (dolist [i indices]
+        (when (and-let1 h (vector-ref entry i)
+                (or (not proc) (eq? proc (cdr h))))
+          (vector-set! entry i #f)))
+      (update-fd! selector fd entry)))
+  (if port-or-fd
+    (delete-from! (port-or-fd->fd port-or-fd))
+    (for-each delete-from! (hash-table-keys (~ selector'handlers)))))
 
 (define-method selector-select ((selector <selector>) :optional (timeout #f))
+  ;; Collects the handlers to call first, so that the handlers can
+  ;; modify the selector.
+  (define (calls fd flags tail)
+    (if-let1 entry (hash-table-get (~ selector'handlers) fd #f)
+      (fold (^[flag tail]
+              (if-let1 h (vector-ref entry (flag->index flag))
+                (acons (cdr h) (list (car h) flag) tail)
+                tail))
+            tail flags)
+      tail))
 
-  (define (pick-handlers fds handlers flag)
-    (fold (^[entry tail]
-            (let1 fd (car entry)
-              (if (sys-fdset-ref fds fd)
-                (cons (list (cdr entry) fd flag) tail)
-                tail)))
-          '()
-          handlers))
-
-  (receive (nfds rfds wfds xfds)
-      (sys-select (slot-ref selector 'rfds)
-                  (slot-ref selector 'wfds)
-                  (slot-ref selector 'xfds)
-                  timeout)
-    (when (> nfds 0)
-      (for-each (^h (apply (car h) (cdr h)))
-                (append
-                 (pick-handlers rfds (slot-ref selector 'rhandlers) 'r)
-                 (pick-handlers wfds (slot-ref selector 'whandlers) 'w)
-                 (pick-handlers xfds (slot-ref selector 'xhandlers) 'x))))
-    nfds))
+  (let1 calls
+      (if-let1 poller (~ selector'poller)
+        (fold (^[ev tail] (calls (car ev) (cdr ev) tail))
+              '()
+              (sys-poller-wait poller timeout))
+        (receive (nfds rfds wfds xfds)
+            (sys-select (~ selector'rfds) (~ selector'wfds)
+                        (~ selector'xfds) timeout)
+          (if (zero? nfds)
+            '()
+            (hash-table-fold (~ selector'handlers)
+                             (^[fd _ tail]
+                               (calls fd
+                                      (filter-map
+                                       (^[flag fds]
+                                         (and (sys-fdset-ref fds fd) flag))
+                                       '(r w x) (list rfds wfds xfds))
+                                      tail))
+                             '()))))
+    (for-each (^c (apply (car c) (cdr c))) (reverse calls))
+    (length calls)))
@@ -25,6 +25,7 @@
 
 (define %sort  (with-module gauche.internal %sort))
 (define %sort! (with-module gauche.internal %sort!))
+(define %radix-sort! (with-module gauche.internal %radix-sort!))
 
 (define-syntax define-less?
   (syntax-rules ()
@@ -165,6 +166,7 @@
                                         p)]
                              [else '()]))])
       (cond [(null? seq) seq]
+            [(radix-sort! seq cmp #f)]
             [(pair? seq) (step (length seq))]
             [(vector? seq)
              (let ([n (vector-length seq)]
@@ -184,7 +186,8 @@
              (do ([spine seq (cdr spine)])
                  [(null? spine)]
                (set-car! spine (cons (car spine) (key (car spine)))))
-             (let1 spine (stable-sort! seq kless?)
+             (let1 spine (or (radix-sort! seq cmp #t)
+                             (stable-sort! seq kless?))
                (do ([lis spine (cdr lis)])
                    [(null? lis)]
                  (set-car! lis (caar lis)))
@@ -195,7 +198,8 @@
                    [(= i len)]
                  (vector-set! seq i (cons (vector-ref seq i)
                                           (key (vector-ref seq i)))))
-               (do ([seq (stable-sort! seq kless?)]
+               (do ([seq (or (radix-sort! seq cmp #t)
+                             (stable-sort! seq kless?))]
                     [i 0 (+ i 1)])
                    [(= i len)]
                  (vector-set! seq i (car (vector-ref seq i))))
@@ -203,6 +207,22 @@
             [(is-a? seq <sequence>) (%generic-sort! seq less? key)]
             [else (error "sequence required, but got:" seq)]))))
 
+;; If the order is numeric and all the keys are fixnums, stable radix sort
+;; is much faster than merge sort.  Returns the sorted list or vector, or
+;; #f without modifying SEQ if it's not applicable.  If KEYED? is true,
+;; elements of SEQ are (elt . key) pairs.
+(define (radix-sort! seq cmp keyed?)
+  (and (memq cmp `(#f ,< ,>))
+       (cond [(vector? seq) (and (%radix-sort! seq (eq? cmp >) keyed?) seq)]
+             [(and (pair? seq) (fixnum? (if keyed? (cdar seq) (car seq))))
+              (let1 v (list->vector seq)
+                (and (%radix-sort! v (eq? cmp >) keyed?)
+                     (do ([p seq (cdr p)]
+                          [i 0 (+ i 1)])
+                         [(null? p) seq]
+                       (set-car! p (vector-ref v i)))))]
+             [else #f])))
+
 ;;; (sort sequence less?)
 ;;; sorts a vector or list non-destructively.  It does this by sorting a
 ;;; copy of the sequence.
@@ -216,13 +236,13 @@
   (define-less? less? cmp 'sort)
   (if (memq key `(,identity ,values))
     (cond [(null? seq) seq]
-          [(pair? seq) (stable-sort! (list-copy seq) less?)]
-          [(vector? seq) (list->vector (sort! (vector->list seq) less?))]
+          [(pair? seq) (stable-sort! (list-copy seq) cmp)]
+          [(vector? seq) (stable-sort! (vector-copy seq) cmp)]
           [(is-a? seq <sequence>) (%generic-sort seq less?)]
           [else (error "sequence required, but got:" seq)])
     (cond [(null? seq) seq]
-          [(pair? seq) (stable-sort! (list-copy seq) less? key)]
-          [(vector? seq) (stable-sort! (vector-copy seq) less? key)]
+          [(pair? seq) (stable-sort! (list-copy seq) cmp key)]
+          [(vector? seq) (stable-sort! (vector-copy seq) cmp key)]
           [(is-a? seq <sequence>) (%generic-sort seq less? key)]
           [else (error "sequence required, but got:" seq)])))
 
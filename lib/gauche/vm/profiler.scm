@@ -36,7 +36,11 @@
   (use util.match)
   (extend gauche.internal)
   (export profiler-show profiler-get-result
-          profiler-show-load-stats with-profiler)
+          profiler-get-stacks profiler-write-collapsed-stacks
+          profiler-toggle-on-signal
+          profiler-show-load-stats with-profiler
+          alloc-profiler-get-result alloc-profiler-show
+          with-alloc-profiler)
   )
 (select-module gauche.vm.profiler)
 
@@ -54,6 +58,78 @@
     (hash-table-map r (^(k v) (cons (entry-name k) v)))
     #f))
 
+;;
+;; Returns the call stacks of the samples, as a list of
+;; ((<name> ...) . <num-samples>).  Names are ordered from the
+;; outermost caller.  If more than one thread has been profiled,
+;; each stack begins with the thread.
+;;
+(define (profiler-get-stacks)
+  ;; NB: this part depends on the result object of profiler-raw-stacks.
+  ;; Keep this in sync with src/prof.c.
+  (if-let1 r (profiler-raw-stacks)
+    (let ([ht (make-hash-table 'equal?)]
+          [top (if (> (hash-table-num-entries r) 1)
+                 (^[vm] (list (thread-entry-name vm)))
+                 (^[vm] '()))])
+      (hash-table-for-each
+       r
+       (^[vm trie]
+         (let walk ([trie trie] [path (top vm)])
+           (hash-table-for-each
+            trie
+            (^[code node]
+              (let1 path (cons (entry-name code) path)
+                (unless (zero? (car node))
+                  (hash-table-update! ht (reverse path)
+                                      (cut + <> (car node)) 0))
+                (when (cdr node) (walk (cdr node) path))))))))
+      (hash-table-map ht cons))
+    #f))
+
+;;
+;; Write the call stacks in the 'collapsed' format that flame graph
+;; tools (e.g. flamegraph.pl) take.  Each line consists of the frame
+;; names separated by semicolons, outermost first, followed by a space
+;; and the number of samples.
+;; DEST may be an output port or a file name.
+;;
+(define (profiler-write-collapsed-stacks :optional (dest (current-output-port)))
+  (define (write-stacks port)
+    (dolist [s (sort-by (or (profiler-get-stacks) '()) cdr >)]
+      (format port "~a ~d\n"
+              (string-join (map frame-name (car s)) ";")
+              (cdr s))))
+  (if (string? dest)
+    (call-with-output-file dest write-stacks)
+    (write-stacks dest)))
+
+;;
+;; Make the signal SIG toggle the profiler, so that it can be attached
+;; to a running process.  The first signal starts profiling all threads.
+;; The next one stops it, writes the collapsed stacks to FILE, and
+;; resets the profiler.  SIG may be a signal number, or a signal name
+;; such as USR2 or SIGUSR2.
+;;
+;;  Keyword args:
+;;    :file   - the output file.  Defaults to gauche-profile-<pid>.txt
+;;              in the current directory.
+;;    :period - the sampling period in microseconds.  0 for the default.
+;;
+(define (profiler-toggle-on-signal sig :key (file #f) (period 0))
+  (define running #f)
+  (set-signal-handler!
+   (signal-number sig)
+   (^_ (if running
+         (let1 f (or file #"gauche-profile-~(sys-getpid).txt")
+           (set! running #f)
+           (profiler-write-collapsed-stacks f)
+           (profiler-reset)
+           (format (current-error-port) "profiler: wrote ~a\n" f))
+         (begin
+           (set! running #t)
+           (profiler-start :all-threads #t :period period))))))
+
 ;;
 ;; Show the profiler result.
 ;;
@@ -129,6 +205,75 @@
     (profiler-reset)
     (apply values vals)))
 
+;;
+;; Returns the allocation profiler result, as a list of
+;; (<site> <kind> <bytes> <objects> <samples>), sorted by <bytes>.
+;; <site> is a string that names the code and, if known, the source
+;; location of the allocation.  <kind> is the class name of the
+;; allocated object, or the name of its C type (a string), or #f.
+;; <bytes> and <objects> are estimated from the samples.
+;;
+(define (alloc-profiler-get-result)
+  ;; NB: this part depends on the result of alloc-profiler-raw-result.
+  ;; Keep this in sync with src/prof.c.
+  (let1 ht (make-hash-table 'equal?)
+    (dolist [e (alloc-profiler-raw-result)]
+      (match-let1 (code src kind bytes objects samples) e
+        (hash-table-update! ht (list (alloc-site-name code src)
+                                     (if (is-a? kind <class>)
+                                       (class-name kind)
+                                       kind))
+                            (^p (map + p (list bytes objects samples)))
+                            '(0 0 0))))
+    (sort-by (hash-table-map ht append) caddr >)))
+
+;;
+;; Show the allocation profiler result.
+;;
+;;  Keyword args:
+;;    :results - give a result returned by alloc-profiler-get-result.
+;;               If not given, the current result is used.
+;;    :group-by - either one of 'site (each site and kind), 'kind,
+;;               or 'code (each code, ignoring the source location).
+;;    :max-rows - # of rows to be shown.  #f to show everything.
+;;
+(define (alloc-profiler-show :key (results #f) (group-by 'site) (max-rows 50))
+  (define key
+    (case group-by
+      [(site) (^e (list (car e) (cadr e)))]
+      [(kind) (^e (list "" (cadr e)))]
+      [(code) (^e (list (alloc-code-name (car e)) ""))]
+      [else
+       (error "alloc-profiler-show: group-by argument must be either one of site, kind, or code, but got:" group-by)]))
+  (let ([ht (make-hash-table 'equal?)]
+        [r (or results (alloc-profiler-get-result))])
+    (dolist [e r]
+      (hash-table-update! ht (key e) (^p (map + p (cddr e))) '(0 0 0)))
+    (if (null? r)
+      (print "No allocation has been sampled.")
+      (let ([rows (sort-by (hash-table-map ht append) caddr >)]
+            [total (fold (^[e sum] (+ (caddr e) sum)) 0 r)])
+        (print "Allocation statistics (estimated total "total" bytes, "
+               "sampled every ~"(alloc-profiler-interval)" bytes)")
+        (print "Site                                       Kind                    bytes   objects")
+        (print "------------------------------------------+---------------------+-------------------")
+        (dolist [e (if (integer? max-rows) (take* rows max-rows) rows)]
+          (match-let1 (site kind bytes objects samples) e
+            (format #t "~42a ~21a ~9d(~2d%) ~8d\n"
+                    site (or kind "?") bytes
+                    (if (zero? total) 0 (exact (round (* 100 (/ bytes total)))))
+                    objects)))))))
+
+;; Convenience API
+(define (with-alloc-profiler thunk :key (interval 0))
+  (receive vals (dynamic-wind
+                  (cut alloc-profiler-start :interval interval)
+                  thunk
+                  alloc-profiler-stop)
+    (alloc-profiler-show)
+    (alloc-profiler-reset)
+    (apply values vals)))
+
 ;;;==========================================================
 ;;; Internal routines
 ;;;
@@ -136,7 +281,7 @@
 ;; Show the result in a comprehensive way
 (define (show-stats stat sort-by max-rows)
   (let* ([num-samples (fold (^(entry cnt) (+ (cddr entry) cnt)) 0 stat)]
-         [sum-time (* num-samples 0.01)]
+         [sum-time (* num-samples (sample-period-ms) 0.001)]
          [sorter (case sort-by
                    [(time)
                     (^(a b) (or (> (cddr a) (cddr b))
@@ -147,7 +292,7 @@
                                 (and (= (cadr a) (cadr b))
                                      (> (cddr a) (cddr b)))))]
                    [(time-per-call)
-                    (^(a b) (> (/ (cddr a) (cadr a)) (/ (cddr b) (cadr b))))]
+                    (^(a b) (> (per-call a) (per-call b)))]
                    [else
                     (error "profiler-show: sort-by argument must be either one of time, count, or time-per-call, but got:" sort-by)])]
          [sorted (sort stat sorter)])
@@ -167,20 +312,32 @@
     ))
 
 
+;; Sampling period, in ms
+(define (sample-period-ms)
+  (/ (profiler-sampling-period) 1000.0))
+
+;; Samples per call.  A code may have samples without being called
+;; while profiling, if it has been running since before that.
+(define (per-call entry)
+  (if (zero? (cadr entry)) 0 (/ (cddr entry) (cadr entry))))
+
 ;; Get a fixed-decimal notation of time/call (in us)
 ;; If the time is under 100ms:  ##.####
 ;; If the time is under 10^6ms: ###.### - ######.
 ;; Else print as is.
 (define (time/call samples ncalls)
-  (let1 time (* 10.0 (/ samples ncalls)) ;; in ms
-    (receive (frac int) (modf (* time 10000))
-      (let1 val (exact (if (>= frac 0.5) (+ int 1) int))
-        (receive (q r) (quotient&remainder val 10000)
-          (format "~2d.~4,'0d" q r))))))
+  (if (zero? ncalls)
+    "      -"
+    (let1 time (* (sample-period-ms) (/ samples ncalls)) ;; in ms
+      (receive (frac int) (modf (* time 10000))
+        (let1 val (exact (if (>= frac 0.5) (+ int 1) int))
+          (receive (q r) (quotient&remainder val 10000)
+            (format "~2d.~4,'0d" q r)))))))
 
 ;; Return a 'printable' notation of sampled code location
 (define (entry-name obj)
   (cond
+   [(not obj) '???]                     ;unknown code; see src/prof.c
    [(and (procedure? obj) (subr? obj))
     (match (~ obj'info)
       ;; Kludge: case-lambda-dispatcher contains #<closure> in its dispatch
@@ -198,3 +355,43 @@
              ,(map class-name (~ obj'specializers)))]
    [else (write-to-string obj)]))
 
+;; The site name of the allocation profiler result: "<name> (<file>:<line>)"
+(define (alloc-site-name code src)
+  (let1 name (write-to-string (entry-name code) display)
+    (if-let1 loc (and src (source-location src))
+      (format "~a (~a:~a)" name (sys-basename (car loc)) (cadr loc))
+      name)))
+
+;; Drop the source location from the site name
+(define (alloc-code-name site)
+  (regexp-replace #/ \([^()]*:\d+\)$/ site ""))
+
+;; Returns (<file> <line>) of the source form, or #f.
+;; See debug-source-info in gauche.vm.debugger.
+(define (source-location form)
+  (and-let1 sis (%source-info form)
+    (any (^[si] (and (car si) (cadr si) (list (car si) (cadr si))))
+         (reverse sis))))
+
+;; A frame name in the collapsed stack format can't contain
+;; semicolons or newlines.
+(define (frame-name name)
+  (regexp-replace-all #/[;\n]/ (write-to-string name display) " "))
+
+(define (thread-entry-name vm)
+  (format "~a[~a]" (or (~ vm'name) "thread") (~ vm'vmid)))
+
+(define (signal-number sig)
+  (cond
+   [(integer? sig) sig]
+   [(or (string? sig) (symbol? sig))
+    (let1 name (string-upcase (x->string sig))
+      (or (string->number name)
+          (global-variable-ref (find-module 'gauche)
+                               (string->symbol
+                                (if (string-prefix? "SIG" name)
+                                  name
+                                  (string-append "SIG" name)))
+                               #f)
+          (error "unknown signal:" sig)))]
+   [else (error "signal number or name required, but got:" sig)]))
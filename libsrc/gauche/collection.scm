@@ -98,6 +98,15 @@
             (^[] (begin0 (cons k v)
                    (set!-values (k v) (iter eof-marker))))))))
 
+(define-method call-with-iterator ((coll <concurrent-hash-table>) proc
+                                   :allow-other-keys)
+  (let ([eof-marker (cons #f #f)]
+        [iter ((with-module gauche.internal %concurrent-hash-table-iter) coll)])
+    (receive (k v) (iter eof-marker)
+      (proc (cut eq? k eof-marker)
+            (^[] (begin0 (cons k v)
+                   (set!-values (k v) (iter eof-marker))))))))
+
 (define-method call-with-iterator ((coll <tree-map>) proc :allow-other-keys)
   (let ([eof-marker (cons #f #f)]
         [iter ((with-module gauche.internal %tree-map-iter) coll)])
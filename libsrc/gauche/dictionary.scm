@@ -193,6 +193,23 @@
   :->alist    tree-map->alist
   :comparator tree-map-comparator)
 
+(define-dict-interface <concurrent-hash-table>
+  :get        concurrent-hash-table-get
+  :put!       concurrent-hash-table-put!
+  :delete!    concurrent-hash-table-delete!
+  :clear!     concurrent-hash-table-clear!
+  :exists?    concurrent-hash-table-exists?
+  :fold       concurrent-hash-table-fold
+  :for-each   concurrent-hash-table-for-each
+  :map        concurrent-hash-table-map
+  :keys       concurrent-hash-table-keys
+  :values     concurrent-hash-table-values
+  :pop!       concurrent-hash-table-pop!
+  :push!      concurrent-hash-table-push!
+  :update!    concurrent-hash-table-update!
+  :->alist    concurrent-hash-table->alist
+  :comparator concurrent-hash-table-comparator)
+
 ;;-----------------------------------------------
 ;; Fallback methods
 ;;
@@ -131,7 +131,9 @@
           debug-print-pre debug-print-post debug-funcall-pre)
 
 (autoload gauche.vm.profiler
-          profiler-show profiler-show-load-stats with-profiler)
+          profiler-show profiler-show-load-stats with-profiler
+          profiler-write-collapsed-stacks profiler-toggle-on-signal
+          alloc-profiler-get-result alloc-profiler-show with-alloc-profiler)
 
 (autoload srfi-7  (:macro program))
 (autoload srfi-55 (:macro require-extension))
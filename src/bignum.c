@@ -31,10 +31,12 @@
  *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-/* Bignum library.  Not optimized well yet---I think bignum performance
- * is not very critical for Gauche, except a few special cases (like
- * the cases used in the numeric I/O routine).  So the implementation
- * emphasizes robustness rather than performance.
+/* Bignum library.  I think bignum performance is not very critical
+ * for Gauche, except a few special cases (like the cases used in the
+ * numeric I/O routine).  So the implementation mostly emphasizes
+ * robustness rather than performance.  The exceptions are multiplication
+ * and division of large numbers, which switch to subquadratic algorithms
+ * above certain sizes (see "Multiplication" and "Division" sections).
  *
  * Bignum is represented by ScmBignum structure.  There are "normalized"
  * and "denormalized" bignums.   Scheme part only sees the normalized
@@ -837,13 +839,286 @@ static ScmBignum *bignum_mul_word(ScmBignum *br, const ScmBignum *bx,
     return br;
 }
 
+/* Multiplication of larger numbers.
+ *
+ * The following routines work on arrays of words, least significant
+ * word first.  Above the thresholds, we use Karatsuba's method, which
+ * splits operands into two and needs 3 recursive multiplications
+ * instead of 4, and Toom-3, which splits them into three and needs 5
+ * instead of 9.  The thresholds are in words of the shorter operand.
+ * Run test/bignum-performance.scm to find the crossover points on
+ * your machine.
+ */
+static int karatsuba_threshold = 32;
+static int toom3_threshold = 128;
+
+int Scm__BignumKaratsubaThreshold(int value)
+{
+    int prev = karatsuba_threshold;
+    if (value >= 0) karatsuba_threshold = max(value, 4);
+    return prev;
+}
+
+int Scm__BignumToom3Threshold(int value)
+{
+    int prev = toom3_threshold;
+    if (value >= 0) toom3_threshold = max(value, 4);
+    return prev;
+}
+
+static inline int words_trim(const u_long *x, int xn)
+{
+    while (xn > 0 && x[xn-1] == 0) xn--;
+    return xn;
+}
+
+/* r[0..xn) = x[0..xn) + y[0..yn), xn >= yn.  Returns carry.
+   r may be the same as x. */
+static u_long words_add(u_long *r, const u_long *x, int xn,
+                        const u_long *y, int yn)
+{
+    u_long c = 0;
+    int i;
+    for (i=0; i<yn; i++) {
+        u_long xi = x[i], yi = y[i];
+        UADD(r[i], c, xi, yi);
+    }
+    for (; i<xn; i++) {
+        u_long xi = x[i];
+        UADD(r[i], c, xi, 0);
+    }
+    return c;
+}
+
+/* r[0..xn) = x[0..xn) - y[0..yn), xn >= yn.  Returns borrow.
+   r may be the same as x. */
+static u_long words_sub(u_long *r, const u_long *x, int xn,
+                        const u_long *y, int yn)
+{
+    u_long c = 0;
+    int i;
+    for (i=0; i<yn; i++) {
+        u_long xi = x[i], yi = y[i];
+        USUB(r[i], c, xi, yi);
+    }
+    for (; i<xn; i++) {
+        u_long xi = x[i];
+        USUB(r[i], c, xi, 0);
+    }
+    return c;
+}
+
+static int words_cmp(const u_long *x, int xn, const u_long *y, int yn)
+{
+    xn = words_trim(x, xn);
+    yn = words_trim(y, yn);
+    if (xn != yn) return (xn < yn)? -1 : 1;
+    for (int i=xn-1; i>=0; i--) {
+        if (x[i] != y[i]) return (x[i] < y[i])? -1 : 1;
+    }
+    return 0;
+}
+
+/* r[0..rn) += x[0..xn).  The caller guarantees the result fits. */
+static void words_add_to(u_long *r, int rn, const u_long *x, int xn)
+{
+    xn = words_trim(x, xn);
+    SCM_ASSERT(xn <= rn);
+    if (words_add(r, r, rn, x, xn) != 0) {
+        Scm_Panic("bignum.c: words_add_to: overflow");
+    }
+}
+
+/* x[0..xn) /= d, where d < HALF_WORD.  Returns the remainder. */
+static u_long words_div_small(u_long *x, int xn, u_long d)
+{
+    u_long rem = 0;
+    for (int i=xn-1; i>=0; i--) {
+        u_long t = (rem << HALF_BITS) | HI(x[i]);
+        u_long qh = t / d;
+        t = ((t % d) << HALF_BITS) | LO(x[i]);
+        x[i] = (qh << HALF_BITS) | (t / d);
+        rem = t % d;
+    }
+    return rem;
+}
+
+/* x[0..xn) >>= 1 */
+static void words_half(u_long *x, int xn)
+{
+    for (int i=0; i<xn-1; i++) x[i] = (x[i] >> 1) | (x[i+1] << (WORD_BITS-1));
+    if (xn > 0) x[xn-1] >>= 1;
+}
+
+static void words_mul(u_long *r, const u_long *x, int xn,
+                      const u_long *y, int yn);
+
+/* r[0..xn+yn) = x * y, schoolbook method.  r is cleared. */
+static void words_mul_basecase(u_long *r, const u_long *x, int xn,
+                               const u_long *y, int yn)
+{
+    for (int j=0; j<yn; j++) {
+        u_long yj = y[j], carry = 0;
+        if (yj == 0) continue;
+        for (int i=0; i<xn; i++) {
+            u_long hi, lo, t, ri = r[i+j], xi = x[i], c = 0;
+            UMUL(hi, lo, xi, yj);
+            UADD(t, c, lo, carry);
+            hi += c;
+            c = 0;
+            UADD(r[i+j], c, t, ri);
+            carry = hi + c;
+        }
+        r[j+xn] = carry;
+    }
+}
+
+/* Karatsuba.  x = x1*B^h + x0, y = y1*B^h + y0, then
+   x*y = z2*B^2h + ((x0+x1)(y0+y1) - z2 - z0)*B^h + z0,
+   where z2 = x1*y1 and z0 = x0*y0.  Assumes xn >= yn > h.
+   r is cleared. */
+static void words_mul_karatsuba(u_long *r, const u_long *x, int xn,
+                                const u_long *y, int yn)
+{
+    int h = (xn+1)/2;
+    u_long *sx = SCM_NEW_ATOMIC_ARRAY(u_long, h+1);
+    u_long *sy = SCM_NEW_ATOMIC_ARRAY(u_long, h+1);
+    u_long *z1 = SCM_NEW_ATOMIC_ARRAY(u_long, 2*h+2);
+
+    words_mul(r, x, h, y, h);                   /* z0 */
+    words_mul(r+2*h, x+h, xn-h, y+h, yn-h);     /* z2 */
+
+    sx[h] = words_add(sx, x, h, x+h, xn-h);
+    sy[h] = words_add(sy, y, h, y+h, yn-h);
+    words_mul(z1, sx, h+1, sy, h+1);
+    words_sub(z1, z1, 2*h+2, r, 2*h);
+    words_sub(z1, z1, 2*h+2, r+2*h, xn+yn-2*h);
+    words_add_to(r+h, xn+yn-h, z1, 2*h+2);
+}
+
+/* Toom-3.  x = x2*B^2k + x1*B^k + x0, and the same for y.  Regarding
+   them as polynomials of B^k, we evaluate them at 0, 1, -1, 2 and
+   infinity, multiply the values, and interpolate the product.
+   Assumes xn >= yn > 2k.  r is cleared. */
+static void words_mul_toom3(u_long *r, const u_long *x, int xn,
+                            const u_long *y, int yn)
+{
+    int k = (xn+2)/3, n = k+1, rn = xn+yn;
+    const u_long *x0 = x, *x1 = x+k, *x2 = x+2*k;
+    const u_long *y0 = y, *y1 = y+k, *y2 = y+2*k;
+    int x2n = xn-2*k, y2n = yn-2*k;
+    u_long *p1 = SCM_NEW_ATOMIC_ARRAY(u_long, n);
+    u_long *pm1 = SCM_NEW_ATOMIC_ARRAY(u_long, n);
+    u_long *p2 = SCM_NEW_ATOMIC_ARRAY(u_long, n);
+    u_long *q1 = SCM_NEW_ATOMIC_ARRAY(u_long, n);
+    u_long *qm1 = SCM_NEW_ATOMIC_ARRAY(u_long, n);
+    u_long *q2 = SCM_NEW_ATOMIC_ARRAY(u_long, n);
+    u_long *v1 = SCM_NEW_ATOMIC_ARRAY(u_long, 2*n);
+    u_long *vm1 = SCM_NEW_ATOMIC_ARRAY(u_long, 2*n);
+    u_long *v2 = SCM_NEW_ATOMIC_ARRAY(u_long, 2*n);
+    u_long *v0 = r, *vinf = r+4*k;
+    int xneg = FALSE, yneg = FALSE;
+
+    /* Evaluation.  p(1) = x0+x1+x2, p(-1) = x0-x1+x2,
+       p(2) = x0+2*x1+4*x2 = ((x2*2 + x1)*2) + x0 */
+#define TOOM3_EVAL(a0, a1, a2, a2n, e1, em1, e2, negp)                  \
+    do {                                                                \
+        u_long *t_ = SCM_NEW_ATOMIC_ARRAY(u_long, n);                   \
+        t_[k] = words_add(t_, a0, k, a2, a2n);                          \
+        e1[k] = t_[k] + words_add(e1, t_, k, a1, k);                    \
+        if (words_cmp(t_, n, a1, k) >= 0) {                             \
+            words_sub(em1, t_, n, a1, k);                               \
+        } else {                                                        \
+            em1[k] = 0;                                                 \
+            words_sub(em1, a1, k, t_, k);                               \
+            negp = TRUE;                                                \
+        }                                                               \
+        memset(e2, 0, sizeof(u_long)*n);                                \
+        memcpy(e2, a2, sizeof(u_long)*a2n);                             \
+        words_add(e2, e2, n, e2, n);                                    \
+        words_add(e2, e2, n, a1, k);                                    \
+        words_add(e2, e2, n, e2, n);                                    \
+        words_add(e2, e2, n, a0, k);                                    \
+    } while (0)
+
+    TOOM3_EVAL(x0, x1, x2, x2n, p1, pm1, p2, xneg);
+    TOOM3_EVAL(y0, y1, y2, y2n, q1, qm1, q2, yneg);
+#undef TOOM3_EVAL
+
+    words_mul(v0, x0, k, y0, k);
+    words_mul(vinf, x2, x2n, y2, y2n);
+    words_mul(v1, p1, n, q1, n);
+    words_mul(vm1, pm1, n, qm1, n);
+    words_mul(v2, p2, n, q2, n);
+
+    /* Interpolation.  The coefficients of the product, c0..c4, are
+       non-negative, and so are all the intermediate values but vm1.
+         v2  <- (v2 - vm1)/3   = c1+c2+3c3+5c4
+         vm1 <- (v1 - vm1)/2   = c1+c3
+         v1  <- v1 - v0        = c1+c2+c3+c4
+         v2  <- (v2 - v1)/2    = c3+2c4
+         v1  <- v1 - vm1 - c4  = c2
+         v2  <- v2 - 2c4       = c3
+         vm1 <- vm1 - v2       = c1                                     */
+    if (xneg != yneg) {
+        words_add(v2, v2, 2*n, vm1, 2*n);
+        words_add(vm1, v1, 2*n, vm1, 2*n);
+    } else {
+        words_sub(v2, v2, 2*n, vm1, 2*n);
+        words_sub(vm1, v1, 2*n, vm1, 2*n);
+    }
+    words_div_small(v2, 2*n, 3);
+    words_half(vm1, 2*n);
+    words_sub(v1, v1, 2*n, v0, 2*k);
+    words_sub(v2, v2, 2*n, v1, 2*n);
+    words_half(v2, 2*n);
+    words_sub(v1, v1, 2*n, vm1, 2*n);
+    words_sub(v1, v1, 2*n, vinf, rn-4*k);
+    words_sub(v2, v2, 2*n, vinf, rn-4*k);
+    words_sub(v2, v2, 2*n, vinf, rn-4*k);
+    words_sub(vm1, vm1, 2*n, v2, 2*n);
+
+    /* r already has c0 and c4 in place. */
+    words_add_to(r+k, rn-k, vm1, 2*n);
+    words_add_to(r+2*k, rn-2*k, v1, 2*n);
+    words_add_to(r+3*k, rn-3*k, v2, 2*n);
+}
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn).  r must not overlap with x or y. */
+static void words_mul(u_long *r, const u_long *x, int xn,
+                      const u_long *y, int yn)
+{
+    memset(r, 0, sizeof(u_long)*(xn+yn));
+    xn = words_trim(x, xn);
+    yn = words_trim(y, yn);
+    if (xn < yn) {
+        const u_long *t = x; x = y; y = t;
+        int tn = xn; xn = yn; yn = tn;
+    }
+    if (yn == 0) return;
+
+    if (yn < karatsuba_threshold) {
+        words_mul_basecase(r, x, xn, y, yn);
+    } else if (yn <= (xn+1)/2) {
+        /* Unbalanced.  Multiply y by each yn-word piece of x. */
+        u_long *t = SCM_NEW_ATOMIC_ARRAY(u_long, yn*2);
+        for (int off=0; off<xn; off+=yn) {
+            int len = min(yn, xn-off);
+            words_mul(t, x+off, len, y, yn);
+            words_add_to(r+off, xn+yn-off, t, len+yn);
+        }
+    } else if (yn < toom3_threshold || yn <= 2*((xn+2)/3)) {
+        words_mul_karatsuba(r, x, xn, y, yn);
+    } else {
+        words_mul_toom3(r, x, xn, y, yn);
+    }
+}
+
 /* returns bx * by.  not normalized */
 static ScmBignum *bignum_mul(const ScmBignum *bx, const ScmBignum *by)
 {
     ScmBignum *br = make_bignum(bx->size + by->size);
-    for (u_int i=0; i<by->size; i++) {
-        bignum_mul_word(br, bx, by->values[i], i);
-    }
+    words_mul(br->values, bx->values, bx->size, by->values, by->size);
     br->sign = bx->sign * by->sign;
     return br;
 }
@@ -1085,6 +1360,182 @@ long Scm_BignumRemSI(const ScmBignum *dividend, long divisor)
 #endif
 }
 
+/* Division of larger numbers.
+ *
+ * We use the recursive division of Burnikel and Ziegler.  Dividing
+ * a 2n-word number by an n-word number is reduced to two divisions of
+ * 3h-word numbers by the 2h-word number (h = n/2), each of which is
+ * a recursive division of a 2h-word number by the upper h words of
+ * the divisor, followed by a multiplication to correct the remainder.
+ * The cost is O(M(n) log n), where M(n) is the cost of multiplication.
+ * The threshold is in words of the divisor.
+ */
+static int div_dc_threshold = 24;
+
+int Scm__BignumDivThreshold(int value)
+{
+    int prev = div_dc_threshold;
+    if (value >= 0) div_dc_threshold = max(value, 4);
+    return prev;
+}
+
+/* q[0..qn) and r[0..bn) get the quotient and remainder of a[0..an) by
+   b[0..bn), using bignum_gdiv.  b[bn-1] != 0, and the quotient must
+   fit in qn words. */
+static void words_divrem_basecase(u_long *q, int qn, u_long *r,
+                                  const u_long *a, int an,
+                                  const u_long *b, int bn)
+{
+    memset(q, 0, sizeof(u_long)*qn);
+    memset(r, 0, sizeof(u_long)*bn);
+    an = words_trim(a, an);
+    if (words_cmp(a, an, b, bn) < 0) {
+        memcpy(r, a, sizeof(u_long)*an);
+        return;
+    }
+    ScmBignum *ba = make_bignum(an), *bb = make_bignum(bn);
+    ScmBignum *bq = make_bignum(an-bn+1);
+    memcpy(ba->values, a, sizeof(u_long)*an);
+    memcpy(bb->values, b, sizeof(u_long)*bn);
+    ScmBignum *br = bignum_gdiv(ba, bb, bq);
+    memcpy(q, bq->values, sizeof(u_long)*min(qn, (int)bq->size));
+    memcpy(r, br->values, sizeof(u_long)*min(bn, (int)br->size));
+}
+
+static void words_div3n2n(u_long *q, u_long *r, const u_long *a,
+                          const u_long *b, int h);
+
+/* q[0..n) and r[0..n) get the quotient and remainder of a[0..2n) by
+   b[0..n), where the MSB of b[n-1] is set and a < b * B^n. */
+static void words_div2n1n(u_long *q, u_long *r, const u_long *a,
+                          const u_long *b, int n)
+{
+    if (n < div_dc_threshold) {
+        words_divrem_basecase(q, n, r, a, 2*n, b, n);
+        return;
+    }
+    if (n % 2) {
+        /* Make n even by multiplying both a and b by B. */
+        u_long *a2 = SCM_NEW_ATOMIC_ARRAY(u_long, 2*n+2);
+        u_long *b2 = SCM_NEW_ATOMIC_ARRAY(u_long, n+1);
+        u_long *q2 = SCM_NEW_ATOMIC_ARRAY(u_long, n+1);
+        u_long *r2 = SCM_NEW_ATOMIC_ARRAY(u_long, n+1);
+        a2[0] = 0; a2[2*n+1] = 0;
+        memcpy(a2+1, a, sizeof(u_long)*2*n);
+        b2[0] = 0;
+        memcpy(b2+1, b, sizeof(u_long)*n);
+        words_div2n1n(q2, r2, a2, b2, n+1);
+        memcpy(q, q2, sizeof(u_long)*n);
+        memcpy(r, r2+1, sizeof(u_long)*n);
+        return;
+    }
+    int h = n/2;
+    u_long *t = SCM_NEW_ATOMIC_ARRAY(u_long, 3*h);
+    words_div3n2n(q+h, t+h, a+h, b, h);
+    memcpy(t, a, sizeof(u_long)*h);
+    words_div3n2n(q, r, t, b, h);
+}
+
+/* q[0..h) and r[0..2h) get the quotient and remainder of a[0..3h) by
+   b[0..2h), where the MSB of b[2h-1] is set and a < b * B^h. */
+static void words_div3n2n(u_long *q, u_long *r, const u_long *a,
+                          const u_long *b, int h)
+{
+    static const u_long one = 1;
+    const u_long *b1 = b+h, *b2 = b;
+    u_long *t = SCM_NEW_ATOMIC_ARRAY(u_long, 2*h+1);
+    u_long *m = SCM_NEW_ATOMIC_ARRAY(u_long, 2*h);
+
+    /* Estimate q from the upper words.  Then t = the remainder of
+       the upper 2h words of a by b1, followed by the rest of a. */
+    memcpy(t, a, sizeof(u_long)*h);
+    if (words_cmp(a+2*h, h, b1, h) == 0) {
+        for (int i=0; i<h; i++) q[i] = SCM_ULONG_MAX;
+        t[2*h] = words_add(t+h, a+h, h, b1, h);
+    } else {
+        words_div2n1n(q, t+h, a+h, b1, h);
+        t[2*h] = 0;
+    }
+    /* The estimate is too large by at most 2. */
+    words_mul(m, q, h, b2, h);
+    if (words_cmp(t, 2*h+1, m, 2*h) >= 0) {
+        words_sub(t, t, 2*h+1, m, 2*h);
+        memcpy(r, t, sizeof(u_long)*2*h);
+    } else {
+        words_sub(m, m, 2*h, t, 2*h); /* t[2h] is 0 here */
+        words_sub(q, q, h, &one, 1);
+        while (words_cmp(m, 2*h, b, 2*h) > 0) {
+            words_sub(m, m, 2*h, b, 2*h);
+            words_sub(q, q, h, &one, 1);
+        }
+        words_sub(r, b, 2*h, m, 2*h);
+    }
+}
+
+/* r[0..xn) = x[0..xn) << d, 0 <= d < WORD_BITS.  Returns the bits
+   shifted out.  r may be the same as x. */
+static u_long words_lshift(u_long *r, const u_long *x, int xn, int d)
+{
+    if (d == 0) {
+        memmove(r, x, sizeof(u_long)*xn);
+        return 0;
+    }
+    u_long out = (xn > 0)? x[xn-1] >> (WORD_BITS-d) : 0;
+    for (int i=xn-1; i>0; i--) r[i] = (x[i] << d) | (x[i-1] >> (WORD_BITS-d));
+    if (xn > 0) r[0] = x[0] << d;
+    return out;
+}
+
+/* r[0..xn) = x[0..xn) >> d, 0 <= d < WORD_BITS.  r may be the same as x. */
+static void words_rshift(u_long *r, const u_long *x, int xn, int d)
+{
+    if (d == 0) {
+        memmove(r, x, sizeof(u_long)*xn);
+        return;
+    }
+    for (int i=0; i<xn-1; i++) r[i] = (x[i] >> d) | (x[i+1] << (WORD_BITS-d));
+    if (xn > 0) r[xn-1] = x[xn-1] >> d;
+}
+
+/* q[0..an-bn+1) and r[0..bn) get the quotient and remainder of a[0..an)
+   by b[0..bn), where b[bn-1] != 0 and an >= bn.  The dividend is treated
+   as a number of base B^bn, whose digits are divided by words_div2n1n. */
+static void words_divrem_dc(u_long *q, u_long *r, const u_long *a, int an,
+                            const u_long *b, int bn)
+{
+    int n = bn;
+    int d = div_normalization_factor(b[n-1]);
+    int k = (an + n)/n;         /* a << d has an+1 words */
+    u_long *u = SCM_NEW_ATOMIC_ARRAY(u_long, k*n);
+    u_long *v = SCM_NEW_ATOMIC_ARRAY(u_long, n);
+    memset(u, 0, sizeof(u_long)*k*n);
+    u[an] = words_lshift(u, a, an, d);
+    words_lshift(v, b, n, d);
+
+    u_long *cur = SCM_NEW_ATOMIC_ARRAY(u_long, 2*n);
+    u_long *qq = SCM_NEW_ATOMIC_ARRAY(u_long, k*n);
+    u_long *rr = SCM_NEW_ATOMIC_ARRAY(u_long, n);
+    memset(rr, 0, sizeof(u_long)*n);
+    for (int i=k-1; i>=0; i--) {
+        memcpy(cur, u+i*n, sizeof(u_long)*n);
+        memcpy(cur+n, rr, sizeof(u_long)*n);
+        words_div2n1n(qq+i*n, rr, cur, v, n);
+    }
+    words_rshift(r, rr, n, d);
+    memcpy(q, qq, sizeof(u_long)*(an-bn+1));
+}
+
+/* Same as words_divrem_dc, but chooses the method by the sizes. */
+static void words_divrem(u_long *q, u_long *r, const u_long *a, int an,
+                         const u_long *b, int bn)
+{
+    if (bn >= div_dc_threshold && an - bn >= div_dc_threshold) {
+        words_divrem_dc(q, r, a, an, b, bn);
+    } else {
+        words_divrem_basecase(q, an-bn+1, r, a, an, b, bn);
+    }
+}
+
 /* assuming dividend and divisor is normalized.  returns quotient and
    remainder */
 ScmObj Scm_BignumDivRem(const ScmBignum *dividend, const ScmBignum *divisor)
@@ -1094,6 +1545,19 @@ ScmObj Scm_BignumDivRem(const ScmBignum *dividend, const ScmBignum *divisor)
         return Scm_Cons(SCM_MAKE_INT(0), SCM_OBJ(dividend));
     }
 
+    if ((u_long)divisor->size >= (u_long)div_dc_threshold
+        && (u_long)(dividend->size - divisor->size)
+           >= (u_long)div_dc_threshold) {
+        ScmBignum *q = make_bignum(dividend->size - divisor->size + 1);
+        ScmBignum *r = make_bignum(divisor->size);
+        words_divrem_dc(q->values, r->values,
+                        dividend->values, dividend->size,
+                        divisor->values, divisor->size);
+        q->sign = dividend->sign * divisor->sign;
+        r->sign = dividend->sign;
+        return Scm_Cons(Scm_NormalizeBignum(q), Scm_NormalizeBignum(r));
+    }
+
     ScmBignum *q = make_bignum(dividend->size - divisor->size + 1);
     ScmBignum *r = bignum_gdiv(dividend, divisor, q);
     q->sign = dividend->sign * divisor->sign;
@@ -1273,29 +1737,298 @@ int Scm_BignumLogCount(const ScmBignum *b)
 
 
 /*-----------------------------------------------------------------------
- * Printing
+ * Radix conversion
+ */
+
+/* Converting an n-word number to and from a string one word at a time
+ * takes O(n^2).  For large numbers we split them by a power of the radix
+ * instead, and convert each half recursively; with the subquadratic
+ * multiplication and division the cost becomes O(M(n) log n).
+ *
+ * We group the digits into chunks.  A chunk is DIGITS digits, and its
+ * value is less than CHUNK = radix^DIGITS, which fits in a half word so
+ * that words_div_small can be used.  The powers CHUNK^(2^i) are computed
+ * on demand and kept for each radix.  Computing the same power in two
+ * threads at the same time is harmless; they get the same value.
+ *
+ * If the radix is a power of two, digits are just taken from bits.
  */
+static int radix_conv_threshold = 32;
+
+int Scm__BignumRadixConvThreshold(int value)
+{
+    int prev = radix_conv_threshold;
+    if (value >= 0) radix_conv_threshold = max(value, 2);
+    return prev;
+}
+
+#define RADIX_POWERS_MAX 32
+
+static struct radix_info_rec {
+    int digits;                 /* # of digits in a chunk */
+    u_long chunk;               /* radix^digits */
+    int chunk_bits;             /* floor(log2(chunk)) */
+    int bits;                   /* log2(radix) if radix is 2^k, 0 otherwise */
+    ScmBignum *powers[RADIX_POWERS_MAX]; /* chunk^(2^i), computed lazily */
+} radix_info[37];
+
+static struct radix_info_rec *get_radix_info(int radix)
+{
+    struct radix_info_rec *ri = &radix_info[radix];
+    if (ri->chunk == 0) {
+        int digits = 1;
+        u_long chunk = radix;
+        while (chunk * radix < HALF_WORD) {
+            chunk *= radix;
+            digits++;
+        }
+        ri->chunk_bits = 0;
+        while ((chunk >> ri->chunk_bits) > 1) ri->chunk_bits++;
+        ri->bits = 0;
+        if ((radix & (radix-1)) == 0) {
+            while ((1 << ri->bits) < radix) ri->bits++;
+        }
+        ri->digits = digits;
+        ri->chunk = chunk;       /* set the last, for the other threads */
+    }
+    return ri;
+}
+
+/* Returns chunk^(2^i). */
+static ScmBignum *radix_power(struct radix_info_rec *ri, int i)
+{
+    if (i >= RADIX_POWERS_MAX) {
+        Scm_Error("number too large to convert");
+        return NULL;            /* dummy */
+    }
+    if (ri->powers[i] == NULL) {
+        ScmBignum *p;
+        if (i == 0) {
+            p = make_bignum(1);
+            p->values[0] = ri->chunk;
+        } else {
+            ScmBignum *h = radix_power(ri, i-1);
+            p = make_bignum(h->size*2);
+            words_mul(p->values, h->values, h->size, h->values, h->size);
+            p->size = words_trim(p->values, p->size);
+        }
+        p->sign = 1;
+        ri->powers[i] = p;
+    }
+    return ri->powers[i];
+}
+
+/* Writes x[0..xn) in the given radix into buf[0..ndigits), padding zeros
+   on the left.  x is destroyed.  This is the quadratic one. */
+static void words_to_digits_basecase(char *buf, int ndigits,
+                                     u_long *x, int xn,
+                                     struct radix_info_rec *ri, int radix,
+                                     const char *tab)
+{
+    char *p = buf + ndigits;
+    xn = words_trim(x, xn);
+    while (xn > 0 && p > buf) {
+        u_long rem = words_div_small(x, xn, ri->chunk);
+        xn = words_trim(x, xn);
+        for (int i=0; i<ri->digits && p > buf; i++) {
+            *--p = tab[rem % radix];
+            rem /= radix;
+        }
+    }
+    while (p > buf) *--p = '0';
+}
+
+/* Writes x[0..xn), which is less than chunk^(2^e), into
+   buf[0..digits*2^e), padding zeros on the left.  x is destroyed. */
+static void words_to_digits(char *buf, u_long *x, int xn, int e,
+                            struct radix_info_rec *ri, int radix,
+                            const char *tab)
+{
+    int ndigits = ri->digits << e;
+    xn = words_trim(x, xn);
+    if (e == 0 || xn < radix_conv_threshold) {
+        words_to_digits_basecase(buf, ndigits, x, xn, ri, radix, tab);
+        return;
+    }
+    ScmBignum *p = radix_power(ri, e-1);
+    int half = ndigits/2;
+    if (words_cmp(x, xn, p->values, p->size) < 0) {
+        memset(buf, '0', half);
+        words_to_digits(buf+half, x, xn, e-1, ri, radix, tab);
+        return;
+    }
+    int pn = p->size;
+    u_long *q = SCM_NEW_ATOMIC_ARRAY(u_long, xn-pn+1);
+    u_long *r = SCM_NEW_ATOMIC_ARRAY(u_long, pn);
+    words_divrem(q, r, x, xn, p->values, pn);
+    words_to_digits(buf, q, xn-pn+1, e-1, ri, radix, tab);
+    words_to_digits(buf+half, r, pn, e-1, ri, radix, tab);
+}
 
 ScmObj Scm_BignumToString(const ScmBignum *b, int radix, int use_upper)
 {
     static const char ltab[] = "0123456789abcdefghijklmnopqrstuvwxyz";
     static const char utab[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
     const char *tab = use_upper? utab : ltab;
-    ScmObj h = SCM_NIL, t = SCM_NIL;
     if (radix < 2 || radix > 36)
         Scm_Error("radix out of range: %d", radix);
-    ScmBignum *q = SCM_BIGNUM(Scm_BignumCopy(b));
-    for (;q->size > 0;) {
-        long rem = bignum_sdiv(q, radix);
-        SCM_ASSERT(rem >= 0 && rem < radix);
-        SCM_APPEND1(h, t, SCM_MAKE_CHAR(tab[rem]));
-        for (; q->values[q->size-1] == 0 && q->size > 0; q->size--)
-            ;
+    struct radix_info_rec *ri = get_radix_info(radix);
+    int xn = words_trim(b->values, b->size);
+    char *buf;
+    int ndigits;
+
+    if (ri->bits > 0) {
+        /* Each digit is a bit field */
+        ndigits = (xn*WORD_BITS + ri->bits - 1)/ri->bits;
+        buf = SCM_NEW_ATOMIC_ARRAY(char, ndigits+2);
+        u_long mask = (1UL << ri->bits) - 1;
+        for (int i=0; i<ndigits; i++) {
+            int bit = i*ri->bits, w = bit/WORD_BITS, s = bit%WORD_BITS;
+            u_long d = b->values[w] >> s;
+            if (s + ri->bits > WORD_BITS && w+1 < xn) {
+                d |= b->values[w+1] << (WORD_BITS - s);
+            }
+            buf[ndigits-i] = tab[d & mask];
+        }
+    } else {
+        u_long *x = SCM_NEW_ATOMIC_ARRAY(u_long, xn);
+        memcpy(x, b->values, sizeof(u_long)*xn);
+        if (xn < radix_conv_threshold) {
+            int nchunks = (xn*WORD_BITS + ri->chunk_bits - 1)/ri->chunk_bits;
+            ndigits = (nchunks > 0? nchunks : 1) * ri->digits;
+            buf = SCM_NEW_ATOMIC_ARRAY(char, ndigits+2);
+            words_to_digits_basecase(buf+1, ndigits, x, xn, ri, radix, tab);
+        } else {
+            int e = 0;
+            for (;;e++) {
+                ScmBignum *p = radix_power(ri, e);
+                if (words_cmp(x, xn, p->values, p->size) < 0) break;
+            }
+            ndigits = ri->digits << e;
+            buf = SCM_NEW_ATOMIC_ARRAY(char, ndigits+2);
+            words_to_digits(buf+1, x, xn, e, ri, radix, tab);
+        }
+    }
+
+    /* buf[1..ndigits] has digits, possibly with leading zeros. */
+    char *p = buf+1, *end = buf+1+ndigits;
+    while (p < end-1 && *p == '0') p++;
+    if (b->sign < 0) *--p = '-';
+    *end = '\0';
+    return Scm_MakeString(p, end-p, end-p, 0);
+}
+
+/* An upper bound of words to hold an NDIGITS-digit number.  Each digit
+   carries less than 6 bits, for radix <= 36. */
+static inline int digits_words(int ndigits)
+{
+    return (ndigits/WORD_BITS + 1)*6 + 1;
+}
+
+/* Returns the value of digits[0..ndigits) (most significant first) in
+   r[0..rn), where each digit is the value, not the character. */
+static void digits_to_words_basecase(u_long *r, int rn,
+                                     const char *digits, int ndigits,
+                                     struct radix_info_rec *ri, int radix)
+{
+    memset(r, 0, sizeof(u_long)*rn);
+    int rsize = 0;
+    int i = 0;
+    while (i < ndigits) {
+        /* The first chunk may be shorter */
+        int k = (i == 0 && ndigits % ri->digits)? ndigits % ri->digits
+            : ri->digits;
+        u_long m = 1, v = 0;
+        for (int j=0; j<k; j++, i++) {
+            v = v * radix + (u_char)digits[i];
+            m *= radix;
+        }
+        /* r = r * m + v */
+        u_long carry = v;
+        for (int j=0; j<rsize; j++) {
+            u_long hi, lo, x = r[j], c = 0;
+            UMUL(hi, lo, x, m);
+            UADD(r[j], c, lo, carry);
+            carry = hi + c;
+        }
+        if (carry) {
+            SCM_ASSERT(rsize < rn);
+            r[rsize++] = carry;
+        }
+    }
+}
+
+/* Returns the value of digits[0..ndigits) in r[0..rn). */
+static void digits_to_words(u_long *r, int rn,
+                            const char *digits, int ndigits,
+                            struct radix_info_rec *ri, int radix)
+{
+    int nchunks = (ndigits + ri->digits - 1)/ri->digits;
+    if (nchunks <= radix_conv_threshold*2) {
+        digits_to_words_basecase(r, rn, digits, ndigits, ri, radix);
+        return;
+    }
+    /* Split so that the lower part has chunk^(2^e) digits */
+    int e = 0;
+    while ((2 << e) < nchunks) e++;
+    int lodigits = ri->digits << e;
+    int hidigits = ndigits - lodigits;
+    ScmBignum *p = radix_power(ri, e);
+    int hn = min(digits_words(hidigits), rn);
+    int ln = min(digits_words(lodigits), rn);
+    u_long *hi = SCM_NEW_ATOMIC_ARRAY(u_long, hn);
+    u_long *lo = SCM_NEW_ATOMIC_ARRAY(u_long, ln);
+    digits_to_words(hi, hn, digits, hidigits, ri, radix);
+    digits_to_words(lo, ln, digits+hidigits, lodigits, ri, radix);
+    hn = words_trim(hi, hn);
+    ln = words_trim(lo, ln);
+    memset(r, 0, sizeof(u_long)*rn);
+    if (hn > 0) {
+        u_long *t = SCM_NEW_ATOMIC_ARRAY(u_long, hn + p->size);
+        words_mul(t, hi, hn, p->values, p->size);
+        int tn = words_trim(t, hn + p->size);
+        SCM_ASSERT(tn <= rn);
+        memcpy(r, t, sizeof(u_long)*tn);
+    }
+    words_add_to(r, rn, lo, ln);
+}
+
+/* Returns an exact integer whose digits in the given radix are
+   digits[0..ndigits), most significant first.  Each element is a digit
+   value (0 <= digits[i] < radix), not a character.  Used by the number
+   reader. */
+ScmObj Scm_BignumFromDigits(const char *digits, int ndigits, int radix)
+{
+    if (radix < 2 || radix > 36)
+        Scm_Error("radix out of range: %d", radix);
+    struct radix_info_rec *ri = get_radix_info(radix);
+    while (ndigits > 0 && *digits == 0) { digits++; ndigits--; }
+
+    ScmBignum *b;
+    if (ri->bits > 0) {
+        int rn = (int)(((long)ndigits * ri->bits + WORD_BITS - 1)/WORD_BITS);
+        b = make_bignum(rn > 0? rn : 1);
+        for (int i=0; i<ndigits; i++) {
+            u_long d = (u_char)digits[ndigits-1-i];
+            int bit = i*ri->bits, w = bit/WORD_BITS, s = bit%WORD_BITS;
+            b->values[w] |= d << s;
+            if (s + ri->bits > WORD_BITS) {
+                b->values[w+1] |= d >> (WORD_BITS - s);
+            }
+        }
+    } else {
+        int rn = digits_words(ndigits);
+        b = make_bignum(rn);
+        digits_to_words(b->values, rn, digits, ndigits, ri, radix);
     }
-    if (q->sign < 0) SCM_APPEND1(h, t, SCM_MAKE_CHAR('-'));
-    return Scm_ListToString(Scm_ReverseX(h));
+    b->sign = 1;
+    return Scm_NormalizeBignum(b);
 }
 
+/*-----------------------------------------------------------------------
+ * Printing
+ */
+
 int Scm_DumpBignum(const ScmBignum *b, ScmPort *out)
 {
     Scm_Printf(out, "#<bignum ");
@@ -35,6 +35,7 @@
 #include "gauche.h"
 #include "gauche/class.h"
 #include "gauche/code.h"
+#include "gauche/priv/atomicP.h"
 #include "gauche/priv/classP.h"
 #include "gauche/priv/builtin-syms.h"
 #include "gauche/priv/macroP.h"
@@ -57,6 +58,7 @@ static void method_print(ScmObj, ScmPort *, ScmWriteContext*);
 static void next_method_print(ScmObj, ScmPort *, ScmWriteContext*);
 static void slot_accessor_print(ScmObj, ScmPort *, ScmWriteContext*);
 static void accessor_method_print(ScmObj, ScmPort *, ScmWriteContext*);
+static void slot_cache_print(ScmObj, ScmPort *, ScmWriteContext*);
 
 static ScmObj class_allocate(ScmClass *klass, ScmObj initargs);
 static ScmObj generic_allocate(ScmClass *klass, ScmObj initargs);
@@ -131,6 +133,7 @@ SCM_DEFINE_BUILTIN_CLASS(Scm_AccessorMethodClass,
                          method_allocate,
                          Scm_MethodCPL);
 SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_NextMethodClass, next_method_print);
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_SlotCacheClass, slot_cache_print);
 
 /* Builtin generic functions */
 SCM_DEFINE_GENERIC(Scm_GenericMake, Scm_NoNextMethod, NULL);
@@ -170,7 +173,8 @@ static ScmObj key_body           = SCM_FALSE;
 
 /* TRANSIENT: Global flag to dispable generic dispatcher.  This is an escape
    pod to fall back the default mechanism when we find a serious bug in
-   dispatch accelerator.  Can be turned on with a environment variable. */
+   dispatch accelerator.  Can be turned on with a environment variable.
+   It also disables the call site method cache. */
 static int disable_generic_dispatcher = FALSE;
 
 /* A global lock to serialize class redefinition.  We need it since
@@ -1201,11 +1205,15 @@ ScmObj Scm_VMTouchInstance(ScmObj obj)
 */
 ScmObj Scm_NewInstance(ScmClass *klass, int coresize)
 {
-    ScmObj obj = SCM_NEW2(ScmObj, coresize);
+    /* We tell the allocation profiler the class, instead of the
+       C type name. */
+    ScmObj obj = SCM_OBJ(Scm__Malloc(coresize, SCM_ALLOC_CLASS, klass));
 
     if (SCM_CLASS_CATEGORY(klass) == SCM_CLASS_BASE
         || SCM_CLASS_CATEGORY(klass) == SCM_CLASS_SCHEME) {
-        ScmObj *slots = SCM_NEW_ARRAY(ScmObj, klass->numInstanceSlots);
+        ScmObj *slots =
+            (ScmObj*)Scm__Malloc(sizeof(ScmObj)*klass->numInstanceSlots,
+                                 SCM_ALLOC_CLASS, klass);
 
         /* NB: actually, for Scheme instances, 'coresize' argument is
            redundant since klass->coreSize has it.  There's a historical
@@ -1638,6 +1646,115 @@ ScmObj Scm_VMSlotSetUsingAccessor(ScmObj obj, ScmSlotAccessor *sa, ScmObj val)
     return slot_set_using_accessor(obj, sa, val);
 }
 
+/* SLOT-REFC and SLOT-SETC instructions
+ *
+ * SITE points to the operand of the instruction, which is either a slot
+ * name or a slot cache (see gauche/priv/classP.h).  If the class of
+ * obj is in the cache, we use the accessor directly.  Otherwise we look
+ * up the accessor and install a new cache that has it.
+ *
+ * A redefined class never hits, and we don't cache the class that's
+ * still malleable, for its accessors may change.  When we don't have
+ * an accessor to use, we go through Scm_VMSlotRef/Scm_VMSlotSet for
+ * the full protocol.
+ */
+static ScmSlotAccessor *slot_cache_lookup(ScmObj operand, ScmClass *klass)
+{
+    if (SCM_SLOT_CACHE_P(operand) && SCM_FALSEP(klass->redefined)) {
+        ScmSlotCache *c = SCM_SLOT_CACHE(operand);
+        for (int i=0; i<c->numEntries; i++) {
+            if (c->entries[i].klass == klass) return c->entries[i].accessor;
+        }
+    }
+    return NULL;
+}
+
+/* The code vector isn't scanned by GC, so the cache must be reachable
+   from the constants of BASE, the compiled code that contains SITE.
+   We replace the old cache in the constants, or add the new one if
+   SITE had the slot name.  The lock serializes the replacements. */
+static ScmInternalMutex slot_cache_mutex;
+
+static ScmSlotAccessor *slot_cache_fill(ScmWord *site, ScmClass *klass,
+                                        ScmCompiledCode *base)
+{
+    ScmObj name = SCM_SLOT_CACHE_NAME(SCM_OBJ(*site));
+
+    if (base == NULL
+        || site < base->code || site >= base->code + base->codeSize
+        || !SCM_FALSEP(klass->redefined) || SCM_CLASS_MALLEABLE_P(klass)) {
+        return NULL;
+    }
+    ScmSlotAccessor *sa = Scm_GetSlotAccessor(klass, name);
+    if (sa == NULL) return NULL;
+
+    ScmSlotCache *c = SCM_NEW(ScmSlotCache);
+    SCM_SET_CLASS(c, SCM_CLASS_SLOT_CACHE);
+    c->name = name;
+    c->entries[0].klass = klass;
+    c->entries[0].accessor = sa;
+    c->numEntries = 1;
+
+    (void)SCM_INTERNAL_MUTEX_LOCK(slot_cache_mutex);
+    ScmObj operand = SCM_OBJ(*site);
+    int i = base->constantSize;
+    if (SCM_SLOT_CACHE_P(operand)) {
+        /* Keep the recent ones; the oldest is evicted if full. */
+        ScmSlotCache *old = SCM_SLOT_CACHE(operand);
+        for (int j=0; j<old->numEntries && c->numEntries<SCM_SLOT_CACHE_SIZE;
+             j++) {
+            if (old->entries[j].klass == klass) continue;
+            c->entries[c->numEntries++] = old->entries[j];
+        }
+        for (i=0; i<base->constantSize; i++) {
+            if (SCM_EQ(base->constants[i], operand)) break;
+        }
+    }
+    if (i < base->constantSize) {
+        base->constants[i] = SCM_OBJ(c);
+    } else {
+        ScmObj *v = SCM_NEW_ARRAY(ScmObj, base->constantSize+1);
+        for (i=0; i<base->constantSize; i++) v[i] = base->constants[i];
+        v[i] = SCM_OBJ(c);
+        base->constants = v;
+        base->constantSize++;
+    }
+    *site = SCM_WORD(c);
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(slot_cache_mutex);
+    return sa;
+}
+
+ScmObj Scm__VMSlotRefC(ScmObj obj, ScmWord *site, ScmCompiledCode *base)
+{
+    ScmClass *klass = Scm_ClassOf(obj);
+    ScmObj operand = SCM_OBJ(*site);
+    ScmSlotAccessor *sa = slot_cache_lookup(operand, klass);
+
+    if (sa == NULL) {
+        sa = slot_cache_fill(site, klass, base);
+        if (sa == NULL) {
+            return Scm_VMSlotRef(obj, SCM_SLOT_CACHE_NAME(operand), FALSE);
+        }
+    }
+    return slot_ref_using_accessor(obj, sa, FALSE);
+}
+
+ScmObj Scm__VMSlotSetC(ScmObj obj, ScmObj val, ScmWord *site,
+                       ScmCompiledCode *base)
+{
+    ScmClass *klass = Scm_ClassOf(obj);
+    ScmObj operand = SCM_OBJ(*site);
+    ScmSlotAccessor *sa = slot_cache_lookup(operand, klass);
+
+    if (sa == NULL) {
+        sa = slot_cache_fill(site, klass, base);
+        if (sa == NULL) {
+            return Scm_VMSlotSet(obj, SCM_SLOT_CACHE_NAME(operand), val);
+        }
+    }
+    return slot_set_using_accessor(obj, sa, val);
+}
+
 /* SLOT-SET-USING-CLASS
  *
  * (define-method slot-set-using-class
@@ -2157,12 +2274,60 @@ int Scm_MethodApplicableForClasses(ScmMethod *m, ScmClass *types[], int nargs)
     return TRUE;
 }
 
+/* Attaches a dispatcher to GF to see if it's worth accelerating.
+   See "Automatic dispatcher" in dispatch.c. */
+static void generic_attach_dispatcher(ScmGeneric *gf)
+{
+    (void)SCM_INTERNAL_MUTEX_LOCK(gf->lock);
+    if (gf->dispatcher == NULL) {
+        gf->dispatcher = Scm__MakeObservingMethodDispatcher();
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+}
+
+static void generic_review_dispatcher(ScmGeneric *gf,
+                                      ScmMethodDispatcher *dis)
+{
+    (void)SCM_INTERNAL_MUTEX_LOCK(gf->lock);
+    if (gf->dispatcher == dis) {
+        gf->dispatcher = Scm__MethodDispatcherReview(dis, gf->methods);
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+}
+
+/* Returns the list of applicable methods in METHODS. */
+static ScmObj filter_applicable_methods(ScmObj methods,
+                                        ScmClass **typev, int argc)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL, mp;
+
+    SCM_ASSERT(SCM_PAIRP(methods));
+    if (SCM_NULLP(SCM_CDR(methods))) {
+        /* We have only one method, so just check its applicability
+           and retrun the list without allocation if possible. */
+        if (Scm_MethodApplicableForClasses(SCM_METHOD(SCM_CAR(methods)),
+                                           typev, argc)) {
+            return methods;
+        } else {
+            return SCM_NIL;
+        }
+    } else {
+        SCM_FOR_EACH(mp, methods) {
+            ScmObj m = SCM_CAR(mp);
+            SCM_ASSERT(SCM_METHODP(m));
+            if (Scm_MethodApplicableForClasses(SCM_METHOD(m), typev, argc)) {
+                SCM_APPEND1(h, t, SCM_OBJ(m));
+            }
+        }
+        return h;
+    }
+}
+
 /* compute-applicable-methods */
 ScmObj Scm_ComputeApplicableMethods(ScmGeneric *gf, ScmObj *argv, int argc,
                                     int applyargs)
 {
-    ScmObj methods = gf->methods, mp, ap;
-    ScmObj h = SCM_NIL, t = SCM_NIL;
+    ScmObj methods = gf->methods, ap;
     ScmClass *typev_s[PREALLOC_SIZE], **typev = typev_s;
     int i, nsel;
 
@@ -2183,34 +2348,27 @@ ScmObj Scm_ComputeApplicableMethods(ScmGeneric *gf, ScmObj *argv, int argc,
         }
     }
 
-    if (gf->dispatcher
-        && argc <= SCM_DISPATCHER_MAX_NARGS
-        && argc >= 1) {
+    if (argc <= SCM_DISPATCHER_MAX_NARGS && argc >= 1) {
         ScmMethodDispatcher *dis = (ScmMethodDispatcher*)gf->dispatcher;
-        ScmObj p = Scm__MethodDispatcherLookup(dis, typev, argc);
-        if (SCM_PAIRP(p)) methods = p;
-    }
-
-    SCM_ASSERT(SCM_PAIRP(methods));
-    if (SCM_NULLP(SCM_CDR(methods))) {
-        /* We have only one method, so just check its applicability
-           and retrun the list without allocation if possible. */
-        if (Scm_MethodApplicableForClasses(SCM_METHOD(SCM_CAR(methods)),
-                                           typev, argc)) {
-            return methods;
+        if (dis == NULL) {
+            if (!disable_generic_dispatcher && SCM_PAIRP(SCM_CDR(methods))) {
+                generic_attach_dispatcher(gf);
+            }
         } else {
-            return SCM_NIL;
-        }
-    } else {
-        SCM_FOR_EACH(mp, methods) {
-            ScmObj m = SCM_CAR(mp);
-            SCM_ASSERT(SCM_METHODP(m));
-            if (Scm_MethodApplicableForClasses(SCM_METHOD(m), typev, argc)) {
-                SCM_APPEND1(h, t, SCM_OBJ(m));
+            int review = FALSE;
+            ScmObj p = Scm__MethodDispatcherLookup(dis, typev, argc, &review);
+            ScmObj r = SCM_NIL;
+            if (SCM_PAIRP(p)) {
+                r = filter_applicable_methods(p, typev, argc);
+                /* None of the methods found by the table is applicable,
+                   but a less specific one may be. */
+                if (SCM_NULLP(r)) Scm__MethodDispatcherMiss(dis);
             }
+            if (review) generic_review_dispatcher(gf, dis);
+            if (!SCM_NULLP(r)) return r;
         }
-        return h;
     }
+    return filter_applicable_methods(methods, typev, argc);
 }
 
 static ScmObj compute_applicable_methods(ScmNextMethod *nm SCM_UNUSED,
@@ -2348,6 +2506,107 @@ ScmObj Scm_SortMethods(ScmObj methods, ScmObj *argv, int argc)
 }
 
 
+/*
+ * Call site method cache
+ *
+ *   The VM asks Scm__CallSiteMethods for the sorted applicable methods
+ *   when it calls a pure generic function.  The result depends only on
+ *   the GF's methods, the number of arguments and the classes of the
+ *   first gf->maxReqargs arguments, so we cache it in a global table
+ *   indexed by the call site and the class of the first argument.
+ *   A polymorphic site uses several entries.
+ *
+ *   The entries are immutable and we swap the pointer atomically.
+ *   Instead of finding the entries to invalidate, we bump the global
+ *   epoch whenever the set of methods or their specializers change;
+ *   an entry made in an older epoch never hits.  We read the epoch
+ *   before computing the methods, so an entry computed concurrently
+ *   with the change is already stale when it's stored.
+ *
+ *   While the GF's automatic dispatcher is still observing the calls,
+ *   we don't cache the result, so that it sees the calls to decide.
+ */
+#define CALL_SITE_CACHE_SIZE   1024 /* must be power of 2 */
+#define CALL_SITE_CACHE_NARGS  4
+
+typedef struct call_site_entry_rec {
+    ScmWord *site;
+    ScmGeneric *gf;
+    ScmAtomicWord epoch;
+    int argc;
+    int nsel;                   /* # of classes in typev */
+    ScmClass *typev[CALL_SITE_CACHE_NARGS];
+    ScmObj methods;             /* sorted applicable methods */
+} call_site_entry;
+
+static ScmAtomicVar call_site_cache[CALL_SITE_CACHE_SIZE];
+static ScmAtomicVar method_epoch = 0;
+
+static void method_epoch_bump(void)
+{
+    for (;;) {
+        ScmAtomicWord n = AO_load(&method_epoch);
+        if (AO_compare_and_swap_full(&method_epoch, n, n+1)) break;
+    }
+}
+
+static inline u_long call_site_hash(ScmWord *site, ScmClass *k0)
+{
+    return ((((u_long)(intptr_t)site) >> 3) ^ (((u_long)(intptr_t)k0) >> 4))
+        & (CALL_SITE_CACHE_SIZE-1);
+}
+
+static ScmObj sorted_applicable_methods(ScmGeneric *gf,
+                                        ScmObj *argv, int argc)
+{
+    ScmObj mm = Scm_ComputeApplicableMethods(gf, argv, argc, FALSE);
+    if (SCM_PAIRP(mm) && SCM_PAIRP(SCM_CDR(mm))) {
+        mm = Scm_SortMethods(mm, argv, argc);
+    }
+    return mm;
+}
+
+ScmObj Scm__CallSiteMethods(ScmGeneric *gf, ScmObj *argv, int argc,
+                            ScmWord *site)
+{
+    int nsel = (argc < gf->maxReqargs)? argc : gf->maxReqargs;
+    if (disable_generic_dispatcher || nsel > CALL_SITE_CACHE_NARGS) {
+        return sorted_applicable_methods(gf, argv, argc);
+    }
+
+    ScmClass *typev[CALL_SITE_CACHE_NARGS];
+    for (int i=0; i<nsel; i++) typev[i] = Scm_ClassOf(argv[i]);
+
+    ScmAtomicWord epoch = AO_load(&method_epoch);
+    u_long h = call_site_hash(site, (nsel > 0)? typev[0] : NULL);
+    call_site_entry *e = (call_site_entry*)AO_load(&call_site_cache[h]);
+    if (e && e->site == site && e->gf == gf && e->argc == argc
+        && e->nsel == nsel && e->epoch == epoch) {
+        int i;
+        for (i=0; i<nsel; i++) {
+            if (e->typev[i] != typev[i]) break;
+        }
+        if (i == nsel) return e->methods;
+    }
+
+    ScmObj mm = sorted_applicable_methods(gf, argv, argc);
+    if (SCM_PAIRP(mm)) {
+        ScmMethodDispatcher *dis = (ScmMethodDispatcher*)gf->dispatcher;
+        if (dis == NULL || Scm__MethodDispatcherSettledP(dis)) {
+            e = SCM_NEW(call_site_entry);
+            e->site = site;
+            e->gf = gf;
+            e->epoch = epoch;
+            e->argc = argc;
+            e->nsel = nsel;
+            for (int i=0; i<nsel; i++) e->typev[i] = typev[i];
+            e->methods = mm;
+            AO_store(&call_site_cache[h], (ScmAtomicWord)e);
+        }
+    }
+    return mm;
+}
+
 /* Developer API.  Accessible from Scheme via generic-build-dispatcher!
    If axis is out of range, we do nothing and returns #f. 
  */
@@ -2593,6 +2852,7 @@ ScmObj Scm_UpdateDirectMethod(ScmMethod *m, ScmClass *old, ScmClass *newc)
        dispatcher table for every invocation of it.
      */
     Scm__GenericInvalidateDispatcher(m->generic);
+    method_epoch_bump();
     return SCM_OBJ(m);
 }
 
@@ -2671,9 +2931,15 @@ ScmObj Scm_AddMethod(ScmGeneric *gf, ScmMethod *method)
     }
     if (gf->dispatcher && (method_locked == NULL)) {
         ScmMethodDispatcher *dis = (ScmMethodDispatcher*)gf->dispatcher;
-        if (replaced) Scm__MethodDispatcherDelete(dis, replaced);
-        Scm__MethodDispatcherAdd(dis, method);
+        if (Scm__MethodDispatcherPinnedP(dis)) {
+            if (replaced) Scm__MethodDispatcherDelete(dis, replaced);
+            Scm__MethodDispatcherAdd(dis, method);
+        } else {
+            /* The automatic dispatcher starts over. */
+            gf->dispatcher = NULL;
+        }
     }
+    if (method_locked == NULL) method_epoch_bump();
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
 
     if (method_locked != NULL) {
@@ -2725,9 +2991,14 @@ ScmObj Scm_DeleteMethod(ScmGeneric *gf, ScmMethod *method)
         }
     }
     if (gf->dispatcher) {
-        Scm__MethodDispatcherDelete((ScmMethodDispatcher*)gf->dispatcher,
-                                    method);
+        ScmMethodDispatcher *dis = (ScmMethodDispatcher*)gf->dispatcher;
+        if (Scm__MethodDispatcherPinnedP(dis)) {
+            Scm__MethodDispatcherDelete(dis, method);
+        } else {
+            gf->dispatcher = NULL;
+        }
     }
+    method_epoch_bump();
     SCM_FOR_EACH(mp, gf->methods) {
         /* sync # of required selector */
         if (SCM_PROCEDURE_REQUIRED(SCM_CAR(mp)) > gf->maxReqargs) {
@@ -2786,6 +3057,21 @@ static void next_method_print(ScmObj obj, ScmPort *out,
     Scm_Printf(out, "#<next-method %S%d %S>", nm->methods, nm->applyargs, args);
 }
 
+/*=====================================================================
+ * Slot cache
+ */
+
+static void slot_cache_print(ScmObj obj, ScmPort *out,
+                             ScmWriteContext *ctx SCM_UNUSED)
+{
+    ScmSlotCache *c = SCM_SLOT_CACHE(obj);
+    Scm_Printf(out, "#<slot-cache %S", c->name);
+    for (int i=0; i<c->numEntries; i++) {
+        Scm_Printf(out, " %S", c->entries[i].klass->name);
+    }
+    Scm_Putc('>', out);
+}
+
 /*=====================================================================
  * Accessor Method
  */
@@ -3364,6 +3650,7 @@ void Scm__InitClass(void)
     key_body = SCM_MAKE_KEYWORD("body");
 
     (void)SCM_INTERNAL_MUTEX_INIT(class_redefinition_lock.mutex);
+    (void)SCM_INTERNAL_MUTEX_INIT(slot_cache_mutex);
     (void)SCM_INTERNAL_COND_INIT(class_redefinition_lock.cv);
 
     if (Scm_GetEnv("GAUCHE_DISABLE_GENERIC_DISPATCHER") != NULL) {
@@ -3402,6 +3689,7 @@ void Scm__InitClass(void)
     Scm_AccessorMethodClass.flags |= SCM_CLASS_APPLICABLE;
     BINIT(SCM_CLASS_SLOT_ACCESSOR,"<slot-accessor>", slot_accessor_slots);
     BINIT(SCM_CLASS_FOREIGN_POINTER, "<foreign-pointer>", NULL);
+    BINIT(SCM_CLASS_SLOT_CACHE, "<slot-cache>", NULL);
 
     /* char.c */
     CINIT(SCM_CLASS_CHAR_SET,         "<char-set>");
@@ -3420,6 +3708,7 @@ void Scm__InitClass(void)
 
     /* hash.c */
     CINIT(SCM_CLASS_HASH_TABLE,       "<hash-table>");
+    CINIT(SCM_CLASS_CONCURRENT_HASH_TABLE, "<concurrent-hash-table>");
 
     /* list.c */
     CINIT(SCM_CLASS_LIST,             "<list>");
@@ -3464,6 +3753,7 @@ void Scm__InitClass(void)
     /* regexp.c */
     CINIT(SCM_CLASS_REGEXP,           "<regexp>");
     CINIT(SCM_CLASS_REGMATCH,         "<regmatch>");
+    CINIT(SCM_CLASS_REGEXP_SET,       "<regexp-set>");
 
     /* string.c */
     CINIT(SCM_CLASS_STRING,           "<string>");
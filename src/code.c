@@ -36,6 +36,7 @@
 #include "gauche/class.h"
 #include "gauche/code.h"
 #include "gauche/vminsn.h"
+#include "gauche/priv/classP.h"
 #include "gauche/priv/codeP.h"
 #include "gauche/priv/identifierP.h"
 #include "gauche/priv/builtin-syms.h"
@@ -169,7 +170,8 @@ void Scm_CompiledCodeDump(ScmCompiledCode *cc)
             case SCM_VM_OPERAND_OBJ:
                 /* Check if we're referring to a lifted closure. */
                 lifted = check_lifted_closure(p+i, lifted);
-                Scm_Printf(out, "%S", p[i+1]);
+                /* Show the slot name instead of the inline cache */
+                Scm_Printf(out, "%S", SCM_SLOT_CACHE_NAME(SCM_OBJ(p[i+1])));
                 i++;
                 break;
             case SCM_VM_OPERAND_OBJ_ADDR:
@@ -861,6 +863,9 @@ ScmObj Scm_CompiledCodeToList(ScmCompiledCode *cc)
 
         switch (Scm_VMInsnOperandType(code)) {
         case SCM_VM_OPERAND_OBJ:;
+            /* Show the slot name instead of the inline cache */
+            SCM_APPEND1(h, t, SCM_SLOT_CACHE_NAME(SCM_OBJ(cc->code[++i])));
+            break;
         case SCM_VM_OPERAND_CODE:;
         case SCM_VM_OPERAND_CODES:;
             SCM_APPEND1(h, t, SCM_OBJ(cc->code[++i]));
@@ -0,0 +1,1157 @@
+/*
+ * codecache.c - on-disk cache of compiled code
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LIBGAUCHE_BODY
+#include "gauche.h"
+#include "gauche/class.h"
+#include "gauche/code.h"
+#include "gauche/regexp.h"
+#include "gauche/vminsn.h"
+#include "gauche/priv/classP.h"
+#include "gauche/priv/identifierP.h"
+
+#include <stdio.h>
+
+/*
+ * Code cache
+ *
+ *   When a directory is given by GAUCHE_CODE_CACHE_DIR environment variable
+ *   (or by set-code-cache-directory!), 'load' saves the compiled code
+ *   of each toplevel form of the loaded source file in a cache file, and
+ *   the subsequent loads of the same, unmodified file run the saved code
+ *   without reading or compiling the source.  The loading loop itself is
+ *   in libeval.scm; this file handles the file format.
+ *
+ *   A cache file consists of a header and a body.  The header records
+ *   the conditions under which the cache is valid---the Gauche version and
+ *   the VM instruction set, the absolute pathname, mtime, size and content
+ *   hash of the source file, and the name of the module that was current
+ *   when the loading started.  The body is a sequence of entries, each of
+ *   which is either a toplevel compiled code or a source form.  A form
+ *   whose compilation changes the global state (e.g. define-syntax or
+ *   select-module; see vm-note-compile-effect! in compile.scm) is saved
+ *   as a source form, and evaluated again when the cache is loaded.
+ *
+ *   Objects are written in native byte order; the cache is not meant
+ *   to be portable across platforms.
+ */
+
+#define CODE_CACHE_MAGIC     "GAUCHE-CODE-CACHE\n"
+#define CODE_CACHE_VERSION   2
+#define CODE_CACHE_SUFFIX    ".gcache"
+
+/* Maximum nesting level of objects.  We don't deal with circular
+   structures; deeper objects just make the entry uncacheable. */
+#define CODE_CACHE_MAX_DEPTH 4096
+
+/* Object tags */
+enum {
+    CC_FALSE, CC_TRUE, CC_NIL, CC_EOF, CC_UNDEFINED, CC_UNBOUND,
+    CC_FIXNUM, CC_FLONUM, CC_NUMBER, CC_CHAR, CC_STRING,
+    CC_SYMBOL, CC_KEYWORD, CC_LIST, CC_VECTOR, CC_UVECTOR,
+    CC_CHARSET, CC_REGEXP, CC_IDENTIFIER, CC_MODULE, CC_CODE,
+    CC_GENSYM,                  /* uninterned symbol, first occurrence */
+    CC_SHARED                   /* reference to previously read gensym
+                                   or code */
+};
+
+static struct {
+    ScmObj directory;           /* string or #f */
+    ScmObj image;               /* #f, or a list of image entries being
+                                   recorded, in reverse order */
+    ScmObj imageFailure;        /* #f, or the reason the image can't be
+                                   dumped */
+    ScmInternalMutex mutex;
+} ccinfo;
+
+/*================================================================
+ * Utilities
+ */
+
+/* FNV-1a.  Used for the file name of the cache and the checksums. */
+static uint64_t fnv_hash(uint64_t h, const unsigned char *p, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+#define FNV_INIT  0xcbf29ce484222325ULL
+
+static void put_bytes(ScmPort *out, const void *p, size_t size)
+{
+    Scm_Putz((const char*)p, size, out);
+}
+
+static void put_u8(ScmPort *out, u_int v)   { Scm_Putb((ScmByte)v, out); }
+static void put_u32(ScmPort *out, uint32_t v) { put_bytes(out, &v, sizeof(v)); }
+static void put_u64(ScmPort *out, uint64_t v) { put_bytes(out, &v, sizeof(v)); }
+
+static void put_cstr(ScmPort *out, const char *s, size_t size)
+{
+    put_u64(out, size);
+    put_bytes(out, s, size);
+}
+
+static void put_string(ScmPort *out, ScmString *s)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(s);
+    put_cstr(out, SCM_STRING_BODY_START(b), SCM_STRING_BODY_SIZE(b));
+}
+
+/* Readers signal an error on premature end of data.  It is caught
+   in libeval.scm, which discards the cache file. */
+static void get_bytes(ScmPort *in, void *p, size_t size)
+{
+    if (size == 0) return;
+    if ((size_t)Scm_Getz((char*)p, size, in) != size) {
+        Scm_Error("code cache is truncated");
+    }
+}
+
+static u_int get_u8(ScmPort *in)
+{
+    int b = Scm_Getb(in);
+    if (b == EOF) Scm_Error("code cache is truncated");
+    return (u_int)b;
+}
+
+static uint32_t get_u32(ScmPort *in)
+{
+    uint32_t v; get_bytes(in, &v, sizeof(v)); return v;
+}
+
+static uint64_t get_u64(ScmPort *in)
+{
+    uint64_t v; get_bytes(in, &v, sizeof(v)); return v;
+}
+
+/* Returns a string of the given flags */
+static ScmObj get_string(ScmPort *in, u_long flags)
+{
+    uint64_t size = get_u64(in);
+    char *buf = SCM_NEW_ATOMIC2(char*, size+1);
+    get_bytes(in, buf, size);
+    buf[size] = '\0';
+    return Scm_MakeString(buf, size, -1, flags);
+}
+
+static ScmObj module_name(ScmModule *m)
+{
+    return SCM_SYMBOLP(m->name)? m->name : SCM_FALSE;
+}
+
+/*================================================================
+ * Writer
+ */
+
+typedef struct cc_writer_rec {
+    ScmPort *out;
+    ScmHashTable *shared;       /* gensym or code -> index */
+    int numShared;
+    int depth;
+} cc_writer;
+
+static int write_obj(cc_writer *w, ScmObj obj);
+
+/* Write OBJ, or FALLBACK if OBJ can't be written.  Used for the debug
+   information that can be dropped safely. */
+static void write_obj_or(cc_writer *w, ScmObj obj, ScmObj fallback)
+{
+    ScmPort *out = w->out;
+    int numShared = w->numShared;
+    ScmObj tmp = Scm_MakeOutputStringPort(TRUE);
+
+    w->out = SCM_PORT(tmp);
+    int ok = write_obj(w, obj);
+    w->out = out;
+    if (ok) {
+        put_string(out, SCM_STRING(Scm_GetOutputStringUnsafe(SCM_PORT(tmp),
+                                                             0)));
+    } else {
+        /* Forget the shared objects registered in the failed attempt. */
+        ScmHashIter iter;
+        ScmDictEntry *e;
+        ScmObj dropped = SCM_NIL;
+        Scm_HashIterInit(&iter, SCM_HASH_TABLE_CORE(w->shared));
+        while ((e = Scm_HashIterNext(&iter)) != NULL) {
+            if (SCM_INT_VALUE(SCM_DICT_VALUE(e)) >= numShared) {
+                dropped = Scm_Cons(SCM_DICT_KEY(e), dropped);
+            }
+        }
+        ScmObj cp;
+        SCM_FOR_EACH(cp, dropped) Scm_HashTableDelete(w->shared, SCM_CAR(cp));
+        w->numShared = numShared;
+        /* fallback is always writable */
+        ScmObj tmp2 = Scm_MakeOutputStringPort(TRUE);
+        w->out = SCM_PORT(tmp2);
+        (void)write_obj(w, fallback);
+        w->out = out;
+        put_string(out, SCM_STRING(Scm_GetOutputStringUnsafe(SCM_PORT(tmp2),
+                                                             0)));
+    }
+}
+
+/* If OBJ has already been written, emit a reference and returns TRUE.
+   Otherwise, register OBJ and returns FALSE. */
+static int write_shared(cc_writer *w, ScmObj obj)
+{
+    ScmObj i = Scm_HashTableRef(w->shared, obj, SCM_FALSE);
+    if (SCM_INTP(i)) {
+        put_u8(w->out, CC_SHARED);
+        put_u32(w->out, (uint32_t)SCM_INT_VALUE(i));
+        return TRUE;
+    }
+    Scm_HashTableSet(w->shared, obj, SCM_MAKE_INT(w->numShared++), 0);
+    return FALSE;
+}
+
+static int write_code(cc_writer *w, ScmCompiledCode *cc)
+{
+    if (cc->builder != NULL || cc->code == NULL) return FALSE;
+    put_u8(w->out, CC_CODE);
+    put_u32(w->out, cc->requiredArgs);
+    put_u32(w->out, cc->optionalArgs);
+    put_u32(w->out, (uint32_t)cc->maxstack);
+    if (!write_obj(w, cc->name)) return FALSE;
+    write_obj_or(w, cc->debugInfo, SCM_NIL);
+    write_obj_or(w, cc->signatureInfo, SCM_FALSE);
+    write_obj_or(w, cc->intermediateForm, SCM_FALSE);
+
+    put_u32(w->out, (uint32_t)cc->codeSize);
+    for (int i = 0; i < cc->codeSize; i++) {
+        ScmWord insn = cc->code[i];
+        u_int code = SCM_VM_INSN_CODE(insn);
+        put_u64(w->out, (uint64_t)insn);
+        switch (Scm_VMInsnOperandType(code)) {
+        case SCM_VM_OPERAND_OBJ:;
+        case SCM_VM_OPERAND_CODE:;
+        case SCM_VM_OPERAND_CODES:
+            if (!write_obj(w, SCM_OBJ(cc->code[++i]))) return FALSE;
+            break;
+        case SCM_VM_OPERAND_ADDR:
+            put_u32(w->out, (uint32_t)((ScmWord*)cc->code[++i] - cc->code));
+            break;
+        case SCM_VM_OPERAND_OBJ_ADDR:
+            if (!write_obj(w, SCM_OBJ(cc->code[i+1]))) return FALSE;
+            put_u32(w->out, (uint32_t)((ScmWord*)cc->code[i+2] - cc->code));
+            i += 2;
+            break;
+        }
+    }
+    return TRUE;
+}
+
+/* Global references are saved as the name and the module name, as
+   the precompiler does. */
+static int write_global_ref(cc_writer *w, ScmObj name, ScmModule *mod)
+{
+    ScmObj modname = module_name(mod);
+    if (!SCM_SYMBOLP(name) || SCM_FALSEP(modname)) return FALSE;
+    put_u8(w->out, CC_IDENTIFIER);
+    if (!write_obj(w, name)) return FALSE;
+    put_string(w->out, SCM_SYMBOL_NAME(modname));
+    return TRUE;
+}
+
+static int write_obj_rec(cc_writer *w, ScmObj obj)
+{
+    ScmPort *out = w->out;
+
+    if (SCM_FALSEP(obj))     { put_u8(out, CC_FALSE); return TRUE; }
+    if (SCM_TRUEP(obj))      { put_u8(out, CC_TRUE); return TRUE; }
+    if (SCM_NULLP(obj))      { put_u8(out, CC_NIL); return TRUE; }
+    if (SCM_EOFP(obj))       { put_u8(out, CC_EOF); return TRUE; }
+    if (SCM_UNDEFINEDP(obj)) { put_u8(out, CC_UNDEFINED); return TRUE; }
+    if (SCM_UNBOUNDP(obj))   { put_u8(out, CC_UNBOUND); return TRUE; }
+    if (SCM_INTP(obj)) {
+        put_u8(out, CC_FIXNUM);
+        put_u64(out, (uint64_t)(int64_t)SCM_INT_VALUE(obj));
+        return TRUE;
+    }
+    if (SCM_FLONUMP(obj)) {
+        double d = SCM_FLONUM_VALUE(obj);
+        put_u8(out, CC_FLONUM);
+        put_bytes(out, &d, sizeof(d));
+        return TRUE;
+    }
+    if (SCM_NUMBERP(obj)) {
+        put_u8(out, CC_NUMBER);
+        put_string(out, SCM_STRING(Scm_NumberToString(obj, 10, 0)));
+        return TRUE;
+    }
+    if (SCM_CHARP(obj)) {
+        put_u8(out, CC_CHAR);
+        put_u32(out, (uint32_t)SCM_CHAR_VALUE(obj));
+        return TRUE;
+    }
+    if (SCM_STRINGP(obj)) {
+        const ScmStringBody *b = SCM_STRING_BODY(obj);
+        put_u8(out, CC_STRING);
+        put_u8(out, SCM_STRING_BODY_FLAGS(b)
+               & (SCM_STRING_IMMUTABLE|SCM_STRING_INCOMPLETE));
+        put_string(out, SCM_STRING(obj));
+        return TRUE;
+    }
+    if (SCM_KEYWORDP(obj)) {
+        put_u8(out, CC_KEYWORD);
+        put_string(out, SCM_STRING(Scm_KeywordToString(SCM_KEYWORD(obj))));
+        return TRUE;
+    }
+    if (SCM_SYMBOLP(obj)) {
+        if (SCM_SYMBOL_INTERNED(obj)) {
+            put_u8(out, CC_SYMBOL);
+        } else {
+            if (write_shared(w, obj)) return TRUE;
+            put_u8(out, CC_GENSYM);
+        }
+        put_string(out, SCM_SYMBOL_NAME(obj));
+        return TRUE;
+    }
+    if (SCM_PAIRP(obj)) {
+        /* Write the elements iteratively, so that a long list doesn't
+           consume C stack. */
+        ScmObj cp;
+        uint64_t len = 0;
+        if (SCM_CIRCULAR_LIST_P(obj)) return FALSE;
+        SCM_FOR_EACH(cp, obj) len++;
+        put_u8(out, CC_LIST);
+        put_u64(out, len);
+        for (cp = obj; SCM_PAIRP(cp); cp = SCM_CDR(cp)) {
+            if (!write_obj(w, SCM_CAR(cp))) return FALSE;
+        }
+        return write_obj(w, cp);
+    }
+    if (SCM_VECTORP(obj)) {
+        ScmSmallInt len = SCM_VECTOR_SIZE(obj);
+        put_u8(out, CC_VECTOR);
+        put_u64(out, len);
+        for (ScmSmallInt i = 0; i < len; i++) {
+            if (!write_obj(w, SCM_VECTOR_ELEMENT(obj, i))) return FALSE;
+        }
+        return TRUE;
+    }
+    if (SCM_UVECTORP(obj)) {
+        int type = Scm_UVectorType(SCM_CLASS_OF(obj));
+        if (type == SCM_UVECTOR_INVALID) return FALSE;
+        put_u8(out, CC_UVECTOR);
+        put_u8(out, type);
+        put_u8(out, SCM_UVECTOR_IMMUTABLE_P(obj)? 1 : 0);
+        put_u64(out, SCM_UVECTOR_SIZE(obj));
+        put_bytes(out, SCM_UVECTOR_ELEMENTS(obj),
+                  Scm_UVectorSizeInBytes(SCM_UVECTOR(obj)));
+        return TRUE;
+    }
+    if (SCM_CHAR_SET_P(obj)) {
+        ScmObj ranges = Scm_CharSetRanges(SCM_CHAR_SET(obj)), cp;
+        put_u8(out, CC_CHARSET);
+        put_u8(out, SCM_CHAR_SET_IMMUTABLE_P(obj)? 1 : 0);
+        put_u64(out, Scm_Length(ranges));
+        SCM_FOR_EACH(cp, ranges) {
+            put_u32(out, (uint32_t)SCM_INT_VALUE(SCM_CAAR(cp)));
+            put_u32(out, (uint32_t)SCM_INT_VALUE(SCM_CDAR(cp)));
+        }
+        return TRUE;
+    }
+    if (SCM_REGEXPP(obj)) {
+        ScmRegexp *rx = SCM_REGEXP(obj);
+        if (!SCM_STRINGP(rx->pattern)) return FALSE;
+        put_u8(out, CC_REGEXP);
+        put_u8(out, (rx->flags & SCM_REGEXP_CASE_FOLD)? 1 : 0);
+        put_string(out, SCM_STRING(rx->pattern));
+        return TRUE;
+    }
+    if (SCM_IDENTIFIERP(obj)) {
+        /* We can't save local frames; such identifiers only appear
+           in the code that we don't cache anyway. */
+        if (!SCM_NULLP(Scm_IdentifierEnv(SCM_IDENTIFIER(obj)))) return FALSE;
+        ScmIdentifier *id = Scm_OutermostIdentifier(SCM_IDENTIFIER(obj));
+        return write_global_ref(w, id->name, id->module);
+    }
+    if (SCM_GLOCP(obj)) {
+        return write_global_ref(w, SCM_OBJ(SCM_GLOC(obj)->name),
+                                SCM_GLOC(obj)->module);
+    }
+    if (SCM_SLOT_CACHE_P(obj)) {
+        return write_obj_rec(w, SCM_SLOT_CACHE(obj)->name);
+    }
+    if (SCM_MODULEP(obj)) {
+        ScmObj name = module_name(SCM_MODULE(obj));
+        if (SCM_FALSEP(name)) return FALSE;
+        put_u8(out, CC_MODULE);
+        put_string(out, SCM_SYMBOL_NAME(name));
+        return TRUE;
+    }
+    if (SCM_COMPILED_CODE_P(obj)) {
+        if (write_shared(w, obj)) return TRUE;
+        return write_code(w, SCM_COMPILED_CODE(obj));
+    }
+    return FALSE;
+}
+
+static int write_obj(cc_writer *w, ScmObj obj)
+{
+    if (w->depth >= CODE_CACHE_MAX_DEPTH) return FALSE;
+    w->depth++;
+    int r = write_obj_rec(w, obj);
+    w->depth--;
+    return r;
+}
+
+/* Appends an entry to the cache body being accumulated in OUT.
+   OBJ is either a toplevel compiled code or a source form.  If OBJ
+   contains something that can't be saved, nothing is written and
+   FALSE is returned. */
+int Scm_CodeCachePut(ScmPort *out, ScmObj obj)
+{
+    ScmObj tmp = Scm_MakeOutputStringPort(TRUE);
+    cc_writer w;
+    w.out = SCM_PORT(tmp);
+    w.shared = SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+    w.numShared = 0;
+    w.depth = 0;
+
+    if (!write_obj(&w, obj)) return FALSE;
+    ScmObj s = Scm_GetOutputStringUnsafe(SCM_PORT(tmp), 0);
+    const ScmStringBody *b = SCM_STRING_BODY(s);
+    put_bytes(out, SCM_STRING_BODY_START(b), SCM_STRING_BODY_SIZE(b));
+    return TRUE;
+}
+
+/*================================================================
+ * Reader
+ */
+
+typedef struct cc_reader_rec {
+    ScmPort *in;
+    ScmHashTable *shared;       /* index -> gensym or code */
+    int numShared;
+} cc_reader;
+
+static ScmObj read_obj(cc_reader *r, ScmObj parent);
+
+static ScmModule *read_module(cc_reader *r)
+{
+    ScmObj name = Scm_Intern(SCM_STRING(get_string(r->in,
+                                                   SCM_STRING_IMMUTABLE)));
+    ScmModule *m = Scm_FindModule(SCM_SYMBOL(name), SCM_FIND_MODULE_QUIET);
+    if (m == NULL) Scm_Error("code cache refers to unknown module: %S", name);
+    return m;
+}
+
+/* Reads a serialized object that was written with write_obj_or. */
+static ScmObj read_optional(cc_reader *r, ScmObj parent)
+{
+    (void)get_u64(r->in);       /* size; we don't need it */
+    return read_obj(r, parent);
+}
+
+static ScmObj read_code(cc_reader *r, ScmObj parent)
+{
+    ScmCompiledCode *cc = SCM_NEW(ScmCompiledCode);
+    SCM_SET_CLASS(cc, SCM_CLASS_COMPILED_CODE);
+    Scm_HashTableSet(r->shared, SCM_MAKE_INT(r->numShared++), SCM_OBJ(cc), 0);
+
+    cc->builder = NULL;
+    cc->parent = parent;
+    cc->requiredArgs = (u_short)get_u32(r->in);
+    cc->optionalArgs = (u_short)get_u32(r->in);
+    cc->maxstack = (int)get_u32(r->in);
+    cc->name = read_obj(r, SCM_OBJ(cc));
+    cc->debugInfo = read_optional(r, SCM_OBJ(cc));
+    cc->signatureInfo = read_optional(r, SCM_OBJ(cc));
+    cc->intermediateForm = read_optional(r, SCM_OBJ(cc));
+
+    int size = (int)get_u32(r->in);
+    ScmWord *code = SCM_NEW_ATOMIC2(ScmWord*, size*sizeof(ScmWord));
+    ScmObj consts = SCM_NIL;
+    int nconsts = 0;
+    for (int i = 0; i < size; i++) {
+        ScmWord insn = (ScmWord)get_u64(r->in);
+        u_int c = SCM_VM_INSN_CODE(insn);
+        if (c >= SCM_VM_NUM_INSNS) Scm_Error("code cache is corrupted");
+        code[i] = insn;
+        switch (Scm_VMInsnOperandType(c)) {
+        case SCM_VM_OPERAND_OBJ:;
+        case SCM_VM_OPERAND_CODE:;
+        case SCM_VM_OPERAND_CODES: {
+            if (i+1 >= size) Scm_Error("code cache is corrupted");
+            ScmObj operand = read_obj(r, SCM_OBJ(cc));
+            code[++i] = SCM_WORD(operand);
+            consts = Scm_Cons(operand, consts);
+            nconsts++;
+            break;
+        }
+        case SCM_VM_OPERAND_ADDR: {
+            uint32_t off = get_u32(r->in);
+            if (i+1 >= size || off > (uint32_t)size) {
+                Scm_Error("code cache is corrupted");
+            }
+            code[++i] = SCM_WORD(code + off);
+            break;
+        }
+        case SCM_VM_OPERAND_OBJ_ADDR: {
+            if (i+2 >= size) Scm_Error("code cache is corrupted");
+            ScmObj operand = read_obj(r, SCM_OBJ(cc));
+            uint32_t off = get_u32(r->in);
+            if (off > (uint32_t)size) Scm_Error("code cache is corrupted");
+            code[i+1] = SCM_WORD(operand);
+            code[i+2] = SCM_WORD(code + off);
+            consts = Scm_Cons(operand, consts);
+            nconsts++;
+            i += 2;
+            break;
+        }
+        }
+    }
+    /* The code vector is atomic; keep the operands in the constant
+       vector so that they won't be GC-ed. */
+    cc->code = code;
+    cc->codeSize = size;
+    cc->constants = SCM_NEW_ARRAY(ScmObj, nconsts);
+    cc->constantSize = nconsts;
+    for (int i = nconsts-1; i >= 0; i--) {
+        cc->constants[i] = SCM_CAR(consts);
+        consts = SCM_CDR(consts);
+    }
+    return SCM_OBJ(cc);
+}
+
+static ScmClass *uvector_class(u_int type)
+{
+    switch (type) {
+    case SCM_UVECTOR_S8:  return SCM_CLASS_S8VECTOR;
+    case SCM_UVECTOR_U8:  return SCM_CLASS_U8VECTOR;
+    case SCM_UVECTOR_S16: return SCM_CLASS_S16VECTOR;
+    case SCM_UVECTOR_U16: return SCM_CLASS_U16VECTOR;
+    case SCM_UVECTOR_S32: return SCM_CLASS_S32VECTOR;
+    case SCM_UVECTOR_U32: return SCM_CLASS_U32VECTOR;
+    case SCM_UVECTOR_S64: return SCM_CLASS_S64VECTOR;
+    case SCM_UVECTOR_U64: return SCM_CLASS_U64VECTOR;
+    case SCM_UVECTOR_F16: return SCM_CLASS_F16VECTOR;
+    case SCM_UVECTOR_F32: return SCM_CLASS_F32VECTOR;
+    case SCM_UVECTOR_F64: return SCM_CLASS_F64VECTOR;
+    default: Scm_Error("code cache is corrupted");
+    }
+    return NULL;                /* dummy */
+}
+
+static ScmObj read_obj(cc_reader *r, ScmObj parent)
+{
+    ScmPort *in = r->in;
+    u_int tag = get_u8(in);
+
+    switch (tag) {
+    case CC_FALSE:     return SCM_FALSE;
+    case CC_TRUE:      return SCM_TRUE;
+    case CC_NIL:       return SCM_NIL;
+    case CC_EOF:       return SCM_EOF;
+    case CC_UNDEFINED: return SCM_UNDEFINED;
+    case CC_UNBOUND:   return SCM_UNBOUND;
+    case CC_FIXNUM:
+        return Scm_MakeInteger((long)(int64_t)get_u64(in));
+    case CC_FLONUM: {
+        double d;
+        get_bytes(in, &d, sizeof(d));
+        return Scm_MakeFlonum(d);
+    }
+    case CC_NUMBER: {
+        ScmObj s = get_string(in, 0);
+        ScmObj n = Scm_StringToNumber(SCM_STRING(s), 10, 0);
+        if (SCM_FALSEP(n)) Scm_Error("code cache is corrupted");
+        return n;
+    }
+    case CC_CHAR:
+        return SCM_MAKE_CHAR(get_u32(in));
+    case CC_STRING: {
+        u_int flags = get_u8(in);
+        return get_string(in, flags);
+    }
+    case CC_SYMBOL:
+        return Scm_Intern(SCM_STRING(get_string(in, SCM_STRING_IMMUTABLE)));
+    case CC_GENSYM: {
+        ScmObj s = Scm_MakeSymbol(SCM_STRING(get_string(in,
+                                                        SCM_STRING_IMMUTABLE)),
+                                  FALSE);
+        Scm_HashTableSet(r->shared, SCM_MAKE_INT(r->numShared++), s, 0);
+        return s;
+    }
+    case CC_KEYWORD:
+        return Scm_MakeKeyword(SCM_STRING(get_string(in,
+                                                     SCM_STRING_IMMUTABLE)));
+    case CC_LIST: {
+        uint64_t len = get_u64(in);
+        ScmObj h = SCM_NIL, t = SCM_NIL;
+        for (uint64_t i = 0; i < len; i++) {
+            SCM_APPEND1(h, t, read_obj(r, parent));
+        }
+        if (SCM_NULLP(t)) Scm_Error("code cache is corrupted");
+        SCM_SET_CDR(t, read_obj(r, parent));
+        return h;
+    }
+    case CC_VECTOR: {
+        uint64_t len = get_u64(in);
+        ScmObj v = Scm_MakeVector((ScmSmallInt)len, SCM_FALSE);
+        for (uint64_t i = 0; i < len; i++) {
+            SCM_VECTOR_ELEMENT(v, i) = read_obj(r, parent);
+        }
+        return v;
+    }
+    case CC_UVECTOR: {
+        ScmClass *klass = uvector_class(get_u8(in));
+        int immutable = get_u8(in);
+        uint64_t len = get_u64(in);
+        ScmObj v = Scm_MakeUVector(klass, (ScmSmallInt)len, NULL);
+        get_bytes(in, SCM_UVECTOR_ELEMENTS(v),
+                  Scm_UVectorSizeInBytes(SCM_UVECTOR(v)));
+        SCM_UVECTOR_IMMUTABLE_SET(v, immutable);
+        return v;
+    }
+    case CC_CHARSET: {
+        int immutable = get_u8(in);
+        uint64_t n = get_u64(in);
+        ScmObj cs = Scm_MakeEmptyCharSet();
+        for (uint64_t i = 0; i < n; i++) {
+            ScmChar lo = (ScmChar)get_u32(in);
+            ScmChar hi = (ScmChar)get_u32(in);
+            Scm_CharSetAddRange(SCM_CHAR_SET(cs), lo, hi);
+        }
+        if (immutable) Scm_CharSetFreezeX(SCM_CHAR_SET(cs));
+        return cs;
+    }
+    case CC_REGEXP: {
+        int flags = get_u8(in)? SCM_REGEXP_CASE_FOLD : 0;
+        ScmObj pat = get_string(in, SCM_STRING_IMMUTABLE);
+        return Scm_RegComp(SCM_STRING(pat), flags);
+    }
+    case CC_IDENTIFIER: {
+        ScmObj name = read_obj(r, parent);
+        if (!SCM_SYMBOLP(name)) Scm_Error("code cache is corrupted");
+        ScmModule *m = read_module(r);
+        return Scm_MakeIdentifier(name, m, SCM_NIL);
+    }
+    case CC_MODULE:
+        return SCM_OBJ(read_module(r));
+    case CC_CODE:
+        return read_code(r, parent);
+    case CC_SHARED: {
+        ScmObj i = SCM_MAKE_INT(get_u32(in));
+        ScmObj v = Scm_HashTableRef(r->shared, i, SCM_UNBOUND);
+        if (SCM_UNBOUNDP(v)) Scm_Error("code cache is corrupted");
+        return v;
+    }
+    default:
+        Scm_Error("code cache is corrupted (unknown tag %d)", tag);
+    }
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+/* Reads the next entry from the body port returned by Scm_CodeCacheOpen.
+   Returns EOF at the end. */
+ScmObj Scm_CodeCacheGet(ScmPort *in)
+{
+    if (Scm_Peekb(in) == EOF) return SCM_EOF;
+    cc_reader r;
+    r.in = in;
+    r.shared = SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQV, 0));
+    r.numShared = 0;
+    return read_obj(&r, SCM_FALSE);
+}
+
+/*================================================================
+ * Cache files
+ */
+
+ScmObj Scm_CodeCacheDirectory(void)
+{
+    ScmObj d;
+    (void)SCM_INTERNAL_MUTEX_LOCK(ccinfo.mutex);
+    d = ccinfo.directory;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(ccinfo.mutex);
+    return d;
+}
+
+void Scm_SetCodeCacheDirectory(ScmObj dir)
+{
+    if (!SCM_FALSEP(dir) && !SCM_STRINGP(dir)) {
+        SCM_TYPE_ERROR(dir, "string or #f");
+    }
+    (void)SCM_INTERNAL_MUTEX_LOCK(ccinfo.mutex);
+    ccinfo.directory = dir;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(ccinfo.mutex);
+}
+
+/* Returns the pathname of the cache file for the source file ABSPATH,
+   or #f if the cache is disabled. */
+static ScmObj cache_file_path(ScmString *abspath)
+{
+    ScmObj dir = Scm_CodeCacheDirectory();
+    if (!SCM_STRINGP(dir)) return SCM_FALSE;
+
+    const ScmStringBody *b = SCM_STRING_BODY(abspath);
+    uint64_t h = fnv_hash(FNV_INIT,
+                          (const unsigned char*)SCM_STRING_BODY_START(b),
+                          SCM_STRING_BODY_SIZE(b));
+    ScmObj base = Scm_BaseName(abspath);
+    return Scm_Sprintf("%A/%A-%08lx%08lx" CODE_CACHE_SUFFIX, dir, base,
+                       (u_long)(h >> 32), (u_long)(h & 0xffffffffUL));
+}
+
+/* Reads the whole file.  Returns NULL if it can't be read. */
+static char *read_file(const char *path, size_t *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return NULL;
+    size_t cap = 8192, len = 0;
+    char *buf = SCM_NEW_ATOMIC2(char*, cap);
+    for (;;) {
+        size_t n = fread(buf+len, 1, cap-len, fp);
+        len += n;
+        if (len < cap) break;
+        char *nbuf = SCM_NEW_ATOMIC2(char*, cap*2);
+        memcpy(nbuf, buf, len);
+        buf = nbuf;
+        cap *= 2;
+    }
+    int err = ferror(fp);
+    fclose(fp);
+    if (err) return NULL;
+    *size = len;
+    return buf;
+}
+
+/* Source file attributes recorded in the header */
+typedef struct source_info_rec {
+    ScmString *abspath;
+    int64_t mtime;
+    int64_t size;
+    uint64_t hash;
+} source_info;
+
+/* Fills SI from stat(2).  The content hash is left 0; see
+   get_source_hash. */
+static int get_source_info(ScmString *srcpath, source_info *si)
+{
+    struct stat st;
+    ScmObj abspath = Scm_NormalizePathname(srcpath,
+                                           SCM_PATH_ABSOLUTE
+                                           |SCM_PATH_CANONICALIZE);
+    const char *cpath = Scm_GetStringConst(SCM_STRING(abspath));
+    if (stat(cpath, &st) < 0 || !S_ISREG(st.st_mode)) return FALSE;
+    si->abspath = SCM_STRING(abspath);
+    si->mtime = (int64_t)st.st_mtime;
+    si->size = (int64_t)st.st_size;
+    si->hash = 0;
+    return TRUE;
+}
+
+/* Reads the source to compute the content hash.  The size is updated
+   to the one actually read. */
+static int get_source_hash(source_info *si)
+{
+    size_t size;
+    char *content = read_file(Scm_GetStringConst(si->abspath), &size);
+    if (content == NULL) return FALSE;
+    si->size = (int64_t)size;
+    si->hash = fnv_hash(FNV_INIT, (const unsigned char*)content, size);
+    return TRUE;
+}
+
+/* Signature of the instruction set.  It can differ between the builds
+   of the same version, e.g. when extra superinstructions are added
+   (see src/gensuperinsn). */
+static uint64_t insn_set_hash(void)
+{
+    static uint64_t h = 0;
+    if (h == 0) {
+        uint64_t hh = FNV_INIT;
+        for (int i=0; i<SCM_VM_NUM_INSNS; i++) {
+            const char *name = Scm_VMInsnName(i);
+            hh = fnv_hash(hh, (const unsigned char*)name, strlen(name)+1);
+        }
+        h = hh;
+    }
+    return h;
+}
+
+/* Header fields that identify the runtime */
+static void write_runtime_info(ScmPort *out)
+{
+    put_cstr(out, CODE_CACHE_MAGIC, strlen(CODE_CACHE_MAGIC));
+    put_u32(out, CODE_CACHE_VERSION);
+    put_cstr(out, GAUCHE_VERSION, strlen(GAUCHE_VERSION));
+    put_u32(out, SCM_VM_NUM_INSNS);
+    put_u64(out, insn_set_hash());
+    put_u32(out, sizeof(ScmWord));
+    put_u32(out, 0x01020304);   /* byte order */
+}
+
+static void write_header(ScmPort *out, source_info *si, ScmObj modname,
+                         const char *body, size_t bodysize)
+{
+    write_runtime_info(out);
+    put_string(out, si->abspath);
+    put_string(out, SCM_SYMBOL_NAME(modname));
+    put_u64(out, (uint64_t)si->mtime);
+    put_u64(out, (uint64_t)si->size);
+    put_u64(out, si->hash);
+    put_u64(out, bodysize);
+    put_u64(out, fnv_hash(FNV_INIT, (const unsigned char*)body, bodysize));
+}
+
+/* Writes HEAD followed by BODY to PATH.  We write to a temporary file
+   and rename it, so that a concurrent reader won't see a partially
+   written file.  Returns TRUE on success. */
+static int write_file(ScmString *path, const ScmStringBody *head,
+                      const ScmStringBody *body)
+{
+    ScmObj tmppath = Scm_Sprintf("%A.%d.tmp", path, (int)getpid());
+    const char *ctmp = Scm_GetStringConst(SCM_STRING(tmppath));
+    FILE *fp = fopen(ctmp, "wb");
+    if (fp == NULL) return FALSE;
+    int ok = (fwrite(SCM_STRING_BODY_START(head), 1,
+                     SCM_STRING_BODY_SIZE(head), fp)
+              == (size_t)SCM_STRING_BODY_SIZE(head)
+              && fwrite(SCM_STRING_BODY_START(body), 1,
+                        SCM_STRING_BODY_SIZE(body), fp)
+                 == (size_t)SCM_STRING_BODY_SIZE(body));
+    ok = (fclose(fp) == 0) && ok;
+#if defined(GAUCHE_WINDOWS)
+    if (ok) remove(Scm_GetStringConst(path));
+#endif /*GAUCHE_WINDOWS*/
+    if (!ok || rename(ctmp, Scm_GetStringConst(path)) != 0) {
+        remove(ctmp);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Opens the cache of the source file SRCPATH loaded into MODULE.
+   If a valid cache exists, returns an input port to read the entries
+   with Scm_CodeCacheGet.  Otherwise, returns #f.
+   If mtime and size of the source match the ones in the header, we
+   take the cache without reading the source.  The content hash is
+   only consulted when mtime differs, e.g. after the file is touched
+   or checked out again, or when the source may have been modified
+   within the same second the cache was written, which mtime can't
+   tell. */
+ScmObj Scm_CodeCacheOpen(ScmString *srcpath, ScmModule *module)
+{
+    ScmObj modname = module_name(module);
+    if (SCM_FALSEP(modname)) return SCM_FALSE;
+    ScmObj abspath = Scm_NormalizePathname(srcpath,
+                                           SCM_PATH_ABSOLUTE
+                                           |SCM_PATH_CANONICALIZE);
+    ScmObj cpath = cache_file_path(SCM_STRING(abspath));
+    if (SCM_FALSEP(cpath)) return SCM_FALSE;
+
+    const char *ccpath = Scm_GetStringConst(SCM_STRING(cpath));
+    struct stat cst;
+    if (stat(ccpath, &cst) < 0) return SCM_FALSE;
+    size_t size;
+    char *content = read_file(ccpath, &size);
+    if (content == NULL) return SCM_FALSE;
+    source_info si;
+    if (!get_source_info(srcpath, &si)) return SCM_FALSE;
+
+    /* We compare the header byte by byte with the one we'd write now,
+       up to the module name.  The rest are the source attributes and
+       the body size and hash, five u64s. */
+    ScmObj expected = Scm_MakeOutputStringPort(TRUE);
+    write_header(SCM_PORT(expected), &si, modname, NULL, 0);
+    const ScmStringBody *eb =
+        SCM_STRING_BODY(Scm_GetOutputStringUnsafe(SCM_PORT(expected), 0));
+    size_t hsize = SCM_STRING_BODY_SIZE(eb);
+    size_t fixed = hsize - 5*sizeof(uint64_t);
+    if (size < hsize
+        || memcmp(content, SCM_STRING_BODY_START(eb), fixed) != 0) {
+        return SCM_FALSE;
+    }
+    uint64_t attrs[5];      /* mtime, size, hash, bodysize, bodyhash */
+    memcpy(attrs, content+fixed, sizeof(attrs));
+    if (attrs[1] != (uint64_t)si.size) return SCM_FALSE;
+    if (attrs[0] != (uint64_t)si.mtime
+        || si.mtime >= (int64_t)cst.st_mtime) {
+        if (!get_source_hash(&si)
+            || attrs[1] != (uint64_t)si.size || attrs[2] != si.hash) {
+            return SCM_FALSE;
+        }
+    }
+    uint64_t bodysize = attrs[3], bodyhash = attrs[4];
+    if (bodysize != size - hsize
+        || bodyhash != fnv_hash(FNV_INIT,
+                                (const unsigned char*)content+hsize,
+                                bodysize)) {
+        return SCM_FALSE;
+    }
+    ScmObj body = Scm_MakeString(content+hsize, bodysize, bodysize,
+                                 SCM_STRING_INCOMPLETE);
+    return Scm_MakeInputStringPort(SCM_STRING(body), TRUE);
+}
+
+/* Saves the entries accumulated in the output string port BODY as
+   the cache of SRCPATH loaded into MODULE.  Returns TRUE on success.
+   Failure to write the cache isn't an error. */
+int Scm_CodeCacheSave(ScmString *srcpath, ScmModule *module, ScmPort *body)
+{
+    ScmObj modname = module_name(module);
+    if (SCM_FALSEP(modname)) return FALSE;
+    source_info si;
+    if (!get_source_info(srcpath, &si) || !get_source_hash(&si)) {
+        return FALSE;
+    }
+    ScmObj cpath = cache_file_path(si.abspath);
+    if (SCM_FALSEP(cpath)) return FALSE;
+
+    const ScmStringBody *bb =
+        SCM_STRING_BODY(Scm_GetOutputStringUnsafe(body, 0));
+    ScmObj header = Scm_MakeOutputStringPort(TRUE);
+    write_header(SCM_PORT(header), &si, modname,
+                 SCM_STRING_BODY_START(bb), SCM_STRING_BODY_SIZE(bb));
+    const ScmStringBody *hb =
+        SCM_STRING_BODY(Scm_GetOutputStringUnsafe(SCM_PORT(header), 0));
+    return write_file(SCM_STRING(cpath), hb, bb);
+}
+
+/* Removes the cache of SRCPATH, if any. */
+void Scm_CodeCacheDiscard(ScmString *srcpath)
+{
+    ScmObj abspath = Scm_NormalizePathname(srcpath,
+                                           SCM_PATH_ABSOLUTE
+                                           |SCM_PATH_CANONICALIZE);
+    ScmObj cpath = cache_file_path(SCM_STRING(abspath));
+    if (SCM_STRINGP(cpath)) remove(Scm_GetStringConst(SCM_STRING(cpath)));
+}
+
+/*================================================================
+ * Images
+ *
+ *   'gosh --dump-image=FILE' records the files loaded while processing
+ *   the command-line options, and writes the body of their code cache
+ *   into FILE, in the order their loading finished.  'gosh --image=FILE'
+ *   runs those entries at startup in place of loading the files, so
+ *   the libraries come up without searching the load path, reading or
+ *   compiling.  (We don't dump the heap itself; the objects built by
+ *   the C initializers can't be relocated without help of the GC.)
+ *
+ *   The image file has the image magic, the runtime info as the code
+ *   cache, and the size and the hash of the content.  The content has
+ *   the list of provided features, followed by the entries.  Each entry
+ *   has the absolute pathname, the module name, mtime and size of the
+ *   source, and the code cache body if the file could be cached.  An
+ *   entry without the body is loaded from the source.
+ *
+ *   We only check mtime and size of the sources when the image is
+ *   restored; if any of them differs, the whole image is ignored.
+ */
+
+#define IMAGE_MAGIC  "GAUCHE-IMAGE\n"
+
+void Scm_ImageStartRecording(void)
+{
+    (void)SCM_INTERNAL_MUTEX_LOCK(ccinfo.mutex);
+    ccinfo.image = SCM_NIL;
+    ccinfo.imageFailure = SCM_FALSE;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(ccinfo.mutex);
+}
+
+int Scm_ImageRecordingP(void)
+{
+    return !SCM_FALSEP(ccinfo.image);
+}
+
+/* Records that SRCPATH is loaded into MODULE.  BODY is the output string
+   port with the code cache entries, or #f if the file can't be cached. */
+void Scm_ImageRecord(ScmString *srcpath, ScmModule *module, ScmObj body)
+{
+    ScmObj modname = module_name(module);
+    source_info si;
+    if (SCM_FALSEP(modname) || !get_source_info(srcpath, &si)) {
+        Scm_ImageRecordFailure(SCM_OBJ(srcpath));
+        return;
+    }
+    ScmObj e = Scm_MakeVector(5, SCM_FALSE);
+    SCM_VECTOR_ELEMENT(e, 0) = SCM_OBJ(si.abspath);
+    SCM_VECTOR_ELEMENT(e, 1) = SCM_OBJ(SCM_SYMBOL_NAME(modname));
+    SCM_VECTOR_ELEMENT(e, 2) = Scm_MakeInteger64(si.mtime);
+    SCM_VECTOR_ELEMENT(e, 3) = Scm_MakeInteger64(si.size);
+    if (SCM_OPORTP(body)) {
+        SCM_VECTOR_ELEMENT(e, 4) = Scm_GetOutputString(SCM_PORT(body), 0);
+    }
+    (void)SCM_INTERNAL_MUTEX_LOCK(ccinfo.mutex);
+    if (!SCM_FALSEP(ccinfo.image)) ccinfo.image = Scm_Cons(e, ccinfo.image);
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(ccinfo.mutex);
+}
+
+/* Records that WHAT (a port or a pathname) is loaded in a way the image
+   can't reproduce. */
+void Scm_ImageRecordFailure(ScmObj what)
+{
+    (void)SCM_INTERNAL_MUTEX_LOCK(ccinfo.mutex);
+    if (!SCM_FALSEP(ccinfo.image) && SCM_FALSEP(ccinfo.imageFailure)) {
+        ccinfo.imageFailure = what;
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(ccinfo.mutex);
+}
+
+static void write_image_header(ScmPort *out, const char *content,
+                               size_t size)
+{
+    put_cstr(out, IMAGE_MAGIC, strlen(IMAGE_MAGIC));
+    write_runtime_info(out);
+    put_u64(out, size);
+    put_u64(out, fnv_hash(FNV_INIT, (const unsigned char*)content, size));
+}
+
+/* Writes the recorded entries to PATH and stops recording. */
+void Scm_ImageDump(ScmString *path)
+{
+    (void)SCM_INTERNAL_MUTEX_LOCK(ccinfo.mutex);
+    ScmObj entries = ccinfo.image;
+    ScmObj failure = ccinfo.imageFailure;
+    ccinfo.image = SCM_FALSE;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(ccinfo.mutex);
+
+    if (SCM_FALSEP(entries)) Scm_Error("image recording isn't started");
+    if (!SCM_FALSEP(failure)) {
+        Scm_Error("can't dump image, for %S is loaded in a way the image "
+                  "can't record", failure);
+    }
+
+    ScmObj out = Scm_MakeOutputStringPort(TRUE);
+    ScmObj features = Scm_ProvidedFeatures(), cp;
+    put_u32(SCM_PORT(out), Scm_Length(features));
+    SCM_FOR_EACH(cp, features) {
+        put_string(SCM_PORT(out), SCM_STRING(SCM_CAR(cp)));
+    }
+    entries = Scm_Reverse(entries);
+    put_u32(SCM_PORT(out), Scm_Length(entries));
+    SCM_FOR_EACH(cp, entries) {
+        ScmObj e = SCM_CAR(cp);
+        put_string(SCM_PORT(out), SCM_STRING(SCM_VECTOR_ELEMENT(e, 0)));
+        put_string(SCM_PORT(out), SCM_STRING(SCM_VECTOR_ELEMENT(e, 1)));
+        put_u64(SCM_PORT(out),
+                (uint64_t)Scm_GetInteger64(SCM_VECTOR_ELEMENT(e, 2)));
+        put_u64(SCM_PORT(out),
+                (uint64_t)Scm_GetInteger64(SCM_VECTOR_ELEMENT(e, 3)));
+        ScmObj body = SCM_VECTOR_ELEMENT(e, 4);
+        put_u8(SCM_PORT(out), SCM_STRINGP(body));
+        if (SCM_STRINGP(body)) put_string(SCM_PORT(out), SCM_STRING(body));
+    }
+
+    const ScmStringBody *cb =
+        SCM_STRING_BODY(Scm_GetOutputStringUnsafe(SCM_PORT(out), 0));
+    ScmObj header = Scm_MakeOutputStringPort(TRUE);
+    write_image_header(SCM_PORT(header), SCM_STRING_BODY_START(cb),
+                       SCM_STRING_BODY_SIZE(cb));
+    const ScmStringBody *hb =
+        SCM_STRING_BODY(Scm_GetOutputStringUnsafe(SCM_PORT(header), 0));
+    if (!write_file(path, hb, cb)) {
+        Scm_SysError("couldn't write image file %S", path);
+    }
+}
+
+/* Reads the image file PATH.  If it is valid, returns
+   (<features> <entry> ...), where each <entry> is (<pathname>
+   <module-name> <body>), and <body> is an input port to read the
+   code cache entries, or #f.  Otherwise, warns and returns #f. */
+ScmObj Scm_ImageOpen(ScmString *path)
+{
+    size_t size;
+    char *content = read_file(Scm_GetStringConst(path), &size);
+    if (content == NULL) {
+        Scm_Warn("couldn't read image file %S", path);
+        return SCM_FALSE;
+    }
+
+    ScmObj expected = Scm_MakeOutputStringPort(TRUE);
+    write_image_header(SCM_PORT(expected), NULL, 0);
+    const ScmStringBody *eb =
+        SCM_STRING_BODY(Scm_GetOutputStringUnsafe(SCM_PORT(expected), 0));
+    size_t hsize = SCM_STRING_BODY_SIZE(eb);
+    size_t fixed = hsize - 2*sizeof(uint64_t);
+    uint64_t csize, chash;
+    if (size < hsize
+        || memcmp(content, SCM_STRING_BODY_START(eb), fixed) != 0) {
+        Scm_Warn("image file %S is made by another version of Gauche; "
+                 "ignored", path);
+        return SCM_FALSE;
+    }
+    memcpy(&csize, content+fixed, sizeof(uint64_t));
+    memcpy(&chash, content+fixed+sizeof(uint64_t), sizeof(uint64_t));
+    if (csize != size - hsize
+        || chash != fnv_hash(FNV_INIT, (const unsigned char*)content+hsize,
+                             csize)) {
+        Scm_Warn("image file %S is corrupted; ignored", path);
+        return SCM_FALSE;
+    }
+
+    ScmObj s = Scm_MakeString(content+hsize, csize, csize,
+                              SCM_STRING_INCOMPLETE);
+    ScmPort *in = SCM_PORT(Scm_MakeInputStringPort(SCM_STRING(s), TRUE));
+    ScmObj features = SCM_NIL, entries = SCM_NIL;
+    for (uint32_t n = get_u32(in); n > 0; n--) {
+        features = Scm_Cons(get_string(in, 0), features);
+    }
+    for (uint32_t n = get_u32(in); n > 0; n--) {
+        ScmObj srcpath = get_string(in, 0);
+        ScmObj modname = Scm_Intern(SCM_STRING(get_string(in, 0)));
+        int64_t mtime = (int64_t)get_u64(in);
+        int64_t srcsize = (int64_t)get_u64(in);
+        ScmObj body = SCM_FALSE;
+        if (get_u8(in)) {
+            ScmObj b = get_string(in, SCM_STRING_INCOMPLETE);
+            body = Scm_MakeInputStringPort(SCM_STRING(b), TRUE);
+        }
+        struct stat st;
+        if (stat(Scm_GetStringConst(SCM_STRING(srcpath)), &st) < 0
+            || (int64_t)st.st_mtime != mtime
+            || (int64_t)st.st_size != srcsize) {
+            Scm_Warn("image file %S is stale, for %S has been changed; "
+                     "ignored", path, srcpath);
+            return SCM_FALSE;
+        }
+        entries = Scm_Cons(SCM_LIST3(srcpath, modname, body), entries);
+    }
+    return Scm_Cons(Scm_Reverse(features), Scm_ReverseX(entries));
+}
+
+void Scm__InitCodeCache(void)
+{
+    const char *dir = Scm_GetEnv("GAUCHE_CODE_CACHE_DIR");
+    (void)SCM_INTERNAL_MUTEX_INIT(ccinfo.mutex);
+    ccinfo.directory = (dir && dir[0])? SCM_MAKE_STR_COPYING(dir) : SCM_FALSE;
+    ccinfo.image = SCM_FALSE;
+    ccinfo.imageFailure = SCM_FALSE;
+}
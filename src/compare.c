@@ -32,6 +32,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 #include "gauche/class.h"
@@ -225,7 +226,9 @@ int Scm_Compare(ScmObj x, ScmObj y)
    is very inefficient and runs much slower than Scheme version, if
    a Scheme comarison function is given.
    So, as of 0.7.2, the C function is only used when a comparison
-   function is omitted. */
+   function is omitted.  The callback no longer conses the argument
+   list (see cmp_scm), but the stable Scheme version is still used
+   for the comparison procedures given to sort. */
 
 /*
  * Basic function for sort family.  An array pointed by elts will be
@@ -249,77 +252,177 @@ int Scm_Compare(ScmObj x, ScmObj y)
  * the algorithm proceeds by Quicksort, but when it detects the recursion
  * is too deep, it switches to Heapsort.  See Knuth, The Art of Computer
  * Programming Second Edition, Section 5.2.2, p.122.
+ *
+ * When cmpfn is #f and the array consists of fixnums only, flonums only
+ * or strings only, we bypass the type dispatch of Scm_Compare.  The
+ * fixnum and flonum versions are instantiated from the same template
+ * with the comparison inlined, and a large fixnum array is sorted by
+ * radix sort (Scm_RadixSortArray) instead.
  */
 
-/* Heap sort */
-static inline void shift_up(ScmObj *elts, int root, int nelts,
-                            int (*cmp)(ScmObj, ScmObj, ScmObj), ScmObj data)
-{
-    int l = root+1, maxchild;
-    while (l*2 <= nelts) {
-        if (l*2 == nelts) {
-            maxchild = nelts-1;
-        } else if (cmp(elts[l*2-1], elts[l*2], data) < 0) {
-            maxchild = l*2;
-        } else {
-            maxchild = l*2-1;
-        }
-        if (cmp(elts[l-1], elts[maxchild], data) < 0) {
-            ScmObj tmp = elts[maxchild];
-            elts[maxchild] = elts[l-1];
-            elts[l-1] = tmp;
-            l = maxchild+1;
-        } else {
-            break;
-        }
-    }
+/* The sort routines are defined by DEFINE_SORTER, which takes the suffix
+   of the function names and a macro LESS(x, y) that is used as the
+   predicate.  LESS can refer to the comparison function cmp and its
+   auxiliary data, which are passed around in the generic version; the
+   others ignore them. */
+#define DEFINE_SORTER(suffix, LESS)                                     \
+/* Heap sort */                                                         \
+static inline void SCM_CPP_CAT(shift_up_, suffix)                       \
+    (ScmObj *elts, int root, int nelts,                                 \
+     int (*cmp)(ScmObj, ScmObj, ScmObj) SCM_UNUSED,                     \
+     ScmObj data SCM_UNUSED)                                            \
+{                                                                       \
+    int l = root+1, maxchild;                                           \
+    while (l*2 <= nelts) {                                              \
+        if (l*2 == nelts) {                                             \
+            maxchild = nelts-1;                                         \
+        } else if (LESS(elts[l*2-1], elts[l*2])) {                      \
+            maxchild = l*2;                                             \
+        } else {                                                        \
+            maxchild = l*2-1;                                           \
+        }                                                               \
+        if (LESS(elts[l-1], elts[maxchild])) {                          \
+            ScmObj tmp = elts[maxchild];                                \
+            elts[maxchild] = elts[l-1];                                 \
+            elts[l-1] = tmp;                                            \
+            l = maxchild+1;                                             \
+        } else {                                                        \
+            break;                                                      \
+        }                                                               \
+    }                                                                   \
+}                                                                       \
+                                                                        \
+static void SCM_CPP_CAT(sort_h_, suffix)                                \
+    (ScmObj *elts, int nelts,                                           \
+     int (*cmp)(ScmObj, ScmObj, ScmObj), ScmObj data)                   \
+{                                                                       \
+    for (int l=nelts/2-1; l>=0; l--) {                                  \
+        SCM_CPP_CAT(shift_up_, suffix)(elts, l, nelts, cmp, data);      \
+    }                                                                   \
+    for (int r=nelts-1; r>=1; r--) {                                    \
+        ScmObj tmp = elts[r];                                           \
+        elts[r] = elts[0];                                              \
+        elts[0] = tmp;                                                  \
+        SCM_CPP_CAT(shift_up_, suffix)(elts, 0, r, cmp, data);          \
+    }                                                                   \
+}                                                                       \
+                                                                        \
+/* Quick sort */                                                        \
+static void SCM_CPP_CAT(sort_q_, suffix)                                \
+    (ScmObj *elts, int lo, int hi, int depth, int limit,                \
+     int (*cmp)(ScmObj, ScmObj, ScmObj), ScmObj data)                   \
+{                                                                       \
+    while (lo < hi) {                                                   \
+        if (depth >= limit) {                                           \
+            SCM_CPP_CAT(sort_h_, suffix)(elts+lo, (hi-lo+1), cmp, data); \
+            break;                                                      \
+        } else {                                                        \
+            int l = lo, r = hi;                                         \
+            ScmObj pivot = elts[lo];                                    \
+            while (l <= r) {                                            \
+                while (l <= r && LESS(elts[l], pivot)) l++;             \
+                while (l <= r && LESS(pivot, elts[r])) r--;             \
+                if (l > r) break;                                       \
+                ScmObj tmp = elts[l]; elts[l] = elts[r]; elts[r] = tmp; \
+                l++;                                                    \
+                r--;                                                    \
+            }                                                           \
+            if (lo < r) {                                               \
+                SCM_CPP_CAT(sort_q_, suffix)(elts, lo, r, depth+1, limit, \
+                                             cmp, data);                \
+            }                                                           \
+            /* tail call to                                             \
+               sort_q(elts, l, hi, depth+1, limit, cmp, data); */       \
+            lo = l;                                                     \
+            depth++;                                                    \
+        }                                                               \
+    }                                                                   \
 }
 
-static void sort_h(ScmObj *elts, int nelts,
-                   int (*cmp)(ScmObj, ScmObj, ScmObj), ScmObj data)
+#define GENERIC_LESS(x, y)  (cmp((x), (y), data) < 0)
+/* Fixnum tagging preserves the order as signed words. */
+#define FIXNUM_LESS(x, y)   ((long)SCM_WORD(x) < (long)SCM_WORD(y))
+/* NaN compares equal to everything, as Scm_NumCmp does. */
+#define FLONUM_LESS(x, y)   (SCM_FLONUM_VALUE(x) < SCM_FLONUM_VALUE(y))
+
+DEFINE_SORTER(generic, GENERIC_LESS)
+DEFINE_SORTER(fixnum,  FIXNUM_LESS)
+DEFINE_SORTER(flonum,  FLONUM_LESS)
+
+/* LSD radix sort of fixnums, a byte at a time.  The sign bit is flipped
+   so that the unsigned order of the words matches the numeric order, and
+   for the descending order all the bits are flipped.  The digits that are
+   the same across all the keys, e.g. the upper bytes of small integers,
+   are skipped.  The sort is stable, so it can also be used to sort
+   (elt . key) pairs by keys, with SCM_SORT_KEY_CDR.
+
+   It requires a temporary array of the same size, so Scm_SortArray uses
+   it only for large arrays, where it beats the quicksort.
+   Returns FALSE without touching elts if any of the keys isn't a fixnum. */
+#define RADIX_SORT_THRESHOLD  1024
+#define RADIX_BITS    8
+#define RADIX_MASK    ((1<<RADIX_BITS)-1)
+#define RADIX_DIGITS  ((SIZEOF_LONG*8)/RADIX_BITS)
+
+static inline u_long radix_key(ScmObj x, u_long flip)
 {
-    for (int l=nelts/2-1; l>=0; l--) {
-        shift_up(elts, l, nelts, cmp, data);
-    }
-    for (int r=nelts-1; r>=1; r--) {
-        ScmObj tmp = elts[r];
-        elts[r] = elts[0];
-        elts[0] = tmp;
-        shift_up(elts, 0, r, cmp, data);
-    }
+    return (u_long)SCM_WORD(x) ^ flip;
 }
 
-/* Quick sort */
-static void sort_q(ScmObj *elts, int lo, int hi, int depth, int limit,
-                   int (*cmp)(ScmObj, ScmObj, ScmObj), ScmObj data)
+int Scm_RadixSortArray(ScmObj *elts, int nelts, int flags)
 {
-    while (lo < hi) {
-        if (depth >= limit) {
-            sort_h(elts+lo, (hi-lo+1), cmp, data);
-            break;
-        } else {
-            int l = lo, r = hi;
-            ScmObj pivot = elts[lo];
-            while (l <= r) {
-                while (l <= r && cmp(elts[l], pivot, data) < 0) l++;
-                while (l <= r && cmp(pivot, elts[r], data) < 0) r--;
-                if (l > r) break;
-                ScmObj tmp = elts[l]; elts[l] = elts[r]; elts[r] = tmp;
-                l++;
-                r--;
-            }
-            if (lo < r) sort_q(elts, lo, r, depth+1, limit, cmp, data);
-            /* tail call to
-               sort_q(elts, l, hi, depth+1, limit, cmp, data); */
-            lo = l;
-            depth++;
+    int count[RADIX_DIGITS][1<<RADIX_BITS];
+    int keyed = (flags & SCM_SORT_KEY_CDR);
+    u_long flip = (flags & SCM_SORT_DESCENDING)
+        ? ~((u_long)1 << (SIZEOF_LONG*8-1))
+        : ((u_long)1 << (SIZEOF_LONG*8-1));
+
+    memset(count, 0, sizeof(count));
+    for (int i=0; i<nelts; i++) {
+        ScmObj k = elts[i];
+        if (keyed) {
+            if (!SCM_PAIRP(k)) return FALSE;
+            k = SCM_CDR(k);
+        }
+        if (!SCM_INTP(k)) return FALSE;
+        u_long w = radix_key(k, flip);
+        for (int d=0; d<RADIX_DIGITS; d++) {
+            count[d][(w >> (d*RADIX_BITS)) & RADIX_MASK]++;
         }
     }
+
+    ScmObj *src = elts;
+    ScmObj *dst;
+    if (keyed) {
+        dst = SCM_NEW_ARRAY(ScmObj, nelts);
+    } else {
+        /* Elements are all fixnums, so GC needn't scan the buffer. */
+        dst = SCM_NEW_ATOMIC_ARRAY(ScmObj, nelts);
+    }
+    for (int d=0; d<RADIX_DIGITS; d++) {
+        int *c = count[d];
+        int pos = 0, trivial = FALSE;
+        for (int b=0; b<(1<<RADIX_BITS); b++) {
+            if (c[b] == nelts) { trivial = TRUE; break; }
+            int n = c[b];
+            c[b] = pos;
+            pos += n;
+        }
+        if (trivial) continue;
+        for (int i=0; i<nelts; i++) {
+            ScmObj k = keyed? SCM_CDR(src[i]) : src[i];
+            u_long w = radix_key(k, flip);
+            dst[c[(w >> (d*RADIX_BITS)) & RADIX_MASK]++] = src[i];
+        }
+        ScmObj *t = src; src = dst; dst = t;
+    }
+    if (src != elts) memcpy(elts, src, sizeof(ScmObj)*nelts);
+    return TRUE;
 }
 
 static int cmp_scm(ScmObj x, ScmObj y, ScmObj fn)
 {
-    ScmObj r = Scm_ApplyRec(fn, SCM_LIST2(x, y));
+    ScmObj r = Scm_ApplyRec2(fn, x, y);
     if (SCM_TRUEP(r) || (SCM_INTP(r) && SCM_INT_VALUE(r) < 0))
         return -1;
     else
@@ -331,16 +434,61 @@ static int cmp_int(ScmObj x, ScmObj y, ScmObj dummy SCM_UNUSED)
     return Scm_Compare(x, y);
 }
 
-void Scm_SortArray(ScmObj *elts, int nelts, ScmObj cmpfn SCM_UNUSED)
+static int cmp_string(ScmObj x, ScmObj y, ScmObj dummy SCM_UNUSED)
+{
+    return Scm_StringCmp(SCM_STRING(x), SCM_STRING(y));
+}
+
+/* Classify the elements to choose the specialized routine. */
+enum {
+    SORT_GENERIC,
+    SORT_FIXNUM,
+    SORT_FLONUM,
+    SORT_STRING
+};
+
+static int sort_array_type(ScmObj *elts, int nelts)
+{
+    int i;
+    if (SCM_INTP(elts[0])) {
+        for (i=1; i<nelts; i++) if (!SCM_INTP(elts[i])) break;
+        if (i == nelts) return SORT_FIXNUM;
+    } else if (SCM_FLONUMP(elts[0])) {
+        for (i=1; i<nelts; i++) if (!SCM_FLONUMP(elts[i])) break;
+        if (i == nelts) return SORT_FLONUM;
+    } else if (SCM_STRINGP(elts[0])) {
+        for (i=1; i<nelts; i++) if (!SCM_STRINGP(elts[i])) break;
+        if (i == nelts) return SORT_STRING;
+    }
+    return SORT_GENERIC;
+}
+
+void Scm_SortArray(ScmObj *elts, int nelts, ScmObj cmpfn)
 {
     int limit, i;
     if (nelts <= 1) return;
     /* approximate 2*log2(nelts) */
     for (i=nelts,limit=1; i > 0; limit++) {i>>=1;}
     if (SCM_PROCEDUREP(cmpfn)) {
-        sort_q(elts, 0, nelts-1, 0, limit, cmp_scm, cmpfn);
-    } else {
-        sort_q(elts, 0, nelts-1, 0, limit, cmp_int, NULL);
+        sort_q_generic(elts, 0, nelts-1, 0, limit, cmp_scm, cmpfn);
+        return;
+    }
+    switch (sort_array_type(elts, nelts)) {
+    case SORT_FIXNUM:
+        if (nelts >= RADIX_SORT_THRESHOLD) {
+            Scm_RadixSortArray(elts, nelts, 0);
+        } else {
+            sort_q_fixnum(elts, 0, nelts-1, 0, limit, NULL, NULL);
+        }
+        break;
+    case SORT_FLONUM:
+        sort_q_flonum(elts, 0, nelts-1, 0, limit, NULL, NULL);
+        break;
+    case SORT_STRING:
+        sort_q_generic(elts, 0, nelts-1, 0, limit, cmp_string, NULL);
+        break;
+    default:
+        sort_q_generic(elts, 0, nelts-1, 0, limit, cmp_int, NULL);
     }
 }
 
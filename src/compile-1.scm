@@ -648,6 +648,7 @@
       ;; record inliner function for compiler.  this is used only when
       ;; the procedure needs to be inlined in the same compiler unit.
       (%insert-binding module (unwrap-syntax name) dummy-proc)
+      (vm-note-compile-effect!)
       (set! (%procedure-inliner dummy-proc) (pass1/inliner-procedure packed)))))
 
 (define (pass1/make-inlinable-binding form name iform cenv)
@@ -684,6 +685,7 @@
                                          expr #f)])
     ;; See the "Hygiene alert" in pass1/define.
     (%insert-syntax-binding (cenv-module cenv) (unwrap-syntax name) trans)
+    (vm-note-compile-effect!)
     ($const-undef)))
 
 (define-pass1-syntax (define-syntax form cenv) :null
@@ -697,6 +699,7 @@
        ;; See the "Hygiene alert" in pass1/define.
        (%insert-syntax-binding (cenv-module cenv) (unwrap-syntax name)
                                transformer)
+       (vm-note-compile-effect!)
        ($const-undef))]
     [_ (error "syntax-error: malformed define-syntax:" form)]))
 
@@ -1490,6 +1493,7 @@
     [(_ name body ...)
      (let* ([mod (ensure-module name 'define-module #t)]
             [newenv (make-bottom-cenv mod)])
+       (vm-note-compile-effect!)
        ($seq (imap (cut pass1 <> newenv) body)))]
     [_ (error "syntax-error: malformed define-module:" form)]))
 
@@ -1513,6 +1517,7 @@
      (let1 m (ensure-module module 'select-module #f)
        (vm-set-current-module m)
        (cenv-module-set! cenv m)
+       (vm-note-compile-effect!)
        ($values0))]
     [else (error "syntax-error: malformed select-module:" form)]))
 
@@ -1523,12 +1528,14 @@
 
 (define-pass1-syntax (export form cenv) :gauche
   (%export-symbols (cenv-module cenv) (cdr form))
+  (vm-note-compile-effect!)
   ($values0))
 
 (define-pass1-syntax (export-all form cenv) :gauche
   (unless (null? (cdr form))
     (error "syntax-error: malformed export-all:" form))
   (%export-all (cenv-module cenv))
+  (vm-note-compile-effect!)
   ($values0))
 
 (define-pass1-syntax (import form cenv) :gauche
@@ -1544,6 +1551,7 @@
                and (select-module r7rs.user) to enter the R7RS namespace.")]
       [(m . r) (process-import (cenv-module cenv) (ensure m) r)]
       [m       (process-import (cenv-module cenv) (ensure m) '())]))
+  (vm-note-compile-effect!)
   ($values0))
 
 (define (process-import current imported args)
@@ -1614,11 +1622,12 @@
                                     (find-module m))
                                   (error "undefined module" m)))
                         (cdr form)))
+  (vm-note-compile-effect!)
   ($values0))
 
 (define-pass1-syntax (require form cenv) :gauche
   (match form
-    [(_ feature) (%require feature) ($values0)]
+    [(_ feature) (%require feature) (vm-note-compile-effect!) ($values0)]
     [_ (error "syntax-error: malformed require:" form)]))
 
 ;; Include .............................................
@@ -1648,6 +1657,9 @@
               (loop (read iport) (cons r forms))))
         (pass1/report-include iport #f)
         (close-input-port iport))))
+  ;; The code cache doesn't track included files, so we make it compile
+  ;; the including form every time.
+  (vm-note-compile-effect!)
   (map do-include args))
   
 ;; If filename is relative, we try to resolve it with the source file.
@@ -1738,7 +1750,8 @@
        (when (and (eqv? situ SCM_VM_COMPILING)
                   (memq :compile-toplevel wlist)
                   (cenv-toplevel? cenv))
-         (dolist [e expr] (eval e (cenv-module cenv))))
+         (dolist [e expr] (eval e (cenv-module cenv)))
+         (vm-note-compile-effect!))
        (if (or (and (eqv? situ SCM_VM_LOADING)
                     (memq :load-toplevel wlist)
                     (cenv-toplevel? cenv))
@@ -1009,6 +1009,8 @@
       (and ($const? y)
            (integer-fits-insn-arg? ($const-value y))
            (pass5/builtin-onearg info NUMADDI ($const-value y) x))
+      (and (pass5/flonum-operands? x y)
+           (pass5/builtin-twoargs info NUMFADD2 0 x y))
       (and ($lref? y)
            (lvar-immutable? ($lref-lvar y))
            (receive (depth offset) (renv-lookup renv ($lref-lvar y))
@@ -1028,6 +1030,8 @@
       (and ($const? y)
            (integer-fits-insn-arg? ($const-value y))
            (pass5/builtin-onearg info NUMADDI (- ($const-value y)) x))
+      (and (pass5/flonum-operands? x y)
+           (pass5/builtin-twoargs info NUMFSUB2 0 x y))
       (pass5/builtin-twoargs info NUMSUB2 0 x y)))
 
 (define (pass5/asm-nummul2 info x y ccb renv ctx)
@@ -1036,6 +1040,36 @@
 (define (pass5/asm-numdiv2 info x y ccb renv ctx)
   (pass5/builtin-twoargs info NUMDIV2 0 x y))
 
+;; Returns #t if we know either X or Y yields a flonum, so that the
+;; flonum instructions (NUMFADD2 etc.) are likely to take the fast path.
+;; It's just a hint; those instructions work on any numbers.
+(define (pass5/flonum-operands? x y)
+  (or (pass5/flonum-iform? x 0) (pass5/flonum-iform? y 0)))
+
+;; We look into flonum constants, f16/f32/f64vector-ref, inexact
+;; arithmetic (+. etc.), generic arithmetic on them, and immutable local
+;; variables initialized by them.  DEPTH limits the search.
+(define (pass5/flonum-iform? iform depth)
+  (and (< depth 8)
+       (case/unquote
+        (iform-tag iform)
+        [($CONST) (flonum? ($const-value iform))]
+        [($LREF) (and-let1 init (lvar-const-value ($lref-lvar iform))
+                   (pass5/flonum-iform? init (+ depth 1)))]
+        [($ASM)
+         (let1 insn ($asm-insn iform)
+           (case/unquote
+            (car insn)
+            [(UVEC-REF)
+             (boolean (memv (cadr insn) `(,SCM_UVECTOR_F16 ,SCM_UVECTOR_F32
+                                          ,SCM_UVECTOR_F64)))]
+            [(NUMIADD2 NUMISUB2 NUMIMUL2 NUMIDIV2) #t]
+            [(NUMADD2 NUMSUB2 NUMMUL2 NUMDIV2)
+             (any (cut pass5/flonum-iform? <> (+ depth 1)) ($asm-args iform))]
+            [(NEGATE) (pass5/flonum-iform? (car ($asm-args iform)) (+ depth 1))]
+            [else #f]))]
+        [else #f])))
+
 ;; if one of arg is constant, it's always x.  see builtin-inline-bitwise below.
 (define (pass5/asm-bitwise info insn x y ccb renv ctx)
   (define lookup `((,LOGAND . ,LOGANDC)
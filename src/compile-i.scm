@@ -247,6 +247,28 @@
 (define-builtin-inliner-uvref f32 F32)
 (define-builtin-inliner-uvref f64 F64)
 
+;; We only inline the calls without the clamp argument.
+(define-macro (define-builtin-inliner-uvset tag TAG)
+  (let ([%-set! (symbol-append tag 'vector-set!)]
+        [%type (symbol-append 'SCM_UVECTOR_ TAG)])
+    `(define-builtin-inliner ,%-set!
+       (^[src args]
+         (match args
+           [(vec ind val) ($asm src `(,UVEC-SET ,,%type) `(,vec ,ind ,val))]
+           [else (undefined)])))))
+
+(define-builtin-inliner-uvset s8 S8)
+(define-builtin-inliner-uvset u8 U8)
+(define-builtin-inliner-uvset s16 S16)
+(define-builtin-inliner-uvset u16 U16)
+(define-builtin-inliner-uvset s32 S32)
+(define-builtin-inliner-uvset u32 U32)
+(define-builtin-inliner-uvset s64 S64)
+(define-builtin-inliner-uvset u64 U64)
+(define-builtin-inliner-uvset f16 F16)
+(define-builtin-inliner-uvset f32 F32)
+(define-builtin-inliner-uvset f64 F64)
+
 (define-builtin-inliner zero?
   (^[src args]
     (match args
@@ -1929,6 +1929,16 @@
  (define-enum SCM_COMPILE_NOINLINE_SETTERS)
  (define-enum SCM_COMPILE_NODISSOLVE_APPLY)
 
+ ;; Compile-time effects.  The compiler calls vm-note-compile-effect!
+ ;; when it changes the global state while compiling a form (defining
+ ;; a macro, switching or modifying modules, etc.)  The code cache
+ ;; compares the counter before and after compiling a toplevel form
+ ;; to see whether the compiled code alone reproduces the form's effect.
+ (define-cproc vm-note-compile-effect! () ::<void>
+   (post++ (-> (Scm_VM) compileEffects)))
+ (define-cproc vm-compile-effects () ::<ulong>
+   (return (-> (Scm_VM) compileEffects)))
+
  ;; Set/get VM's current module info. (temporary)
  (define-cproc vm-current-module () (return (SCM_OBJ (-> (Scm_VM) module))))
  (define-cproc vm-set-current-module (mod::<module>) ::<void>
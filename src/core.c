@@ -75,6 +75,8 @@ extern void Scm__InitWrite(void);
 extern void Scm__InitCompaux(void);
 extern void Scm__InitMacro(void);
 extern void Scm__InitLoad(void);
+extern void Scm__InitCodeCache(void);
+extern void Scm__InitJIT(void);
 extern void Scm__InitParameter(void);
 extern void Scm__InitProc(void);
 extern void Scm__InitRegexp(void);
@@ -168,6 +170,8 @@ void Scm_Init(const char *signature)
     Scm__InitWrite();
     Scm__InitMacro();
     Scm__InitLoad();
+    Scm__InitCodeCache();
+    Scm__InitJIT();
     Scm__InitRegexp();
     Scm__InitRead();
     Scm__InitSignal();
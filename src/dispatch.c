@@ -51,13 +51,10 @@
  *   - It is in performance critical path, and we can take advantage of
  *     domain knowledge to make it faster than generic implementation.
  *
- *  At this moment, the dispatch accelerator isn't built automatically.
- *  You need to call gauche.object#generic-build-dispatcher! explicitly
- *  on a generic function.  The effect varies depending on the methods
- *  the GF has, so we selectively turn on this feature for speed-sensitive
- *  GFs and see how it goes.  If it is proven to be effective enough,
- *  we might implement an automated mechanism when GF meets certain
- *  criteria.
+ *  The dispatch accelerator can be built explicitly by
+ *  gauche.object#generic-build-dispatcher! on a generic function, or
+ *  automatically when the GF meets certain criteria.  See "Automatic
+ *  dispatcher" below.
  *
  *  We take advantage of the following facts:
  *
@@ -114,11 +111,56 @@
  *   The locking on GF is done in class.c.
  */
 
+/* Automatic dispatcher
+ *
+ *   When a GF with more than one method is called, class.c attaches
+ *   an observing dispatcher (axis < 0), which doesn't have the table and
+ *   only counts the calls.  When it has seen DISPATCHER_REVIEW_CALLS
+ *   calls, we look at the shape of the methods to choose the axis.
+ *   The axis must satisfy the following conditions:
+ *
+ *   - All methods have <top> specializers before the axis.  Methods are
+ *     ordered by the specializers from left to right, so otherwise
+ *     a method found by the axis may not be the most specific one.
+ *   - At least DISPATCHER_MIN_METHODS leaf methods, and at least half of
+ *     all the methods, are leaf methods specialized by the axis.
+ *
+ *   If we find one, we replace the dispatcher with the one with the
+ *   table on that axis.  It counts the lookups and the hits, and after
+ *   another DISPATCHER_REVIEW_CALLS lookups, we check the hit rate.
+ *   If less than 1/DISPATCHER_MIN_HIT_RATIO of the lookups hit, the
+ *   table doesn't pay off and we retire the dispatcher, i.e. replace it
+ *   with one without the table.  Either way, it won't be reviewed again.
+ *
+ *   The automatic dispatcher is discarded when the methods of the GF
+ *   are changed, and we start over.  The one built explicitly is
+ *   pinned, and kept updated instead.
+ *
+ *   The counters are updated without synchronization, so they may
+ *   miss some counts when the GF is called concurrently.  They are
+ *   only for heuristics and statistics.
+ */
+#define DISPATCHER_REVIEW_CALLS  1024
+#define DISPATCHER_MIN_METHODS   4
+#define DISPATCHER_MIN_HIT_RATIO 4
+
+enum {
+    DISPATCHER_OBSERVING,        /* counting calls to decide */
+    DISPATCHER_ACTIVE,           /* table is built automatically */
+    DISPATCHER_SETTLED,          /* ditto, and passed the review */
+    DISPATCHER_RETIRED,          /* decided not to have table */
+    DISPATCHER_PINNED            /* table is built explicitly */
+};
+
 struct ScmMethodDispatcherRec {
     int axis;                    /* Which argument we look at?
-                                    This is immutable. */
+                                    This is immutable.  Negative if
+                                    we don't have the table. */
+    int state;                   /* DISPATCHER_* above.  Immutable. */
     ScmAtomicVar methodHash;	 /* mhash.  In case mhash is extended,
                                     we atomically swap reference. */
+    u_long calls;                /* # of lookups */
+    u_long hits;                 /* # of lookups that found methods */
 };
 
 typedef struct mhash_entry_rec {
@@ -270,7 +312,7 @@ static mhash *mhash_delete(mhash *h, ScmClass *k, int nargs, ScmMethod *m)
                 mn = Scm_Delete(SCM_OBJ(m), mn, SCM_CMP_EQ);
             }
 
-            if (SCM_NULLP(ml) && SCM_NULLP(ml)) {
+            if (SCM_NULLP(ml) && SCM_NULLP(mn)) {
                 h->num_entries--;
                 AO_store(&h->bins[j], 1); /* mark as deleted */
             } else {
@@ -311,7 +353,7 @@ static void mhash_print(mhash *h, ScmPort *out)
 static mhash *add_method_to_dispatcher(mhash *h, int axis, ScmMethod *m)
 {
     int req = SCM_PROCEDURE_REQUIRED(m);
-    if (req >= axis) {
+    if (req > axis) {
         ScmClass *klass = m->specializers[axis];
         if (SCM_PROCEDURE_OPTIONAL(m)) {
             for (int k = req; k < SCM_DISPATCHER_MAX_NARGS; k++)
@@ -326,7 +368,7 @@ static mhash *add_method_to_dispatcher(mhash *h, int axis, ScmMethod *m)
 static mhash *delete_method_from_dispatcher(mhash *h, int axis, ScmMethod *m)
 {
     int req = SCM_PROCEDURE_REQUIRED(m);
-    if (req >= axis) {
+    if (req > axis) {
         ScmClass *klass = m->specializers[axis];
         if (SCM_PROCEDURE_OPTIONAL(m)) {
             for (int k = req; k < SCM_DISPATCHER_MAX_NARGS; k++)
@@ -343,8 +385,16 @@ static mhash *delete_method_from_dispatcher(mhash *h, int axis, ScmMethod *m)
     leaf methods, and then process non-leaf methods.  Non-leaf methods
     cancels the dispatcher entry and forces to go through normal route.
  */
-ScmMethodDispatcher *Scm__BuildMethodDispatcher(ScmObj methods, int axis)
+static ScmMethodDispatcher *make_dispatcher(ScmObj methods, int axis,
+                                            int state)
 {
+    ScmMethodDispatcher *dis = SCM_NEW(ScmMethodDispatcher);
+    dis->axis = axis;
+    dis->state = state;
+    dis->methodHash = 0;
+    dis->calls = dis->hits = 0;
+    if (axis < 0) return dis;
+
     mhash *mh = make_mhash(32);
     ScmObj mm;
     for (int i = 0; i < 2; i++) {
@@ -356,12 +406,96 @@ ScmMethodDispatcher *Scm__BuildMethodDispatcher(ScmObj methods, int axis)
             }
         }
     }
-    ScmMethodDispatcher *dis = SCM_NEW(ScmMethodDispatcher);
-    dis->axis = axis;
     dis->methodHash = (ScmAtomicWord)mh;
     return dis;
 }
 
+/* Explicitly built dispatcher */
+ScmMethodDispatcher *Scm__BuildMethodDispatcher(ScmObj methods, int axis)
+{
+    return make_dispatcher(methods, axis, DISPATCHER_PINNED);
+}
+
+/* Initial dispatcher attached to a GF automatically */
+ScmMethodDispatcher *Scm__MakeObservingMethodDispatcher(void)
+{
+    return make_dispatcher(SCM_NIL, -1, DISPATCHER_OBSERVING);
+}
+
+int Scm__MethodDispatcherPinnedP(const ScmMethodDispatcher *dis)
+{
+    return dis->state == DISPATCHER_PINNED;
+}
+
+/* Returns TRUE if DIS won't be reviewed anymore. */
+int Scm__MethodDispatcherSettledP(const ScmMethodDispatcher *dis)
+{
+    return dis->state != DISPATCHER_OBSERVING
+        && dis->state != DISPATCHER_ACTIVE;
+}
+
+/* Returns the axis suitable for METHODS, or -1 if there's none.
+   See "Automatic dispatcher" above. */
+static int choose_axis(ScmObj methods)
+{
+    int nmethods = Scm_Length(methods);
+    int best = -1, best_score = 0;
+
+    for (int axis = 0; axis < SCM_DISPATCHER_MAX_NARGS; axis++) {
+        int score = 0;
+        ScmObj mm;
+        SCM_FOR_EACH(mm, methods) {
+            ScmMethod *m = SCM_METHOD(SCM_CAR(mm));
+            int req = SCM_PROCEDURE_REQUIRED(m);
+            for (int i = 0; i < axis && i < req; i++) {
+                if (m->specializers[i] != SCM_CLASS_TOP) return best;
+            }
+            if (req > axis && m->specializers[axis] != SCM_CLASS_TOP
+                && SCM_METHOD_LEAF_P(m)) {
+                score++;
+            }
+        }
+        if (score > best_score
+            && score >= DISPATCHER_MIN_METHODS
+            && score*2 >= nmethods) {
+            best = axis;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+/* Called when Scm__MethodDispatcherLookup sets *review.  Returns the
+   dispatcher to replace DIS.  The caller holds the GF lock. */
+ScmMethodDispatcher *Scm__MethodDispatcherReview(ScmMethodDispatcher *dis,
+                                                 ScmObj methods)
+{
+    switch (dis->state) {
+    case DISPATCHER_OBSERVING: {
+        int axis = choose_axis(methods);
+        if (axis < 0) return make_dispatcher(methods, -1, DISPATCHER_RETIRED);
+        return make_dispatcher(methods, axis, DISPATCHER_ACTIVE);
+    }
+    case DISPATCHER_ACTIVE:
+        if (dis->hits * DISPATCHER_MIN_HIT_RATIO < dis->calls) {
+            ScmMethodDispatcher *r =
+                make_dispatcher(methods, -1, DISPATCHER_RETIRED);
+            r->calls = dis->calls;
+            r->hits = dis->hits;
+            return r;
+        }
+        else {
+            ScmMethodDispatcher *r =
+                make_dispatcher(methods, dis->axis, DISPATCHER_SETTLED);
+            r->calls = dis->calls;
+            r->hits = dis->hits;
+            return r;
+        }
+    default:
+        return dis;
+    }
+}
+
 void Scm__MethodDispatcherAdd(ScmMethodDispatcher *dis, ScmMethod *m)
 {
     mhash *h = (mhash*)AO_load(&dis->methodHash);
@@ -376,16 +510,34 @@ void Scm__MethodDispatcherDelete(ScmMethodDispatcher *dis, ScmMethod *m)
     if (h != h2) AO_store(&dis->methodHash, (ScmAtomicWord)h2);
 }
 
+/* Returns a list of methods if we find them in the table, or #f.
+   Sets *review to TRUE if the dispatcher needs review (see
+   Scm__MethodDispatcherReview), whether the lookup hits or not;
+   otherwise a dispatcher with a good hit rate would never settle. */
 ScmObj Scm__MethodDispatcherLookup(ScmMethodDispatcher *dis,
-                                   ScmClass **typev, int argc)
+                                   ScmClass **typev, int argc,
+                                   int *review)
 {
-    if (dis->axis <= argc) {
+    ScmObj r = SCM_FALSE;
+    dis->calls++;
+    if (dis->axis >= 0 && dis->axis < argc) {
         ScmClass *selector = typev[dis->axis];
         mhash *h = (mhash*)AO_load(&dis->methodHash);
-        return mhash_probe(h, selector, argc);
-    } else {
-        return SCM_FALSE;
+        r = mhash_probe(h, selector, argc);
+        if (SCM_PAIRP(r)) dis->hits++;
+        else r = SCM_FALSE;
     }
+    *review = (dis->calls >= DISPATCHER_REVIEW_CALLS
+               && (dis->state == DISPATCHER_OBSERVING
+                   || dis->state == DISPATCHER_ACTIVE));
+    return r;
+}
+
+/* Called when the methods found by the table turned out not to be
+   applicable.  It isn't counted as a hit. */
+void Scm__MethodDispatcherMiss(ScmMethodDispatcher *dis)
+{
+    dis->hits--;
 }
 
 ScmObj Scm__MethodDispatcherInfo(const ScmMethodDispatcher *dis)
@@ -395,16 +547,26 @@ ScmObj Scm__MethodDispatcherInfo(const ScmMethodDispatcher *dis)
        http://www.open-std.org/jtc1/sc22/wg14/www/docs/summary.htm#dr_459 */
     ScmAtomicVar *loc = (ScmAtomicVar*)&dis->methodHash;
     const mhash *mh = (const mhash*)AO_load(loc);
+    static const char *states[] = {
+        "observing", "active", "settled", "retired", "pinned"
+    };
+    SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("state"));
+    SCM_APPEND1(h, t, SCM_INTERN(states[dis->state]));
     SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("axis"));
     SCM_APPEND1(h, t, SCM_MAKE_INT(dis->axis));
     SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("num-entries"));
-    SCM_APPEND1(h, t, SCM_MAKE_INT(mh->num_entries));
+    SCM_APPEND1(h, t, SCM_MAKE_INT(mh? mh->num_entries : 0));
+    SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("calls"));
+    SCM_APPEND1(h, t, Scm_MakeIntegerU(dis->calls));
+    SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("hits"));
+    SCM_APPEND1(h, t, Scm_MakeIntegerU(dis->hits));
     return h;
 }
 
 void Scm__MethodDispatcherDump(ScmMethodDispatcher *dis, ScmPort *port)
 {
-    Scm_Printf(port, "MethodDispatcher axis=%d\n", dis->axis);
-    mhash_print((mhash*)dis->methodHash, port);
+    Scm_Printf(port, "MethodDispatcher axis=%d calls=%lu hits=%lu\n",
+               dis->axis, dis->calls, dis->hits);
+    if (dis->methodHash) mhash_print((mhash*)dis->methodHash, port);
 }
 
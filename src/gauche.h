@@ -502,18 +502,50 @@ typedef struct ScmInstanceRec {
 #define SCM_INSTANCE(obj)        ((ScmInstance*)(obj))
 #define SCM_INSTANCE_SLOTS(obj)  (SCM_INSTANCE(obj)->slots)
 
-/* Fundamental allocators */
-#define SCM_MALLOC(size)          GC_MALLOC(size)
-#define SCM_MALLOC_ATOMIC(size)   GC_MALLOC_ATOMIC(size)
+/* Fundamental allocators.
+   While the allocation profiler is running (Scm__AllocProfiling is
+   set), every allocation through these counts down
+   Scm__AllocSampleBudget.  When it goes negative, the allocation is
+   done by Scm__AllocSample, which records it for the profiler (see
+   prof.c) along with WHAT, the name of the allocated C type, or the
+   class if the SCM_ALLOC_CLASS flag is given.  Otherwise, the only
+   extra cost is reading the flag, which is rarely written, so that
+   allocating threads don't contend for the budget. */
+enum {
+    SCM_ALLOC_ATOMIC = (1L<<0), /* the object doesn't contain pointers */
+    SCM_ALLOC_CLASS = (1L<<1)   /* WHAT is ScmClass* */
+};
+
+SCM_EXTERN int  Scm__AllocProfiling;
+SCM_EXTERN long Scm__AllocSampleBudget;
+SCM_EXTERN void *Scm__AllocSample(size_t size, int flags, const void *what);
+
+static inline void *Scm__Malloc(size_t size, int flags, const void *what)
+{
+    if (Scm__AllocProfiling
+        && (Scm__AllocSampleBudget -= (long)size) < 0) {
+        return Scm__AllocSample(size, flags, what);
+    }
+    return (flags & SCM_ALLOC_ATOMIC)? GC_MALLOC_ATOMIC(size) : GC_MALLOC(size);
+}
+
+#define SCM_MALLOC(size)          Scm__Malloc(size, 0, NULL)
+#define SCM_MALLOC_ATOMIC(size)   Scm__Malloc(size, SCM_ALLOC_ATOMIC, NULL)
 #define SCM_STRDUP(s)             GC_STRDUP(s)
 #define SCM_STRDUP_PARTIAL(s, n)  Scm_StrdupPartial(s, n)
 
-#define SCM_NEW(type)         ((type*)(SCM_MALLOC(sizeof(type))))
-#define SCM_NEW_ARRAY(type, nelts) ((type*)(SCM_MALLOC(sizeof(type)*(nelts))))
-#define SCM_NEW2(type, size)  ((type)(SCM_MALLOC(size)))
-#define SCM_NEW_ATOMIC(type)  ((type*)(SCM_MALLOC_ATOMIC(sizeof(type))))
-#define SCM_NEW_ATOMIC_ARRAY(type, nelts)  ((type*)(SCM_MALLOC_ATOMIC(sizeof(type)*(nelts))))
-#define SCM_NEW_ATOMIC2(type, size) ((type)(SCM_MALLOC_ATOMIC(size)))
+#define SCM_NEW(type) \
+    ((type*)Scm__Malloc(sizeof(type), 0, #type))
+#define SCM_NEW_ARRAY(type, nelts) \
+    ((type*)Scm__Malloc(sizeof(type)*(nelts), 0, #type "[]"))
+#define SCM_NEW2(type, size) \
+    ((type)Scm__Malloc(size, 0, #type))
+#define SCM_NEW_ATOMIC(type) \
+    ((type*)Scm__Malloc(sizeof(type), SCM_ALLOC_ATOMIC, #type))
+#define SCM_NEW_ATOMIC_ARRAY(type, nelts) \
+    ((type*)Scm__Malloc(sizeof(type)*(nelts), SCM_ALLOC_ATOMIC, #type "[]"))
+#define SCM_NEW_ATOMIC2(type, size) \
+    ((type)Scm__Malloc(size, SCM_ALLOC_ATOMIC, #type))
 
 typedef void (*ScmFinalizerProc)(ScmObj z, void *data);
 SCM_EXTERN void Scm_RegisterFinalizer(ScmObj z, ScmFinalizerProc finalizer,
@@ -551,6 +583,7 @@ typedef struct ScmMacroRec          ScmMacro;
 typedef struct ScmPromiseRec        ScmPromise;
 typedef struct ScmRegexpRec         ScmRegexp;
 typedef struct ScmRegMatchRec       ScmRegMatch;
+typedef struct ScmRegexpSetRec      ScmRegexpSet;
 typedef struct ScmWriteControlsRec  ScmWriteControls;  /* see writerP.h */
 typedef struct ScmWriteContextRec   ScmWriteContext;   /* see writerP.h */
 typedef struct ScmWriteStateRec     ScmWriteState;     /* see wrtierP.h */
@@ -1848,6 +1881,14 @@ SCM_EXTERN ScmObj Scm_RegMatchAfter(ScmRegMatch *rm, ScmObj obj);
 SCM_EXTERN ScmObj Scm_RegMatchBefore(ScmRegMatch *rm, ScmObj obj);
 SCM_EXTERN void Scm_RegMatchDump(ScmRegMatch *match);
 
+SCM_CLASS_DECL(Scm_RegexpSetClass);
+#define SCM_CLASS_REGEXP_SET      (&Scm_RegexpSetClass)
+#define SCM_REGEXP_SET(obj)       ((ScmRegexpSet*)obj)
+#define SCM_REGEXP_SET_P(obj)     SCM_XTYPEP(obj, SCM_CLASS_REGEXP_SET)
+
+SCM_EXTERN ScmObj Scm_MakeRegexpSet(ScmObj regexps);
+SCM_EXTERN ScmObj Scm_RegexpSetMatch(ScmRegexpSet *rs, ScmObj input);
+
 /*-------------------------------------------------------
  * STUB MACROS
  */
@@ -1912,9 +1953,21 @@ SCM_EXTERN void   Scm_SetSigmask(sigset_t *mask);
  */
 
 SCM_EXTERN void   Scm_ProfilerStart(void);
+SCM_EXTERN void   Scm_ProfilerStartWithFlags(u_long flags, u_long period);
 SCM_EXTERN int    Scm_ProfilerStop(void);
 SCM_EXTERN void   Scm_ProfilerReset(void);
 
+/* flags for Scm_ProfilerStartWithFlags */
+enum {
+    SCM_PROFILER_ALL_THREADS = (1L<<0)  /* sample every Scheme thread */
+};
+
+SCM_EXTERN void   Scm_AllocProfilerStart(u_long interval);
+SCM_EXTERN void   Scm_AllocProfilerStop(void);
+SCM_EXTERN void   Scm_AllocProfilerReset(void);
+SCM_EXTERN ScmObj Scm_AllocProfilerRawResult(void);
+SCM_EXTERN u_long Scm_AllocProfilerInterval(void);
+
 /*---------------------------------------------------
  * UTILITY STUFF
  */
@@ -46,6 +46,8 @@ SCM_EXTERN ScmObj Scm_MakeBignumFromDouble(double val);
 SCM_EXTERN ScmObj Scm_BignumCopy(const ScmBignum *b);
 SCM_EXTERN ScmObj Scm_BignumToString(const ScmBignum *b, int radix,
                                      int use_upper);
+SCM_EXTERN ScmObj Scm_BignumFromDigits(const char *digits, int ndigits,
+                                       int radix);
 
 SCM_EXTERN long   Scm_BignumToSI(const ScmBignum *b, int clamp, int* oor);
 SCM_EXTERN u_long Scm_BignumToUI(const ScmBignum *b, int clamp, int* oor);
@@ -89,5 +91,13 @@ SCM_EXTERN ScmBignum *Scm_BignumAccMultAddUI(ScmBignum *acc,
 
 SCM_EXTERN int Scm_DumpBignum(const ScmBignum *b, ScmPort *out);
 
+/* Thresholds of subquadratic multiplication, division and radix
+   conversion, for tuning.  Returns the previous value.  If VALUE is
+   negative, just returns the current value. */
+SCM_EXTERN int Scm__BignumKaratsubaThreshold(int value);
+SCM_EXTERN int Scm__BignumToom3Threshold(int value);
+SCM_EXTERN int Scm__BignumDivThreshold(int value);
+SCM_EXTERN int Scm__BignumRadixConvThreshold(int value);
+
 #endif /* GAUCHE_BIGNUM_H */
 
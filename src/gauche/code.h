@@ -75,6 +75,10 @@ struct ScmCompiledCodeRec {
                                    #f otherwise. (*5) */
     void *builder;              /* An opaque data used during consturcting
                                    the code vector.  Usually NULL. */
+    u_int callCount;            /* # of calls while JIT is enabled. (*6) */
+    void *native;               /* An opaque data of the native code
+                                   compiled from the code vector, or NULL.
+                                   (*6) */
 };
 
 /* Footnotes on ScmCompiledCodeRec
@@ -100,6 +104,8 @@ struct ScmCompiledCodeRec {
  *       metainfo about closure interface, e.g. types.
  *   *5) This IForm is a direct result of Pass1, i.e. non-optimized form.
  *       Pass2 scans it when IForm is inlined into the caller site.
+ *   *6) See jit.c.  These are left zero by
+ *       SCM_COMPILED_CODE_CONST_INITIALIZER.
  */
 
 SCM_CLASS_DECL(Scm_CompiledCodeClass);
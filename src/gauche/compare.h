@@ -104,6 +104,13 @@ SCM_EXTERN void   Scm_SortArray(ScmObj *elts, int nelts, ScmObj cmpfn);
 SCM_EXTERN ScmObj Scm_SortList(ScmObj objs, ScmObj fn);
 SCM_EXTERN ScmObj Scm_SortListX(ScmObj objs, ScmObj fn);
 
+/* Flags for Scm_RadixSortArray */
+enum {
+    SCM_SORT_DESCENDING = (1L<<0),
+    SCM_SORT_KEY_CDR = (1L<<1)  /* elements are (elt . key) pairs */
+};
+SCM_EXTERN int    Scm_RadixSortArray(ScmObj *elts, int nelts, int flags);
+
 
 SCM_DECL_END
 
@@ -72,8 +72,34 @@ struct ScmHashCoreRec {
     ScmHashProc          *hashfn;
     ScmHashCompareProc   *cmpfn;
     void *data;
+    u_long flags;               /* SCM_HASH_CORE_* */
+    int numDeleted;             /* # of tombstones (open addressing only) */
+    void *rehash;               /* incremental rehash state (type hidden) */
 };
 
+/* Flags for ScmHashCore.
+   By default, the hash core uses separate chaining, that is, each bucket
+   has a list of entries, each of which is allocated separately.
+   SCM_HASH_CORE_OPEN_ADDRESSING makes the core keep all entries in a
+   single flat array with linear probing.  It is faster and much
+   more memory-efficient for large tables, but ScmDictEntry* returned
+   by Scm_HashCoreSearch is only valid until the next insertion to the
+   table, since growing the table relocates the entries.  Weak hash
+   tables don't support this layout.
+
+   SCM_HASH_CORE_INCREMENTAL_REHASH is for the chained layout.  When
+   the table needs to grow, the old and the new bucket arrays coexist
+   for a while, and each insertion moves a few old buckets to the new
+   array, instead of relinking all the entries at once.  It avoids a
+   long pause when a huge table grows. */
+enum {
+    SCM_HASH_CORE_OPEN_ADDRESSING = (1L<<0),
+    SCM_HASH_CORE_INCREMENTAL_REHASH = (1L<<1)
+};
+
+#define SCM_HASH_CORE_OPEN_ADDRESSING_P(core) \
+    ((core)->flags & SCM_HASH_CORE_OPEN_ADDRESSING)
+
 SCM_EXTERN void Scm_HashCoreInitSimple(ScmHashCore *core,
                                        ScmHashType type,
                                        unsigned int initSize,
@@ -85,6 +111,19 @@ SCM_EXTERN void Scm_HashCoreInitGeneral(ScmHashCore *core,
                                         unsigned int initSize,
                                         void *data);
 
+SCM_EXTERN void Scm_HashCoreInitSimpleWithFlags(ScmHashCore *core,
+                                                ScmHashType type,
+                                                unsigned int initSize,
+                                                u_long flags,
+                                                void *data);
+
+SCM_EXTERN void Scm_HashCoreInitGeneralWithFlags(ScmHashCore *core,
+                                                 ScmHashProc *hashfn,
+                                                 ScmHashCompareProc *cmpfn,
+                                                 unsigned int initSize,
+                                                 u_long flags,
+                                                 void *data);
+
 SCM_EXTERN int  Scm_HashCoreTypeToProcs(ScmHashType type,
                                         ScmHashProc **hashfn,
                                         ScmHashCompareProc **cmpfn);
@@ -149,6 +188,14 @@ SCM_EXTERN ScmObj Scm_MakeHashTableFull(ScmHashProc *hashfn,
                                         ScmHashCompareProc *cmpfn,
                                         unsigned int initSize,
                                         void *data);
+SCM_EXTERN ScmObj Scm_MakeHashTableSimpleWithFlags(ScmHashType type,
+                                                   unsigned int initSize,
+                                                   u_long flags);
+SCM_EXTERN ScmObj Scm_MakeHashTableFullWithFlags(ScmHashProc *hashfn,
+                                                 ScmHashCompareProc *cmpfn,
+                                                 unsigned int initSize,
+                                                 u_long flags,
+                                                 void *data);
 
 SCM_EXTERN ScmHashType Scm_HashTableType(ScmHashTable *tab);
 
@@ -166,6 +213,78 @@ SCM_EXTERN ScmObj Scm_HashTableValues(ScmHashTable *table);
 
 SCM_EXTERN ScmObj Scm_HashTableStat(ScmHashTable *table);
 
+/*================================================================
+ * ScmConcurrentHashTable
+ */
+
+/* A hash table that can be shared among threads without external
+   locking.  Lookups don't take any locks.  Insertions, updates and
+   deletions are done by compare-and-swap on the slot and the entry's
+   value, so they don't block each other either.  Only when the table
+   needs to be extended, the writers wait for the extension to finish.
+
+   Keys and values are always ScmObj.  The procs field is only used
+   to carry hash/compare functions and the data passed to them;
+   other fields of it are unused.  The table field points to the
+   current slot table, which is swapped atomically on extension
+   (actual type hidden). */
+
+typedef struct ScmConcurrentHashTableRec {
+    SCM_HEADER;
+    ScmHashType type;
+    ScmHashCore procs;
+    void *table;
+    ScmWord numEntries;
+    ScmInternalMutex mutex;     /* held while the table is extended */
+} ScmConcurrentHashTable;
+
+SCM_CLASS_DECL(Scm_ConcurrentHashTableClass);
+#define SCM_CLASS_CONCURRENT_HASH_TABLE  (&Scm_ConcurrentHashTableClass)
+#define SCM_CONCURRENT_HASH_TABLE(obj)   ((ScmConcurrentHashTable*)(obj))
+#define SCM_CONCURRENT_HASH_TABLE_P(obj) \
+    SCM_XTYPEP(obj, SCM_CLASS_CONCURRENT_HASH_TABLE)
+
+SCM_EXTERN ScmObj Scm_MakeConcurrentHashTableSimple(ScmHashType type,
+                                                    unsigned int initSize);
+SCM_EXTERN ScmObj Scm_MakeConcurrentHashTableFull(ScmHashProc *hashfn,
+                                                  ScmHashCompareProc *cmpfn,
+                                                  unsigned int initSize,
+                                                  void *data);
+
+SCM_EXTERN ScmObj Scm_ConcurrentHashTableRef(ScmConcurrentHashTable *ct,
+                                             ScmObj key, ScmObj fallback);
+SCM_EXTERN ScmObj Scm_ConcurrentHashTableSet(ScmConcurrentHashTable *ct,
+                                             ScmObj key, ScmObj value,
+                                             int flags);
+SCM_EXTERN ScmObj Scm_ConcurrentHashTableDelete(ScmConcurrentHashTable *ct,
+                                                ScmObj key);
+/* Replaces the value of KEY with NEWVAL iff the current value is eq? to
+   EXPECTED.  SCM_UNBOUND as EXPECTED or NEWVAL stands for the absence
+   of the entry.  Returns TRUE on success. */
+SCM_EXTERN int    Scm_ConcurrentHashTableCompareAndSwap(ScmConcurrentHashTable *ct,
+                                                        ScmObj key,
+                                                        ScmObj expected,
+                                                        ScmObj newval);
+SCM_EXTERN int    Scm_ConcurrentHashTableNumEntries(ScmConcurrentHashTable *ct);
+SCM_EXTERN void   Scm_ConcurrentHashTableClear(ScmConcurrentHashTable *ct);
+
+SCM_EXTERN ScmObj Scm_ConcurrentHashTableKeys(ScmConcurrentHashTable *ct);
+SCM_EXTERN ScmObj Scm_ConcurrentHashTableValues(ScmConcurrentHashTable *ct);
+
+/* The iterator walks over a snapshot of the slot table taken at
+   Scm_ConcurrentHashIterInit.  Entries added after that may not be
+   seen, but entries modified or deleted are reflected. */
+typedef struct ScmConcurrentHashIterRec {
+    ScmConcurrentHashTable *ct;
+    void *table;
+    int index;
+} ScmConcurrentHashIter;
+
+SCM_EXTERN void Scm_ConcurrentHashIterInit(ScmConcurrentHashIter *iter,
+                                           ScmConcurrentHashTable *ct);
+SCM_EXTERN int  Scm_ConcurrentHashIterNext(ScmConcurrentHashIter *iter,
+                                           ScmObj *key, ScmObj *value);
+
 
 /*====================================================================
  * For backward compatibility.  DEPRECATED.
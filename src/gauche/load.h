@@ -79,6 +79,26 @@ SCM_EXTERN int Scm_Load(const char *file, u_long flags, ScmLoadPacket *p);
 SCM_EXTERN int Scm_LoadFromCString(const char *program, u_long flags,
                                    ScmLoadPacket *p);
 
+/*=================================================================
+ * Code cache (see codecache.c)
+ */
+SCM_EXTERN ScmObj Scm_CodeCacheDirectory(void);
+SCM_EXTERN void   Scm_SetCodeCacheDirectory(ScmObj dir);
+SCM_EXTERN ScmObj Scm_CodeCacheOpen(ScmString *srcpath, ScmModule *module);
+SCM_EXTERN ScmObj Scm_CodeCacheGet(ScmPort *in);
+SCM_EXTERN int    Scm_CodeCachePut(ScmPort *out, ScmObj obj);
+SCM_EXTERN int    Scm_CodeCacheSave(ScmString *srcpath, ScmModule *module,
+                                    ScmPort *body);
+SCM_EXTERN void   Scm_CodeCacheDiscard(ScmString *srcpath);
+
+SCM_EXTERN void   Scm_ImageStartRecording(void);
+SCM_EXTERN int    Scm_ImageRecordingP(void);
+SCM_EXTERN void   Scm_ImageRecord(ScmString *srcpath, ScmModule *module,
+                                  ScmObj body);
+SCM_EXTERN void   Scm_ImageRecordFailure(ScmObj what);
+SCM_EXTERN void   Scm_ImageDump(ScmString *path);
+SCM_EXTERN ScmObj Scm_ImageOpen(ScmString *path);
+
 /*=================================================================
  * Dynamic state access
  */
@@ -117,6 +137,7 @@ SCM_EXTERN ScmObj Scm_DLObjs(void);
 SCM_EXTERN int Scm_Require(ScmObj feature, int flags, ScmLoadPacket *p);
 SCM_EXTERN ScmObj Scm_Provide(ScmObj feature);
 SCM_EXTERN int    Scm_ProvidedP(ScmObj feature);
+SCM_EXTERN ScmObj Scm_ProvidedFeatures(void);
 
 /*=================================================================
  * Autoloads
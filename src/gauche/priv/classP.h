@@ -46,4 +46,44 @@ SCM_EXTERN void   Scm__GenericInvalidateDispatcher(ScmGeneric *gf);
 SCM_EXTERN ScmObj Scm__GenericDispatcherInfo(ScmGeneric *gf);
 SCM_EXTERN void   Scm__GenericDispatcherDump(ScmGeneric *gf, ScmPort *port);
 
+/* Inline caches.
+
+   The operand of SLOT-REFC and SLOT-SETC is initially the slot name.
+   When the instruction is executed, it is replaced with ScmSlotCache,
+   which remembers the accessors of the classes seen at that site.
+   The cache is immutable; we replace the operand with a new one
+   to add an entry.  Since the code vector isn't scanned by GC, the
+   cache is also kept in the constants of the compiled code.
+
+   Generic function calls are cached in a global table indexed by
+   the call site, for CALL doesn't have an operand. */
+
+#define SCM_SLOT_CACHE_SIZE  4
+
+typedef struct ScmSlotCacheRec {
+    SCM_HEADER;
+    ScmObj name;                /* slot name */
+    int numEntries;
+    struct {
+        ScmClass *klass;
+        ScmSlotAccessor *accessor;
+    } entries[SCM_SLOT_CACHE_SIZE]; /* most recent first */
+} ScmSlotCache;
+
+SCM_CLASS_DECL(Scm_SlotCacheClass);
+#define SCM_CLASS_SLOT_CACHE     (&Scm_SlotCacheClass)
+#define SCM_SLOT_CACHE(obj)      ((ScmSlotCache*)(obj))
+#define SCM_SLOT_CACHE_P(obj)    SCM_XTYPEP(obj, SCM_CLASS_SLOT_CACHE)
+
+/* Returns the slot name if OPERAND is a slot cache, OPERAND otherwise. */
+#define SCM_SLOT_CACHE_NAME(operand)                                    \
+    (SCM_SLOT_CACHE_P(operand)? SCM_SLOT_CACHE(operand)->name : (operand))
+
+SCM_EXTERN ScmObj Scm__VMSlotRefC(ScmObj obj, ScmWord *site,
+                                  ScmCompiledCode *base);
+SCM_EXTERN ScmObj Scm__VMSlotSetC(ScmObj obj, ScmObj val, ScmWord *site,
+                                  ScmCompiledCode *base);
+SCM_EXTERN ScmObj Scm__CallSiteMethods(ScmGeneric *gf, ScmObj *argv,
+                                       int argc, ScmWord *site);
+
 #endif /*GAUCHE_PRIV_CLASSP_H*/
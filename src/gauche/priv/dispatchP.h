@@ -44,11 +44,18 @@
 typedef struct ScmMethodDispatcherRec ScmMethodDispatcher;
 
 ScmMethodDispatcher *Scm__BuildMethodDispatcher(ScmObj methods, int axis);
+ScmMethodDispatcher *Scm__MakeObservingMethodDispatcher(void);
+ScmMethodDispatcher *Scm__MethodDispatcherReview(ScmMethodDispatcher *dis,
+                                                 ScmObj methods);
+int    Scm__MethodDispatcherPinnedP(const ScmMethodDispatcher *dis);
+int    Scm__MethodDispatcherSettledP(const ScmMethodDispatcher *dis);
 
 void   Scm__MethodDispatcherAdd(ScmMethodDispatcher *dis, ScmMethod *m);
 void   Scm__MethodDispatcherDelete(ScmMethodDispatcher *dis, ScmMethod *m);
 ScmObj Scm__MethodDispatcherLookup(ScmMethodDispatcher *dis,
-                                   ScmClass **typev, int argc);
+                                   ScmClass **typev, int argc,
+                                   int *review);
+void   Scm__MethodDispatcherMiss(ScmMethodDispatcher *dis);
 ScmObj Scm__MethodDispatcherInfo(const ScmMethodDispatcher *dis);
 void   Scm__MethodDispatcherDump(ScmMethodDispatcher *dis, ScmPort *port);
 
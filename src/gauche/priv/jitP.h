@@ -0,0 +1,61 @@
+/*
+ * jitP.h - native code generation of VM instructions
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_PRIV_JITP_H
+#define GAUCHE_PRIV_JITP_H
+
+SCM_DECL_BEGIN
+
+#include <gauche/vm.h>
+
+/* The native code generator is only for x86_64 for now. */
+#if defined(SCM_TARGET_X86_64) && defined(HAVE_SYS_MMAN_H) && !defined(GAUCHE_WINDOWS)
+#define SCM_JIT_AVAILABLE 1
+#endif
+
+/* A closure body is compiled into native code when the closure is
+   called this many times while SCM_ENABLE_JIT is set. */
+#define SCM_JIT_THRESHOLD  1000
+
+/* These are called from the VM loop.  They run the native code of CC
+   from vm->pc, if any, and return the PC where the VM should resume.
+   Scm__JITCall counts the calls and compiles CC when it gets hot. */
+SCM_EXTERN ScmWord *Scm__JITCall(ScmVM *vm, ScmCompiledCode *cc);
+SCM_EXTERN ScmWord *Scm__JITResume(ScmVM *vm, ScmCompiledCode *cc);
+
+SCM_EXTERN int Scm__JITAvailableP(void);
+SCM_EXTERN int Scm__JITCompiledP(ScmCompiledCode *cc);
+
+SCM_DECL_END
+
+#endif /* GAUCHE_PRIV_JITP_H */
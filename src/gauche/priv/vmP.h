@@ -50,6 +50,7 @@ struct ScmCallTraceRec {
 };
 
 ScmCallTrace *Scm__MakeCallTraceQueue(u_long size);
+ScmObj Scm__VMList(void);
 
 SCM_DECL_END
 
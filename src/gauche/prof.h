@@ -41,7 +41,9 @@
 /* We have two types of profilers, a statistic sampler and call-counter.
  *
  * The statistic sampler uses ITIMER_PROF and records the current code
- * base and PC for every SIGPROF.
+ * base and PC for every SIGPROF, followed by the code bases of the
+ * continuation frames (up to SCM_PROF_MAX_STACK_DEPTH), so that
+ * we can reconstruct the call stack of each sample.
  * (NB: in order for this to work, VM's PC must always be saved
  * in VM structure; in another word, vm.c must be compiled with
  * SMALL_REGS == 0).
@@ -50,14 +52,27 @@
  * execution on the thread.   Each entry just records the address of
  * the called object.
  *
- * TODO: It is not known if sampling profiler works when more than one
- * thread requests profiling.  Should be considrered later.
+ * By default, only the thread that calls Scm_ProfilerStart is profiled.
+ * If SCM_PROFILER_ALL_THREADS is given to Scm_ProfilerStartWithFlags,
+ * every Scheme thread gets its own profiling buffer, including the ones
+ * created while the profiler is running.  ITIMER_PROF is process-wide,
+ * and at least on Linux SIGPROF is delivered to the thread that consumed
+ * the CPU time; each thread records samples into its own buffer, and
+ * the results are merged when they are retrieved.  Threads block
+ * SIGPROF by default, so that a busy thread that isn't profiled doesn't
+ * take samples away; a profiled thread unblocks it by itself while the
+ * profiler is running (Scm__ProfilerUpdateSigmask, called at the next
+ * safe point on request).  (The flag is ignored on Windows, where the
+ * sampler is an observer thread per target.)
  *
  * When the on-memory buffer of the call counter gets full, it is collected
- * to a hash table.  When the statistic sampling buffer gets full, it
- * is flushed to a temporary file (we can't use a hashtable, since the
- * flushing may be done within a signal handler and we can't call allocator
- * in it).
+ * to a hash table.  The statistic sampler runs in a signal handler, where
+ * we can't call allocator, so it can't use a hashtable directly.  When
+ * its buffer gets half full, it asks the VM to collect the samples at
+ * the next safe point (Scm_ProfilerSampleBufferFlush, called from
+ * process_queued_requests in vm.c).  If the buffer gets full before
+ * that, the samples are flushed to a temporary file and collected
+ * when the result is requested.
  *
  * Profiler status:
  *
@@ -85,11 +100,18 @@ enum {
 typedef struct ScmProfSampleRec {
     ScmObj func;                /* ScmCompiledCode or ScmSubr */
     ScmWord *pc;
+    int depth;                  /* # of the caller entries that follow
+                                   this entry.  -1 if this entry itself
+                                   is a caller entry. */
 } ScmProfSample;
 
-/* # of on-memory samples for the statistic sampler. */
+/* # of on-memory samples for the statistic sampler.  Each sample
+   takes 1 + depth entries. */
 #define SCM_PROF_SAMPLES_IN_BUFFER  6000
 
+/* Max # of callers recorded per sample. */
+#define SCM_PROF_MAX_STACK_DEPTH    128
+
 /* A record of call counter */
 typedef struct ScmProfCountRec {
     ScmObj func;                /* Called Function */
@@ -108,10 +130,22 @@ struct ScmVMProfilerRec {
     int currentSample;          /* index to the current sample */
     int totalSamples;           /* total # of samples */
     int errorOccurred;          /* TRUE if error has occurred during I/O */
+    int flushRequested;         /* TRUE if the sampler asks the VM to
+                                   move samples to stackHash */
+    volatile int collecting;    /* TRUE while samples are being moved;
+                                   the sampler skips samples meanwhile */
+    int sigmaskRequested;       /* TRUE if the thread is asked to update
+                                   its SIGPROF mask to the profiler state */
+    int sigprofUnblocked;       /* TRUE if we unblocked SIGPROF */
+    int sigprofBlocked;         /* TRUE if SIGPROF was blocked before */
     int currentCount;           /* index to the current counter */
     ScmHashTable* statHash;     /* hashtable for collected data.
                                    value is a pair of integers,
                                    (<call-count> . <sample-hits>) */
+    ScmHashTable* stackHash;    /* call stacks of the samples, as a
+                                   trie.  Maps a code, outermost first,
+                                   to a pair (<sample-hits> . <subtrie>).
+                                   <subtrie> may be #f. */
 #if defined(GAUCHE_WINDOWS)
     HANDLE hTargetThread;       /* target thread */
     HANDLE hObserverThread;     /* observer thread */
@@ -123,11 +157,22 @@ struct ScmVMProfilerRec {
 };
 
 SCM_EXTERN ScmObj Scm_ProfilerRawResult(void);
+SCM_EXTERN ScmObj Scm_ProfilerRawStacks(void);
+SCM_EXTERN u_long Scm_ProfilerSamplingPeriod(void);
+
+/* Called by vm.c when a thread starts and finishes running a VM */
+SCM_EXTERN void Scm__ProfilerAttachVM(ScmVM *vm);
+SCM_EXTERN void Scm__ProfilerDetachVM(ScmVM *vm);
+SCM_EXTERN void Scm__ProfilerUpdateSigmask(ScmVM *vm);
 
 /* Call Counter API */
 
 SCM_EXTERN void Scm_ProfilerCountBufferFlush(ScmVM *vm);
 
+/* Statistic sampler API */
+
+SCM_EXTERN void Scm_ProfilerSampleBufferFlush(ScmVM *vm);
+
 #ifdef GAUCHE_PROFILE
 #define SCM_PROF_COUNT_CALL(vm, obj)                                    \
     do {                                                                \
@@ -54,6 +54,9 @@ struct ScmRegexpRec {
                             match at the beginning of the regexp.  It can be
                             used to skip input start position when regexp
                             isn't BOL_ANCHORED. */
+    void *dfa;           /* Programs for the lazy DFA matcher, or NULL
+                            if the regexp requires backtracking.
+                            See "Lazy DFA matcher" in regexp.c. */
 };
 
 struct ScmRegMatchRec {
@@ -72,9 +75,23 @@ struct ScmRegMatchRec {
     } **matches;
 };
 
+struct ScmRegexpSetRec {
+    SCM_HEADER;
+    int numRegexps;
+    ScmRegexp **regexps;
+    void *prog;          /* Combined program for the lazy DFA matcher.
+                            See "Regexp set" in regexp.c. */
+};
+
 #define SCM_REG_MATCH_SINGLE_BYTE_P(rm) \
     ((rm)->inputSize == (rm)->inputLen)
 
+/* For testing and benchmarking.  Turns the lazy DFA matcher or the
+   required literal prefilter on (1) or off (0), or just queries (-1).
+   Returns the previous setting. */
+SCM_EXTERN int Scm__RegexpUseDFA(int flag);
+SCM_EXTERN int Scm__RegexpUsePrefilter(int flag);
+
 /* Note: The structure of ScmRegexp is changed on 0.9.1.  Shuold be safe,
    for it should never be statically allocated. */
 
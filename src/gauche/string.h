@@ -74,6 +74,9 @@ typedef struct ScmStringBodyRec {
     ScmSmallInt length;
     ScmSmallInt size;
     const char *start;
+    void *index;                /* character index of a multibyte body,
+                                   built lazily (actual type hidden).
+                                   See "Character index" in string.c */
 } ScmStringBody;
 
 #if SIZEOF_LONG == 4
@@ -282,6 +285,11 @@ SCM_EXTERN const char *Scm_StringPosition(ScmString *str, ScmSmallInt k); /*DEPR
 SCM_EXTERN const char *Scm_StringBodyPosition(const ScmStringBody *str, ScmSmallInt k);
 SCM_EXTERN ScmObj  Scm_MaybeSubstring(ScmString *x, ScmObj start, ScmObj end);
 
+/* Character index for multibyte strings.  See string.c */
+SCM_EXTERN ScmSmallInt Scm_StringIndexInterval(ScmSmallInt n);
+SCM_EXTERN ScmObj      Scm_StringBuildIndex(ScmString *str);
+SCM_EXTERN int         Scm_StringBodyFastIndexableP(const ScmStringBody *b);
+
 /*
  * Static initializer
  */
@@ -278,6 +278,26 @@ typedef struct ScmHeaderRec ScmSysFdset;
 #define SCM_SYS_FDSET_P(obj)    (FALSE)
 #endif /*!HAVE_SELECT*/
 
+/* poll/epoll.  The structure is private to system.c. */
+#ifdef HAVE_POLL
+typedef struct ScmSysPollerRec ScmSysPoller;
+
+SCM_CLASS_DECL(Scm_SysPollerClass);
+#define SCM_CLASS_SYS_POLLER    (&Scm_SysPollerClass)
+#define SCM_SYS_POLLER(obj)     ((ScmSysPoller*)(obj))
+#define SCM_SYS_POLLER_P(obj)   (SCM_XTYPEP(obj, SCM_CLASS_SYS_POLLER))
+
+SCM_EXTERN void   Scm_SysPollerSet(ScmSysPoller *p, int fd, ScmObj flags);
+SCM_EXTERN ScmObj Scm_SysPollerWait(ScmSysPoller *p, ScmObj timeout);
+SCM_EXTERN ScmObj Scm_SysPollerBackend(ScmSysPoller *p);
+SCM_EXTERN void   Scm_SysPollerClose(ScmSysPoller *p);
+#else  /*!HAVE_POLL*/
+/* dummy definitions */
+typedef struct ScmHeaderRec ScmSysPoller;
+#define SCM_SYS_POLLER(obj)     (obj)
+#define SCM_SYS_POLLER_P(obj)   (FALSE)
+#endif /*!HAVE_POLL*/
+
 /*==============================================================
  * Miscellaneous
  */
@@ -517,6 +517,11 @@ struct ScmVMRec {
 
     /* Program information */
     int    evalSituation;       /* eval situation (related to eval-when) */
+    u_long compileEffects;      /* incremented whenever the compiler
+                                   changes the global state while compiling
+                                   a form, e.g. by define-syntax.  The code
+                                   cache uses it to tell which toplevel
+                                   forms need to be compiled again. */
 
     /* Signal information */
     ScmSignalQueue sigq;
@@ -662,8 +667,10 @@ enum {
                                            module */
     SCM_COLLECT_VM_STATS     = (1L<<5), /* enable statistics collection
                                            (incurs runtime overhead) */
-    SCM_COLLECT_LOAD_STATS   = (1L<<6)  /* log the stats of file load
+    SCM_COLLECT_LOAD_STATS   = (1L<<6), /* log the stats of file load
                                            timings (incurs runtime overhead) */
+    SCM_ENABLE_JIT           = (1L<<7)  /* compile hot closures into
+                                           native code (see jit.c) */
 };
 
 #define SCM_VM_RUNTIME_FLAG_IS_SET(vm, flag) ((vm)->runtimeFlags & (flag))
@@ -74,6 +74,8 @@ check gauche.sys.crypt NULL HAVE_CRYPT
 check gauche.sys.symlink NULL HAVE_SYMLINK
 check gauche.sys.readlink NULL HAVE_READLINK
 check gauche.sys.select NULL HAVE_SELECT
+check gauche.sys.poll NULL HAVE_POLL
+check gauche.sys.epoll NULL HAVE_EPOLL_CREATE1
 
 check gauche.net.ipv6 gauche.net HAVE_IPV6
 check gauche.sys.openpty gauche.termios HAVE_OPENPTY
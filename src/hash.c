@@ -55,6 +55,26 @@ typedef struct EntryRec {
 #define MAX_AVG_CHAIN_LIMITS   3
 #define EXTEND_BITS            2
 
+/* State of incremental rehashing.  While the table is being extended,
+   table->buckets is the new bucket array and this keeps the old one.
+   The old buckets below INDEX are already moved (and NULL-cleared). */
+typedef struct RehashRec {
+    Entry **buckets;
+    int numBuckets;
+    int numBucketsLog2;
+    int index;
+} Rehash;
+
+#define REHASH(hc)    ((Rehash*)(hc)->rehash)
+
+/* Number of old buckets moved per insertion.  The table is extended
+   by 2^EXTEND_BITS times, and it won't be extended again until
+   the old number of buckets times (2^EXTEND_BITS-1)*MAX_AVG_CHAIN_LIMITS
+   entries are inserted, so one bucket per insertion is enough to finish
+   the work before the next extension.  We move a bit more to shorten
+   the period we need to look at two buckets. */
+#define REHASH_STEP            4
+
 /* We limit portable hash value to 32bits */
 #define PORTABLE_HASHMASK  0xffffffffUL
 
@@ -515,8 +535,34 @@ u_long Scm_CombineHashValue(u_long a, u_long b)
  * throw Scheme error.  Be aware of that.
  */
 
+/*
+ * Move at most N buckets of the incremental rehash in progress.
+ */
+static void rehash_step(ScmHashCore *table, int n)
+{
+    Rehash *r = REHASH(table);
+    Entry **newb = BUCKETS(table);
+
+    for (; n > 0 && r->index < r->numBuckets; n--, r->index++) {
+        Entry *e = r->buckets[r->index], *next;
+        for (; e; e = next) {
+            u_long index = HASH2INDEX(table->numBuckets,
+                                      table->numBucketsLog2, e->hashval);
+            next = e->next;
+            e->next = newb[index];
+            newb[index] = e;
+        }
+        r->buckets[r->index] = NULL;
+    }
+    if (r->index >= r->numBuckets) table->rehash = NULL;
+}
+
 /*
  * Common function called when the accessor function needs to add an entry.
+ *
+ * With SCM_HASH_CORE_INCREMENTAL_REHASH, insertion is the only operation
+ * that moves entries between bucket arrays.  Lookup and deletion don't,
+ * so they are as safe during iteration as in the non-incremental mode.
  */
 static Entry *insert_entry(ScmHashCore *table,
                            intptr_t key,
@@ -532,6 +578,8 @@ static Entry *insert_entry(ScmHashCore *table,
     buckets[index] = e;
     table->numEntries++;
 
+    if (table->rehash) rehash_step(table, REHASH_STEP);
+
     if (table->numEntries > table->numBuckets*MAX_AVG_CHAIN_LIMITS) {
         /* Extend the table */
         int newsize = (table->numBuckets << EXTEND_BITS);
@@ -540,6 +588,22 @@ static Entry *insert_entry(ScmHashCore *table,
         Entry **newb = SCM_NEW_ARRAY(Entry*, newsize);
         for (int i=0; i<newsize; i++) newb[i] = NULL;
 
+        if (table->flags & SCM_HASH_CORE_INCREMENTAL_REHASH) {
+            /* Shouldn't happen, but just in case. */
+            if (table->rehash) rehash_step(table, INT_MAX);
+
+            Rehash *r = SCM_NEW(Rehash);
+            r->buckets = BUCKETS(table);
+            r->numBuckets = table->numBuckets;
+            r->numBucketsLog2 = table->numBucketsLog2;
+            r->index = 0;
+            table->numBuckets = newsize;
+            table->numBucketsLog2 = newbits;
+            table->buckets = (void**)newb;
+            table->rehash = r;
+            return e;
+        }
+
         ScmHashIter iter;
         Entry *f;
         Scm_HashIterInit(&iter, table);
@@ -564,26 +628,27 @@ static Entry *insert_entry(ScmHashCore *table,
    "current" entry of iteration is safe as far as other iterators
    are running on the same hash table. */
 static Entry *delete_entry(ScmHashCore *table,
+                           Entry **buckets,
                            Entry *entry, Entry *prev,
                            int index)
 {
     if (prev) prev->next = entry->next;
-    else table->buckets[index] = (void*)entry->next;
+    else buckets[index] = entry->next;
     table->numEntries--;
     SCM_ASSERT(table->numEntries >= 0);
     entry->next = NULL;         /* GC friendliness */
     return entry;
 }
 
-#define FOUND(table, op, e, p, index)                   \
-    do {                                                \
-        switch (op) {                                   \
-        case SCM_DICT_GET:;                             \
-        case SCM_DICT_CREATE:;                          \
-            return e;                                   \
-        case SCM_DICT_DELETE:;                          \
-            return delete_entry(table, e, p, index);    \
-        }                                               \
+#define FOUND(table, op, buckets, e, p, index)                  \
+    do {                                                        \
+        switch (op) {                                           \
+        case SCM_DICT_GET:;                                     \
+        case SCM_DICT_CREATE:;                                  \
+            return e;                                           \
+        case SCM_DICT_DELETE:;                                  \
+            return delete_entry(table, buckets, e, p, index);   \
+        }                                                       \
     } while (0)
 
 #define NOTFOUND(table, op, key, hashval, index)                \
@@ -595,6 +660,32 @@ static Entry *delete_entry(ScmHashCore *table,
         }                                                       \
     } while (0)
 
+/* Common search loop for the chained layout.  MATCH is an expression
+   to check if Entry *e matches the key.  If an incremental rehash is
+   in progress and the old bucket for HASHVAL hasn't been moved, we
+   look into it before the new one. */
+#define CHAINED_SEARCH(table, op, key, hashval, match)                  \
+    do {                                                                \
+        Rehash *r_ = REHASH(table);                                     \
+        if (r_) {                                                       \
+            u_long j_ = HASH2INDEX(r_->numBuckets, r_->numBucketsLog2,  \
+                                   hashval);                            \
+            if ((int)j_ >= r_->index) {                                 \
+                for (Entry *e = r_->buckets[j_], *p = NULL; e;          \
+                     p = e, e = e->next) {                              \
+                    if (match) FOUND(table, op, r_->buckets, e, p, j_); \
+                }                                                       \
+            }                                                           \
+        }                                                               \
+        u_long i_ = HASH2INDEX((table)->numBuckets,                     \
+                               (table)->numBucketsLog2, hashval);       \
+        Entry **b_ = BUCKETS(table);                                    \
+        for (Entry *e = b_[i_], *p = NULL; e; p = e, e = e->next) {     \
+            if (match) FOUND(table, op, b_, e, p, i_);                  \
+        }                                                               \
+        NOTFOUND(table, op, key, hashval, i_);                          \
+    } while (0)
+
 /*
  * Accessor function for address.   Used for EQ-type hash.
  */
@@ -602,16 +693,9 @@ static Entry *address_access(ScmHashCore *table,
                              intptr_t key,
                              ScmDictOp op)
 {
-    u_long hashval, index;
-    Entry **buckets = (Entry**)table->buckets;
-
+    u_long hashval;
     ADDRESS_HASH(hashval, key);
-    index = HASH2INDEX(table->numBuckets, table->numBucketsLog2, hashval);
-
-    for (Entry *e = buckets[index], *p = NULL; e; p = e, e = e->next) {
-        if (e->key == key) FOUND(table, op, e, p, index);
-    }
-    NOTFOUND(table, op, key, hashval, index);
+    CHAINED_SEARCH(table, op, key, hashval, e->key == key);
 }
 
 static u_long address_hash(const ScmHashCore *ht SCM_UNUSED, intptr_t obj)
@@ -663,22 +747,14 @@ static Entry *string_access(ScmHashCore *table, intptr_t k, ScmDictOp op)
         Scm_Error("Got non-string key %S to the string hashtable.", key);
     }
     u_long hashval = Scm_HashString(SCM_STRING(key), 0);
-    u_long index = HASH2INDEX(table->numBuckets, table->numBucketsLog2, hashval);
-    Entry **buckets = (Entry**)table->buckets;
-
     const ScmStringBody *keyb = SCM_STRING_BODY(key);
     long size = SCM_STRING_BODY_SIZE(keyb);
-    for (Entry *e = buckets[index], *p = NULL; e; p = e, e = e->next) {
-        ScmObj ee = SCM_OBJ(e->key);
-        const ScmStringBody *eeb = SCM_STRING_BODY(ee);
-        int eesize = SCM_STRING_BODY_SIZE(eeb);
-        if (size == eesize
-            && memcmp(SCM_STRING_BODY_START(keyb),
-                      SCM_STRING_BODY_START(eeb), eesize) == 0){
-            FOUND(table, op, e, p, index);
-        }
-    }
-    NOTFOUND(table, op, k, hashval, index);
+    const char *start = SCM_STRING_BODY_START(keyb);
+    CHAINED_SEARCH(table, op, k, hashval,
+                   (size == SCM_STRING_BODY_SIZE(SCM_STRING_BODY(e->key))
+                    && memcmp(start,
+                              SCM_STRING_BODY_START(SCM_STRING_BODY(e->key)),
+                              size) == 0));
 }
 
 static u_long string_hash(const ScmHashCore *ht SCM_UNUSED, intptr_t key)
@@ -717,18 +793,13 @@ static u_long multiword_hash(const ScmHashCore *table, intptr_t key)
 #if 0
 static Entry *multiword_access(ScmHashCore *table, intptr_t k, ScmDictOp op)
 {
-    u_long hashval, index;
+    u_long hashval;
     ScmWord keysize = (ScmWord)table->data;
 
     hashval = multiword_hash(table, k);
-    index = HASH2INDEX(table->numBuckets, table->numBucketsLog2, hashval);
-    Entry **buckets = (Entry**)table->buckets;
-
-    for (Entry *e = buckets[index], *p = NULL; e; p = e, e = e->next) {
-        if (memcmp((void*)k, (void*)e->key, keysize*sizeof(ScmWord)) == 0)
-            FOUND(table, op, e, p, index);
-    }
-    NOTFOUND(table, op, k, hashval, index);
+    CHAINED_SEARCH(table, op, k, hashval,
+                   memcmp((void*)k, (void*)e->key,
+                          keysize*sizeof(ScmWord)) == 0);
 }
 #endif
 
@@ -739,16 +810,216 @@ static Entry *multiword_access(ScmHashCore *table, intptr_t k, ScmDictOp op)
  */
 static Entry *general_access(ScmHashCore *table, intptr_t key, ScmDictOp op)
 {
-    u_long hashval, index;
+    u_long hashval = table->hashfn(table, key);
+    CHAINED_SEARCH(table, op, key, hashval, table->cmpfn(table, key, e->key));
+}
+
+/*------------------------------------------------------------
+ * Open addressing layout
+ *
+ * If SCM_HASH_CORE_OPEN_ADDRESSING flag is set, we don't allocate
+ * Entry for each association.  Instead, table->buckets points to a
+ * single chunk that holds numBuckets of OAEntry, followed by numBuckets
+ * of control bytes.  A control byte is OA_EMPTY, OA_DELETED, or
+ * OA_LIVE_BIT combined with 7 bits taken from the entry's hash value,
+ * so that most of probe steps can reject a slot without touching
+ * the entry itself.
+ *
+ * We use linear probing.  A deleted slot becomes a tombstone, which
+ * keeps the key and the value until the slot is reused or the table
+ * is rehashed, for the caller of SCM_DICT_DELETE may look at them.
+ * The table is rehashed when the live entries plus tombstones exceed
+ * 3/4 of the slots, so there's always an empty slot to stop probing.
+ */
+
+/* The beginning of this structure must match ScmDictEntry. */
+typedef struct OAEntryRec {
+    intptr_t key;
+    intptr_t value;
+    u_long   hashval;
+} OAEntry;
+
+#define OA_EMPTY         0
+#define OA_DELETED       1
+#define OA_LIVE_BIT      0x80
+#define OA_TAG(hashval)  ((u_char)(OA_LIVE_BIT|(((hashval)>>16)&0x7f)))
+#define OA_LIVE_P(c)     ((c)&OA_LIVE_BIT)
+
+#define OA_ENTRIES(hc)   ((OAEntry*)(hc)->buckets)
+#define OA_CTRL(hc)      ((u_char*)(OA_ENTRIES(hc) + (hc)->numBuckets))
+
+#define OA_MAX_LOAD(nb)  (((nb)>>1) + ((nb)>>2))
+#define OA_EXTEND_BITS   1
+
+static void **oa_alloc(int nb)
+{
+    size_t size = nb*(sizeof(OAEntry)+1);
+    void **b = SCM_NEW2(void**, size);
+    memset(b, 0, size);
+    return b;
+}
+
+/* Put an entry in a slot known to be empty.  No check is done. */
+static OAEntry *oa_place(ScmHashCore *table, intptr_t key, u_long hashval)
+{
+    u_long mask = table->numBuckets - 1;
+    u_long i = HASH2INDEX(table->numBuckets, table->numBucketsLog2, hashval);
+    u_char *cs = OA_CTRL(table);
+    while (cs[i] != OA_EMPTY) i = (i+1) & mask;
+
+    OAEntry *e = &OA_ENTRIES(table)[i];
+    e->key = key;
+    e->value = 0;
+    e->hashval = hashval;
+    cs[i] = OA_TAG(hashval);
+    return e;
+}
+
+/* Reallocate slots and move live entries.  If most of the used slots
+   are tombstones, we just rebuild the table with the same size. */
+static void oa_rehash(ScmHashCore *table)
+{
+    int newsize = table->numBuckets;
+    int newbits = table->numBucketsLog2;
+    if (table->numEntries >= OA_MAX_LOAD(table->numBuckets)/2) {
+        newsize <<= OA_EXTEND_BITS;
+        newbits += OA_EXTEND_BITS;
+    }
+
+    ScmHashCore old = *table;
+    OAEntry *es = OA_ENTRIES(&old);
+    u_char *cs = OA_CTRL(&old);
+
+    table->buckets = oa_alloc(newsize);
+    table->numBuckets = newsize;
+    table->numBucketsLog2 = newbits;
+    table->numDeleted = 0;
+    for (int i=0; i<old.numBuckets; i++) {
+        if (OA_LIVE_P(cs[i])) {
+            OAEntry *e = oa_place(table, es[i].key, es[i].hashval);
+            e->value = es[i].value;
+        }
+    }
+}
+
+/* Called when the search fails with SCM_DICT_CREATE.  INDEX is the
+   first tombstone in the probe sequence, or the empty slot that
+   terminated the probing. */
+static Entry *oa_insert(ScmHashCore *table, intptr_t key, u_long hashval,
+                        u_long index)
+{
+    u_char *cs = OA_CTRL(table);
+    if (cs[index] == OA_DELETED) {
+        table->numDeleted--;
+    } else if (table->numEntries + table->numDeleted + 1
+               > OA_MAX_LOAD(table->numBuckets)) {
+        oa_rehash(table);
+        table->numEntries++;
+        return (Entry*)oa_place(table, key, hashval);
+    }
+    OAEntry *e = &OA_ENTRIES(table)[index];
+    e->key = key;
+    e->value = 0;
+    e->hashval = hashval;
+    cs[index] = OA_TAG(hashval);
+    table->numEntries++;
+    return (Entry*)e;
+}
+
+/* If the next slot is empty, no probe sequence goes through INDEX,
+   so we can make it empty instead of a tombstone. */
+static Entry *oa_delete(ScmHashCore *table, OAEntry *e, u_long index)
+{
+    u_char *cs = OA_CTRL(table);
+    if (cs[(index+1) & (table->numBuckets-1)] == OA_EMPTY) {
+        cs[index] = OA_EMPTY;
+    } else {
+        cs[index] = OA_DELETED;
+        table->numDeleted++;
+    }
+    table->numEntries--;
+    SCM_ASSERT(table->numEntries >= 0);
+    return (Entry*)e;
+}
+
+/* Common probing loop.  MATCH is an expression to check if the
+   OAEntry *e matches the key. */
+#define OA_SEARCH(table, op, key, hashval, match)                       \
+    do {                                                                \
+        u_long mask_ = (table)->numBuckets - 1;                         \
+        u_long i_ = HASH2INDEX((table)->numBuckets,                     \
+                               (table)->numBucketsLog2, hashval);       \
+        u_char tag_ = OA_TAG(hashval);                                  \
+        u_char *cs_ = OA_CTRL(table);                                   \
+        long free_ = -1;                                                \
+        for (;; i_ = (i_+1) & mask_) {                                  \
+            u_char c_ = cs_[i_];                                        \
+            if (c_ == tag_) {                                           \
+                OAEntry *e = &OA_ENTRIES(table)[i_];                    \
+                if (match) {                                            \
+                    if (op == SCM_DICT_DELETE) {                        \
+                        return oa_delete(table, e, i_);                 \
+                    }                                                   \
+                    return (Entry*)e;                                   \
+                }                                                       \
+            } else if (c_ == OA_EMPTY) {                                \
+                break;                                                  \
+            } else if (c_ == OA_DELETED && free_ < 0) {                 \
+                free_ = (long)i_;                                       \
+            }                                                           \
+        }                                                               \
+        if (op == SCM_DICT_CREATE) {                                    \
+            return oa_insert(table, key, hashval,                       \
+                             (free_ >= 0) ? (u_long)free_ : i_);        \
+        }                                                               \
+        return NULL;                                                    \
+    } while (0)
+
+static Entry *oa_address_access(ScmHashCore *table,
+                                intptr_t key,
+                                ScmDictOp op)
+{
+    u_long hashval;
+    ADDRESS_HASH(hashval, key);
+    OA_SEARCH(table, op, key, hashval, e->key == key);
+}
 
-    hashval = table->hashfn(table, key);
-    index = HASH2INDEX(table->numBuckets, table->numBucketsLog2, hashval);
-    Entry **buckets = (Entry**)table->buckets;
+static Entry *oa_string_access(ScmHashCore *table, intptr_t k, ScmDictOp op)
+{
+    ScmObj key = SCM_OBJ(k);
 
-    for (Entry *e = buckets[index], *p = NULL; e; p = e, e = e->next) {
-        if (table->cmpfn(table, key, e->key)) FOUND(table, op, e, p, index);
+    if (!SCM_STRINGP(key)) {
+        Scm_Error("Got non-string key %S to the string hashtable.", key);
     }
-    NOTFOUND(table, op, key, hashval, index);
+    u_long hashval = Scm_HashString(SCM_STRING(key), 0);
+    const ScmStringBody *keyb = SCM_STRING_BODY(key);
+    long size = SCM_STRING_BODY_SIZE(keyb);
+    const char *start = SCM_STRING_BODY_START(keyb);
+    OA_SEARCH(table, op, k, hashval,
+              (e->hashval == hashval
+               && size == SCM_STRING_BODY_SIZE(SCM_STRING_BODY(e->key))
+               && memcmp(start,
+                         SCM_STRING_BODY_START(SCM_STRING_BODY(e->key)),
+                         size) == 0));
+}
+
+static Entry *oa_general_access(ScmHashCore *table, intptr_t key,
+                                ScmDictOp op)
+{
+    u_long hashval = table->hashfn(table, key);
+    OA_SEARCH(table, op, key, hashval,
+              (e->hashval == hashval && table->cmpfn(table, key, e->key)));
+}
+
+/* Returns the open-addressing version of the accessor. */
+static SearchProc *oa_accessor(SearchProc *accessfn)
+{
+    if (accessfn == address_access) return oa_address_access;
+    if (accessfn == string_access)  return oa_string_access;
+    if (accessfn == general_access) return oa_general_access;
+    Scm_Panic("[internal] hash core accessor doesn't support "
+              "open addressing");
+    return NULL;                /* dummy */
 }
 
 /*============================================================
@@ -760,24 +1031,42 @@ static void hash_core_init(ScmHashCore *table,
                            ScmHashProc *hashfn,
                            ScmHashCompareProc *cmpfn,
                            unsigned int initSize,
+                           u_long flags,
                            void *data)
 {
-    if (initSize != 0) initSize = round2up(initSize);
-    else initSize = DEFAULT_NUM_BUCKETS;
+    if ((flags & SCM_HASH_CORE_OPEN_ADDRESSING)
+        && (flags & SCM_HASH_CORE_INCREMENTAL_REHASH)) {
+        Scm_Error("Incremental rehash isn't supported for open-addressing "
+                  "hash tables.");
+    }
+    if (flags & SCM_HASH_CORE_OPEN_ADDRESSING) {
+        /* For open addressing, we take initSize as the expected number
+           of entries, and make enough room to hold them. */
+        if (initSize != 0) initSize = round2up(initSize + initSize/3 + 1);
+        else initSize = DEFAULT_NUM_BUCKETS;
+        table->buckets = oa_alloc(initSize);
+        accessfn = oa_accessor(accessfn);
+    } else {
+        if (initSize != 0) initSize = round2up(initSize);
+        else initSize = DEFAULT_NUM_BUCKETS;
 
-    Entry **b = SCM_NEW_ARRAY(Entry*, initSize);
-    table->buckets = (void**)b;
+        Entry **b = SCM_NEW_ARRAY(Entry*, initSize);
+        table->buckets = (void**)b;
+        for (u_int i=0; i<initSize; i++) table->buckets[i] = NULL;
+    }
     table->numBuckets = initSize;
     table->numEntries = 0;
+    table->numDeleted = 0;
+    table->rehash = NULL;
     table->accessfn = (void*)accessfn;
     table->hashfn = hashfn;
     table->cmpfn = cmpfn;
     table->data = data;
+    table->flags = flags;
     table->numBucketsLog2 = 0;
     for (u_int i=initSize; i > 1; i /= 2) {
         table->numBucketsLog2++;
     }
-    for (u_int i=0; i<initSize; i++) table->buckets[i] = NULL;
 }
 
 /* choose appropriate procedures for predefined hash types. */
@@ -813,10 +1102,11 @@ int  hash_core_predef_procs(ScmHashType type,
     }
 }
 
-void Scm_HashCoreInitSimple(ScmHashCore *core,
-                            ScmHashType type,
-                            unsigned int initSize,
-                            void *data)
+void Scm_HashCoreInitSimpleWithFlags(ScmHashCore *core,
+                                     ScmHashType type,
+                                     unsigned int initSize,
+                                     u_long flags,
+                                     void *data)
 {
     SearchProc  *accessfn = NULL;
     ScmHashProc *hashfn = NULL;
@@ -825,7 +1115,26 @@ void Scm_HashCoreInitSimple(ScmHashCore *core,
     if (hash_core_predef_procs(type, &accessfn, &hashfn, &cmpfn) == FALSE) {
         Scm_Error("[internal error]: wrong TYPE argument passed to Scm_HashCoreInitSimple: %d", type);
     }
-    hash_core_init(core, accessfn, hashfn, cmpfn, initSize, data);
+    hash_core_init(core, accessfn, hashfn, cmpfn, initSize, flags, data);
+}
+
+void Scm_HashCoreInitSimple(ScmHashCore *core,
+                            ScmHashType type,
+                            unsigned int initSize,
+                            void *data)
+{
+    Scm_HashCoreInitSimpleWithFlags(core, type, initSize, 0, data);
+}
+
+void Scm_HashCoreInitGeneralWithFlags(ScmHashCore *core,
+                                      ScmHashProc *hashfn,
+                                      ScmHashCompareProc *cmpfn,
+                                      unsigned int initSize,
+                                      u_long flags,
+                                      void *data)
+{
+    hash_core_init(core, general_access, hashfn,
+                   cmpfn, initSize, flags, data);
 }
 
 void Scm_HashCoreInitGeneral(ScmHashCore *core,
@@ -834,8 +1143,7 @@ void Scm_HashCoreInitGeneral(ScmHashCore *core,
                              unsigned int initSize,
                              void *data)
 {
-    hash_core_init(core, general_access, hashfn,
-                   cmpfn, initSize, data);
+    Scm_HashCoreInitGeneralWithFlags(core, hashfn, cmpfn, initSize, 0, data);
 }
 
 int Scm_HashCoreTypeToProcs(ScmHashType type,
@@ -848,22 +1156,47 @@ int Scm_HashCoreTypeToProcs(ScmHashType type,
 
 void Scm_HashCoreCopy(ScmHashCore *dst, const ScmHashCore *src)
 {
-    Entry **b = SCM_NEW_ARRAY(Entry*, src->numBuckets);
-
-    for (int i=0; i<src->numBuckets; i++) {
-        Entry *p = NULL;
-        Entry *s = (Entry*)src->buckets[i];
-        b[i] = NULL;
-        while (s) {
-            Entry *e = SCM_NEW(Entry);
-            e->key = s->key;
-            e->value = s->value;
-            e->next = NULL;
-            e->hashval = s->hashval;
-            if (p) p->next = e;
-            else   b[i] = e;
-            p = e;
-            s = s->next;
+    void **b;
+
+    if (SCM_HASH_CORE_OPEN_ADDRESSING_P(src)) {
+        b = oa_alloc(src->numBuckets);
+        memcpy(b, src->buckets, src->numBuckets*(sizeof(OAEntry)+1));
+    } else {
+        b = SCM_NEW_ARRAY(void*, src->numBuckets);
+        for (int i=0; i<src->numBuckets; i++) {
+            Entry *p = NULL;
+            Entry *s = (Entry*)src->buckets[i];
+            b[i] = NULL;
+            while (s) {
+                Entry *e = SCM_NEW(Entry);
+                e->key = s->key;
+                e->value = s->value;
+                e->next = NULL;
+                e->hashval = s->hashval;
+                if (p) p->next = e;
+                else   b[i] = e;
+                p = e;
+                s = s->next;
+            }
+        }
+        /* If SRC is in the middle of incremental rehashing, the copy
+           gets the entries in the unmoved old buckets directly in its
+           buckets, so the copy doesn't need to finish rehashing. */
+        Rehash *r = REHASH(src);
+        if (r) {
+            for (int i=r->index; i<r->numBuckets; i++) {
+                for (Entry *s = r->buckets[i]; s; s = s->next) {
+                    u_long index = HASH2INDEX(src->numBuckets,
+                                              src->numBucketsLog2,
+                                              s->hashval);
+                    Entry *e = SCM_NEW(Entry);
+                    e->key = s->key;
+                    e->value = s->value;
+                    e->next = (Entry*)b[index];
+                    e->hashval = s->hashval;
+                    b[index] = e;
+                }
+            }
         }
     }
 
@@ -875,6 +1208,9 @@ void Scm_HashCoreCopy(ScmHashCore *dst, const ScmHashCore *src)
     dst->cmpfn    = src->cmpfn;
     dst->accessfn = src->accessfn;
     dst->data     = src->data;
+    dst->flags    = src->flags;
+    dst->rehash   = NULL;
+    dst->numDeleted = src->numDeleted;
     dst->numEntries = src->numEntries;
     dst->numBucketsLog2 = src->numBucketsLog2;
     dst->numBuckets = src->numBuckets;
@@ -882,8 +1218,18 @@ void Scm_HashCoreCopy(ScmHashCore *dst, const ScmHashCore *src)
 
 void Scm_HashCoreClear(ScmHashCore *table)
 {
-    for (int i=0; i<table->numBuckets; i++) {
-        table->buckets[i] = NULL;
+    if (SCM_HASH_CORE_OPEN_ADDRESSING_P(table)) {
+        memset(table->buckets, 0, table->numBuckets*(sizeof(OAEntry)+1));
+        table->numDeleted = 0;
+    } else {
+        for (int i=0; i<table->numBuckets; i++) {
+            table->buckets[i] = NULL;
+        }
+        Rehash *r = REHASH(table);
+        if (r) {
+            for (int i=r->index; i<r->numBuckets; i++) r->buckets[i] = NULL;
+            table->rehash = NULL;
+        }
     }
     table->numEntries = 0;
 }
@@ -904,35 +1250,88 @@ int Scm_HashCoreNumEntries(ScmHashCore *table)
  * NB: It is important to keep the pointer to the "next" entry,
  * not the "current", since the current entry may be deleted,
  * erasing its next pointer.
+ *
+ * While incremental rehashing is in progress, iter->bucket runs over
+ * the new buckets first, then the old buckets that haven't been moved.
+ *
+ * For open addressing, iter->bucket is the index of the slot we start
+ * scanning at the next call, and iter->next isn't used.  A deleted
+ * slot is just skipped, so it is safe to delete entries during iteration.
  */
+
+/* Find the first non-empty bucket at or after index I.  Returns -1
+   if there's none. */
+static int iter_find_bucket(ScmHashCore *table, int i, Entry **head)
+{
+    for (; i < table->numBuckets; i++) {
+        if (table->buckets[i]) {
+            *head = BUCKETS(table)[i];
+            return i;
+        }
+    }
+    Rehash *r = REHASH(table);
+    if (r) {
+        int j = i - table->numBuckets;
+        if (j < r->index) j = r->index;
+        for (; j < r->numBuckets; j++) {
+            if (r->buckets[j]) {
+                *head = r->buckets[j];
+                return j + table->numBuckets;
+            }
+        }
+    }
+    return -1;
+}
+
 void Scm_HashIterInit(ScmHashIter *iter, ScmHashCore *table)
 {
     iter->core = table;
-    for (int i=0; i<table->numBuckets; i++) {
-        if (table->buckets[i]) {
-            iter->bucket = i;
-            iter->next = table->buckets[i];
-            return;
+    if (SCM_HASH_CORE_OPEN_ADDRESSING_P(table)) {
+        iter->bucket = 0;
+        iter->next = NULL;
+        return;
+    }
+    Entry *head;
+    int i = iter_find_bucket(table, 0, &head);
+    if (i >= 0) {
+        iter->bucket = i;
+        iter->next = head;
+    } else {
+        iter->next = NULL;
+    }
+}
+
+static ScmDictEntry *oa_iter_next(ScmHashIter *iter)
+{
+    ScmHashCore *table = iter->core;
+    u_char *cs = OA_CTRL(table);
+    for (int i = iter->bucket; i < table->numBuckets; i++) {
+        if (OA_LIVE_P(cs[i])) {
+            iter->bucket = i+1;
+            return (ScmDictEntry*)&OA_ENTRIES(table)[i];
         }
     }
-    iter->next = NULL;
+    iter->bucket = table->numBuckets;
+    return NULL;
 }
 
 ScmDictEntry *Scm_HashIterNext(ScmHashIter *iter)
 {
+    if (SCM_HASH_CORE_OPEN_ADDRESSING_P(iter->core)) {
+        return oa_iter_next(iter);
+    }
     Entry *e = (Entry*)iter->next;
     if (e != NULL) {
         if (e->next) iter->next = e->next;
         else {
-            int i = iter->bucket + 1;
-            for (; i < iter->core->numBuckets; i++) {
-                if (iter->core->buckets[i]) {
-                    iter->bucket = i;
-                    iter->next = iter->core->buckets[i];
-                    return (ScmDictEntry*)e;
-                }
+            Entry *head;
+            int i = iter_find_bucket(iter->core, iter->bucket + 1, &head);
+            if (i >= 0) {
+                iter->bucket = i;
+                iter->next = head;
+            } else {
+                iter->next = NULL;
             }
-            iter->next = NULL;
         }
     }
     return (ScmDictEntry*)e;
@@ -948,7 +1347,9 @@ SCM_DEFINE_BUILTIN_CLASS(Scm_HashTableClass, hash_print, Scm_ObjectCompare,
                          NULL, NULL,
                          SCM_CLASS_DICTIONARY_CPL);
 
-ScmObj Scm_MakeHashTableSimple(ScmHashType type, unsigned int initSize)
+ScmObj Scm_MakeHashTableSimpleWithFlags(ScmHashType type,
+                                        unsigned int initSize,
+                                        u_long flags)
 {
     /* We only allow ScmObj in <hash-table> */
     if (type > SCM_HASH_GENERAL) {
@@ -956,22 +1357,37 @@ ScmObj Scm_MakeHashTableSimple(ScmHashType type, unsigned int initSize)
     }
     ScmHashTable *z = SCM_NEW(ScmHashTable);
     SCM_SET_CLASS(z, SCM_CLASS_HASH_TABLE);
-    Scm_HashCoreInitSimple(&z->core, type, initSize, NULL);
+    Scm_HashCoreInitSimpleWithFlags(&z->core, type, initSize, flags, NULL);
     z->type = type;
     return SCM_OBJ(z);
 }
 
-ScmObj Scm_MakeHashTableFull(ScmHashProc hashfn,
-                             ScmHashCompareProc cmpfn,
-                             unsigned int initSize, void *data)
+ScmObj Scm_MakeHashTableSimple(ScmHashType type, unsigned int initSize)
+{
+    return Scm_MakeHashTableSimpleWithFlags(type, initSize, 0);
+}
+
+ScmObj Scm_MakeHashTableFullWithFlags(ScmHashProc hashfn,
+                                      ScmHashCompareProc cmpfn,
+                                      unsigned int initSize,
+                                      u_long flags,
+                                      void *data)
 {
     ScmHashTable *z = SCM_NEW(ScmHashTable);
     SCM_SET_CLASS(z, SCM_CLASS_HASH_TABLE);
     z->type = SCM_HASH_GENERAL;
-    Scm_HashCoreInitGeneral(&z->core, hashfn, cmpfn, initSize, data);
+    Scm_HashCoreInitGeneralWithFlags(&z->core, hashfn, cmpfn, initSize,
+                                     flags, data);
     return SCM_OBJ(z);
 }
 
+ScmObj Scm_MakeHashTableFull(ScmHashProc hashfn,
+                             ScmHashCompareProc cmpfn,
+                             unsigned int initSize, void *data)
+{
+    return Scm_MakeHashTableFullWithFlags(hashfn, cmpfn, initSize, 0, data);
+}
+
 ScmObj Scm_HashTableCopy(ScmHashTable *src)
 {
     ScmHashTable *dst = SCM_NEW(ScmHashTable);
@@ -1053,14 +1469,49 @@ ScmObj Scm_HashTableStat(ScmHashTable *table)
     SCM_APPEND1(h, t, Scm_MakeInteger(c->numBuckets));
     SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("num-buckets-log2"));
     SCM_APPEND1(h, t, Scm_MakeInteger(c->numBucketsLog2));
+    SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("layout"));
+    SCM_APPEND1(h, t, (SCM_HASH_CORE_OPEN_ADDRESSING_P(c)
+                       ? SCM_INTERN("open-addressing")
+                       : ((c->flags & SCM_HASH_CORE_INCREMENTAL_REHASH)
+                          ? SCM_INTERN("incremental")
+                          : SCM_INTERN("chained"))));
 
-    Entry** b = BUCKETS(c);
     ScmVector *v = SCM_VECTOR(Scm_MakeVector(c->numBuckets, SCM_NIL));
     ScmObj *vp = SCM_VECTOR_ELEMENTS(v);
-    for (int i = 0; i<c->numBuckets; i++, vp++) {
-        Entry *e = b[i];
-        for (; e; e = e->next) {
-            *vp = Scm_Acons(SCM_DICT_KEY(e), SCM_DICT_VALUE(e), *vp);
+    if (SCM_HASH_CORE_OPEN_ADDRESSING_P(c)) {
+        /* Each slot becomes an alist of at most one entry. */
+        OAEntry *es = OA_ENTRIES(c);
+        u_char *cs = OA_CTRL(c);
+        SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("num-deleted"));
+        SCM_APPEND1(h, t, Scm_MakeInteger(c->numDeleted));
+        for (int i = 0; i<c->numBuckets; i++, vp++) {
+            if (OA_LIVE_P(cs[i])) {
+                *vp = Scm_Acons(SCM_DICT_KEY(&es[i]), SCM_DICT_VALUE(&es[i]),
+                                SCM_NIL);
+            }
+        }
+    } else {
+        Entry** b = BUCKETS(c);
+        for (int i = 0; i<c->numBuckets; i++, vp++) {
+            Entry *e = b[i];
+            for (; e; e = e->next) {
+                *vp = Scm_Acons(SCM_DICT_KEY(e), SCM_DICT_VALUE(e), *vp);
+            }
+        }
+        /* Entries not moved yet are shown in the buckets they'll go. */
+        Rehash *r = REHASH(c);
+        SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("rehash-remaining"));
+        SCM_APPEND1(h, t, Scm_MakeInteger(r ? r->numBuckets - r->index : 0));
+        if (r) {
+            vp = SCM_VECTOR_ELEMENTS(v);
+            for (int i = r->index; i<r->numBuckets; i++) {
+                for (Entry *e = r->buckets[i]; e; e = e->next) {
+                    u_long k = HASH2INDEX(c->numBuckets, c->numBucketsLog2,
+                                          e->hashval);
+                    vp[k] = Scm_Acons(SCM_DICT_KEY(e), SCM_DICT_VALUE(e),
+                                      vp[k]);
+                }
+            }
         }
     }
     SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("contents"));
@@ -1118,6 +1569,400 @@ static unsigned int round2up(unsigned int val)
     return n;
 }
 
+/*====================================================================
+ * Concurrent hash table
+ */
+
+/*
+ * The slot table is an open-addressing array of pointers to ConcEntry,
+ * probed linearly.  A slot is only filled once; it goes from NULL to
+ * an entry by CAS and never goes back.  Deleting an entry just sets its
+ * value to SCM_UNBOUND, leaving the entry as a tombstone which can be
+ * revived by a later insertion of the same key.  Since the probe sequence
+ * of a key only grows, two threads inserting the same key can't create
+ * two entries---the one that loses the race on a slot sees the winner's
+ * entry in it.
+ *
+ * When the table gets full, a new table is built while holding ct->mutex.
+ * The builder first seals the old table: empty slots are set to
+ * CONC_SEALED, and tombstones get CONC_DEAD as their value, both by CAS.
+ * The remaining entries are shared by the new table, so updates to them
+ * through the old table are still valid.  A writer that sees CONC_SEALED
+ * or CONC_DEAD waits for the builder and retries with the new table.
+ * Readers never wait; they treat them as empty.
+ */
+
+typedef struct ConcEntryRec {
+    intptr_t key;
+    ScmAtomicVar value;
+    u_long hashval;
+} ConcEntry;
+
+typedef struct ConcTableRec {
+    int numSlots;               /* power of 2 */
+    int numSlotsLog2;
+    ScmAtomicVar numUsed;       /* # of filled slots */
+    ScmAtomicVar slots[1];      /* ConcEntry*, NULL or CONC_SEALED */
+} ConcTable;
+
+static ScmWord conc_sealed_marker;
+static ScmWord conc_dead_marker;
+static ScmWord conc_moved_marker;
+
+#define CONC_SEALED     ((ConcEntry*)&conc_sealed_marker)
+#define CONC_DEAD       ((ScmAtomicWord)&conc_dead_marker)
+#define CONC_MOVED      ((ConcEntry*)&conc_moved_marker) /* returned by
+                                                            conc_search */
+#define CONC_MIN_SLOTS  16
+#define CONC_FULL_P(tab) \
+    (AO_load(&(tab)->numUsed) > (ScmAtomicWord)((tab)->numSlots/4*3))
+
+#define CONC_TABLE(ct) \
+    ((ConcTable*)AO_load((ScmAtomicVar*)&(ct)->table))
+
+static ConcTable *conc_table_new(int numSlots)
+{
+    ConcTable *tab = SCM_NEW2(ConcTable*, sizeof(ConcTable)
+                              + sizeof(ScmAtomicWord)*(numSlots-1));
+    tab->numSlots = numSlots;
+    tab->numSlotsLog2 = 0;
+    while ((1<<tab->numSlotsLog2) < numSlots) tab->numSlotsLog2++;
+    return tab;
+}
+
+static void conc_count_add(ScmAtomicVar *loc, long delta)
+{
+    for (;;) {
+        ScmAtomicWord n = AO_load(loc);
+        if (AO_compare_and_swap_full(loc, n, n+delta)) break;
+    }
+}
+
+static u_long conc_hash(ScmConcurrentHashTable *ct, ScmObj key)
+{
+    if (ct->type == SCM_HASH_STRING && !SCM_STRINGP(key)) {
+        Scm_Error("Got non-string key %S to the string hashtable.", key);
+    }
+    return ct->procs.hashfn(&ct->procs, (intptr_t)key);
+}
+
+/* Returns the entry of KEY in TAB, or NULL if there's none.  If CREATE
+   is true, a new entry with SCM_UNBOUND value is put in the first empty
+   slot instead of returning NULL.  Returns CONC_MOVED if we can't create
+   an entry since TAB is full or being replaced. */
+static ConcEntry *conc_search(ScmConcurrentHashTable *ct, ConcTable *tab,
+                              intptr_t key, u_long hashval, int create)
+{
+    u_long mask = tab->numSlots - 1;
+    u_long i = HASH2INDEX(tab->numSlots, tab->numSlotsLog2, hashval);
+    ConcEntry *ne = NULL;
+
+    for (int n = 0; n < tab->numSlots; n++, i = (i+1) & mask) {
+        ScmAtomicVar *loc = &tab->slots[i];
+        ConcEntry *e = (ConcEntry*)AO_load(loc);
+        if (e == NULL) {
+            if (!create) return NULL;
+            if (ne == NULL) {
+                ne = SCM_NEW(ConcEntry);
+                ne->key = key;
+                ne->value = (ScmAtomicWord)SCM_UNBOUND;
+                ne->hashval = hashval;
+            }
+            ScmAtomicWord expected = 0;
+            if (AO_compare_and_swap_full(loc, expected, (ScmAtomicWord)ne)) {
+                conc_count_add(&tab->numUsed, 1);
+                return ne;
+            }
+            /* Somebody else has filled this slot.  Check it. */
+            e = (ConcEntry*)AO_load(loc);
+        }
+        if (e == CONC_SEALED) break;
+        if (e->hashval == hashval
+            && (e->key == key
+                || (ct->type != SCM_HASH_EQ
+                    && ct->procs.cmpfn(&ct->procs, key, e->key)))) {
+            return e;
+        }
+    }
+    return create? CONC_MOVED : NULL;
+}
+
+/* Seal TAB and publish a new table.  If CLEAR is true, all entries are
+   discarded.  Must be called while holding ct->mutex. */
+static void conc_rebuild(ScmConcurrentHashTable *ct, ConcTable *tab,
+                         int clear)
+{
+    int live = 0;
+
+    for (int i = 0; i < tab->numSlots; i++) {
+        ScmAtomicVar *loc = &tab->slots[i];
+        ScmAtomicWord expected = 0;
+        if (AO_compare_and_swap_full(loc, expected,
+                                     (ScmAtomicWord)CONC_SEALED)) {
+            continue;
+        }
+        ConcEntry *e = (ConcEntry*)AO_load(loc);
+        for (;;) {
+            ScmAtomicWord v = AO_load(&e->value);
+            if (!clear && v != (ScmAtomicWord)SCM_UNBOUND) {
+                live++;
+                break;
+            }
+            if (AO_compare_and_swap_full(&e->value, v, CONC_DEAD)) {
+                if (v != (ScmAtomicWord)SCM_UNBOUND) {
+                    conc_count_add((ScmAtomicVar*)&ct->numEntries, -1);
+                }
+                break;
+            }
+        }
+    }
+
+    /* Now no entry can be added to TAB, nor any entry can be revived.
+       The set of live entries is fixed. */
+    int size = CONC_MIN_SLOTS;
+    while (size < (live+1)*2) size <<= 1;
+    ConcTable *ntab = conc_table_new(size);
+    if (!clear) {
+        u_long mask = size - 1;
+        for (int i = 0; i < tab->numSlots; i++) {
+            ConcEntry *e = (ConcEntry*)AO_load(&tab->slots[i]);
+            if (e == CONC_SEALED || AO_load(&e->value) == CONC_DEAD) continue;
+            u_long j = HASH2INDEX(ntab->numSlots, ntab->numSlotsLog2,
+                                  e->hashval);
+            while (ntab->slots[j]) j = (j+1) & mask;
+            ntab->slots[j] = (ScmAtomicWord)e;
+            ntab->numUsed++;
+        }
+    }
+    AO_store_full((ScmAtomicVar*)&ct->table, (ScmAtomicWord)ntab);
+}
+
+/* Replace TAB with a new table, unless somebody has already done so.
+   If another thread is rebuilding the table, we just wait for it. */
+static void conc_extend(ScmConcurrentHashTable *ct, ConcTable *tab)
+{
+    SCM_INTERNAL_MUTEX_LOCK(ct->mutex);
+    if (CONC_TABLE(ct) == tab) conc_rebuild(ct, tab, FALSE);
+    SCM_INTERNAL_MUTEX_UNLOCK(ct->mutex);
+}
+
+enum {
+    CONC_IF_ANY,                /* always modify */
+    CONC_IF_ABSENT,             /* modify if there's no value */
+    CONC_IF_PRESENT,            /* modify if there's a value */
+    CONC_IF_EQ                  /* modify if the value is eq? to expected */
+};
+
+/* Common routine of modifiers.  Changes the value of KEY to NEWVAL
+   (SCM_UNBOUND to delete) if COND is satisfied.  Returns TRUE if the
+   condition is satisfied.  The value before the operation is stored
+   in *OLDVAL (SCM_UNBOUND if there was none). */
+static int conc_modify(ScmConcurrentHashTable *ct, ScmObj key,
+                       ScmObj newval, int cond, ScmObj expected,
+                       ScmObj *oldval)
+{
+    u_long hashval = conc_hash(ct, key);
+    int create = (!SCM_UNBOUNDP(newval)
+                  && cond != CONC_IF_PRESENT
+                  && !(cond == CONC_IF_EQ && !SCM_UNBOUNDP(expected)));
+
+    for (;;) {
+        ConcTable *tab = CONC_TABLE(ct);
+        ConcEntry *e = conc_search(ct, tab, (intptr_t)key, hashval, create);
+        if (e == CONC_MOVED) {
+            conc_extend(ct, tab);
+            continue;
+        }
+        if (e == NULL) {
+            *oldval = SCM_UNBOUND;
+            return (cond != CONC_IF_PRESENT
+                    && !(cond == CONC_IF_EQ && !SCM_UNBOUNDP(expected)));
+        }
+
+        ScmAtomicWord cur;
+        while ((cur = AO_load(&e->value)) != CONC_DEAD) {
+            ScmObj curval = SCM_OBJ(cur);
+            int ok = FALSE;
+            switch (cond) {
+            case CONC_IF_ANY:     ok = TRUE; break;
+            case CONC_IF_ABSENT:  ok = SCM_UNBOUNDP(curval); break;
+            case CONC_IF_PRESENT: ok = !SCM_UNBOUNDP(curval); break;
+            case CONC_IF_EQ:      ok = SCM_EQ(curval, expected); break;
+            }
+            *oldval = curval;
+            if (!ok) return FALSE;
+            if (AO_compare_and_swap_full(&e->value, cur,
+                                         (ScmAtomicWord)newval)) {
+                if (SCM_UNBOUNDP(curval) && !SCM_UNBOUNDP(newval)) {
+                    conc_count_add((ScmAtomicVar*)&ct->numEntries, 1);
+                } else if (!SCM_UNBOUNDP(curval) && SCM_UNBOUNDP(newval)) {
+                    conc_count_add((ScmAtomicVar*)&ct->numEntries, -1);
+                }
+                if (create && CONC_FULL_P(tab)) conc_extend(ct, tab);
+                return TRUE;
+            }
+        }
+        /* The entry has been dropped from the table being replaced.
+           Wait for the new table and retry. */
+        conc_extend(ct, tab);
+    }
+}
+
+static void conc_print(ScmObj obj, ScmPort *port,
+                       ScmWriteContext *ctx SCM_UNUSED)
+{
+    Scm_Printf(port, "#<concurrent-hash-table %p>", obj);
+}
+
+SCM_DEFINE_BUILTIN_CLASS(Scm_ConcurrentHashTableClass, conc_print,
+                         Scm_ObjectCompare, NULL, NULL,
+                         SCM_CLASS_DICTIONARY_CPL);
+
+static ScmObj conc_make(ScmHashType type, ScmHashProc *hashfn,
+                        ScmHashCompareProc *cmpfn, unsigned int initSize,
+                        void *data)
+{
+    ScmConcurrentHashTable *z = SCM_NEW(ScmConcurrentHashTable);
+    SCM_SET_CLASS(z, SCM_CLASS_CONCURRENT_HASH_TABLE);
+    z->type = type;
+    z->procs.hashfn = hashfn;
+    z->procs.cmpfn = cmpfn;
+    z->procs.data = data;
+    int size = CONC_MIN_SLOTS;
+    while (size/4*3 < (int)initSize && size < (1<<30)) size <<= 1;
+    z->table = conc_table_new(size);
+    z->numEntries = 0;
+    SCM_INTERNAL_MUTEX_INIT(z->mutex);
+    return SCM_OBJ(z);
+}
+
+ScmObj Scm_MakeConcurrentHashTableSimple(ScmHashType type,
+                                         unsigned int initSize)
+{
+    ScmHashProc *hashfn = NULL;
+    ScmHashCompareProc *cmpfn = NULL;
+
+    if (type >= SCM_HASH_GENERAL
+        || !Scm_HashCoreTypeToProcs(type, &hashfn, &cmpfn)) {
+        Scm_Error("Scm_MakeConcurrentHashTableSimple: wrong type arg: %d",
+                  type);
+    }
+    return conc_make(type, hashfn, cmpfn, initSize, NULL);
+}
+
+ScmObj Scm_MakeConcurrentHashTableFull(ScmHashProc *hashfn,
+                                       ScmHashCompareProc *cmpfn,
+                                       unsigned int initSize,
+                                       void *data)
+{
+    return conc_make(SCM_HASH_GENERAL, hashfn, cmpfn, initSize, data);
+}
+
+ScmObj Scm_ConcurrentHashTableRef(ScmConcurrentHashTable *ct,
+                                  ScmObj key, ScmObj fallback)
+{
+    u_long hashval = conc_hash(ct, key);
+    ConcEntry *e = conc_search(ct, CONC_TABLE(ct), (intptr_t)key, hashval,
+                               FALSE);
+    if (e) {
+        ScmAtomicWord v = AO_load(&e->value);
+        if (v != CONC_DEAD && !SCM_UNBOUNDP(SCM_OBJ(v))) return SCM_OBJ(v);
+    }
+    return fallback;
+}
+
+/* Same as Scm_HashTableSet */
+ScmObj Scm_ConcurrentHashTableSet(ScmConcurrentHashTable *ct,
+                                  ScmObj key, ScmObj value, int flags)
+{
+    ScmObj oldval;
+    int cond = CONC_IF_ANY;
+
+    if (SCM_UNBOUNDP(value)) {
+        Scm_Error("[internal] attempt to set unbound value to a concurrent hash table.");
+    }
+    if (flags & SCM_DICT_NO_OVERWRITE) cond = CONC_IF_ABSENT;
+    else if (flags & SCM_DICT_NO_CREATE) cond = CONC_IF_PRESENT;
+    if (conc_modify(ct, key, value, cond, SCM_UNBOUND, &oldval)) {
+        return value;
+    }
+    return oldval;
+}
+
+ScmObj Scm_ConcurrentHashTableDelete(ScmConcurrentHashTable *ct, ScmObj key)
+{
+    ScmObj oldval;
+    conc_modify(ct, key, SCM_UNBOUND, CONC_IF_ANY, SCM_UNBOUND, &oldval);
+    return oldval;
+}
+
+int Scm_ConcurrentHashTableCompareAndSwap(ScmConcurrentHashTable *ct,
+                                          ScmObj key,
+                                          ScmObj expected,
+                                          ScmObj newval)
+{
+    ScmObj oldval;
+    return conc_modify(ct, key, newval, CONC_IF_EQ, expected, &oldval);
+}
+
+int Scm_ConcurrentHashTableNumEntries(ScmConcurrentHashTable *ct)
+{
+    return (int)AO_load((ScmAtomicVar*)&ct->numEntries);
+}
+
+void Scm_ConcurrentHashTableClear(ScmConcurrentHashTable *ct)
+{
+    SCM_INTERNAL_MUTEX_LOCK(ct->mutex);
+    conc_rebuild(ct, CONC_TABLE(ct), TRUE);
+    SCM_INTERNAL_MUTEX_UNLOCK(ct->mutex);
+}
+
+void Scm_ConcurrentHashIterInit(ScmConcurrentHashIter *iter,
+                                ScmConcurrentHashTable *ct)
+{
+    iter->ct = ct;
+    iter->table = CONC_TABLE(ct);
+    iter->index = 0;
+}
+
+int Scm_ConcurrentHashIterNext(ScmConcurrentHashIter *iter,
+                               ScmObj *key, ScmObj *value)
+{
+    ConcTable *tab = (ConcTable*)iter->table;
+    while (iter->index < tab->numSlots) {
+        ConcEntry *e = (ConcEntry*)AO_load(&tab->slots[iter->index++]);
+        if (e == NULL || e == CONC_SEALED) continue;
+        ScmAtomicWord v = AO_load(&e->value);
+        if (v == CONC_DEAD || SCM_UNBOUNDP(SCM_OBJ(v))) continue;
+        *key = SCM_OBJ(e->key);
+        *value = SCM_OBJ(v);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+ScmObj Scm_ConcurrentHashTableKeys(ScmConcurrentHashTable *ct)
+{
+    ScmConcurrentHashIter iter;
+    ScmObj h = SCM_NIL, t = SCM_NIL, k, v;
+    Scm_ConcurrentHashIterInit(&iter, ct);
+    while (Scm_ConcurrentHashIterNext(&iter, &k, &v)) {
+        SCM_APPEND1(h, t, k);
+    }
+    return h;
+}
+
+ScmObj Scm_ConcurrentHashTableValues(ScmConcurrentHashTable *ct)
+{
+    ScmConcurrentHashIter iter;
+    ScmObj h = SCM_NIL, t = SCM_NIL, k, v;
+    Scm_ConcurrentHashIterInit(&iter, ct);
+    while (Scm_ConcurrentHashIterNext(&iter, &k, &v)) {
+        SCM_APPEND1(h, t, v);
+    }
+    return h;
+}
+
 /*====================================================================
  * Initialization
  */
@@ -0,0 +1,853 @@
+/*
+ * jit.c - native code generation of VM instructions
+ *
+ *   Copyright (c) 2018  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LIBGAUCHE_BODY
+#include "gauche.h"
+#include "gauche/code.h"
+#include "gauche/vminsn.h"
+#include "gauche/priv/atomicP.h"
+#include "gauche/priv/jitP.h"
+
+/*
+ * A template JIT.
+ *
+ *   When a closure is called SCM_JIT_THRESHOLD times with the runtime
+ *   flag SCM_ENABLE_JIT, we translate its code vector into x86_64
+ *   machine code, instruction by instruction.  A small set of
+ *   instructions---constants, local variable references, stack pushes,
+ *   fixnum arithmetic and comparison, branches and some pair
+ *   operations---is turned into inline native code, so that a run of
+ *   them doesn't go through the VM dispatch.  Everything else,
+ *   including the slow paths of the supported instructions (e.g. an
+ *   argument that isn't a fixnum, or an overflow), exits to the VM
+ *   with the PC of the instruction, and the VM executes it as usual.
+ *
+ *   The native code never calls back into C; it only reads and writes
+ *   the VM registers in ScmVM (vm->val0, vm->sp etc.), the same way the
+ *   VM loop does, so there's no extra state to reconcile on exit.  The
+ *   VM enters the native code at the beginning of the closure (vmcall.c),
+ *   when a continuation returns into the compiled code (RETURN_OP in
+ *   vm.c), and after JUMP and LOCAL-ENV-JUMP executed by the VM.  The
+ *   last one matters for loops: LOCAL-ENV-JUMP, the back-edge of named
+ *   let, has no template, and without re-entering there the rest of the
+ *   activation would stay in the VM after the first side exit.
+ *
+ *   The calling convention of the native code is
+ *
+ *      ScmWord *native(ScmVM *vm, void *entry)
+ *
+ *   where ENTRY is the address of the native code of the instruction to
+ *   start with.  It returns the PC to resume the VM.
+ *
+ *   The code object keeps its native code in cc->native.  The objects
+ *   embedded in the native code are the constants of the compiled code,
+ *   so they are kept alive by cc->constants.
+ */
+
+#if defined(SCM_JIT_AVAILABLE)
+
+#include <sys/mman.h>
+#include <stddef.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+typedef struct ScmJITCodeRec {
+    u_char *native;             /* mmap-ed native code */
+    size_t mapSize;
+    int codeSize;               /* copied from the compiled code */
+    int32_t entries[1];         /* native offset for each word of the
+                                   code vector, or -1 if we can't start
+                                   from there.  Variable length. */
+} ScmJITCode;
+
+typedef ScmWord *(*jit_proc)(ScmVM *vm, void *entry);
+
+/* Marks the code we tried but didn't compile. */
+static ScmJITCode jit_failed;
+
+/* x86_64 registers we use.  RBX holds vm throughout. */
+enum { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSI = 6, RDI = 7 };
+
+/* Condition codes */
+enum { CC_O = 0x0, CC_E = 0x4, CC_NE = 0x5,
+       CC_L = 0xc, CC_GE = 0xd, CC_LE = 0xe, CC_G = 0xf };
+
+#define OFF_VAL0     ((int)offsetof(ScmVM, val0))
+#define OFF_NUMVALS  ((int)offsetof(ScmVM, numVals))
+#define OFF_SP       ((int)offsetof(ScmVM, sp))
+#define OFF_ENV      ((int)offsetof(ScmVM, env))
+#define OFF_ATTN     ((int)offsetof(ScmVM, attentionRequest))
+#define OFF_UP       ((int)offsetof(ScmEnvFrame, up))
+
+/* Fixups of jump targets; resolved after all instructions are emitted. */
+enum { FIX_INSN, FIX_EXIT };
+
+typedef struct {
+    size_t pos;                 /* position of rel32 */
+    int kind;                   /* FIX_INSN or FIX_EXIT */
+    int index;                  /* index of code vector */
+} jit_fixup;
+
+typedef struct {
+    ScmCompiledCode *cc;
+    u_char *buf;
+    size_t pos;
+    size_t cap;
+    jit_fixup *fixups;
+    int numFixups;
+    int fixupCap;
+    int32_t *labels;            /* native offset of each insn, or -1 */
+} jit_ctx;
+
+/*----------------------------------------------------------------
+ * Emitting bytes
+ */
+
+static void ensure(jit_ctx *c, size_t n)
+{
+    if (c->pos + n <= c->cap) return;
+    size_t ncap = (c->cap + n) * 2;
+    u_char *nbuf = SCM_NEW_ATOMIC_ARRAY(u_char, ncap);
+    memcpy(nbuf, c->buf, c->pos);
+    c->buf = nbuf;
+    c->cap = ncap;
+}
+
+static void e8(jit_ctx *c, int b)
+{
+    c->buf[c->pos++] = (u_char)b;
+}
+
+static void e32(jit_ctx *c, int32_t v)
+{
+    uint32_t u = (uint32_t)v;
+    for (int i=0; i<4; i++) { e8(c, u & 0xff); u >>= 8; }
+}
+
+static void e64(jit_ctx *c, ScmWord v)
+{
+    for (int i=0; i<8; i++) { e8(c, (int)(v & 0xff)); v >>= 8; }
+}
+
+static int modrm(int mod, int reg, int rm)
+{
+    return (mod << 6) | ((reg & 7) << 3) | (rm & 7);
+}
+
+/* mov r, imm64 */
+static void mov_r_imm(jit_ctx *c, int r, ScmWord v)
+{
+    e8(c, 0x48); e8(c, 0xb8 + r); e64(c, v);
+}
+
+/* mov r, [base+disp] */
+static void mov_r_mem(jit_ctx *c, int r, int base, int disp)
+{
+    e8(c, 0x48); e8(c, 0x8b); e8(c, modrm(2, r, base)); e32(c, disp);
+}
+
+/* mov [base+disp], r */
+static void mov_mem_r(jit_ctx *c, int base, int disp, int r)
+{
+    e8(c, 0x48); e8(c, 0x89); e8(c, modrm(2, r, base)); e32(c, disp);
+}
+
+/* mov qword [rbx+disp], imm32 (sign extended) */
+static void mov_vm_imm(jit_ctx *c, int disp, int32_t v)
+{
+    e8(c, 0x48); e8(c, 0xc7); e8(c, modrm(2, 0, RBX)); e32(c, disp); e32(c, v);
+}
+
+/* mov dst, src */
+static void mov_r_r(jit_ctx *c, int dst, int src)
+{
+    e8(c, 0x48); e8(c, 0x89); e8(c, modrm(3, src, dst));
+}
+
+/* add/sub/cmp dst, src */
+#define ALU_ADD 0x01
+#define ALU_SUB 0x29
+#define ALU_CMP 0x39
+static void alu_r_r(jit_ctx *c, int op, int dst, int src)
+{
+    e8(c, 0x48); e8(c, op); e8(c, modrm(3, src, dst));
+}
+
+/* add/sub/cmp r, imm32 */
+#define ALUI_ADD 0
+#define ALUI_SUB 5
+#define ALUI_CMP 7
+static void alu_r_imm(jit_ctx *c, int ext, int r, int32_t v)
+{
+    e8(c, 0x48); e8(c, 0x81); e8(c, modrm(3, ext, r)); e32(c, v);
+}
+
+/* add/sub/cmp qword [rbx+disp], imm8 */
+static void alu_vm_imm8(jit_ctx *c, int ext, int disp, int v)
+{
+    e8(c, 0x48); e8(c, 0x83); e8(c, modrm(2, ext, RBX)); e32(c, disp); e8(c, v);
+}
+
+/* cmovCC dst, src */
+static void cmov(jit_ctx *c, int cc, int dst, int src)
+{
+    e8(c, 0x48); e8(c, 0x0f); e8(c, 0x40 + cc); e8(c, modrm(3, dst, src));
+}
+
+/* jCC rel32 / jmp rel32.  Returns the position of rel32. */
+static size_t jcc(jit_ctx *c, int cc)
+{
+    e8(c, 0x0f); e8(c, 0x80 + cc); e32(c, 0);
+    return c->pos - 4;
+}
+
+static size_t jmp(jit_ctx *c)
+{
+    e8(c, 0xe9); e32(c, 0);
+    return c->pos - 4;
+}
+
+/* Let the jump at POS go to the current position. */
+static void patch_here(jit_ctx *c, size_t pos)
+{
+    int32_t rel = (int32_t)(c->pos - (pos + 4));
+    for (int i=0; i<4; i++) c->buf[pos+i] = (u_char)((uint32_t)rel >> (i*8));
+}
+
+static void add_fixup(jit_ctx *c, size_t pos, int kind, int index)
+{
+    if (c->numFixups == c->fixupCap) {
+        int ncap = c->fixupCap * 2 + 16;
+        jit_fixup *n = SCM_NEW_ATOMIC_ARRAY(jit_fixup, ncap);
+        memcpy(n, c->fixups, sizeof(jit_fixup) * c->numFixups);
+        c->fixups = n;
+        c->fixupCap = ncap;
+    }
+    c->fixups[c->numFixups].pos = pos;
+    c->fixups[c->numFixups].kind = kind;
+    c->fixups[c->numFixups].index = index;
+    c->numFixups++;
+}
+
+/* Jump to the native code of insn INDEX, or exit to the VM at INDEX. */
+static void jcc_insn(jit_ctx *c, int cc, int index)
+{
+    add_fixup(c, jcc(c, cc), FIX_INSN, index);
+}
+
+static void jmp_insn(jit_ctx *c, int index)
+{
+    add_fixup(c, jmp(c), FIX_INSN, index);
+}
+
+static void jcc_exit(jit_ctx *c, int cc, int index)
+{
+    add_fixup(c, jcc(c, cc), FIX_EXIT, index);
+}
+
+/* Return to the VM with PC at insn INDEX. */
+static void emit_exit(jit_ctx *c, int index)
+{
+    mov_r_imm(c, RAX, (ScmWord)(c->cc->code + index));
+    e8(c, 0x5b);                /* pop rbx */
+    e8(c, 0xc3);                /* ret */
+}
+
+/*----------------------------------------------------------------
+ * Instruction templates
+ */
+
+/* Where the argument comes from. */
+enum { ARG_VAL0, ARG_POP, ARG_LREF };
+
+typedef struct {
+    int kind;
+    int depth;
+    int offset;
+} jit_arg;
+
+static jit_arg arg_val0 = { ARG_VAL0, 0, 0 };
+static jit_arg arg_pop  = { ARG_POP, 0, 0 };
+
+static jit_arg arg_lref(int depth, int offset)
+{
+    jit_arg a = { ARG_LREF, depth, offset };
+    return a;
+}
+
+/* Depth and offset of LREFnm shortcuts, from the insn name. */
+static jit_arg arg_lrefx(u_int op)
+{
+    const char *n = Scm_VMInsnName(op) + 4; /* skip "LREF" */
+    if (n[1] >= '0' && n[1] <= '9') return arg_lref(n[0]-'0', n[1]-'0');
+    else return arg_lref(0, n[0]-'0');
+}
+
+/* Where the result goes. */
+enum { RES_REG, RES_PUSH };
+
+static void load_lref(jit_ctx *c, int r, int depth, int offset)
+{
+    mov_r_mem(c, r, RBX, OFF_ENV);
+    for (int d=0; d<depth; d++) mov_r_mem(c, r, r, OFF_UP);
+    mov_r_mem(c, r, r, -(int)sizeof(ScmObj)*(offset+1));
+}
+
+/* Load the argument to R (other than RCX).  The stack isn't popped yet;
+   call finish_arg after all the checks. */
+static void load_arg(jit_ctx *c, int r, jit_arg a)
+{
+    switch (a.kind) {
+    case ARG_VAL0: mov_r_mem(c, r, RBX, OFF_VAL0); break;
+    case ARG_POP:
+        mov_r_mem(c, RCX, RBX, OFF_SP);
+        mov_r_mem(c, r, RCX, -(int)sizeof(ScmObj));
+        break;
+    case ARG_LREF: load_lref(c, r, a.depth, a.offset); break;
+    }
+}
+
+static void finish_arg(jit_ctx *c, jit_arg a)
+{
+    if (a.kind == ARG_POP) alu_vm_imm8(c, ALUI_SUB, OFF_SP, sizeof(ScmObj));
+}
+
+/* Store R (other than RCX) as the result. */
+static void result(jit_ctx *c, int r, int mode)
+{
+    if (mode == RES_REG) {
+        mov_mem_r(c, RBX, OFF_VAL0, r);
+        /* mov dword [rbx+numVals], 1 */
+        e8(c, 0xc7); e8(c, modrm(2, 0, RBX)); e32(c, OFF_NUMVALS); e32(c, 1);
+    } else {
+        mov_r_mem(c, RCX, RBX, OFF_SP);
+        mov_mem_r(c, RCX, 0, r);
+        alu_vm_imm8(c, ALUI_ADD, OFF_SP, sizeof(ScmObj));
+    }
+}
+
+/* Exit at INDEX unless R is a fixnum.  Clobbers RDI. */
+static void check_fixnum(jit_ctx *c, int r, int index)
+{
+    e8(c, 0x89); e8(c, modrm(3, r, RDI));           /* mov edi, r32 */
+    e8(c, 0x83); e8(c, modrm(3, 4, RDI)); e8(c, 3); /* and edi, 3 */
+    e8(c, 0x83); e8(c, modrm(3, 7, RDI)); e8(c, 1); /* cmp edi, 1 */
+    jcc_exit(c, CC_NE, index);
+}
+
+/* Exit at INDEX unless R is a pair.  Clobbers RDI.  We leave lazy pairs
+   to the VM. */
+static void check_pair(jit_ctx *c, int r, int index)
+{
+    e8(c, 0x89); e8(c, modrm(3, r, RDI));           /* mov edi, r32 */
+    e8(c, 0x83); e8(c, modrm(3, 4, RDI)); e8(c, 3); /* and edi, 3 */
+    jcc_exit(c, CC_NE, index);
+    e8(c, 0x48); e8(c, 0x8b); e8(c, modrm(0, RDI, r)); /* mov rdi, [r] */
+    e8(c, 0x83); e8(c, modrm(3, 4, RDI)); e8(c, 7); /* and edi, 7 */
+    e8(c, 0x83); e8(c, modrm(3, 7, RDI)); e8(c, 7); /* cmp edi, 7 */
+    jcc_exit(c, CC_E, index);
+}
+
+/* Tail of a branch insn at INDEX, whose flags are set so that CC means
+   to take the branch.  If STAR, VAL0 gets #f when taken, #t otherwise
+   (cf. $branch* in vminsn.scm).  Like CHECK-INTR, we go back to the VM
+   when it has something to do. */
+static void branch(jit_ctx *c, int index, int cc, int target, int star)
+{
+    size_t taken = jcc(c, cc);
+    if (star) mov_vm_imm(c, OFF_VAL0, (int32_t)SCM_WORD(SCM_TRUE));
+    size_t done = jmp(c);
+    patch_here(c, taken);
+    if (star) mov_vm_imm(c, OFF_VAL0, (int32_t)SCM_WORD(SCM_FALSE));
+    alu_vm_imm8(c, ALUI_CMP, OFF_ATTN, 0);
+    jcc_exit(c, CC_NE, target);
+    jmp_insn(c, target);
+    patch_here(c, done);
+}
+
+static void emit_const(jit_ctx *c, ScmObj v, int mode)
+{
+    mov_r_imm(c, RAX, SCM_WORD(v));
+    result(c, RAX, mode);
+}
+
+static void emit_lref(jit_ctx *c, jit_arg a, int mode)
+{
+    load_lref(c, RAX, a.depth, a.offset);
+    result(c, RAX, mode);
+}
+
+/* NUMADD2 and NUMSUB2, for fixnums.  Since a fixnum n is represented
+   as 4n+1, and the range of fixnums covers the entire word, the overflow
+   of the word arithmetic is exactly the overflow of fixnums. */
+static void emit_arith2(jit_ctx *c, int index, jit_arg x, int add)
+{
+    load_arg(c, RAX, x);
+    mov_r_mem(c, RDX, RBX, OFF_VAL0);
+    check_fixnum(c, RAX, index);
+    check_fixnum(c, RDX, index);
+    if (add) {
+        mov_r_r(c, RSI, RDX);
+        alu_r_imm(c, ALUI_SUB, RSI, 1);
+        alu_r_r(c, ALU_ADD, RSI, RAX);      /* (4x+1) + 4y */
+        jcc_exit(c, CC_O, index);
+    } else {
+        mov_r_r(c, RSI, RAX);
+        alu_r_r(c, ALU_SUB, RSI, RDX);      /* (4x+1) - (4y+1) */
+        jcc_exit(c, CC_O, index);
+        alu_r_imm(c, ALUI_ADD, RSI, 1);
+    }
+    finish_arg(c, x);
+    result(c, RSI, RES_REG);
+}
+
+/* NUMADDI and NUMSUBI, for a fixnum. */
+static void emit_arithi(jit_ctx *c, int index, jit_arg x, long imm,
+                        int add, int mode)
+{
+    load_arg(c, RAX, x);
+    check_fixnum(c, RAX, index);
+    if (add) {
+        mov_r_imm(c, RSI, (ScmWord)imm << 2);
+        alu_r_r(c, ALU_ADD, RSI, RAX);      /* 4imm + (4x+1) */
+    } else {
+        mov_r_imm(c, RSI, ((ScmWord)imm << 2) + 2);
+        alu_r_r(c, ALU_SUB, RSI, RAX);      /* (4imm+2) - (4x+1) */
+    }
+    jcc_exit(c, CC_O, index);
+    result(c, RSI, mode);
+}
+
+/* Compares X and VAL0 and leaves the flags.  Fixnums are compared as
+   words, since the representation preserves the order. */
+static void emit_numcmp(jit_ctx *c, int index, jit_arg x)
+{
+    load_arg(c, RAX, x);
+    mov_r_mem(c, RDX, RBX, OFF_VAL0);
+    check_fixnum(c, RAX, index);
+    check_fixnum(c, RDX, index);
+    finish_arg(c, x);
+    alu_r_r(c, ALU_CMP, RAX, RDX);
+}
+
+/* Sets VAL0 to #t if CC holds, #f otherwise. */
+static void bool_result(jit_ctx *c, int cc)
+{
+    mov_r_imm(c, RAX, SCM_WORD(SCM_FALSE));
+    mov_r_imm(c, RDX, SCM_WORD(SCM_TRUE));
+    cmov(c, cc, RAX, RDX);
+    result(c, RAX, RES_REG);
+}
+
+/* CAR, CDR and the combinations.  PATH is read from right to left,
+   e.g. "ad" for CADR. */
+static void emit_cxr(jit_ctx *c, int index, jit_arg x, const char *path,
+                     int mode)
+{
+    load_arg(c, RAX, x);
+    for (int i = (int)strlen(path)-1; i >= 0; i--) {
+        check_pair(c, RAX, index);
+        mov_r_mem(c, RAX, RAX,
+                  path[i] == 'a'
+                  ? (int)offsetof(ScmPair, car)
+                  : (int)offsetof(ScmPair, cdr));
+    }
+    result(c, RAX, mode);
+}
+
+/* Compares VAL0 with a constant and leaves the flags. */
+static void cmp_val0(jit_ctx *c, ScmObj v)
+{
+    mov_r_mem(c, RAX, RBX, OFF_VAL0);
+    alu_r_imm(c, ALUI_CMP, RAX, (int32_t)SCM_WORD(v));
+}
+
+#define LREFX_CASES(suffix)                                             \
+    case SCM_VM_LREF0##suffix: case SCM_VM_LREF1##suffix:               \
+    case SCM_VM_LREF2##suffix: case SCM_VM_LREF3##suffix:               \
+    case SCM_VM_LREF10##suffix: case SCM_VM_LREF11##suffix:             \
+    case SCM_VM_LREF12##suffix: case SCM_VM_LREF20##suffix:             \
+    case SCM_VM_LREF21##suffix: case SCM_VM_LREF30##suffix
+
+/* Emits the native code of the insn at INDEX.  Returns FALSE if we
+   don't have a template for it. */
+static int emit_insn(jit_ctx *c, int index)
+{
+    ScmWord *p = c->cc->code + index;
+    u_int op = SCM_VM_INSN_CODE(p[0]);
+    int target = -1;
+
+    if (Scm_VMInsnOperandType(op) == SCM_VM_OPERAND_ADDR) {
+        target = (int)((ScmWord*)p[1] - c->cc->code);
+    }
+
+    switch (op) {
+    case SCM_VM_NOP: break;
+
+    case SCM_VM_CONST:   emit_const(c, SCM_OBJ(p[1]), RES_REG); break;
+    case SCM_VM_CONST_PUSH: emit_const(c, SCM_OBJ(p[1]), RES_PUSH); break;
+    case SCM_VM_CONSTI:
+        emit_const(c, SCM_MAKE_INT(SCM_VM_INSN_ARG(p[0])), RES_REG); break;
+    case SCM_VM_CONSTI_PUSH:
+        emit_const(c, SCM_MAKE_INT(SCM_VM_INSN_ARG(p[0])), RES_PUSH); break;
+    case SCM_VM_CONSTN:  emit_const(c, SCM_NIL, RES_REG); break;
+    case SCM_VM_CONSTN_PUSH: emit_const(c, SCM_NIL, RES_PUSH); break;
+    case SCM_VM_CONSTF:  emit_const(c, SCM_FALSE, RES_REG); break;
+    case SCM_VM_CONSTF_PUSH: emit_const(c, SCM_FALSE, RES_PUSH); break;
+    case SCM_VM_CONSTU:  emit_const(c, SCM_UNDEFINED, RES_REG); break;
+
+    case SCM_VM_PUSH:
+        load_arg(c, RAX, arg_val0);
+        result(c, RAX, RES_PUSH);
+        break;
+
+    case SCM_VM_LREF:
+        emit_lref(c, arg_lref(SCM_VM_INSN_ARG0(p[0]), SCM_VM_INSN_ARG1(p[0])),
+                  RES_REG);
+        break;
+    case SCM_VM_LREF_PUSH:
+        emit_lref(c, arg_lref(SCM_VM_INSN_ARG0(p[0]), SCM_VM_INSN_ARG1(p[0])),
+                  RES_PUSH);
+        break;
+    LREFX_CASES():      emit_lref(c, arg_lrefx(op), RES_REG); break;
+    LREFX_CASES(_PUSH): emit_lref(c, arg_lrefx(op), RES_PUSH); break;
+
+    case SCM_VM_NUMADD2: emit_arith2(c, index, arg_pop, TRUE); break;
+    case SCM_VM_NUMSUB2: emit_arith2(c, index, arg_pop, FALSE); break;
+    case SCM_VM_LREF_VAL0_NUMADD2:
+        emit_arith2(c, index,
+                    arg_lref(SCM_VM_INSN_ARG0(p[0]), SCM_VM_INSN_ARG1(p[0])),
+                    TRUE);
+        break;
+    case SCM_VM_NUMADDI:
+        emit_arithi(c, index, arg_val0, SCM_VM_INSN_ARG(p[0]), TRUE, RES_REG);
+        break;
+    case SCM_VM_NUMSUBI:
+        emit_arithi(c, index, arg_val0, SCM_VM_INSN_ARG(p[0]), FALSE, RES_REG);
+        break;
+    LREFX_CASES(_NUMADDI):
+        emit_arithi(c, index, arg_lrefx(op), SCM_VM_INSN_ARG(p[0]),
+                    TRUE, RES_REG);
+        break;
+    LREFX_CASES(_NUMADDI_PUSH):
+        emit_arithi(c, index, arg_lrefx(op), SCM_VM_INSN_ARG(p[0]),
+                    TRUE, RES_PUSH);
+        break;
+
+    case SCM_VM_NUMEQ2:
+        emit_numcmp(c, index, arg_pop); bool_result(c, CC_E); break;
+    case SCM_VM_NUMLT2:
+        emit_numcmp(c, index, arg_pop); bool_result(c, CC_L); break;
+    case SCM_VM_NUMLE2:
+        emit_numcmp(c, index, arg_pop); bool_result(c, CC_LE); break;
+    case SCM_VM_NUMGT2:
+        emit_numcmp(c, index, arg_pop); bool_result(c, CC_G); break;
+    case SCM_VM_NUMGE2:
+        emit_numcmp(c, index, arg_pop); bool_result(c, CC_GE); break;
+
+    case SCM_VM_EQ:
+        load_arg(c, RAX, arg_pop);
+        finish_arg(c, arg_pop);
+        mov_r_mem(c, RDX, RBX, OFF_VAL0);
+        alu_r_r(c, ALU_CMP, RAX, RDX);
+        bool_result(c, CC_E);
+        break;
+    case SCM_VM_NOT:   cmp_val0(c, SCM_FALSE); bool_result(c, CC_E); break;
+    case SCM_VM_NULLP: cmp_val0(c, SCM_NIL);   bool_result(c, CC_E); break;
+
+    case SCM_VM_CAR:      emit_cxr(c, index, arg_val0, "a", RES_REG); break;
+    case SCM_VM_CAR_PUSH: emit_cxr(c, index, arg_val0, "a", RES_PUSH); break;
+    case SCM_VM_CDR:      emit_cxr(c, index, arg_val0, "d", RES_REG); break;
+    case SCM_VM_CDR_PUSH: emit_cxr(c, index, arg_val0, "d", RES_PUSH); break;
+    case SCM_VM_CAAR:     emit_cxr(c, index, arg_val0, "aa", RES_REG); break;
+    case SCM_VM_CAAR_PUSH:emit_cxr(c, index, arg_val0, "aa", RES_PUSH); break;
+    case SCM_VM_CADR:     emit_cxr(c, index, arg_val0, "ad", RES_REG); break;
+    case SCM_VM_CADR_PUSH:emit_cxr(c, index, arg_val0, "ad", RES_PUSH); break;
+    case SCM_VM_CDAR:     emit_cxr(c, index, arg_val0, "da", RES_REG); break;
+    case SCM_VM_CDAR_PUSH:emit_cxr(c, index, arg_val0, "da", RES_PUSH); break;
+    case SCM_VM_CDDR:     emit_cxr(c, index, arg_val0, "dd", RES_REG); break;
+    case SCM_VM_CDDR_PUSH:emit_cxr(c, index, arg_val0, "dd", RES_PUSH); break;
+    LREFX_CASES(_CAR):
+        emit_cxr(c, index, arg_lrefx(op), "a", RES_REG); break;
+    LREFX_CASES(_CDR):
+        emit_cxr(c, index, arg_lrefx(op), "d", RES_REG); break;
+
+    case SCM_VM_JUMP:
+        alu_vm_imm8(c, ALUI_CMP, OFF_ATTN, 0);
+        jcc_exit(c, CC_NE, target);
+        jmp_insn(c, target);
+        break;
+    case SCM_VM_BF:
+        cmp_val0(c, SCM_FALSE); branch(c, index, CC_E, target, FALSE); break;
+    case SCM_VM_BT:
+        cmp_val0(c, SCM_FALSE); branch(c, index, CC_NE, target, FALSE); break;
+    case SCM_VM_BNNULL:
+        cmp_val0(c, SCM_NIL); branch(c, index, CC_NE, target, TRUE); break;
+    case SCM_VM_BNEQ:
+        load_arg(c, RAX, arg_pop);
+        finish_arg(c, arg_pop);
+        mov_r_mem(c, RDX, RBX, OFF_VAL0);
+        alu_r_r(c, ALU_CMP, RAX, RDX);
+        branch(c, index, CC_NE, target, TRUE);
+        break;
+    /* BNxx branches when the comparison fails. */
+    case SCM_VM_BNUMNE:
+        emit_numcmp(c, index, arg_pop);
+        branch(c, index, CC_NE, target, TRUE); break;
+    case SCM_VM_BNLT:
+        emit_numcmp(c, index, arg_pop);
+        branch(c, index, CC_GE, target, TRUE); break;
+    case SCM_VM_BNLE:
+        emit_numcmp(c, index, arg_pop);
+        branch(c, index, CC_G, target, TRUE); break;
+    case SCM_VM_BNGT:
+        emit_numcmp(c, index, arg_pop);
+        branch(c, index, CC_LE, target, TRUE); break;
+    case SCM_VM_BNGE:
+        emit_numcmp(c, index, arg_pop);
+        branch(c, index, CC_L, target, TRUE); break;
+    case SCM_VM_LREF_VAL0_BNUMNE:
+    case SCM_VM_LREF_VAL0_BNLT:
+    case SCM_VM_LREF_VAL0_BNLE:
+    case SCM_VM_LREF_VAL0_BNGT:
+    case SCM_VM_LREF_VAL0_BNGE:
+        emit_numcmp(c, index,
+                    arg_lref(SCM_VM_INSN_ARG0(p[0]), SCM_VM_INSN_ARG1(p[0])));
+        branch(c, index,
+               (op == SCM_VM_LREF_VAL0_BNUMNE ? CC_NE
+                : op == SCM_VM_LREF_VAL0_BNLT ? CC_GE
+                : op == SCM_VM_LREF_VAL0_BNLE ? CC_G
+                : op == SCM_VM_LREF_VAL0_BNGT ? CC_LE
+                : CC_L),
+               target, TRUE);
+        break;
+    case SCM_VM_BNUMNEI:
+        load_arg(c, RAX, arg_val0);
+        check_fixnum(c, RAX, index);
+        mov_r_imm(c, RDX, SCM_WORD(SCM_MAKE_INT(SCM_VM_INSN_ARG(p[0]))));
+        alu_r_r(c, ALU_CMP, RAX, RDX);
+        branch(c, index, CC_NE, target, TRUE);
+        break;
+
+    default:
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*----------------------------------------------------------------
+ * Compiling a code vector
+ */
+
+static void jit_code_finalize(ScmObj z, void *data SCM_UNUSED)
+{
+    ScmJITCode *j = (ScmJITCode*)z;
+    if (j->native) munmap(j->native, j->mapSize);
+    j->native = NULL;
+}
+
+static ScmJITCode *jit_compile(ScmCompiledCode *cc)
+{
+    int size = cc->codeSize;
+    if (size <= 0 || size > 0x10000) return &jit_failed;
+
+    jit_ctx c;
+    c.cc = cc;
+    c.cap = size * 64 + 64;
+    c.buf = SCM_NEW_ATOMIC_ARRAY(u_char, c.cap);
+    c.pos = 0;
+    c.fixups = NULL;
+    c.numFixups = c.fixupCap = 0;
+    c.labels = SCM_NEW_ATOMIC_ARRAY(int32_t, size);
+
+    ScmJITCode *j = SCM_NEW_ATOMIC2(ScmJITCode*,
+                                    sizeof(ScmJITCode)
+                                    + sizeof(int32_t)*(size-1));
+    j->codeSize = size;
+    for (int i=0; i<size; i++) j->entries[i] = c.labels[i] = -1;
+
+    /* Prologue: push rbx; mov rbx, rdi; jmp rsi */
+    e8(&c, 0x53);
+    mov_r_r(&c, RBX, RDI);
+    e8(&c, 0xff); e8(&c, modrm(3, 4, RSI));
+
+    int supported = 0;
+    for (int i=0; i<size; ) {
+        u_int op = SCM_VM_INSN_CODE(cc->code[i]);
+        int n = 1;
+        switch (Scm_VMInsnOperandType(op)) {
+        case SCM_VM_OPERAND_NONE: break;
+        case SCM_VM_OPERAND_OBJ_ADDR: n = 3; break;
+        default: n = 2;
+        }
+        ensure(&c, 512);
+        c.labels[i] = (int32_t)c.pos;
+        if (emit_insn(&c, i)) {
+            j->entries[i] = c.labels[i];
+            supported++;
+        } else {
+            emit_exit(&c, i);
+        }
+        i += n;
+    }
+    if (supported == 0) return &jit_failed;
+    ensure(&c, 2);
+    e8(&c, 0x0f); e8(&c, 0x0b); /* ud2; we never fall off the end */
+
+    /* Exit stubs, shared by the slow paths of the same insn. */
+    int32_t *exits = SCM_NEW_ATOMIC_ARRAY(int32_t, size);
+    for (int i=0; i<size; i++) exits[i] = -1;
+    for (int k=0; k<c.numFixups; k++) {
+        jit_fixup *f = &c.fixups[k];
+        int32_t dest;
+        if (f->index < 0 || f->index >= size) return &jit_failed;
+        if (f->kind == FIX_INSN) {
+            dest = c.labels[f->index];
+            if (dest < 0) return &jit_failed;
+        } else {
+            if (exits[f->index] < 0) {
+                ensure(&c, 16);
+                exits[f->index] = (int32_t)c.pos;
+                emit_exit(&c, f->index);
+            }
+            dest = exits[f->index];
+        }
+        int32_t rel = dest - (int32_t)(f->pos + 4);
+        for (int b=0; b<4; b++) {
+            c.buf[f->pos+b] = (u_char)((uint32_t)rel >> (b*8));
+        }
+    }
+
+    long pagesize = sysconf(_SC_PAGESIZE);
+    size_t mapsize = (c.pos + pagesize - 1) & ~(size_t)(pagesize - 1);
+    void *m = mmap(NULL, mapsize, PROT_READ|PROT_WRITE,
+                   MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED) return &jit_failed;
+    memcpy(m, c.buf, c.pos);
+    if (mprotect(m, mapsize, PROT_READ|PROT_EXEC) < 0) {
+        munmap(m, mapsize);
+        return &jit_failed;
+    }
+    j->native = (u_char*)m;
+    j->mapSize = mapsize;
+    Scm_RegisterFinalizer(SCM_OBJ(j), jit_code_finalize, NULL);
+    return j;
+}
+
+/* Install the native code to CC.  If another thread has done it
+   first, we use theirs. */
+static ScmJITCode *jit_install(ScmCompiledCode *cc)
+{
+    ScmJITCode *j = jit_compile(cc);
+    ScmAtomicWord none = 0;
+    if (!AO_compare_and_swap_full((ScmAtomicVar*)&cc->native,
+                                  none, (ScmAtomicWord)j)) {
+        j = (ScmJITCode*)AO_load((ScmAtomicVar*)&cc->native);
+    }
+    return j;
+}
+
+static ScmWord *jit_run(ScmVM *vm, ScmJITCode *j, ScmCompiledCode *cc)
+{
+    if (j == &jit_failed) return vm->pc;
+    ptrdiff_t index = vm->pc - cc->code;
+    if (index < 0 || index >= j->codeSize) return vm->pc;
+    int32_t off = j->entries[index];
+    if (off < 0) return vm->pc;
+    return ((jit_proc)(void*)j->native)(vm, j->native + off);
+}
+
+ScmWord *Scm__JITCall(ScmVM *vm, ScmCompiledCode *cc)
+{
+    ScmJITCode *j = (ScmJITCode*)AO_load((ScmAtomicVar*)&cc->native);
+    if (j == NULL) {
+        /* The count may be off if threads race; it doesn't matter. */
+        if (++cc->callCount < SCM_JIT_THRESHOLD) return vm->pc;
+        j = jit_install(cc);
+    }
+    return jit_run(vm, j, cc);
+}
+
+ScmWord *Scm__JITResume(ScmVM *vm, ScmCompiledCode *cc)
+{
+    ScmJITCode *j = (ScmJITCode*)AO_load((ScmAtomicVar*)&cc->native);
+    if (j == NULL) return vm->pc;
+    return jit_run(vm, j, cc);
+}
+
+int Scm__JITAvailableP(void)
+{
+    return TRUE;
+}
+
+int Scm__JITCompiledP(ScmCompiledCode *cc)
+{
+    void *j = cc->native;
+    return (j != NULL && j != (void*)&jit_failed);
+}
+
+#else  /*!SCM_JIT_AVAILABLE*/
+
+ScmWord *Scm__JITCall(ScmVM *vm, ScmCompiledCode *cc SCM_UNUSED)
+{
+    return vm->pc;
+}
+
+ScmWord *Scm__JITResume(ScmVM *vm, ScmCompiledCode *cc SCM_UNUSED)
+{
+    return vm->pc;
+}
+
+int Scm__JITAvailableP(void)
+{
+    return FALSE;
+}
+
+int Scm__JITCompiledP(ScmCompiledCode *cc SCM_UNUSED)
+{
+    return FALSE;
+}
+
+#endif /*!SCM_JIT_AVAILABLE*/
+
+void Scm__InitJIT(void)
+{
+    /* The runtime flag is usually set by gosh -fjit, but we also take
+       the environment variable, to run the programs that don't go
+       through gosh (e.g. the scripts run by other scripts). */
+    if (Scm__JITAvailableP() && Scm_GetEnv("GAUCHE_JIT") != NULL) {
+        SCM_VM_RUNTIME_FLAG_SET(Scm_VM(), SCM_ENABLE_JIT);
+    }
+}
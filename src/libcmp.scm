@@ -509,3 +509,12 @@
         [else (SCM_TYPE_ERROR seq "proper list or vector")
               (return SCM_UNDEFINED)]))
 
+;; Stable radix sort of a vector whose keys are all fixnums.  If KEYED is
+;; true, elements are (elt . key) pairs.  Returns #f, leaving VEC intact,
+;; if there's a non-fixnum key.
+(define-cproc %radix-sort! (vec::<vector> descending::<boolean>
+                            keyed::<boolean>) ::<boolean>
+  (return (Scm_RadixSortArray (SCM_VECTOR_ELEMENTS vec) (SCM_VECTOR_SIZE vec)
+                              (logior (?: descending SCM_SORT_DESCENDING 0)
+                                      (?: keyed SCM_SORT_KEY_CDR 0)))))
+
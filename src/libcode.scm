@@ -51,7 +51,10 @@
           compiled-code-new-label compiled-code-set-label!
           compiled-code-push-info!
           compiled-code-finish-builder
-          compiled-code-copy!))
+          compiled-code-copy!
+
+          vm-jit-available? vm-jit-enabled? vm-jit-enable!
+          compiled-code-native?))
 (select-module gauche.vm.code)
 
 ;;============================================================
@@ -62,6 +65,7 @@
  (declcode
   (.include <gauche/code.h>
             <gauche/priv/codeP.h>
+            <gauche/priv/jitP.h>
             <gauche/class.h>
             <gauche/vminsn.h>))
 
@@ -159,6 +163,18 @@
  (define-cproc compiled-code-push-info! (cc::<compiled-code> info)
    ::<void> Scm_CompiledCodePushInfo)
 
+ ;; Native code compilation (see jit.c).  The flag is per VM; a new
+ ;; thread inherits it from its parent.
+ (define-cproc vm-jit-available? () ::<boolean> Scm__JITAvailableP)
+ (define-cproc vm-jit-enabled? () ::<boolean>
+   (return (SCM_VM_RUNTIME_FLAG_IS_SET (Scm_VM) SCM_ENABLE_JIT)))
+ (define-cproc vm-jit-enable! (flag::<boolean>) ::<void>
+   (if (and flag (Scm__JITAvailableP))
+     (SCM_VM_RUNTIME_FLAG_SET (Scm_VM) SCM_ENABLE_JIT)
+     (SCM_VM_RUNTIME_FLAG_CLEAR (Scm_VM) SCM_ENABLE_JIT)))
+ (define-cproc compiled-code-native? (code::<compiled-code>) ::<boolean>
+   Scm__JITCompiledP)
+
  ;; Kludge: Let gauche.internal import me.  It must be done before the
  ;; compiler runs. This should eventually be done in the gauche.internal side.
  (initcode
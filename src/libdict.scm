@@ -55,7 +55,7 @@
  (define-cise-stmt dict-update!
    [(_ dict searcher xtractor cc) ;; assumes key, proc, and fallback
     `(let* ([e::ScmDictEntry*]
-            [data::(.array void* (1))])
+            [data::(.array void* (3))])
        (cond [(SCM_UNBOUNDP fallback)
               (set! e (,searcher (,xtractor ,dict) (cast intptr_t key)
                                  SCM_DICT_GET))
@@ -66,7 +66,9 @@
               (unless (-> e value)
                 (cast void (SCM_DICT_SET_VALUE e fallback)))])
        (set! (aref data 0) (cast void* e))
-       (Scm_VMPushCC ,cc data 1)
+       (set! (aref data 1) (cast void* ,dict))
+       (set! (aref data 2) (cast void* key))
+       (Scm_VMPushCC ,cc data 3)
        (return (Scm_VMApply1 proc (SCM_DICT_VALUE e))))])
 
  (define-cise-stmt dict-push!
@@ -123,6 +125,16 @@
        [(SCM_HASH_GENERAL) (return 'general)]
        [else (return '#f)]           ; TODO: need to think over
        )])
+
+ (define-cise-stmt set-hash-layout!
+   [(_ cvar scmvar)
+    `(cond [(or (SCM_FALSEP ,scmvar) (SCM_EQ ,scmvar 'chained))
+            (set! ,cvar 0)]
+           [(SCM_EQ ,scmvar 'open-addressing)
+            (set! ,cvar SCM_HASH_CORE_OPEN_ADDRESSING)]
+           [(SCM_EQ ,scmvar 'incremental)
+            (set! ,cvar SCM_HASH_CORE_INCREMENTAL_REHASH)]
+           [else (Scm_Error "unsupported hash table layout: %S" ,scmvar)])])
  )
 
 (select-module gauche.internal)
@@ -147,10 +159,12 @@
 
 (define-cproc hash-table? (obj) ::<boolean> :fast-flonum SCM_HASH_TABLE_P)
 
-(define-cproc %make-hash-table-simple (type init-size::<int>)
-  (let* ([ctype::int 0])
+(define-cproc %make-hash-table-simple (type init-size::<int>
+                                            :optional (layout #f))
+  (let* ([ctype::int 0] [flags::u_long 0])
     (set-hash-type! ctype type)
-    (return (Scm_MakeHashTableSimple ctype init-size))))
+    (set-hash-layout! flags layout)
+    (return (Scm_MakeHashTableSimpleWithFlags ctype init-size flags))))
 
 (inline-stub
 (define-cfn generic-hashtable-hash (h::(const ScmHashCore*) key::intptr_t)
@@ -196,23 +210,30 @@
 
 (define-cproc %make-hash-table-from-comparator (comparator::<comparator>
                                                 init-size::<int>
-                                                has-type-check::<boolean>)
-  (if has-type-check
-    (return (Scm_MakeHashTableFull generic-hashtable-hash-typecheck
-                                   generic-hashtable-eq-typecheck
-                                   init-size
-                                   comparator))
-    (return (Scm_MakeHashTableFull generic-hashtable-hash
-                                   generic-hashtable-eq
-                                   init-size
-                                   comparator))))
+                                                has-type-check::<boolean>
+                                                :optional (layout #f))
+  (let* ([flags::u_long 0])
+    (set-hash-layout! flags layout)
+    (if has-type-check
+      (return (Scm_MakeHashTableFullWithFlags generic-hashtable-hash-typecheck
+                                              generic-hashtable-eq-typecheck
+                                              init-size
+                                              flags
+                                              comparator))
+      (return (Scm_MakeHashTableFullWithFlags generic-hashtable-hash
+                                              generic-hashtable-eq
+                                              init-size
+                                              flags
+                                              comparator)))))
 
 ;; Comparator argument can be <comparator> or one of the symbols
 ;; eq?, eqv?, equal? or string=?.
-(define (make-hash-table :optional (comparator 'eq?) (init-size 0))
+;; Layout argument can be #f, chained, open-addressing or incremental.
+(define (make-hash-table :optional (comparator 'eq?) (init-size 0)
+                                   (layout #f))
   (case comparator
     [(eq? eqv? equal? string=?)
-     (%make-hash-table-simple comparator init-size)]
+     (%make-hash-table-simple comparator init-size layout)]
     [else
      (unless (comparator? comparator)
        (error "make-hash-table requires a comparator or \
@@ -220,13 +241,13 @@
               comparator))
      (cond
       [(eq? comparator eq-comparator)
-       (make-hash-table 'eq? init-size)]
+       (make-hash-table 'eq? init-size layout)]
       [(eq? comparator eqv-comparator)
-       (make-hash-table 'eqv? init-size)]
+       (make-hash-table 'eqv? init-size layout)]
       [(eq? comparator equal-comparator)
-       (make-hash-table 'equal? init-size)]
+       (make-hash-table 'equal? init-size layout)]
       [(eq? comparator string-comparator)
-       (make-hash-table 'string=? init-size)]
+       (make-hash-table 'string=? init-size layout)]
       [else
        (unless (comparator-hashable? comparator)
          (error "make-hash-table requires a comparator with hash function, \
@@ -234,7 +255,8 @@
        ($ %make-hash-table-from-comparator
           comparator init-size
           (not (eq? (comparator-type-test-predicate comparator)
-                    (with-module gauche.internal default-type-test))))])]))
+                    (with-module gauche.internal default-type-test)))
+          layout)])]))
 
 (define-cproc hash-table-type (hash::<hash-table>)
   (get-hash-type (-> hash type)))
@@ -286,8 +308,14 @@
   (return (dict-exists? hash Scm_HashTableRef)))
 
 (inline-stub
+ ;; An entry of open-addressing table may be moved if PROC inserts
+ ;; to the same table, so we search it again.
  (define-cfn hash-table-update-cc (result (data :: void**)) :static
-   (let* ([e::ScmDictEntry* (cast ScmDictEntry* (aref data 0))])
+   (let* ([e::ScmDictEntry* (cast ScmDictEntry* (aref data 0))]
+          [core::ScmHashCore* (SCM_HASH_TABLE_CORE (aref data 1))])
+     (when (SCM_HASH_CORE_OPEN_ADDRESSING_P core)
+       (set! e (Scm_HashCoreSearch core (cast intptr_t (aref data 2))
+                                   SCM_DICT_CREATE)))
      (cast void (SCM_DICT_SET_VALUE e result))
      (return result)))
  )
@@ -337,6 +365,213 @@
 (define (hash-table->alist h)
   (hash-table-map h cons))
 
+;;;
+;;; Concurrent hash tables
+;;;
+
+(select-module gauche)
+(define-cproc concurrent-hash-table? (obj) ::<boolean>
+  SCM_CONCURRENT_HASH_TABLE_P)
+
+(define-cproc %make-concurrent-hash-table-simple (type init-size::<int>)
+  (let* ([ctype::int 0])
+    (set-hash-type! ctype type)
+    (return (Scm_MakeConcurrentHashTableSimple ctype init-size))))
+
+(define-cproc %make-concurrent-hash-table-from-comparator
+  (comparator::<comparator> init-size::<int> has-type-check::<boolean>)
+  (if has-type-check
+    (return (Scm_MakeConcurrentHashTableFull generic-hashtable-hash-typecheck
+                                             generic-hashtable-eq-typecheck
+                                             init-size
+                                             comparator))
+    (return (Scm_MakeConcurrentHashTableFull generic-hashtable-hash
+                                             generic-hashtable-eq
+                                             init-size
+                                             comparator))))
+
+(define (make-concurrent-hash-table :optional (comparator 'eq?) (init-size 0))
+  (case comparator
+    [(eq? eqv? equal? string=?)
+     (%make-concurrent-hash-table-simple comparator init-size)]
+    [else
+     (unless (comparator? comparator)
+       (error "make-concurrent-hash-table requires a comparator or \
+               one of the symbols in eq?, eqv?, equal? or string=?, but got:"
+              comparator))
+     (cond
+      [(eq? comparator eq-comparator)
+       (%make-concurrent-hash-table-simple 'eq? init-size)]
+      [(eq? comparator eqv-comparator)
+       (%make-concurrent-hash-table-simple 'eqv? init-size)]
+      [(eq? comparator equal-comparator)
+       (%make-concurrent-hash-table-simple 'equal? init-size)]
+      [(eq? comparator string-comparator)
+       (%make-concurrent-hash-table-simple 'string=? init-size)]
+      [else
+       (unless (comparator-hashable? comparator)
+         (error "make-concurrent-hash-table requires a comparator \
+                 with hash function, but got:" comparator))
+       ($ %make-concurrent-hash-table-from-comparator
+          comparator init-size
+          (not (eq? (comparator-type-test-predicate comparator)
+                    (with-module gauche.internal default-type-test))))])]))
+
+(define-cproc concurrent-hash-table-type (ct::<concurrent-hash-table>)
+  (get-hash-type (-> ct type)))
+
+(define (concurrent-hash-table-comparator ct)
+  (case (concurrent-hash-table-type ct)
+    [(eq?) eq-comparator]
+    [(eqv?) eqv-comparator]
+    [(equal?) equal-comparator]
+    [(string=?) string-comparator]
+    [(general) ((with-module gauche.internal %concurrent-hash-table-comparator-int) ct)]
+    [else (error "unknown hashtable type:" ct)]))
+
+(select-module gauche.internal)
+(define-cproc %concurrent-hash-table-comparator-int
+  (ct::<concurrent-hash-table>)
+  (return (SCM_OBJ (ref (-> ct procs) data))))
+
+(select-module gauche)
+(define-cproc concurrent-hash-table-num-entries (ct::<concurrent-hash-table>)
+  ::<int> Scm_ConcurrentHashTableNumEntries)
+
+(define-cproc concurrent-hash-table-clear! (ct::<concurrent-hash-table>)
+  ::<void> Scm_ConcurrentHashTableClear)
+
+(define-cproc concurrent-hash-table-get (ct::<concurrent-hash-table> key
+                                         :optional fallback)
+  (dict-get ct Scm_ConcurrentHashTableRef))
+
+(define-cproc concurrent-hash-table-put! (ct::<concurrent-hash-table>
+                                          key value) ::<void>
+  (Scm_ConcurrentHashTableSet ct key value 0))
+
+(define-cproc concurrent-hash-table-adjoin! (ct::<concurrent-hash-table>
+                                             key value) ::<void>
+  (Scm_ConcurrentHashTableSet ct key value SCM_DICT_NO_OVERWRITE))
+
+(define-cproc concurrent-hash-table-replace! (ct::<concurrent-hash-table>
+                                              key value) ::<void>
+  (Scm_ConcurrentHashTableSet ct key value SCM_DICT_NO_CREATE))
+
+(define-cproc concurrent-hash-table-delete! (ct::<concurrent-hash-table> key)
+  ::<boolean>
+  (return (not (SCM_UNBOUNDP (Scm_ConcurrentHashTableDelete ct key)))))
+
+(define-cproc concurrent-hash-table-exists? (ct::<concurrent-hash-table> key)
+  ::<boolean>
+  (return (dict-exists? ct Scm_ConcurrentHashTableRef)))
+
+;; Returns #t and stores NEW iff the current value of KEY is eq? to OLD.
+;; If OLD is omitted, the entry must not exist.  If NEW is omitted,
+;; the entry is deleted.
+(define-cproc concurrent-hash-table-compare-and-swap!
+  (ct::<concurrent-hash-table> key :optional old new) ::<boolean>
+  (return (Scm_ConcurrentHashTableCompareAndSwap ct key old new)))
+
+(inline-stub
+ ;; PROC is called without holding any lock.  If another thread changes
+ ;; the entry while PROC is running, PROC is called again with the new value.
+ (define-cfn concurrent-hash-table-update-cc (result (data :: void**))
+   :static
+   (let* ([ct::ScmConcurrentHashTable*
+              (SCM_CONCURRENT_HASH_TABLE (aref data 0))]
+          [key (SCM_OBJ (aref data 1))]
+          [old (SCM_OBJ (aref data 2))]
+          [proc (SCM_OBJ (aref data 3))]
+          [fallback (SCM_OBJ (aref data 4))])
+     (when (Scm_ConcurrentHashTableCompareAndSwap ct key old result)
+       (return result))
+     (set! old (Scm_ConcurrentHashTableRef ct key SCM_UNBOUND))
+     (when (SCM_UNBOUNDP old)
+       (dict-check-entry ct key (SCM_UNBOUNDP fallback)))
+     (set! (aref data 2) old)
+     (Scm_VMPushCC concurrent-hash-table-update-cc data 5)
+     (return (Scm_VMApply1 proc (?: (SCM_UNBOUNDP old) fallback old)))))
+ )
+
+(define-cproc concurrent-hash-table-update! (ct::<concurrent-hash-table>
+                                             key proc :optional fallback)
+  (let* ([old (Scm_ConcurrentHashTableRef ct key SCM_UNBOUND)]
+         [data::(.array void* (5))])
+    (when (SCM_UNBOUNDP old)
+      (dict-check-entry ct key (SCM_UNBOUNDP fallback)))
+    (set! (aref data 0) ct
+          (aref data 1) key
+          (aref data 2) old
+          (aref data 3) proc
+          (aref data 4) fallback)
+    (Scm_VMPushCC concurrent-hash-table-update-cc data 5)
+    (return (Scm_VMApply1 proc (?: (SCM_UNBOUNDP old) fallback old)))))
+
+(define (concurrent-hash-table-push! ct key value)
+  (concurrent-hash-table-update! ct key (cut cons value <>) '()))
+
+(define (concurrent-hash-table-pop! ct key :optional fallback)
+  (let loop ()
+    (let1 v (concurrent-hash-table-get ct key '())
+      (cond [(pair? v)
+             (if (concurrent-hash-table-compare-and-swap! ct key v (cdr v))
+               (car v)
+               (loop))]
+            [(undefined? fallback)
+             (errorf "~s's value for key ~s is not a pair: ~s" ct key v)]
+            [else fallback]))))
+
+(inline-stub
+ (define-cfn concurrent-hash-table-iter (args::ScmObj* nargs::int data::void*)
+   :static
+   (cast void nargs) ; suppress unused var warning
+   (let* ([iter::ScmConcurrentHashIter* (cast ScmConcurrentHashIter* data)]
+          [k] [v]
+          [eofval (aref args 0)])
+     (if (Scm_ConcurrentHashIterNext iter (& k) (& v))
+       (return (values k v))
+       (return (values eofval eofval)))))
+ )
+
+(select-module gauche.internal)
+(define-cproc %concurrent-hash-table-iter (ct::<concurrent-hash-table>)
+  (let* ([iter::ScmConcurrentHashIter* (SCM_NEW ScmConcurrentHashIter)])
+    (Scm_ConcurrentHashIterInit iter ct)
+    (return (Scm_MakeSubr concurrent_hash_table_iter iter 1 0
+                          '"concurrent-hash-table-iterator"))))
+
+(select-module gauche)
+(define-cproc concurrent-hash-table-keys (ct::<concurrent-hash-table>)
+  Scm_ConcurrentHashTableKeys)
+(define-cproc concurrent-hash-table-values (ct::<concurrent-hash-table>)
+  Scm_ConcurrentHashTableValues)
+
+;; The traversal procedures see a snapshot of the table at the time
+;; they're called, although the entries modified or deleted during
+;; traversal may be reflected.
+(define (concurrent-hash-table-fold ct kons knil)
+  (let ([i ((with-module gauche.internal %concurrent-hash-table-iter) ct)]
+        [eof (list #f)])
+    (let loop ([r knil])
+      (receive [k v] (i eof)
+        (if (eq? k eof)
+          r
+          (loop (kons k v r)))))))
+
+(define (concurrent-hash-table-for-each ct proc)
+  (concurrent-hash-table-fold ct (^[k v _] (proc k v)) #f)
+  (undefined))
+
+(define (concurrent-hash-table-map ct proc)
+  (concurrent-hash-table-fold ct (^[k v r] (cons (proc k v) r)) '()))
+
+(define (concurrent-hash-table->alist ct)
+  (concurrent-hash-table-map ct cons))
+
+(define (alist->concurrent-hash-table a . opt-cmpr)
+  (rlet1 ct (apply make-concurrent-hash-table opt-cmpr)
+    (for-each (^x (concurrent-hash-table-put! ct (car x) (cdr x))) a)))
+
 ;;;
 ;;; TreeMap
 ;;;
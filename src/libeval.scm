@@ -36,6 +36,7 @@
 (inline-stub
  (declcode (.include <gauche/vminsn.h>
                      <gauche/class.h>
+                     <gauche/code.h>
                      <gauche/priv/readerP.h>)))
 
 (declare (keep-private-macro autoload add-load-path))
@@ -87,19 +88,28 @@
                 (if hooked? " (hooked) " "")))
       (if (not (input-port? port))
         (and error-if-not-found (raise port))
-        (load-from-port (if ignore-coding
-                          port
-                          (open-coding-aware-port port))
-                        :environment environment
-                        :paths remaining-paths)))))
+        (%load-from-port (if ignore-coding
+                           port
+                           (open-coding-aware-port port))
+                         remaining-paths environment
+                         (and (not hooked?) path))))))
 
 
 (select-module gauche.internal)
 
-;; API: The actual load operation is done here.
+;; API
 (define-in-module gauche (load-from-port port
                                          :key (paths #f)
                                               (environment #f))
+  (%load-from-port port paths environment #f))
+
+;; The actual load operation is done here.
+;; If SRCPATH is given, it is the pathname of the source file PORT is
+;; reading from, and the code cache is used if it is enabled.
+;; If IMAGE-BODY is given, it is an input port of the code cache entries
+;; of SRCPATH taken from an image, and run instead of the source.
+(define (%load-from-port port paths environment srcpath
+                         :optional (image-body #f))
   (unless (input-port? port)
     (error "input port required, but got:" port))
   (unless (or (module? environment) (not environment))
@@ -139,26 +149,128 @@
       (%record-load-stat #f)
       (%port-unlock! port))
 
-    (guard (e [else (let1 e2 (if (condition? e)
-                               ($ make-compound-condition e
-                                  $ make <load-condition-mixin>
-                                  :history (current-load-history)
-                                  :port (current-load-port)
-                                  :expr #f)
-                               e)
-                      (restore-load-context)
-                      (raise e2))])
-      (setup-load-context)
+    ;; Evaluates each toplevel form from PORT with EVAL-FORM.
+    (define (load-forms eval-form)
       ;; Discard BOM
       (when (eq? (gauche-character-encoding) 'utf-8)
         (when (eqv? (peek-char port) #\ufeff)
           (read-char port)))
       (do ([s (read port) (read port)])
           [(eof-object? s)]
-        (eval s #f)))
+        (eval-form s)))
+
+    ;; Loads the forms while saving their compiled code to the cache.
+    ;; A form whose compilation has effects other than generating the
+    ;; code, or whose code can't be saved, is saved as is to be evaluated
+    ;; again.  See codecache.c.
+    (define (load-forms/save-cache)
+      (let ([module (vm-current-module)]
+            [body (open-output-string)]
+            [cacheable? #t])
+        (load-forms
+         (^s (let* ([effects (vm-compile-effects)]
+                    [code (compile s #f)])
+               (%show-compile-result code) ; as eval does
+               (unless (or (and (= effects (vm-compile-effects))
+                                (%code-cache-put! body code))
+                           (%code-cache-put! body s))
+                 (set! cacheable? #f))
+               ((make-toplevel-closure code)))))
+        (when (and cacheable? (code-cache-directory))
+          (%code-cache-save srcpath module body))
+        (when (%image-recording?)
+          (%image-record! srcpath module (and cacheable? body)))))
+
+    ;; Runs the entries of the code cache.
+    (define (load-cache cache)
+      (let loop ([e (%code-cache-get cache)])
+        (unless (eof-object? e)
+          (if (procedure? e) (e) (eval e #f))
+          (loop (%code-cache-get cache)))))
+
+    (let1 cache #f
+      (guard (e [else (let1 e2 (if (condition? e)
+                                 ($ make-compound-condition e
+                                    $ make <load-condition-mixin>
+                                    :history (current-load-history)
+                                    :port (current-load-port)
+                                    :expr #f)
+                                 e)
+                        ;; The cache may be stale, e.g. it refers to
+                        ;; a module that no longer exists.  Make sure
+                        ;; the next load compiles the source.
+                        (when cache (%code-cache-discard srcpath))
+                        (restore-load-context)
+                        (raise e2))])
+        (setup-load-context)
+        (cond [image-body (load-cache image-body)]
+              [(%image-recording?)
+               (if (and srcpath (module-name (vm-current-module)))
+                 (load-forms/save-cache)
+                 (begin (%image-record-failure! (or srcpath port))
+                        (load-forms (^s (eval s #f)))))]
+              [(not (and srcpath
+                         (code-cache-directory)
+                         (module-name (vm-current-module))
+                         ;; The diagnostic output of the compiler needs
+                         ;; the forms to be compiled.
+                         (not (%compiler-diagnostics?))))
+               (load-forms (^s (eval s #f)))]
+              [(%code-cache-open srcpath (vm-current-module))
+               => (^c (set! cache c) (load-cache c))]
+              [else (load-forms/save-cache)])))
     (restore-load-context)
     #t))
 
+;; Code cache
+(select-module gauche)
+(define-cproc code-cache-directory () Scm_CodeCacheDirectory)
+(define-cproc set-code-cache-directory! (dir) ::<void>
+  Scm_SetCodeCacheDirectory)
+
+(select-module gauche.internal)
+(define-cproc %code-cache-open (srcpath::<string> module::<module>)
+  Scm_CodeCacheOpen)
+;; Returns a thunk to run a compiled code, a form to be evaluated, or EOF.
+(define-cproc %code-cache-get (cache::<input-port>)
+  (let* ([e (Scm_CodeCacheGet cache)])
+    (if (SCM_COMPILED_CODE_P e)
+      (return (Scm_MakeClosure e NULL))
+      (return e))))
+(define-cproc %code-cache-put! (body::<output-port> obj) ::<boolean>
+  Scm_CodeCachePut)
+(define-cproc %code-cache-save (srcpath::<string> module::<module>
+                                body::<output-port>) ::<boolean>
+  Scm_CodeCacheSave)
+(define-cproc %code-cache-discard (srcpath::<string>) ::<void>
+  Scm_CodeCacheDiscard)
+
+;; Image.  Called from main.c for --dump-image and --image options.
+(define-cproc %image-start-recording () ::<void> Scm_ImageStartRecording)
+(define-cproc %image-recording? () ::<boolean> Scm_ImageRecordingP)
+(define-cproc %image-record! (srcpath::<string> module::<module> body)
+  ::<void> Scm_ImageRecord)
+(define-cproc %image-record-failure! (what) ::<void> Scm_ImageRecordFailure)
+(define-cproc %image-dump (path::<string>) ::<void> Scm_ImageDump)
+(define-cproc %image-open (path::<string>) Scm_ImageOpen)
+
+;; Runs the entries of the image file PATH.  Returns #f if the image
+;; can't be used, in which case nothing is changed.
+(define (%image-restore path)
+  (and-let1 image (%image-open path)
+    ;; The entries are in the order their loading finished, so a
+    ;; 'require' in an entry is for a feature loaded by a preceding entry.
+    (for-each provide (car image))
+    (dolist [e (cdr image)]
+      (let ([srcpath (car e)]
+            [module (find-module (cadr e))])
+        (unless module
+          (errorf "module ~s used by image ~s doesn't exist" (cadr e) path))
+        (call-with-input-file srcpath
+          (^[in] (%load-from-port (open-coding-aware-port in)
+                                  #f module srcpath (caddr e))))))
+    #t))
+
 ;; A few helper procedures
 (define-cproc %record-load-stat (path) ::<void>
   (.if "defined(HAVE_GETTIMEOFDAY)"
@@ -184,6 +296,16 @@
 (define-cproc %load-verbose? () ::<boolean>
   (return (SCM_VM_RUNTIME_FLAG_IS_SET (Scm_VM) SCM_LOAD_VERBOSE)))
 
+;; Used by %load-from-port, to make the code cache produce the same
+;; output as compiling the source.
+(define-cproc %compiler-diagnostics? () ::<boolean>
+  (return (SCM_VM_COMPILER_FLAG_IS_SET (Scm_VM)
+                                       (logior SCM_COMPILE_SHOWRESULT
+                                               SCM_COMPILE_INCLUDE_VERBOSE))))
+(define-cproc %show-compile-result (code::<compiled-code>) ::<void>
+  (when (SCM_VM_COMPILER_FLAG_IS_SET (Scm_VM) SCM_COMPILE_SHOWRESULT)
+    (Scm_CompiledCodeDump code)))
+
 ;; Called from Scm_DynLoad to get initfn name, which always begins with #\_.
 ;; If INITFN is given, we just add "_" in front of it.  Otherwise we
 ;; derive it from the name of DSO.
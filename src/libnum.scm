@@ -126,6 +126,17 @@
 (define-cproc %bignum-dump (obj) ::<void>
   (when (SCM_BIGNUMP obj)
     (Scm_DumpBignum (SCM_BIGNUM obj) SCM_CUROUT)))
+;; Thresholds (in words) to switch to subquadratic algorithms.  For
+;; testing and tuning.  Returns the previous value; with no argument,
+;; just returns the current value.
+(define-cproc %bignum-karatsuba-threshold (:optional (value::<int> -1))
+  ::<int> Scm__BignumKaratsubaThreshold)
+(define-cproc %bignum-toom3-threshold (:optional (value::<int> -1))
+  ::<int> Scm__BignumToom3Threshold)
+(define-cproc %bignum-div-threshold (:optional (value::<int> -1))
+  ::<int> Scm__BignumDivThreshold)
+(define-cproc %bignum-radix-conv-threshold (:optional (value::<int> -1))
+  ::<int> Scm__BignumRadixConvThreshold)
 
 ;;
 ;; Comparison
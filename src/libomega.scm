@@ -227,11 +227,12 @@
 
 ;;
 ;; Turn on generic dispatcher on selected gfs.
-;; Eventually, we automate attaching dispacher whenever gf meets certain
-;; criteria.  The dispatcher is so effective, (e.g. ref <vector>
-;; gets 8x speedup) so we manually turn it on for soem gfs.
-;; In case if bug is found in dispatcher mechanism, use -fno-generic-dispatcher
-;; option to turn off dispatchers.
+;; Other gfs get the dispatcher automatically when they meet certain
+;; criteria (see dispatch.c), but we know these benefit from it (e.g.
+;; ref <vector> gets 8x speedup), so we build it from the start.
+;; In case if bug is found in dispatcher mechanism, set
+;; GAUCHE_DISABLE_GENERIC_DISPATCHER environment variable to turn off
+;; dispatchers.
 ;;
 (with-module gauche.object
   (generic-build-dispatcher! ref 0)
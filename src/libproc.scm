@@ -211,14 +211,26 @@
 ;;;
 
 (select-module gauche)
-(define-cproc profiler-start () ::<void> Scm_ProfilerStart)
+(define-cproc profiler-start (:key (all-threads::<boolean> #f)
+                                   (period::<ulong> 0)) ::<void>
+  (Scm_ProfilerStartWithFlags (?: all-threads SCM_PROFILER_ALL_THREADS 0)
+                              period))
 (define-cproc profiler-stop  () ::<int>  Scm_ProfilerStop)
 (define-cproc profiler-reset () ::<void> Scm_ProfilerReset)
 
+(define-cproc alloc-profiler-start (:key (interval::<ulong> 0)) ::<void>
+  Scm_AllocProfilerStart)
+(define-cproc alloc-profiler-stop  () ::<void> Scm_AllocProfilerStop)
+(define-cproc alloc-profiler-reset () ::<void> Scm_AllocProfilerReset)
+
 (select-module gauche.internal)
 ;; Autoloaded profiler-get-result will use this.
 ;; See lib/gauche/vm/profiler.scm
 (define-cproc profiler-raw-result () Scm_ProfilerRawResult)
+(define-cproc profiler-raw-stacks () Scm_ProfilerRawStacks)
+(define-cproc profiler-sampling-period () ::<ulong> Scm_ProfilerSamplingPeriod)
+(define-cproc alloc-profiler-raw-result () Scm_AllocProfilerRawResult)
+(define-cproc alloc-profiler-interval () ::<ulong> Scm_AllocProfilerInterval)
 
 ;;;
 ;;; Introspection
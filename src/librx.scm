@@ -96,6 +96,21 @@
     (return SCM_NIL)
     (rxmatchop (-> (SCM_REGMATCH match) grpNames))))
 
+(define-cproc regexp-set? (obj) ::<boolean> SCM_REGEXP_SET_P)
+(define-cproc make-regexp-set (regexps)
+  (let* ([h SCM_NIL] [t SCM_NIL])
+    (dolist [rx regexps]
+      (if (SCM_STRINGP rx)
+        (SCM_APPEND1 h t (Scm_RegComp (SCM_STRING rx) 0))
+        (SCM_APPEND1 h t rx)))
+    (return (Scm_MakeRegexpSet h))))
+(define-cproc regexp-set-regexps (rs::<regexp-set>)
+  (let* ([h SCM_NIL] [t SCM_NIL])
+    (dotimes [i (-> rs numRegexps)]
+      (SCM_APPEND1 h t (SCM_OBJ (aref (-> rs regexps) i))))
+    (return h)))
+(define-cproc regexp-set-match (rs::<regexp-set> input) Scm_RegexpSetMatch)
+
 (select-module gauche.internal)
 (define-cproc %regexp-dump (rx::<regexp>) ::<void> Scm_RegDump)
 (define-cproc %regmatch-dump (rm::<regmatch>) ::<void> Scm_RegMatchDump)
@@ -106,6 +121,18 @@
   (return (-> regexp pattern)))
 (define-cproc %regexp-laset (regexp::<regexp>) ; for testing
   (return (-> regexp laset)))
+(define-cproc %regexp-must-match (regexp::<regexp>) ; for testing
+  (return (?: (-> regexp mustMatch) (SCM_OBJ (-> regexp mustMatch)) '#f)))
+(define-cproc %regexp-dfa? (regexp::<regexp>) ::<boolean> ; for testing
+  (return (!= (-> regexp dfa) NULL)))
+;; Turn on/off the lazy DFA matcher and the literal prefilter for testing
+;; and benchmarking.  Returns the previous setting.
+(define-cproc %regexp-use-dfa (:optional flag) ::<boolean>
+  (return (Scm__RegexpUseDFA (?: (SCM_UNBOUNDP flag) -1
+                                 (?: (SCM_FALSEP flag) 0 1)))))
+(define-cproc %regexp-use-prefilter (:optional flag) ::<boolean>
+  (return (Scm__RegexpUsePrefilter (?: (SCM_UNBOUNDP flag) -1
+                                       (?: (SCM_FALSEP flag) 0 1)))))
 
 (select-module gauche.internal)
 ;; aux routine for regexp-replace[-all]
@@ -196,6 +223,13 @@
       (rlet1 s (regexp-unparse (regexp-ast rx))
         (set! (%regexp-pattern rx) s))))
 
+(define-in-module gauche (regexp-set-rxmatch rs str)
+  (let1 ks (regexp-set-match rs str)
+    (if (null? ks)
+      (values #f #f)
+      (values (rxmatch (list-ref (regexp-set-regexps rs) (car ks)) str)
+              (car ks)))))
+
 (define-in-module gauche (rxmatch->string rx str . sel)
   (cond [(null? sel) (rxmatch-substring (rxmatch rx str))]
         [(eq? (car sel) 'after)
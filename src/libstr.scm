@@ -108,6 +108,13 @@
 (define-cproc string-size (str::<string>) ::<fixnum> :constant
   (return (SCM_STRING_BODY_SIZE (SCM_STRING_BODY str))))
 
+;; Character index of multibyte strings.  See "Character index" in string.c
+(define-cproc string-build-index! (str::<string>) Scm_StringBuildIndex)
+(define-cproc string-fast-indexable? (str::<string>) ::<boolean>
+  (return (Scm_StringBodyFastIndexableP (SCM_STRING_BODY str))))
+(define-cproc string-character-index-interval (:optional (n::<fixnum> -1))
+  ::<fixnum> Scm_StringIndexInterval)
+
 (select-module gauche.internal)
 ;; see lib/gauche/stringutil.scm for generic string-split
 (define-cproc %string-split-by-char (s::<string> ch::<char>
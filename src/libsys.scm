@@ -1281,6 +1281,28 @@
    ) ;; when defined(HAVE_SELECT)
  )
 
+;;---------------------------------------------------------------------
+;; poll/epoll
+
+(inline-stub
+ (define-type <sys-poller> "ScmSysPoller*")
+
+ (when "defined(HAVE_POLL)"
+   (define-cproc sys-poller-set! (poller::<sys-poller> pf flags::<list>)
+     ::<void>
+     (Scm_SysPollerSet poller (Scm_GetPortFd pf TRUE) flags))
+
+   (define-cproc sys-poller-wait (poller::<sys-poller> :optional (timeout #f))
+     Scm_SysPollerWait)
+
+   (define-cproc sys-poller-backend (poller::<sys-poller>)
+     Scm_SysPollerBackend)
+
+   (define-cproc sys-poller-close (poller::<sys-poller>) ::<void>
+     Scm_SysPollerClose)
+   ) ;; when defined(HAVE_POLL)
+ )
+
 ;;---------------------------------------------------------------------
 ;; miscellaneous
 
@@ -242,6 +242,7 @@
   (return (Scm_VMUVectorRef v SCM_UVECTOR_U64 i fallback)))
 
 (define-cproc f16vector-set! (v::<f16vector> i::<fixnum> val :optional clamp)
+  :fast-flonum
   (return (Scm_UVectorSet v SCM_UVECTOR_F16 i val (Scm_ClampMode clamp))))
 (define-cproc f16vector-ref (v::<f16vector> i::<fixnum> :optional fallback)
   :fast-flonum
@@ -249,6 +250,7 @@
   (return (Scm_VMUVectorRef v SCM_UVECTOR_F16 i fallback)))
 
 (define-cproc f32vector-set! (v::<f32vector> i::<fixnum> val :optional clamp)
+  :fast-flonum
   (return (Scm_UVectorSet v SCM_UVECTOR_F32 i val (Scm_ClampMode clamp))))
 (define-cproc f32vector-ref (v::<f32vector> i::<fixnum> :optional fallback)
   :fast-flonum
@@ -256,6 +258,7 @@
   (return (Scm_VMUVectorRef v SCM_UVECTOR_F32 i fallback)))
 
 (define-cproc f64vector-set! (v::<f64vector> i::<fixnum> val :optional clamp)
+  :fast-flonum
   (return (Scm_UVectorSet v SCM_UVECTOR_F64 i val (Scm_ClampMode clamp))))
 (define-cproc f64vector-ref (v::<f64vector> i::<fixnum> :optional fallback)
   :fast-flonum
@@ -934,6 +934,15 @@ int Scm_ProvidedP(ScmObj feature)
     return r;
 }
 
+/* Returns a fresh list of the provided features. */
+ScmObj Scm_ProvidedFeatures(void)
+{
+    (void)SCM_INTERNAL_MUTEX_LOCK(ldinfo.prov_mutex);
+    ScmObj r = Scm_CopyList(ldinfo.provided);
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(ldinfo.prov_mutex);
+    return r;
+}
+
 /*------------------------------------------------------------------
  * Autoload
  */
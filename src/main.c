@@ -62,6 +62,8 @@ int interactive_mode = FALSE;   /* force interactive mode */
 int test_mode = FALSE;          /* add . and ../lib implicitly  */
 int profiling_mode = FALSE;     /* profile the script? */
 int stats_mode = FALSE;         /* collect stats (EXPERIMENTAL) */
+const char *image_file = NULL;  /* --image */
+const char *dump_image_file = NULL; /* --dump-image */
 
 ScmObj pre_cmds = SCM_NIL;      /* assoc list of commands that needs to be
                                    processed before entering repl.
@@ -91,7 +93,7 @@ ScmModule *default_toplevel_module = NULL;
 void usage(void)
 {
     fprintf(stderr,
-            "Usage: gosh [-biqV][-I<path>][-A<path>][-u<module>][-m<module>][-l<file>][-L<file>][-e<expr>][-E<expr>][-p<type>][-F<feature>][-r<standard>][-f<flag>][--] [file]\n"
+            "Usage: gosh [-biqV][-I<path>][-A<path>][-u<module>][-m<module>][-l<file>][-L<file>][-e<expr>][-E<expr>][-p<type>][-F<feature>][-r<standard>][-f<flag>][--image=<file>][--dump-image=<file>][--] [file]\n"
             "Options:\n"
             "  -V       Prints version and exits.\n"
             "  -b       Batch mode.  Doesn't print prompts.  Supersedes -i.\n"
@@ -129,6 +131,10 @@ void usage(void)
             "      case-fold       uses case-insensitive reader (as in R5RS)\n"
             "      load-verbose    report while loading files\n"
             "      include-verbose report while including files\n"
+            "      jit             compile frequently called closures into native\n"
+            "                      code (on x86_64; ignored on other platforms)\n"
+            "      no-jit          don't compile closures into native code, even if\n"
+            "                      GAUCHE_JIT is set\n"
             "      warn-legacy-syntax\n"
             "                      print warning when legacy Gauche syntax is encountered\n"
             "      no-inline       don't inline procedures & constants (combined\n"
@@ -146,16 +152,26 @@ void usage(void)
             "                      don't run post-inline optimization pass.\n"
             "      no-source-info  don't preserve source information for debugging\n"
             "      test            test mode, to run gosh inside the build tree\n"
+            "  --dump-image=<file> Loads the libraries and files given by -u, -l,\n"
+            "           -L and -r options, saves their compiled code in <file>\n"
+            "           and exits.\n"
+            "  --image=<file> Runs the compiled code saved by --dump-image in\n"
+            "           <file> at startup, instead of loading the files.\n"
             "Environment variables:\n"
             "  GAUCHE_AVAILABLE_PROCESSORS\n"
             "      Value must be an integer.  If set, it overrides the number of\n"
             "      available processors on the system, returned from\n"
             "      `sys-available-processors'.\n"
+            "  GAUCHE_CODE_CACHE_DIR\n"
+            "      If set to a directory, caches compiled code of loaded files there.\n"
             "  GAUCHE_DYNLOAD_PATH\n"
             "      Directories separated by colon (on Unix) or semilcolon (on Windows)\n"
             "      to search dynamically loadable files.\n"
             "  GAUCHE_EDITOR\n"
             "      Path of the editor invoked with `ed'.\n"
+            "  GAUCHE_JIT\n"
+            "      If set, compiles frequently called closures into native code,\n"
+            "      as -fjit.\n"
             "  GAUCHE_KEYWORD_IS_SYMBOL\n"
             "      If set, keywords become subclass of symbols, to be fully R7RS\n"
             "      conformant.  This is the current default behavior.  Legacy code may\n"
@@ -168,6 +184,10 @@ void usage(void)
             "  GAUCHE_LOAD_PATH\n"
             "      Directories separated by colon (on Unix) or semilcolon (on Windows)\n"
             "      to search scheme files to load.\n"
+            "  GAUCHE_PROFILER_SIGNAL\n"
+            "      A signal name (e.g. USR2) or number.  If set, the signal toggles\n"
+            "      the profiler on all threads.  When turned off, the call stacks\n"
+            "      are written to gauche-profile-<pid>.txt for flame graph tools.\n"
             "  GAUCHE_QUASIRENAME_MODE\n"
             "      Customize quasirename compatibility mode.  See 'Explicit-renaming\n"
             "      macro transformer' section of the manual for the details."
@@ -269,6 +289,12 @@ void further_options(const char *optarg)
     else if (strcmp(optarg, "case-fold") == 0) {
         SCM_VM_RUNTIME_FLAG_SET(vm, SCM_CASE_FOLD);
     }
+    else if (strcmp(optarg, "jit") == 0) {
+        SCM_VM_RUNTIME_FLAG_SET(vm, SCM_ENABLE_JIT);
+    }
+    else if (strcmp(optarg, "no-jit") == 0) {
+        SCM_VM_RUNTIME_FLAG_CLEAR(vm, SCM_ENABLE_JIT);
+    }
     else if (strcmp(optarg, "warn-legacy-syntax") == 0) {
         Scm_SetReaderLexicalMode(SCM_INTERN("warn-legacy"));
     }
@@ -298,7 +324,22 @@ void further_options(const char *optarg)
     }
     else {
         fprintf(stderr, "unknown -f option: %s\n", optarg);
-        fprintf(stderr, "supported options are: -fcase-fold, -fload-verbose, -finclude-verbose, -fno-dissolve-apply -fno-inline, -fno-inline-globals, -fno-inline-locals, -fno-inline-constants, -fno-inline-setters, -fno-source-info, -fno-post-inline-pass, -fno-lambda-lifting-pass, -fwarn-legacy-syntax, or -ftest\n");
+        fprintf(stderr, "supported options are: -fcase-fold, -fload-verbose, -finclude-verbose, -fjit, -fno-jit, -fno-dissolve-apply -fno-inline, -fno-inline-globals, -fno-inline-locals, -fno-inline-constants, -fno-inline-setters, -fno-source-info, -fno-post-inline-pass, -fno-lambda-lifting-pass, -fwarn-legacy-syntax, or -ftest\n");
+        exit(1);
+    }
+}
+
+void long_options(const char *optarg)
+{
+    if (strncmp(optarg, "image=", 6) == 0 && optarg[6]) {
+        image_file = optarg+6;
+    }
+    else if (strncmp(optarg, "dump-image=", 11) == 0 && optarg[11]) {
+        dump_image_file = optarg+11;
+    }
+    else {
+        fprintf(stderr, "unknown option: --%s\n", optarg);
+        fprintf(stderr, "supported options are: --image=<file> or --dump-image=<file>\n");
         exit(1);
     }
 }
@@ -331,7 +372,9 @@ void feature_options(const char *optarg)
 int parse_options(int argc, char *argv[])
 {
     int c;
-    while ((c = getopt(argc, argv, "+be:E:ip:ql:L:m:u:Vv:r:F:f:I:A:-")) >= 0) {
+    /* NB: "--" alone ends the options as usual, and "--<name>=<value>"
+       is passed to long_options with optarg "<name>=<value>". */
+    while ((c = getopt(argc, argv, "+be:E:ip:ql:L:m:u:Vv:r:F:f:I:A:-:")) >= 0) {
         switch (c) {
         case 'b': batch_mode = TRUE; break;
         case 'i': interactive_mode = TRUE; break;
@@ -360,7 +403,7 @@ int parse_options(int argc, char *argv[])
                 /*NOTREACHED*/
             }
             break;
-        case '-': break;
+        case '-': long_options(optarg); break;
         case '?': usage(); break;
         }
     }
@@ -568,6 +611,30 @@ static void process_command_args(ScmObj cmd_args)
     }
 }
 
+/* Runs the image saved by --dump-image.  If the image can't be used,
+   a warning is shown and we start as usual. */
+static void restore_image(const char *file)
+{
+    static ScmObj restore_proc = SCM_UNDEFINED;
+    SCM_BIND_PROC(restore_proc, "%image-restore", Scm_GaucheInternalModule());
+    ScmEvalPacket epak;
+    if (Scm_Apply(restore_proc, SCM_LIST1(SCM_MAKE_STR_COPYING(file)),
+                  &epak) < 0) {
+        error_exit(epak.exception);
+    }
+}
+
+static void dump_image(const char *file)
+{
+    static ScmObj dump_proc = SCM_UNDEFINED;
+    SCM_BIND_PROC(dump_proc, "%image-dump", Scm_GaucheInternalModule());
+    ScmEvalPacket epak;
+    if (Scm_Apply(dump_proc, SCM_LIST1(SCM_MAKE_STR_COPYING(file)),
+                  &epak) < 0) {
+        error_exit(epak.exception);
+    }
+}
+
 /* When scriptfile is provided, execute it.  Returns exit code. */
 int execute_script(const char *scriptfile, ScmObj args)
 {
@@ -749,8 +816,22 @@ int main(int ac, char **av)
         args = Scm_InitCommandLine(1, (const char**)argv);
     }
 
+    if (image_file) restore_image(image_file);
+    if (dump_image_file) {
+        if (scriptfile != NULL) {
+            fprintf(stderr, "--dump-image can't be used with a script file\n");
+            exit(1);
+        }
+        Scm_ImageStartRecording();
+    }
+
     process_command_args(Scm_Reverse(pre_cmds));
 
+    if (dump_image_file) {
+        dump_image(dump_image_file);
+        Scm_Exit(0);
+    }
+
     /* Set up instruments. */
     ScmLoadPacket lpak;
     if (profiling_mode) {
@@ -759,6 +840,15 @@ int main(int ac, char **av)
         }
         Scm_ProfilerStart();
     }
+    const char *profsig = Scm_GetEnv("GAUCHE_PROFILER_SIGNAL");
+    if (profsig != NULL) {
+        ScmEvalPacket epak;
+        if (Scm_Eval(SCM_LIST2(SCM_INTERN("profiler-toggle-on-signal"),
+                               SCM_MAKE_STR_COPYING(profsig)),
+                     SCM_OBJ(Scm_GaucheModule()), &epak) < 0) {
+            error_exit(epak.exception);
+        }
+    }
     Scm_AddCleanupHandler(cleanup_main, NULL);
 
 #if defined(GAUCHE_WINDOWS)
@@ -3941,24 +3941,18 @@ enum { /* used in the exactness flag */
     NOEXACT, EXACT, INEXACT
 };
 
-/* Max digits D such that all D-digit radix R integers fit in signed
-   long, i.e. R^(D+1)-1 <= LONG_MAX */
-static long longdigs[RADIX_MAX-RADIX_MIN+1] = { 0 };
-
 /* Max integer I such that reading next digit (in radix R) will overflow
    long integer.   floor(LONG_MAX/R - R). */
 static u_long longlimit[RADIX_MAX-RADIX_MIN+1] = { 0 };
 
-/* An integer table of R^D, which is a "big digit" to be added
-   into bignum. */
-static u_long bigdig[RADIX_MAX-RADIX_MIN+1] = { 0 };
-
 static ScmObj numread_error(const char *msg, struct numread_packet *context);
 
 /* Returns either small integer or bignum.
    initval may be a Scheme integer that will be 'concatenated' before
    the integer to be read; it is used to read floating-point number.
-   Note that value_big may keep denormalized bignum. */
+   Once the value doesn't fit in a word, we just keep the digits and
+   convert them at once with Scm_BignumFromDigits, which is subquadratic
+   for large numbers. */
 static ScmObj read_uint(const char **strp, int *lenp,
                         struct numread_packet *ctx,
                         ScmObj initval)
@@ -3967,21 +3961,18 @@ static ScmObj read_uint(const char **strp, int *lenp,
     int digread = FALSE;
     int len = *lenp;
     int radix = ctx->radix;
-    int digits = 0, diglimit = longdigs[radix-RADIX_MIN];
-    u_long limit = longlimit[radix-RADIX_MIN], bdig = bigdig[radix-RADIX_MIN];
+    u_long limit = longlimit[radix-RADIX_MIN];
     u_long value_int = 0;
-    ScmBignum *value_big = NULL;
+    int overflow = FALSE;       /* value_int isn't enough */
+    char digbuf[64] = {0}, *digs = digbuf;
+    int ndigs = 0, digsize = sizeof(digbuf);
     static const char tab[] = "0123456789abcdefghijklmnopqrstuvwxyz";
 
     if (!SCM_FALSEP(initval)) {
-        if (SCM_INTP(initval)) {
-            if ((u_long)SCM_INT_VALUE(initval) > limit) {
-                value_big = Scm_MakeBignumWithSize(4, SCM_INT_VALUE(initval));
-            } else {
-                value_int = SCM_INT_VALUE(initval);
-            }
-        } else if (SCM_BIGNUMP(initval)) {
-            value_big = SCM_BIGNUM(Scm_BignumCopy(SCM_BIGNUM(initval)));
+        if (SCM_INTP(initval) && (u_long)SCM_INT_VALUE(initval) <= limit) {
+            value_int = SCM_INT_VALUE(initval);
+        } else {
+            overflow = TRUE;
         }
         digread = TRUE;
     } else if (*str == '0') {
@@ -4017,28 +4008,29 @@ static ScmObj read_uint(const char **strp, int *lenp,
             }
         }
         if (digval < 0) break;
-        value_int = value_int * radix + digval;
-        digits++;
-        if (value_big == NULL) {
-            if (value_int >= limit) {
-                value_big = Scm_MakeBignumWithSize(4, value_int);
-                value_int = digits = 0;
-            }
-        } else if (digits > diglimit) {
-            value_big = Scm_BignumAccMultAddUI(value_big, bdig, value_int);
-            value_int = digits = 0;
+        if (ndigs == digsize) {
+            char *newdigs = SCM_NEW_ATOMIC_ARRAY(char, digsize*2);
+            memcpy(newdigs, digs, digsize);
+            digs = newdigs;
+            digsize *= 2;
+        }
+        digs[ndigs++] = (char)digval;
+        if (!overflow) {
+            value_int = value_int * radix + digval;
+            if (value_int >= limit) overflow = TRUE;
         }
     }
     *strp = str-1;
     *lenp = len+1;
 
-    if (value_big == NULL) return Scm_MakeInteger(value_int);
-    if (digits > 0) {
-        value_big = Scm_BignumAccMultAddUI(value_big,
-                                           ipow(radix, digits),
-                                           value_int);
+    if (!overflow) return Scm_MakeInteger(value_int);
+    ScmObj v = Scm_BignumFromDigits(digs, ndigs, radix);
+    if (!SCM_FALSEP(initval)) {
+        ScmObj scale = Scm_ExactIntegerExpt(SCM_MAKE_INT(radix),
+                                            SCM_MAKE_INT(ndigs));
+        v = Scm_Add(Scm_Mul(initval, scale), v);
     }
-    return Scm_NormalizeBignum(SCM_BIGNUM(value_big));
+    return v;
 }
 
 /*
@@ -4531,15 +4523,6 @@ void Scm__InitNumber(void)
     for (int radix = RADIX_MIN; radix <= RADIX_MAX; radix++) {
         longlimit[radix-RADIX_MIN] =
             (u_long)floor((double)LONG_MAX/radix - radix);
-        /* Find max D where R^(D+1)-1 <= LONG_MAX */
-        u_long n = 1;
-        for (int i = 0; ; i++, n *= radix) {
-            if (n >= (u_long)(LONG_MAX/radix)) {
-                longdigs[radix-RADIX_MIN] = i-1;
-                bigdig[radix-RADIX_MIN] = n;
-                break;
-            }
-        }
     }
 
     SCM_2_63 = Scm_Ash(SCM_MAKE_INT(1), 63);
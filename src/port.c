@@ -839,139 +839,173 @@ static ScmSize bufport_read(ScmPort *p, char *dst, ScmSize siz)
  *
  *   The OS doesn't automatically flush the buffered output port,
  *   as it does on FILE* structure.  So Gauche keeps track of active
- *   output buffered ports, in a weak vector.
- *   When the port is no longer used, it is collected by GC and removed
- *   from the vector.   Scm_FlushAllPorts() flushes the active ports.
+ *   output buffered ports.  Scm_FlushAllPorts() flushes the active ports.
  *
- *   Note that we don't remove entry from the weak vector explicitly.
- *   We used to do that in the port finalizer; however, the finalizer
- *   is called _after_ GC has run and determined the port is a garbage,
- *   and at that moment GC has already cleared the vector entry.  So we
- *   can rather let GC remove the entries.
+ *   The registry is divided into PORT_SHARDS shards, chosen by the port's
+ *   address, so that threads opening and closing ports rarely contend
+ *   on the same mutex.  Each shard keeps the ports in a weak vector, so
+ *   that the registry doesn't prevent the ports from being collected.
+ *   Unused slots of the vector are kept in a free list, and a hash table
+ *   maps a port to its slot.  The key of the hash table is the port's
+ *   address disguised by PORT_KEY, so that it doesn't keep the port
+ *   alive either.  Registering and unregistering are O(1).
  *
- *   When we find the weak vector is full, we trigger a global GC once.
- *   It may collect garbaged ports and make some room in the vector,
- *   even though the ports are not finalized (GC_gcollect doesn't call
- *   finalizers; they are called at the next checkpoint in VM).
+ *   A port is unregistered when it is closed, either explicitly or
+ *   by its finalizer.  Note that GC clears the weak vector entry
+ *   _before_ the finalizer is called, so we may see a cleared entry
+ *   whose slot hasn't been freed yet; the slot is freed when the
+ *   finalizer unregisters the port.
+ *
+ *   When a shard runs out of free slots, its vector is doubled.  We
+ *   never need to run GC to make room.
  */
 
-/*TODO: allow to extend the port vector. */
-
-#define PORT_VECTOR_SIZE 256    /* need to be 2^n */
+#define PORT_SHARDS      16     /* need to be 2^n */
+#define PORT_SHARD_INIT  16     /* initial # of slots of a shard */
 
-static struct {
-    ScmWeakVector   *ports;
+typedef struct port_shard_rec {
+    ScmWeakVector   *ports;     /* registered ports.  #f for free slots,
+                                   #t for the slots being flushed by
+                                   Scm_FlushAllPorts(). */
+    int             *freeSlots; /* stack of free slot indexes */
+    int              numFree;
+    ScmHashCore      slotOf;    /* PORT_KEY(port) -> slot index */
     ScmInternalMutex mutex;
-} active_buffered_ports;
+} port_shard;
+
+static port_shard active_buffered_ports[PORT_SHARDS];
 
 #define PORT_HASH(port)  \
-    ((((SCM_WORD(port)>>3) * 2654435761UL)>>16) % PORT_VECTOR_SIZE)
+    ((((SCM_WORD(port)>>3) * 2654435761UL)>>16) % PORT_SHARDS)
+#define PORT_KEY(port)   (~(intptr_t)(port))
 
-static void register_buffered_port(ScmPort *port)
+static void port_shard_init(port_shard *shard)
 {
-    int i, h, c;
-    int tried_gc = FALSE;
-    int need_gc  = FALSE;
-
-  retry:
-    h = i = (int)PORT_HASH(port);
-    c = 0;
-    /* search an available entry by quadratic hash
-       used entry may have #<port> or #t.  #t is for transient state
-       during Scm_FlushAllPorts()---see below. */
-    (void)SCM_INTERNAL_MUTEX_LOCK(active_buffered_ports.mutex);
-    while (!SCM_FALSEP(Scm_WeakVectorRef(active_buffered_ports.ports,
-                                         i, SCM_FALSE))) {
-        i -= ++c; while (i<0) i+=PORT_VECTOR_SIZE;
-        if (i == h) {
-            /* Vector entry is full.  We run global GC to try to collect
-               unused entry. */
-            need_gc = TRUE;
-            break;
-        }
+    (void)SCM_INTERNAL_MUTEX_INIT(shard->mutex);
+    shard->ports = SCM_WEAK_VECTOR(Scm_MakeWeakVector(PORT_SHARD_INIT));
+    shard->freeSlots = SCM_NEW_ATOMIC_ARRAY(int, PORT_SHARD_INIT);
+    for (int i=0; i<PORT_SHARD_INIT; i++) {
+        shard->freeSlots[i] = PORT_SHARD_INIT-i-1;
     }
-    if (!need_gc) {
-        Scm_WeakVectorSet(active_buffered_ports.ports, i, SCM_OBJ(port));
-    }
-    (void)SCM_INTERNAL_MUTEX_UNLOCK(active_buffered_ports.mutex);
+    shard->numFree = PORT_SHARD_INIT;
+    Scm_HashCoreInitSimple(&shard->slotOf, SCM_HASH_WORD, 0, NULL);
+}
 
-    if (need_gc) {
-        if (tried_gc) {
-            /* We should probably try to extend the weak vector.
-               But for the time being... */
-            Scm_Panic("active buffered port table overflow");
-        } else {
-            GC_gcollect();
-            tried_gc = TRUE;
-            need_gc = FALSE;
-            goto retry;
-        }
+/* Double the slots of the shard.  Called with shard->mutex held,
+   when there's no free slots. */
+static void port_shard_extend(port_shard *shard)
+{
+    ScmWeakVector *ov = shard->ports;
+    ScmSmallInt osize = ov->size, nsize = osize*2;
+    ScmWeakVector *nv = SCM_WEAK_VECTOR(Scm_MakeWeakVector(nsize));
+    int *freeSlots = SCM_NEW_ATOMIC_ARRAY(int, nsize);
+
+    for (ScmSmallInt i=0; i<osize; i++) {
+        /* NB: The entry of a port that has been collected but not yet
+           finalized reads as #f.  We keep its slot in use until the
+           port is unregistered. */
+        Scm_WeakVectorSet(nv, i, Scm_WeakVectorRef(ov, i, SCM_FALSE));
+        Scm_WeakVectorSet(ov, i, SCM_FALSE);
     }
+    for (ScmSmallInt i=0; i<nsize-osize; i++) {
+        freeSlots[i] = (int)(nsize-i-1);
+    }
+    shard->ports = nv;
+    shard->freeSlots = freeSlots;
+    shard->numFree = (int)(nsize-osize);
+}
+
+/* Free the slot of PORT.  Called with shard->mutex held. */
+static void port_shard_release(port_shard *shard, ScmPort *port)
+{
+    ScmDictEntry *e = Scm_HashCoreSearch(&shard->slotOf, PORT_KEY(port),
+                                         SCM_DICT_DELETE);
+    if (e == NULL) return;
+    int i = (int)SCM_INT_VALUE(SCM_DICT_VALUE(e));
+    Scm_WeakVectorSet(shard->ports, i, SCM_FALSE);
+    shard->freeSlots[shard->numFree++] = i;
+}
+
+static void register_buffered_port(ScmPort *port)
+{
+    port_shard *shard = &active_buffered_ports[PORT_HASH(port)];
+
+    (void)SCM_INTERNAL_MUTEX_LOCK(shard->mutex);
+    /* In case a stale entry of a port that used to live at the same
+       address is left. */
+    port_shard_release(shard, port);
+    if (shard->numFree == 0) port_shard_extend(shard);
+    int i = shard->freeSlots[--shard->numFree];
+    Scm_WeakVectorSet(shard->ports, i, SCM_OBJ(port));
+    ScmDictEntry *e = Scm_HashCoreSearch(&shard->slotOf, PORT_KEY(port),
+                                         SCM_DICT_CREATE);
+    (void)SCM_DICT_SET_VALUE(e, SCM_MAKE_INT(i));
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(shard->mutex);
 }
 
-/* This should be called when the output buffered port is explicitly closed.
-   The ports collected by GC are automatically unregistered. */
+/* This is called when the output buffered port is closed, either
+   explicitly or by the finalizer. */
 static void unregister_buffered_port(ScmPort *port)
 {
-    int h = (int)PORT_HASH(port);
-    int i = h;
-    int c = 0;
-    (void)SCM_INTERNAL_MUTEX_LOCK(active_buffered_ports.mutex);
-    do {
-        ScmObj p = Scm_WeakVectorRef(active_buffered_ports.ports, i, SCM_FALSE);
-        if (!SCM_FALSEP(p) && SCM_EQ(SCM_OBJ(port), p)) {
-            Scm_WeakVectorSet(active_buffered_ports.ports, i, SCM_FALSE);
-            break;
-        }
-        i -= ++c; while (i<0) i+=PORT_VECTOR_SIZE;
-    } while (i != h);
-    (void)SCM_INTERNAL_MUTEX_UNLOCK(active_buffered_ports.mutex);
+    port_shard *shard = &active_buffered_ports[PORT_HASH(port)];
+
+    (void)SCM_INTERNAL_MUTEX_LOCK(shard->mutex);
+    port_shard_release(shard, port);
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(shard->mutex);
 }
 
 /* Flush all ports.  Note that it is possible that this routine can be
    called recursively if one of the flushing routine calls Scm_Exit.
-   In order to avoid infinite loop, I have to delete the entries of already
+   In order to avoid infinite loop, I have to mark the entries of already
    flushed port before calling flush, then recover them before return
    (unless exitting is true, in that case we know nobody cares the active
    port vector anymore).
    Even if more than one thread calls Scm_FlushAllPorts simultaneously,
-   the flush method is called only once for each vector.
+   the flush method is called only once for each port.
  */
 void Scm_FlushAllPorts(int exitting)
 {
-    ScmObj p = SCM_FALSE;
-    int saved = 0;
-
-    ScmVector *save = SCM_VECTOR(Scm_MakeVector(PORT_VECTOR_SIZE, SCM_FALSE));
-    ScmWeakVector *ports = active_buffered_ports.ports;
-
-    for (int i=0; i<PORT_VECTOR_SIZE;) {
-        (void)SCM_INTERNAL_MUTEX_LOCK(active_buffered_ports.mutex);
-        for (; i<PORT_VECTOR_SIZE; i++) {
-            p = Scm_WeakVectorRef(ports, i, SCM_FALSE);
-            if (SCM_PORTP(p)) {
-                Scm_VectorSet(save, i, p);
-                /* Set #t so that the slot won't be reused. */
-                Scm_WeakVectorSet(ports, i, SCM_TRUE);
-                saved++;
-                break;
+    for (int s=0; s<PORT_SHARDS; s++) {
+        port_shard *shard = &active_buffered_ports[s];
+        ScmObj saved = SCM_NIL;  /* ((port . slot) ...) */
+
+        for (ScmSmallInt i=0;;) {
+            ScmObj p = SCM_FALSE;
+            (void)SCM_INTERNAL_MUTEX_LOCK(shard->mutex);
+            /* NB: shard->ports may be extended while we're flushing, but
+               the slot indexes are preserved. */
+            for (; i<shard->ports->size; i++) {
+                p = Scm_WeakVectorRef(shard->ports, i, SCM_FALSE);
+                if (SCM_PORTP(p)) {
+                    saved = Scm_Acons(p, SCM_MAKE_INT(i), saved);
+                    /* Set #t so that the slot won't be reused. */
+                    Scm_WeakVectorSet(shard->ports, i++, SCM_TRUE);
+                    break;
+                }
             }
-        }
-        (void)SCM_INTERNAL_MUTEX_UNLOCK(active_buffered_ports.mutex);
-        if (SCM_PORTP(p)) {
+            (void)SCM_INTERNAL_MUTEX_UNLOCK(shard->mutex);
+            if (!SCM_PORTP(p)) break;
             SCM_ASSERT(SCM_PORT_TYPE(p)==SCM_PORT_FILE);
             if (!SCM_PORT_ERROR_OCCURRED_P(SCM_PORT(p))) {
                 bufport_flush(SCM_PORT(p), 0, TRUE);
             }
         }
-    }
-    if (!exitting && saved) {
-        (void)SCM_INTERNAL_MUTEX_LOCK(active_buffered_ports.mutex);
-        for (int i=0; i<PORT_VECTOR_SIZE; i++) {
-            p = Scm_VectorRef(save, i, SCM_FALSE);
-            if (SCM_PORTP(p)) Scm_WeakVectorSet(ports, i, p);
+        if (!exitting && !SCM_NULLP(saved)) {
+            (void)SCM_INTERNAL_MUTEX_LOCK(shard->mutex);
+            ScmObj cp;
+            SCM_FOR_EACH(cp, saved) {
+                ScmObj p = SCM_CAAR(cp);
+                ScmObj i = SCM_CDAR(cp);
+                /* The port may have been closed during flushing. */
+                ScmDictEntry *e = Scm_HashCoreSearch(&shard->slotOf,
+                                                     PORT_KEY(p),
+                                                     SCM_DICT_GET);
+                if (e && SCM_EQ(SCM_DICT_VALUE(e), i)) {
+                    Scm_WeakVectorSet(shard->ports, SCM_INT_VALUE(i), p);
+                }
+            }
+            (void)SCM_INTERNAL_MUTEX_UNLOCK(shard->mutex);
         }
-        (void)SCM_INTERNAL_MUTEX_UNLOCK(active_buffered_ports.mutex);
     }
 }
 
@@ -1725,8 +1759,9 @@ ScmObj Scm_SetCurrentErrorPort(ScmPort *port)
 
 void Scm__InitPort(void)
 {
-    (void)SCM_INTERNAL_MUTEX_INIT(active_buffered_ports.mutex);
-    active_buffered_ports.ports = SCM_WEAK_VECTOR(Scm_MakeWeakVector(PORT_VECTOR_SIZE));
+    for (int i=0; i<PORT_SHARDS; i++) {
+        port_shard_init(&active_buffered_ports[i]);
+    }
 
     Scm_InitStaticClass(&Scm_PortClass, "<port>",
                         Scm_GaucheModule(), port_slots, 0);
@@ -37,6 +37,7 @@
 #include "gauche/code.h"
 #include "gauche/vminsn.h"
 #include "gauche/prof.h"
+#include "gauche/priv/vmP.h"
 
 #ifdef GAUCHE_PROFILE
 
@@ -48,10 +49,26 @@
 #endif
 
 /*=============================================================
- * Interval timer operation
+ * Global state
  */
 
-#define SAMPLING_PERIOD 10000
+#define SAMPLING_PERIOD 10000   /* default, in microseconds */
+
+static u_long sampling_period = SAMPLING_PERIOD;
+
+/* SCM_PROFILER_ALL_THREADS mode.  All_threads is set when the profiler
+   is started in that mode, and cleared by Scm_ProfilerReset.  While
+   all_running is TRUE, newly attached VMs start profiling as well.
+   Retired_vms keeps the VMs whose threads have finished while being
+   profiled, so that we can still gather their results. */
+static int all_threads = FALSE;
+static int all_running = FALSE;
+static ScmObj retired_vms = SCM_NIL;
+static ScmInternalMutex prof_mutex = SCM_INTERNAL_MUTEX_INITIALIZER;
+
+/*=============================================================
+ * Interval timer operation
+ */
 
 #if defined(GAUCHE_WINDOWS)
 
@@ -67,7 +84,7 @@ static unsigned __stdcall observer_thread(void *arg)
     /* NB: We can't use Scm_SysError in this thread. */
     /* NB: GetThreadContext might be required to make the target thread
            certainly suspended. */
-    sleep_time = SAMPLING_PERIOD / 1000;
+    sleep_time = sampling_period / 1000;
     if (sleep_time <= 0) sleep_time = 1;
     do {
         if (!suspend_flag &&
@@ -133,14 +150,13 @@ static void ITIMER_STOP(void)
 
 #else  /* !GAUCHE_WINDOWS */
 
-#define ITIMER_START()                                  \
-    do {                                                \
-        struct itimerval tval, oval;                    \
-        tval.it_interval.tv_sec = 0;                    \
-        tval.it_interval.tv_usec = SAMPLING_PERIOD;     \
-        tval.it_value.tv_sec = 0;                       \
-        tval.it_value.tv_usec = SAMPLING_PERIOD;        \
-        setitimer(ITIMER_PROF, &tval, &oval);           \
+#define ITIMER_START()                                          \
+    do {                                                        \
+        struct itimerval tval, oval;                            \
+        tval.it_interval.tv_sec = sampling_period / 1000000;    \
+        tval.it_interval.tv_usec = sampling_period % 1000000;   \
+        tval.it_value = tval.it_interval;                       \
+        setitimer(ITIMER_PROF, &tval, &oval);                   \
     } while (0)
 
 #define ITIMER_STOP()                           \
@@ -160,16 +176,20 @@ static void ITIMER_STOP(void)
  */
 
 /* Flush sample buffer to the file.
-   We save the address value to the file.  The address should also be
-   recorded in the call counter, thus we don't need to worry about
-   the addressed object being GCed. */
-
-#define CHK(exp)  do { if (!(exp)) goto bad; } while (0)
+   We save the address value to the file.  When we read them back,
+   we only trust the addresses that are also recorded in statHash,
+   for the object may have been GCed in the meantime (see known_func). */
 
 static void sampler_flush(ScmVM *vm)
 {
     if (vm->prof == NULL) return; /* for safety */
-    if (vm->prof->samplerFd < 0 || vm->prof->currentSample == 0) return;
+    if (vm->prof->currentSample == 0) return;
+    if (vm->prof->samplerFd < 0) {
+        /* We don't have a temporary file; the samples are lost. */
+        vm->prof->errorOccurred++;
+        vm->prof->currentSample = 0;
+        return;
+    }
 
     int nsamples = vm->prof->currentSample;
     ssize_t r = write(vm->prof->samplerFd, vm->prof->samples,
@@ -193,8 +213,11 @@ static void sampler_sample(int sig SCM_UNUSED)
 #endif /* !GAUCHE_WINDOWS */
     if (vm == NULL || vm->prof == NULL) return;
     if (vm->prof->state != SCM_PROFILER_RUNNING) return;
+    if (vm->prof->collecting) return;
 
-    if (vm->prof->currentSample >= SCM_PROF_SAMPLES_IN_BUFFER) {
+    ScmVMProfiler *prof = vm->prof;
+    if (prof->currentSample + SCM_PROF_MAX_STACK_DEPTH + 1
+        >= SCM_PROF_SAMPLES_IN_BUFFER) {
 #if !defined(GAUCHE_WINDOWS)
         ITIMER_STOP();
 #endif /* !GAUCHE_WINDOWS */
@@ -204,40 +227,127 @@ static void sampler_sample(int sig SCM_UNUSED)
 #endif /* !GAUCHE_WINDOWS */
     }
 
-    int i = vm->prof->currentSample++;
+    ScmProfSample *s = &prof->samples[prof->currentSample];
+    int n = 1;                  /* # of entries of this sample */
     if (vm->base) {
         /* If vm->pc is RET and val0 is a subr, it is pretty likely that
-           we're actually executing that subr. */
+           we're actually executing that subr.  The current code is
+           its caller then. */
         if (vm->pc && SCM_VM_INSN_CODE(*vm->pc) == SCM_VM_RET
             && SCM_SUBRP(vm->val0)) {
-            vm->prof->samples[i].func = vm->val0;
-            vm->prof->samples[i].pc = NULL;
+            s[0].func = vm->val0;
+            s[0].pc = NULL;
+            s[1].func = SCM_OBJ(vm->base);
+            s[1].pc = vm->pc;
+            s[1].depth = -1;
+            n++;
         } else {
-            vm->prof->samples[i].func = SCM_OBJ(vm->base);
-            vm->prof->samples[i].pc = vm->pc;
+            s[0].func = SCM_OBJ(vm->base);
+            s[0].pc = vm->pc;
         }
     } else {
-        vm->prof->samples[i].func = SCM_FALSE;
-        vm->prof->samples[i].pc = NULL;
+        s[0].func = SCM_FALSE;
+        s[0].pc = NULL;
     }
-    vm->prof->totalSamples++;
+
+    /* Record the callers.  The base of each continuation frame is the
+       code that pushed it.  (We don't record cpc, for it isn't set in
+       C continuation frames.) */
+    for (ScmContFrame *c = vm->cont;
+         c != NULL && n <= SCM_PROF_MAX_STACK_DEPTH;
+         c = c->prev) {
+        if (c->base == NULL) continue;
+        s[n].func = SCM_OBJ(c->base);
+        s[n].pc = NULL;
+        s[n].depth = -1;
+        n++;
+    }
+    s[0].depth = n - 1;
+    prof->currentSample += n;
+    prof->totalSamples++;
+
+    /* Ask the VM to move the samples to the hashtables before the
+       buffer gets full.  See Scm_ProfilerSampleBufferFlush. */
+    if (prof->currentSample > SCM_PROF_SAMPLES_IN_BUFFER/2
+        && !prof->flushRequested) {
+        prof->flushRequested = TRUE;
+        vm->attentionRequest = TRUE;
+    }
+}
+
+/* Samples read back from the temporary file are mere addresses.  We
+   trust FUNC only if it is in statHash, which keeps it alive.  Otherwise
+   we use #f instead of it. */
+static ScmObj known_func(ScmVMProfiler *prof, ScmObj func)
+{
+    ScmObj e = Scm_HashTableRef(prof->statHash, func, SCM_UNBOUND);
+    return SCM_UNBOUNDP(e)? SCM_FALSE : func;
 }
 
-/* register samples into the stat table.  Called from Scm_ProfilerResult */
-void collect_samples(ScmVMProfiler *prof)
+/* Register a sample, consisting of the entries S[0] ... S[S[0].depth],
+   into the stat table and the stack trie. */
+static void collect_sample(ScmVMProfiler *prof, ScmProfSample *s,
+                           int trusted)
 {
-    for (int i=0; i<prof->currentSample; i++) {
-        ScmObj e = Scm_HashTableRef(prof->statHash,
-                                    prof->samples[i].func, SCM_UNBOUND);
+    ScmHashTable *node = prof->stackHash;
+    ScmObj e = SCM_FALSE;
+    ScmObj func = SCM_FALSE;
+
+    /* The outermost caller comes last. */
+    for (int k = s[0].depth; k >= 0; k--) {
+        func = trusted? s[k].func : known_func(prof, s[k].func);
+        if (node == NULL) {
+            node = SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+            SCM_SET_CDR(e, SCM_OBJ(node));
+        }
+        e = Scm_HashTableRef(node, func, SCM_UNBOUND);
         if (SCM_UNBOUNDP(e)) {
-            /* NB: just for now */
-            Scm_Warn("profiler: uncounted object appeared in a sample: %p (%S)",
-                     prof->samples[i].func, prof->samples[i].func);
-        } else {
-            SCM_ASSERT(SCM_PAIRP(e));
-            SCM_SET_CDR(e, Scm_Add(SCM_CDR(e), SCM_MAKE_INT(1)));
+            e = Scm_Cons(SCM_MAKE_INT(0), SCM_FALSE);
+            Scm_HashTableSet(node, func, e, 0);
         }
+        node = SCM_HASH_TABLE_P(SCM_CDR(e))? SCM_HASH_TABLE(SCM_CDR(e)) : NULL;
+    }
+    SCM_SET_CAR(e, Scm_Add(SCM_CAR(e), SCM_MAKE_INT(1)));
+
+    /* Flat stats.  FUNC is the innermost one. */
+    e = Scm_HashTableRef(prof->statHash, func, SCM_UNBOUND);
+    if (SCM_UNBOUNDP(e)) {
+        e = Scm_Cons(SCM_MAKE_INT(0), SCM_MAKE_INT(0));
+        Scm_HashTableSet(prof->statHash, func, e, 0);
+    }
+    SCM_ASSERT(SCM_PAIRP(e));
+    SCM_SET_CDR(e, Scm_Add(SCM_CDR(e), SCM_MAKE_INT(1)));
+}
+
+/* Register samples in SAMPLES[0] ... SAMPLES[N-1].  Returns the number of
+   entries consumed; a sample at the end may be incomplete if we're
+   reading back from the file, and it is left for the next round. */
+static int collect_samples(ScmVMProfiler *prof, ScmProfSample *samples,
+                           int n, int trusted)
+{
+    int i = 0;
+    while (i < n) {
+        if (samples[i].depth < 0) { i++; continue; } /* for safety */
+        if (i + samples[i].depth + 1 > n) break;
+        collect_sample(prof, samples+i, trusted);
+        i += samples[i].depth + 1;
     }
+    return i;
+}
+
+/* Called by the VM at a safe point, when the sampler requests it. */
+void Scm_ProfilerSampleBufferFlush(ScmVM *vm)
+{
+    ScmVMProfiler *prof = vm->prof;
+    if (prof == NULL) return; /* for safety */
+
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(vm->vmlock);
+    prof->collecting = TRUE;
+    (void)collect_samples(prof, prof->samples, prof->currentSample, TRUE);
+    prof->currentSample = 0;
+    prof->flushRequested = FALSE;
+    prof->collecting = FALSE;
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
 }
 
 /*=============================================================
@@ -247,17 +357,17 @@ void collect_samples(ScmVMProfiler *prof)
 /* Inserting data into array is done in a macro (prof.h).  It calls
    this flush routine when the array gets full. */
 
-void Scm_ProfilerCountBufferFlush(ScmVM *vm)
+static void count_flush(ScmVM *vm)
 {
     if (vm->prof == NULL) return; /* for safety */
     if (vm->prof->currentCount == 0) return;
 
     /* suspend itimer during hash table operation */
 #if !defined(GAUCHE_WINDOWS)
-    sigset_t set;
+    sigset_t set, omask;
     sigemptyset(&set);
     sigaddset(&set, SIGPROF);
-    SIGPROCMASK(SIG_BLOCK, &set, NULL);
+    SIGPROCMASK(SIG_BLOCK, &set, &omask);
 #endif /* !GAUCHE_WINDOWS */
 
     int ncounts = vm->prof->currentCount;
@@ -284,50 +394,303 @@ void Scm_ProfilerCountBufferFlush(ScmVM *vm)
 
     /* resume itimer */
 #if !defined(GAUCHE_WINDOWS)
-    SIGPROCMASK(SIG_UNBLOCK, &set, NULL);
+    SIGPROCMASK(SIG_SETMASK, &omask, NULL);
 #endif /* !GAUCHE_WINDOWS */
 }
 
+/* We take vmlock, since in SCM_PROFILER_ALL_THREADS mode another thread
+   may be gathering the result of this VM. */
+void Scm_ProfilerCountBufferFlush(ScmVM *vm)
+{
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(vm->vmlock);
+    count_flush(vm);
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+}
+
 /*=============================================================
- * External API
+ * Per-VM operations
  */
-void Scm_ProfilerStart(void)
+
+static int make_sampler_file(ScmVMProfiler *prof)
 {
-    ScmVM *vm = Scm_VM();
     ScmObj templat = Scm_StringAppendC(SCM_STRING(Scm_TmpDir()),
                                        "/gauche-profXXXXXX", -1, -1);
     char *templat_buf = Scm_GetString(SCM_STRING(templat)); /*mutable copy*/
+    int fd = Scm_Mkstemp(templat_buf);
+#if defined(GAUCHE_WINDOWS)
+    prof->samplerFileName = templat_buf;
+#else  /* !GAUCHE_WINDOWS */
+    (void)prof;
+    unlink(templat_buf);       /* keep anonymous tmpfile */
+#endif /* !GAUCHE_WINDOWS */
+    return fd;
+}
 
+/* Sets up VM's profiler to run.  This doesn't create the temporary
+   file, since it may be called from a thread being attached (see
+   Scm__ProfilerAttachVM), where we can't handle errors.  Without the
+   file, the sampler just drops samples when its buffer overflows. */
+static void prof_start_vm(ScmVM *vm)
+{
     if (!vm->prof) {
-        vm->prof = SCM_NEW(ScmVMProfiler);
-        vm->prof->state = SCM_PROFILER_INACTIVE;
-        vm->prof->samplerFd = Scm_Mkstemp(templat_buf);
-        vm->prof->currentSample = 0;
-        vm->prof->totalSamples = 0;
-        vm->prof->errorOccurred = 0;
-        vm->prof->currentCount = 0;
-        vm->prof->statHash =
+        ScmVMProfiler *prof = SCM_NEW(ScmVMProfiler);
+        prof->state = SCM_PROFILER_INACTIVE;
+        prof->samplerFd = -1;
+        prof->currentSample = 0;
+        prof->totalSamples = 0;
+        prof->errorOccurred = 0;
+        prof->flushRequested = FALSE;
+        prof->collecting = FALSE;
+        prof->sigmaskRequested = FALSE;
+        prof->sigprofUnblocked = FALSE;
+        prof->sigprofBlocked = FALSE;
+        prof->currentCount = 0;
+        prof->statHash =
+            SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+        prof->stackHash =
             SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
 #if defined(GAUCHE_WINDOWS)
+        prof->hTargetThread = NULL;
+        prof->hObserverThread = NULL;
+        prof->hTimerEvent = NULL;
+        prof->samplerFileName = NULL;
+#endif /* GAUCHE_WINDOWS */
+        vm->prof = prof;
+    }
+    if (vm->prof->state == SCM_PROFILER_RUNNING) return;
+    vm->prof->state = SCM_PROFILER_RUNNING;
+    vm->profilerRunning = TRUE;
+}
+
+static int prof_stop_vm(ScmVM *vm)
+{
+#if defined(GAUCHE_WINDOWS)
+    if (vm->prof->hTargetThread != NULL) {
+        CloseHandle(vm->prof->hTargetThread);
         vm->prof->hTargetThread = NULL;
-        vm->prof->hObserverThread = NULL;
-        vm->prof->hTimerEvent = NULL;
-        vm->prof->samplerFileName = templat_buf;
-#else  /* !GAUCHE_WINDOWS */
-        unlink(templat_buf);       /* keep anonymous tmpfile */
-#endif /* !GAUCHE_WINDOWS */
-    } else if (vm->prof->samplerFd < 0) {
-        vm->prof->samplerFd = Scm_Mkstemp(templat_buf);
+    }
+#endif /* GAUCHE_WINDOWS */
+    vm->prof->state = SCM_PROFILER_PAUSING;
+    vm->profilerRunning = FALSE;
+    return vm->prof->totalSamples;
+}
+
+/* Lets the calling thread, which runs VM, receive SIGPROF while VM is
+   being profiled, and restores the previous mask after that.  See
+   gauche/prof.h. */
+static void prof_update_sigmask(ScmVM *vm)
+{
+#if !defined(GAUCHE_WINDOWS)
+    ScmVMProfiler *prof = vm->prof;
+    sigset_t set, omask;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPROF);
+    prof->sigmaskRequested = FALSE;
+    if (vm->profilerRunning) {
+        if (!prof->sigprofUnblocked) {
+            SIGPROCMASK(SIG_UNBLOCK, &set, &omask);
+            prof->sigprofBlocked = sigismember(&omask, SIGPROF);
+            prof->sigprofUnblocked = TRUE;
+        }
+    } else if (prof->sigprofUnblocked) {
+        if (prof->sigprofBlocked) SIGPROCMASK(SIG_BLOCK, &set, NULL);
+        prof->sigprofUnblocked = FALSE;
+    }
+#else  /* GAUCHE_WINDOWS */
+    vm->prof->sigmaskRequested = FALSE;
+#endif /* GAUCHE_WINDOWS */
+}
+
+/* Signal masks are per thread, so we ask the thread running VM to
+   update its mask at the next safe point, unless it is ourselves. */
+static void prof_request_sigmask(ScmVM *vm)
+{
+    if (vm == Scm_VM()) {
+        prof_update_sigmask(vm);
+    } else {
+        vm->prof->sigmaskRequested = TRUE;
+        vm->attentionRequest = TRUE;
+    }
+}
+
+/* Called by the VM at a safe point, when the profiler requests it. */
+void Scm__ProfilerUpdateSigmask(ScmVM *vm)
+{
+    if (vm->prof == NULL) return; /* for safety */
+    prof_update_sigmask(vm);
+}
+
+static void prof_reset_vm(ScmVM *vm)
+{
+    ScmVMProfiler *prof = vm->prof;
+
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(vm->vmlock);
+    if (prof->samplerFd >= 0) {
+        close(prof->samplerFd);
+        prof->samplerFd = -1;
 #if defined(GAUCHE_WINDOWS)
-        vm->prof->samplerFileName = templat_buf;
+        unlink(prof->samplerFileName);
+#endif /* GAUCHE_WINDOWS */
+    }
+    prof->totalSamples = 0;
+    prof->currentSample = 0;
+    prof->errorOccurred = 0;
+    prof->flushRequested = FALSE;
+    prof->currentCount = 0;
+    prof->statHash =
+        SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+    prof->stackHash =
+        SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+    prof->state = SCM_PROFILER_INACTIVE;
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+}
+
+/* Read back the samples saved in the temporary file.  Returns 0 on
+   success, or -1 if we can't seek. */
+static int read_sampler_file(ScmVMProfiler *prof)
+{
+    if (prof->samplerFd < 0) return 0;
+
+    off_t off;
+    SCM_SYSCALL(off, lseek(prof->samplerFd, 0, SEEK_SET));
+    if (off == (off_t)-1) return -1;
+
+    int carry = 0;
+    for (;;) {
+        ssize_t r = read(prof->samplerFd, prof->samples + carry,
+                         sizeof(ScmProfSample[1])
+                         * (SCM_PROF_SAMPLES_IN_BUFFER - carry));
+        if (r <= 0) break;
+        int n = carry + (int)(r / sizeof(ScmProfSample[1]));
+        int used = collect_samples(prof, prof->samples, n, FALSE);
+        carry = n - used;
+        memmove(prof->samples, prof->samples + used,
+                carry * sizeof(ScmProfSample[1]));
+    }
+    prof->currentSample = 0;
+    return 0;
+}
+
+/* Moves the call counts and the samples of VM into its statHash and
+   stackHash. */
+static void collect_vm(ScmVM *vm)
+{
+    ScmVMProfiler *prof = vm->prof;
+    int r = 0;
+
+    if (prof->errorOccurred > 0) {
+        Scm_Warn("profiler: An error has been occurred during saving profiling samples.  The result may not be accurate");
+    }
+
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(vm->vmlock);
+    count_flush(vm);
+    /* collect samples in the current buffer */
+    prof->collecting = TRUE;
+    (void)collect_samples(prof, prof->samples, prof->currentSample, TRUE);
+    prof->currentSample = 0;
+    prof->flushRequested = FALSE;
+    /* collect samples in the saved file */
+    r = read_sampler_file(prof);
+    prof->collecting = FALSE;
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+
+    if (r < 0) {
+        Scm_ProfilerReset();
+        Scm_Error("profiler: seek failed in retrieving sample data");
+    }
+    if (prof->samplerFd >= 0) {
+#if defined(GAUCHE_WINDOWS)
+        close(prof->samplerFd);
+        prof->samplerFd = -1;
+        unlink(prof->samplerFileName);
 #else  /* !GAUCHE_WINDOWS */
-        unlink(templat_buf);
+        if (ftruncate(prof->samplerFd, 0) < 0) {
+            Scm_SysError("profiler: failed to truncate temporary file");
+        }
 #endif /* !GAUCHE_WINDOWS */
     }
+}
 
-    if (vm->prof->state == SCM_PROFILER_RUNNING) return;
-    vm->prof->state = SCM_PROFILER_RUNNING;
-    vm->profilerRunning = TRUE;
+/* Returns a list of VMs that have profiling data. */
+static ScmObj profiled_vms(void)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL, cp;
+
+    if (!all_threads) {
+        ScmVM *vm = Scm_VM();
+        if (vm->prof == NULL || vm->prof->state == SCM_PROFILER_INACTIVE) {
+            return SCM_NIL;
+        }
+        return SCM_LIST1(SCM_OBJ(vm));
+    }
+
+    ScmObj vms = Scm__VMList();
+    SCM_INTERNAL_MUTEX_LOCK(prof_mutex);
+    vms = Scm_Append2(vms, retired_vms);
+    SCM_INTERNAL_MUTEX_UNLOCK(prof_mutex);
+    SCM_FOR_EACH(cp, vms) {
+        ScmVM *vm = SCM_VM(SCM_CAR(cp));
+        if (vm->prof && vm->prof->state != SCM_PROFILER_INACTIVE) {
+            SCM_APPEND1(h, t, SCM_OBJ(vm));
+        }
+    }
+    return h;
+}
+
+/* Stops the profiler if it's running, and collects the data of the
+   profiled VMs.  Returns a list of them. */
+static ScmObj prof_collect(void)
+{
+    ScmObj vms = profiled_vms(), cp;
+    Scm_ProfilerStop();
+    SCM_FOR_EACH(cp, vms) {
+        collect_vm(SCM_VM(SCM_CAR(cp)));
+    }
+    return vms;
+}
+
+/*=============================================================
+ * External API
+ */
+void Scm_ProfilerStart(void)
+{
+    Scm_ProfilerStartWithFlags(0, 0);
+}
+
+/* PERIOD is the sampling period in microseconds.  0 to use the
+   default or the previous value. */
+void Scm_ProfilerStartWithFlags(u_long flags, u_long period)
+{
+    ScmVM *vm = Scm_VM();
+
+#if defined(GAUCHE_WINDOWS)
+    flags &= ~SCM_PROFILER_ALL_THREADS;  /* not supported */
+#endif /* GAUCHE_WINDOWS */
+
+    if (vm->prof && vm->prof->state == SCM_PROFILER_RUNNING) return;
+    if (period > 0) sampling_period = period;
+    /* The mode can only be changed after reset. */
+    if (vm->prof == NULL || vm->prof->state == SCM_PROFILER_INACTIVE) {
+        all_threads = (flags & SCM_PROFILER_ALL_THREADS) != 0;
+    }
+
+    ScmObj vms = SCM_LIST1(SCM_OBJ(vm)), cp;
+    if (all_threads) {
+        /* The VMs attached after Scm__VMList() start profiling by
+           themselves, since all_running is set. */
+        SCM_INTERNAL_MUTEX_LOCK(prof_mutex);
+        all_running = TRUE;
+        vms = Scm__VMList();
+        SCM_FOR_EACH(cp, vms) prof_start_vm(SCM_VM(SCM_CAR(cp)));
+        SCM_INTERNAL_MUTEX_UNLOCK(prof_mutex);
+    } else {
+        prof_start_vm(vm);
+    }
+    SCM_FOR_EACH(cp, vms) {
+        ScmVMProfiler *prof = SCM_VM(SCM_CAR(cp))->prof;
+        if (prof->samplerFd < 0) prof->samplerFd = make_sampler_file(prof);
+        prof_request_sigmask(SCM_VM(SCM_CAR(cp)));
+    }
 
     /* NB: this should be done globally!!! */
 #if defined(GAUCHE_WINDOWS)
@@ -355,90 +718,114 @@ void Scm_ProfilerStart(void)
 int Scm_ProfilerStop(void)
 {
     ScmVM *vm = Scm_VM();
+
+    if (all_threads) {
+        if (!all_running) return 0;
+        ITIMER_STOP();
+        SCM_INTERNAL_MUTEX_LOCK(prof_mutex);
+        all_running = FALSE;
+        SCM_INTERNAL_MUTEX_UNLOCK(prof_mutex);
+
+        int total = 0;
+        ScmObj cp;
+        SCM_FOR_EACH(cp, profiled_vms()) {
+            total += prof_stop_vm(SCM_VM(SCM_CAR(cp)));
+            prof_request_sigmask(SCM_VM(SCM_CAR(cp)));
+        }
+        return total;
+    }
+
     if (vm->prof == NULL) return 0;
     if (vm->prof->state != SCM_PROFILER_RUNNING) return 0;
     ITIMER_STOP();
-#if defined(GAUCHE_WINDOWS)
-    if (vm->prof->hTargetThread != NULL) {
-        CloseHandle(vm->prof->hTargetThread);
-        vm->prof->hTargetThread = NULL;
-    }
-#endif /* GAUCHE_WINDOWS */
-    vm->prof->state = SCM_PROFILER_PAUSING;
-    vm->profilerRunning = FALSE;
-    return vm->prof->totalSamples;
+    int total = prof_stop_vm(vm);
+    prof_update_sigmask(vm);
+    return total;
 }
 
 void Scm_ProfilerReset(void)
 {
-    ScmVM *vm = Scm_VM();
+    ScmObj vms = profiled_vms(), cp;
 
-    if (vm->prof == NULL) return;
-    if (vm->prof->state == SCM_PROFILER_INACTIVE) return;
-    if (vm->prof->state == SCM_PROFILER_RUNNING) Scm_ProfilerStop();
-
-    if (vm->prof->samplerFd >= 0) {
-        close(vm->prof->samplerFd);
-        vm->prof->samplerFd = -1;
-#if defined(GAUCHE_WINDOWS)
-        unlink(vm->prof->samplerFileName);
-#endif /* GAUCHE_WINDOWS */
+    Scm_ProfilerStop();
+    SCM_FOR_EACH(cp, vms) {
+        prof_reset_vm(SCM_VM(SCM_CAR(cp)));
     }
-    vm->prof->totalSamples = 0;
-    vm->prof->currentSample = 0;
-    vm->prof->errorOccurred = 0;
-    vm->prof->currentCount = 0;
-    vm->prof->statHash =
-        SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
-    vm->prof->state = SCM_PROFILER_INACTIVE;
+    SCM_INTERNAL_MUTEX_LOCK(prof_mutex);
+    retired_vms = SCM_NIL;
+    all_threads = FALSE;
+    SCM_INTERNAL_MUTEX_UNLOCK(prof_mutex);
 }
 
-/* Returns the statHash */
+/* Returns the statHash.  In SCM_PROFILER_ALL_THREADS mode, the statHashes
+   of all profiled VMs are merged. */
 ScmObj Scm_ProfilerRawResult(void)
 {
-    ScmVM *vm = Scm_VM();
-
-    if (vm->prof == NULL) return SCM_FALSE;
-    if (vm->prof->state == SCM_PROFILER_INACTIVE) return SCM_FALSE;
-    if (vm->prof->state == SCM_PROFILER_RUNNING) Scm_ProfilerStop();
+    ScmObj vms = prof_collect(), cp;
 
-    if (vm->prof->errorOccurred > 0) {
-        Scm_Warn("profiler: An error has been occurred during saving profiling samples.  The result may not be accurate");
+    if (SCM_NULLP(vms)) return SCM_FALSE;
+    if (SCM_NULLP(SCM_CDR(vms))) {
+        return SCM_OBJ(SCM_VM(SCM_CAR(vms))->prof->statHash);
     }
 
-    Scm_ProfilerCountBufferFlush(vm);
+    ScmHashTable *r = SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+    SCM_FOR_EACH(cp, vms) {
+        ScmHashIter iter;
+        ScmDictEntry *e;
+        Scm_HashIterInit(&iter,
+                         SCM_HASH_TABLE_CORE(SCM_VM(SCM_CAR(cp))->prof->statHash));
+        while ((e = Scm_HashIterNext(&iter)) != NULL) {
+            ScmObj v = SCM_DICT_VALUE(e);
+            ScmObj p = Scm_HashTableRef(r, SCM_DICT_KEY(e), SCM_UNBOUND);
+            if (SCM_UNBOUNDP(p)) {
+                p = Scm_Cons(SCM_MAKE_INT(0), SCM_MAKE_INT(0));
+                Scm_HashTableSet(r, SCM_DICT_KEY(e), p, 0);
+            }
+            SCM_SET_CAR(p, Scm_Add(SCM_CAR(p), SCM_CAR(v)));
+            SCM_SET_CDR(p, Scm_Add(SCM_CDR(p), SCM_CDR(v)));
+        }
+    }
+    return SCM_OBJ(r);
+}
 
-    /* collect samples in the current buffer */
-    collect_samples(vm->prof);
+/* Returns a hashtable that maps each profiled VM to its stackHash. */
+ScmObj Scm_ProfilerRawStacks(void)
+{
+    ScmObj vms = prof_collect(), cp;
 
-    /* collect samples in the saved file */
-    off_t off;
-    SCM_SYSCALL(off, lseek(vm->prof->samplerFd, 0, SEEK_SET));
-    if (off == (off_t)-1) {
-        Scm_ProfilerReset();
-        Scm_Error("profiler: seek failed in retrieving sample data");
-    }
-    for (;;) {
-        ssize_t r = read(vm->prof->samplerFd, vm->prof->samples,
-                         sizeof(ScmProfSample[1]) * SCM_PROF_SAMPLES_IN_BUFFER);
-        if (r <= 0) break;
-        vm->prof->currentSample = r / sizeof(ScmProfSample[1]);
-        collect_samples(vm->prof);
-    }
-    vm->prof->currentSample = 0;
-#if defined(GAUCHE_WINDOWS)
-    if (vm->prof->samplerFd >= 0) {
-        close(vm->prof->samplerFd);
-        vm->prof->samplerFd = -1;
-        unlink(vm->prof->samplerFileName);
-    }
-#else  /* !GAUCHE_WINDOWS */
-    if (ftruncate(vm->prof->samplerFd, 0) < 0) {
-        Scm_SysError("profiler: failed to truncate temporary file");
+    if (SCM_NULLP(vms)) return SCM_FALSE;
+    ScmHashTable *r = SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+    SCM_FOR_EACH(cp, vms) {
+        Scm_HashTableSet(r, SCM_CAR(cp),
+                         SCM_OBJ(SCM_VM(SCM_CAR(cp))->prof->stackHash), 0);
     }
-#endif /* !GAUCHE_WINDOWS */
+    return SCM_OBJ(r);
+}
 
-    return SCM_OBJ(vm->prof->statHash);
+u_long Scm_ProfilerSamplingPeriod(void)
+{
+    return sampling_period;
+}
+
+/* Called from Scm_AttachVM, in the thread that runs VM. */
+void Scm__ProfilerAttachVM(ScmVM *vm)
+{
+    SCM_INTERNAL_MUTEX_LOCK(prof_mutex);
+    if (all_running) prof_start_vm(vm);
+    SCM_INTERNAL_MUTEX_UNLOCK(prof_mutex);
+    if (vm->prof) prof_update_sigmask(vm);
+}
+
+/* Called from Scm_DetachVM.  VM won't appear in Scm__VMList() after
+   this, so we keep it until the result is retrieved. */
+void Scm__ProfilerDetachVM(ScmVM *vm)
+{
+    if (!all_threads || vm->prof == NULL) return;
+    if (vm->prof->state == SCM_PROFILER_INACTIVE) return;
+    (void)prof_stop_vm(vm);
+    SCM_INTERNAL_MUTEX_LOCK(prof_mutex);
+    retired_vms = Scm_Cons(SCM_OBJ(vm), retired_vms);
+    SCM_INTERNAL_MUTEX_UNLOCK(prof_mutex);
 }
 
 #else  /* !GAUCHE_PROFILE */
@@ -447,6 +834,12 @@ void Scm_ProfilerStart(void)
     Scm_Error("profiler is not supported.");
 }
 
+void Scm_ProfilerStartWithFlags(u_long flags SCM_UNUSED,
+                                u_long period SCM_UNUSED)
+{
+    Scm_Error("profiler is not supported.");
+}
+
 int  Scm_ProfilerStop(void)
 {
     Scm_Error("profiler is not supported.");
@@ -463,4 +856,228 @@ ScmObj Scm_ProfilerRawResult(void)
     Scm_Error("profiler is not supported.");
     return SCM_FALSE;
 }
+
+ScmObj Scm_ProfilerRawStacks(void)
+{
+    Scm_Error("profiler is not supported.");
+    return SCM_FALSE;
+}
+
+u_long Scm_ProfilerSamplingPeriod(void)
+{
+    return 0;
+}
+
+void Scm_ProfilerSampleBufferFlush(ScmVM *vm SCM_UNUSED)
+{
+}
+
+void Scm__ProfilerAttachVM(ScmVM *vm SCM_UNUSED)
+{
+}
+
+void Scm__ProfilerDetachVM(ScmVM *vm SCM_UNUSED)
+{
+}
+
+void Scm__ProfilerUpdateSigmask(ScmVM *vm SCM_UNUSED)
+{
+}
 #endif /* !GAUCHE_PROFILE */
+
+/*=============================================================
+ * Allocation profiler
+ */
+
+/* The allocation profiler takes a sample about every alloc_interval
+ * bytes allocated via SCM_MALLOC and its friends (see gauche.h).  Each
+ * sample is recorded with its allocation site, that is, the code base
+ * and PC of the VM that allocates, and the kind of the allocated
+ * object, and accounts for all the bytes allocated since the previous
+ * sample.  We randomize the interval a bit, so that periodic allocation
+ * patterns don't bias the samples.
+ *
+ * The allocators only look at the countdown, Scm__AllocSampleBudget,
+ * while Scm__AllocProfiling is set, so that they don't write to the
+ * shared variable unless the profiler is running.  While running, the
+ * countdown is shared by all threads and not protected; we may lose
+ * some decrements under contention, but the result is an estimation
+ * anyway.
+ *
+ * Scm__AllocSample is called within the allocator, so it must not use
+ * SCM_MALLOC; it'd recurse, trying to lock alloc_mutex again.  The site
+ * records are allocated by GC_MALLOC directly.
+ */
+
+#define ALLOC_SAMPLING_INTERVAL 16384 /* default, in bytes */
+#define ALLOC_TABLE_SIZE        1024  /* # of buckets; must be 2^n */
+
+typedef struct alloc_site_rec {
+    struct alloc_site_rec *next;
+    ScmCompiledCode *base;      /* NULL if unknown */
+    SCM_PCTYPE pc;
+    const void *what;           /* C type name, or class */
+    int flags;                  /* SCM_ALLOC_* flags */
+    u_long bytes;               /* estimated # of bytes */
+    u_long objects;             /* estimated # of objects */
+    u_long samples;             /* # of samples */
+} alloc_site;
+
+int  Scm__AllocProfiling = FALSE;
+long Scm__AllocSampleBudget = LONG_MAX;
+
+static u_long alloc_interval = 0;  /* 0 while not running */
+static u_long alloc_last_interval = ALLOC_SAMPLING_INTERVAL;
+static long alloc_budget = 0;      /* Scm__AllocSampleBudget at reset */
+static uint32_t alloc_seed = 2463534242U;
+static alloc_site **alloc_table = NULL;
+static ScmInternalMutex alloc_mutex = SCM_INTERNAL_MUTEX_INITIALIZER;
+
+/* Called while alloc_mutex is held. */
+static void alloc_budget_reset(void)
+{
+    if (alloc_interval == 0) {
+        Scm__AllocProfiling = FALSE;
+        Scm__AllocSampleBudget = LONG_MAX;
+        return;
+    }
+    /* xorshift32 */
+    alloc_seed ^= alloc_seed << 13;
+    alloc_seed ^= alloc_seed >> 17;
+    alloc_seed ^= alloc_seed << 5;
+    alloc_budget = (long)(alloc_interval/2 + alloc_seed % alloc_interval);
+    Scm__AllocSampleBudget = alloc_budget;
+    Scm__AllocProfiling = TRUE;
+}
+
+/* Called while alloc_mutex is held. */
+static void alloc_record(ScmCompiledCode *base, SCM_PCTYPE pc,
+                         int flags, const void *what,
+                         size_t size, u_long weight)
+{
+    u_long h = (((u_long)(intptr_t)pc >> 3) ^ ((u_long)(intptr_t)what >> 3))
+        & (ALLOC_TABLE_SIZE - 1);
+    alloc_site *s;
+
+    for (s = alloc_table[h]; s != NULL; s = s->next) {
+        if (s->pc == pc && s->base == base
+            && s->what == what && s->flags == flags) break;
+    }
+    if (s == NULL) {
+        s = (alloc_site*)GC_MALLOC(sizeof(alloc_site));
+        s->base = base;
+        s->pc = pc;
+        s->what = what;
+        s->flags = flags;
+        s->next = alloc_table[h];
+        alloc_table[h] = s;
+    }
+    s->bytes += weight;
+    s->objects += (size > 0 && weight >= size)? weight/size : 1;
+    s->samples++;
+}
+
+void *Scm__AllocSample(size_t size, int flags, const void *what)
+{
+    void *p = (flags & SCM_ALLOC_ATOMIC)
+        ? GC_MALLOC_ATOMIC(size) : GC_MALLOC(size);
+
+    /* NB: Scm_VM() isn't usable in the early stage of initialization,
+       but then the profiler can't be running. */
+    if (alloc_interval == 0) {
+        Scm__AllocSampleBudget = LONG_MAX;
+        return p;
+    }
+
+    ScmVM *vm = Scm_VM();
+    ScmCompiledCode *base = vm? vm->base : NULL;
+    SCM_PCTYPE pc = vm? vm->pc : NULL;
+
+    SCM_INTERNAL_MUTEX_LOCK(alloc_mutex);
+    if (alloc_interval > 0) {
+        long weight = alloc_budget - Scm__AllocSampleBudget;
+        if (weight < (long)size) weight = (long)size;
+        alloc_record(base, pc, flags, what, size, (u_long)weight);
+    }
+    alloc_budget_reset();
+    SCM_INTERNAL_MUTEX_UNLOCK(alloc_mutex);
+    return p;
+}
+
+/* INTERVAL is the average # of bytes between samples.  0 to use the
+   default or the previous value. */
+void Scm_AllocProfilerStart(u_long interval)
+{
+    /* Allocate the table before taking the lock; see above. */
+    alloc_site **table = NULL;
+    if (alloc_table == NULL) {
+        table = SCM_NEW_ARRAY(alloc_site*, ALLOC_TABLE_SIZE);
+    }
+
+    SCM_INTERNAL_MUTEX_LOCK(alloc_mutex);
+    if (alloc_table == NULL) alloc_table = table;
+    if (interval > 0) alloc_last_interval = interval;
+    alloc_interval = alloc_last_interval;
+    alloc_budget_reset();
+    SCM_INTERNAL_MUTEX_UNLOCK(alloc_mutex);
+}
+
+void Scm_AllocProfilerStop(void)
+{
+    SCM_INTERNAL_MUTEX_LOCK(alloc_mutex);
+    alloc_interval = 0;
+    alloc_budget_reset();
+    SCM_INTERNAL_MUTEX_UNLOCK(alloc_mutex);
+}
+
+void Scm_AllocProfilerReset(void)
+{
+    SCM_INTERNAL_MUTEX_LOCK(alloc_mutex);
+    alloc_interval = 0;
+    alloc_budget_reset();
+    if (alloc_table != NULL) {
+        for (int i=0; i<ALLOC_TABLE_SIZE; i++) alloc_table[i] = NULL;
+    }
+    SCM_INTERNAL_MUTEX_UNLOCK(alloc_mutex);
+}
+
+/* Stops the allocation profiler, and returns a list of
+ *   (<code> <source> <kind> <bytes> <objects> <samples>)
+ * for each allocation site.  <code> is the compiled code that was
+ * running, or #f if unknown.  <source> is the source form that
+ * contains the site if known, #f otherwise.  <kind> is the class of
+ * the allocated object, or the name of its C type, or #f if the
+ * allocation isn't typed.
+ */
+ScmObj Scm_AllocProfilerRawResult(void)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+
+    /* Once stopped, nobody touches alloc_table but us. */
+    Scm_AllocProfilerStop();
+    if (alloc_table == NULL) return SCM_NIL;
+    for (int i=0; i<ALLOC_TABLE_SIZE; i++) {
+        for (alloc_site *s = alloc_table[i]; s != NULL; s = s->next) {
+            ScmObj code = s->base? SCM_OBJ(s->base) : SCM_FALSE;
+            ScmObj src = s->base
+                ? Scm_VMGetSourceInfo(s->base, s->pc) : SCM_FALSE;
+            ScmObj kind = SCM_FALSE;
+            if (s->flags & SCM_ALLOC_CLASS) {
+                kind = SCM_OBJ(s->what);
+            } else if (s->what != NULL) {
+                kind = SCM_MAKE_STR_IMMUTABLE((const char*)s->what);
+            }
+            SCM_APPEND1(h, t, Scm_Cons(code,
+                                       SCM_LIST5(src, kind,
+                                                 Scm_MakeIntegerU(s->bytes),
+                                                 Scm_MakeIntegerU(s->objects),
+                                                 Scm_MakeIntegerU(s->samples))));
+        }
+    }
+    return h;
+}
+
+u_long Scm_AllocProfilerInterval(void)
+{
+    return alloc_last_interval;
+}
@@ -40,6 +40,7 @@
 #include "gauche/class.h"
 #include "gauche/priv/builtin-syms.h"
 #include "gauche/priv/charP.h"
+#include "gauche/priv/atomicP.h"
 
 /* I don't like to reinvent wheels, so I looked for a regexp implementation
  * that can handle multibyte encodings and not bound to Unicode.
@@ -162,6 +163,34 @@ enum {
     RE_NUM_INSN
 };
 
+/* Instructions of the NFA program for the lazy DFA matcher.  See
+   "pass 4" below. */
+enum {
+    NFA_CHAR,                   /* arg: char to match */
+    NFA_CHAR_CI,                /* arg: downcased char to match */
+    NFA_SET,                    /* arg: charset #.  match any char in it */
+    NFA_NSET,                   /* arg: charset #.  match any char not in it */
+    NFA_ANY,                    /* match any char */
+    NFA_MATCH,                  /* success.  arg: index of the regexp
+                                   in a regexp set */
+    NFA_SPLIT,                  /* try x, then y */
+    NFA_JUMP,                   /* jump to x */
+    NFA_SAVE,                   /* arg: submatch slot (2*group for the
+                                   beginning, 2*group+1 for the end) */
+    NFA_EDGE_PREV,              /* assertion: no char before the position */
+    NFA_EDGE_NEXT,              /* assertion: no char after the position */
+    NFA_WB,                     /* word boundary assertion */
+    NFA_NWB,                    /* negative word boundary assertion */
+    NFA_FAIL                    /* fail */
+};
+
+typedef struct nfa_insn_rec {
+    int op;
+    int arg;
+    int x;                      /* destination of SPLIT and JUMP */
+    int y;                      /* alternative destination of SPLIT */
+} nfa_insn;
+
 /* maximum # of {n,m}-type limited repeat count */
 #define MAX_LIMITED_REPEAT 255
 
@@ -171,6 +200,8 @@ enum {
 #define SCM_REGEXP_SIMPLE_PREFIX  (1L<<3) /* The regexp begins with a repeating
                                              character or charset, e.g. #/a+b/.
                                              See is_simple_prefixed() below. */
+#define SCM_REGEXP_LITERAL_PREFIX (1L<<4) /* Every match begins with mustMatch.
+                                             See rc_setup_must_match() below. */
 
 /* AST - the first pass of regexp compiler creates intermediate AST.
  * Alternatively, you can provide AST directly to the regexp compiler,
@@ -228,6 +259,9 @@ SCM_DEFINE_BUILTIN_CLASS(Scm_RegexpClass,
                          SCM_CLASS_DEFAULT_CPL);
 SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_RegMatchClass, NULL);
 
+static void regexp_set_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx);
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_RegexpSetClass, regexp_set_print);
+
 static ScmRegexp *make_regexp(void)
 {
     ScmRegexp *rx = SCM_NEW(ScmRegexp);
@@ -242,6 +276,7 @@ static ScmRegexp *make_regexp(void)
     rx->flags = 0;
     rx->pattern = SCM_FALSE;
     rx->ast = SCM_FALSE;
+    rx->dfa = NULL;
     return rx;
 }
 
@@ -285,8 +320,11 @@ static int regexp_compare(ScmObj x, ScmObj y, int equalp)
 /* 3-pass compiler.
  *
  *  pass 1: parses the pattern and creates an AST.
- *  pass 2: optimize on AST.
+ *  pass 2: optimize on AST.  Also extracts a required literal.
  *  pass 3: byte code generation.
+ *
+ * If the regexp doesn't need backtracking, pass 3 is followed by
+ * pass 4, which creates NFA programs for the lazy DFA matcher.
  */
 
 /* compiler state information */
@@ -302,6 +340,12 @@ typedef struct regcomp_ctx_rec {
     int codep;                  /* [pass3] front of code generation */
     int emitp;                  /* [pass3] am I generating code? */
     int codemax;                /* [pass3] max codep */
+    int optimizedp;             /* [pass4] TRUE if AST is from pass 2 */
+    int reversep;               /* [pass4] TRUE if building reverse NFA */
+    int nfafailp;               /* [pass4] TRUE if AST can't be an NFA */
+    nfa_insn *nfa;              /* [pass4] NFA program being built */
+    int nfap;                   /* [pass4] front of NFA generation */
+    int nfamax;                 /* [pass4] allocated size of nfa */
 } regcomp_ctx;
 
 /* If we run from pass1, input string should be passed to PATTERN.
@@ -328,6 +372,12 @@ static void rc_ctx_init(regcomp_ctx *ctx,
     ctx->codep = 0;
     ctx->emitp = FALSE;
     ctx->codemax = 1;
+    ctx->optimizedp = FALSE;
+    ctx->reversep = FALSE;
+    ctx->nfafailp = FALSE;
+    ctx->nfa = NULL;
+    ctx->nfap = 0;
+    ctx->nfamax = 0;
 }
 
 static ScmObj rc_charset(regcomp_ctx *ctx);
@@ -339,6 +389,7 @@ static ScmObj rc1_group_name(regcomp_ctx *ctx);
 static ScmObj rc1_lex_minmax(regcomp_ctx *ctx);
 static ScmObj rc1_lex_open_paren(regcomp_ctx *ctx);
 static ScmObj rc1_lex_xdigits(ScmPort *port, int key);
+static void  *rc4(regcomp_ctx *ctx, ScmObj ast);
 
 /*----------------------------------------------------------------
  * pass1 - parser
@@ -1182,6 +1233,122 @@ ScmObj Scm_RegOptimizeAST(ScmObj ast)
     return rc2_optimize(ast, SCM_NIL);
 }
 
+/*-------------------------------------------------------------
+ * required literal
+ *
+ *   After pass 2, we look for the longest literal string that every
+ *   match must contain, and save it in rx->mustMatch.  If every match
+ *   begins with it, SCM_REGEXP_LITERAL_PREFIX is also set.  The matcher
+ *   scans the input for the literal before running the regexp, to reject
+ *   the input or to jump directly to the candidate positions.
+ *
+ *   We only look at the items that are always matched in sequence;
+ *   chars in groups, non-capturing sequences and the mandatory part of
+ *   repetitions.  Zero-width assertions don't break the literal.
+ *   Anything else does.
+ */
+
+#define MUST_MATCH_MAX 64       /* max # of chars of the literal */
+
+typedef struct must_match_ctx_rec {
+    ScmChar cur[MUST_MATCH_MAX];
+    int curlen;
+    int curprefixp;             /* TRUE if the current run is a prefix */
+    ScmChar best[MUST_MATCH_MAX];
+    int bestlen;
+    int bestprefixp;
+    int startp;                 /* TRUE if nothing is consumed so far */
+} must_match_ctx;
+
+static void rc_must_match_seq(must_match_ctx *ctx, ScmObj seq, int uncase);
+
+static void rc_must_match_break(must_match_ctx *ctx)
+{
+    if (ctx->curlen > ctx->bestlen) {
+        memcpy(ctx->best, ctx->cur, sizeof(ScmChar)*ctx->curlen);
+        ctx->bestlen = ctx->curlen;
+        ctx->bestprefixp = ctx->curprefixp;
+    }
+    ctx->curlen = 0;
+    ctx->startp = FALSE;
+}
+
+static void rc_must_match_rec(must_match_ctx *ctx, ScmObj ast, int uncase)
+{
+    if (SCM_CHARP(ast) && !uncase) {
+        /* A prefix of the literal is also a literal, so we just stop
+           extending when it gets too long. */
+        if (ctx->curlen == 0) ctx->curprefixp = ctx->startp;
+        if (ctx->curlen < MUST_MATCH_MAX) {
+            ctx->cur[ctx->curlen++] = SCM_CHAR_VALUE(ast);
+        }
+        ctx->startp = FALSE;
+        return;
+    }
+    if (SCM_EQ(ast, SCM_SYM_BOL) || SCM_EQ(ast, SCM_SYM_WB)
+        || SCM_EQ(ast, SCM_SYM_NWB)) {
+        return;
+    }
+    if (!SCM_PAIRP(ast)) {
+        rc_must_match_break(ctx);
+        return;
+    }
+
+    ScmObj type = SCM_CAR(ast);
+    if (SCM_INTP(type)) {
+        rc_must_match_seq(ctx, SCM_CDDR(ast), uncase);
+    } else if (SCM_EQ(type, SCM_SYM_SEQ)) {
+        rc_must_match_seq(ctx, SCM_CDR(ast), uncase);
+    } else if (SCM_EQ(type, SCM_SYM_SEQ_CASE)) {
+        rc_must_match_seq(ctx, SCM_CDR(ast), FALSE);
+    } else if (SCM_EQ(type, SCM_SYM_SEQ_UNCASE)) {
+        rc_must_match_seq(ctx, SCM_CDR(ast), TRUE);
+    } else if (SCM_EQ(type, SCM_SYM_ASSERT) || SCM_EQ(type, SCM_SYM_NASSERT)) {
+        return;
+    } else if (SCM_EQ(type, SCM_SYM_REP) || SCM_EQ(type, SCM_SYM_REP_MIN)
+               || SCM_EQ(type, SCM_SYM_REP_WHILE)) {
+        /* The body of the mandatory part is always matched, but it isn't
+           adjacent to the surrounding items. */
+        rc_must_match_break(ctx);
+        if (SCM_INT_VALUE(SCM_CADR(ast)) > 0) {
+            rc_must_match_seq(ctx, SCM_CDR(SCM_CDDR(ast)), uncase);
+            rc_must_match_break(ctx);
+        }
+    } else {
+        rc_must_match_break(ctx);
+    }
+}
+
+static void rc_must_match_seq(must_match_ctx *ctx, ScmObj seq, int uncase)
+{
+    ScmObj cp;
+    SCM_FOR_EACH(cp, seq) {
+        rc_must_match_rec(ctx, SCM_CAR(cp), uncase);
+    }
+}
+
+static void rc_setup_must_match(regcomp_ctx *ctx, ScmObj ast)
+{
+#if defined(GAUCHE_CHAR_ENCODING_EUC_JP) || defined(GAUCHE_CHAR_ENCODING_SJIS)
+    /* In these encodings, the byte sequence of the literal may be found
+       across the char boundary, so the bytewise scan can't be used. */
+    return;
+#endif
+    must_match_ctx mctx;
+    mctx.curlen = mctx.bestlen = 0;
+    mctx.curprefixp = mctx.bestprefixp = FALSE;
+    mctx.startp = TRUE;
+    rc_must_match_rec(&mctx, ast, ctx->casefoldp);
+    rc_must_match_break(&mctx);
+    if (mctx.bestlen == 0) return;
+
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+    for (int i=0; i<mctx.bestlen; i++) Scm_DStringPutc(&ds, mctx.best[i]);
+    ctx->rx->mustMatch = SCM_STRING(Scm_DStringGet(&ds, SCM_STRING_IMMUTABLE));
+    if (mctx.bestprefixp) ctx->rx->flags |= SCM_REGEXP_LITERAL_PREFIX;
+}
+
 /*-------------------------------------------------------------
  * pass 3 - code generation
  *          This pass actually called twice; the first run counts
@@ -1903,9 +2070,417 @@ static ScmObj rc3(regcomp_ctx *ctx, ScmObj ast)
     ctx->rx->numCodes = ctx->codep;
 
     ctx->rx->ast = ast;
+
+    /* pass 4 : NFA programs for lazy DFA, if possible */
+    ctx->rx->dfa = rc4(ctx, ast);
     return SCM_OBJ(ctx->rx);
 }
 
+/*-------------------------------------------------------------
+ * pass 4 - NFA programs for the lazy DFA matcher
+ *
+ *   If the regexp has no backreference, conditional pattern,
+ *   standalone pattern, or lookahead/lookbehind assertion, the
+ *   backtracking matcher is not the only way to match it.  We compile
+ *   the AST once more into a simple NFA program, which the matcher
+ *   runs as a DFA built on demand (see "Lazy DFA matcher" below).
+ *
+ *   Two programs are created.  The forward program finds the end of
+ *   the match.  It keeps the priority of choices (the order of
+ *   alternatives and greediness of repetitions), so the match is
+ *   the same as what the backtracking matcher finds.  The forward
+ *   program also records submatch boundaries with NFA_SAVE.
+ *   The reverse program matches reversed input from the end of the
+ *   match, to find where the match begins.
+ *
+ *   The structure of the generated program follows pass 3, including
+ *   its treatment of '$' in the middle of the pattern and the order of
+ *   choices of {n,m}.
+ */
+
+#define NFA_MAX_INSNS  8192
+
+/* Char context of a position, determined by the char adjacent to it. */
+enum {
+    CTX_EDGE,                   /* beginning or end of input */
+    CTX_WORD,                   /* word-constituent char */
+    CTX_NONWORD                 /* other char */
+};
+
+typedef struct nfa_prog_rec {
+    ScmRegexp *rx;              /* NULL for the program of a regexp set */
+    nfa_insn *insns;            /* program.  starts from insns[0] */
+    int numInsns;
+    ScmCharSet **sets;          /* charsets referred by NFA_SET/NFA_NSET */
+    int reversep;               /* TRUE if this is a reverse program */
+    int unanchored;             /* TRUE if the match can begin anywhere */
+    int setp;                   /* TRUE if this is a program of a regexp
+                                   set.  NFA_MATCH's arg is the index of
+                                   the regexp in the set. */
+    int wordp;                  /* TRUE if we need word-constituency of
+                                   chars, for WB/NWB */
+    int numClasses;             /* # of char classes */
+    int nonasciiClass;          /* class of non-ASCII chars, or -1 if
+                                   they need to be examined individually */
+    unsigned char asciiClass[128]; /* char class of ASCII chars */
+    ScmAtomicVar cache;         /* dfa_cache */
+    /* work area to compute DFA states.  protected by dfa_mutex. */
+    int *marks;
+    int markgen;
+    int *stack;
+    int *work;
+    int *work2;
+} nfa_prog;
+
+typedef struct regexp_dfa_rec {
+    nfa_prog *forward;
+    nfa_prog *reverse;
+} regexp_dfa;
+
+static void  *make_dfa_cache(void);
+static int    is_word_constituent(unsigned char b);
+static int    nfa_char_match(nfa_prog *prog, const nfa_insn *insn,
+                             ScmChar ch);
+
+static int rc4_emit(regcomp_ctx *ctx, int op, int arg, int x, int y)
+{
+    if (ctx->nfap >= ctx->nfamax) {
+        if (ctx->nfamax >= NFA_MAX_INSNS) {
+            /* Too big.  We give up building the NFA, but keep going
+               with the existing buffer so that the callers don't need
+               to check every time. */
+            ctx->nfafailp = TRUE;
+            ctx->nfap = 0;
+        } else {
+            int newmax = ctx->nfamax * 2;
+            nfa_insn *newnfa = SCM_NEW_ATOMIC_ARRAY(nfa_insn, newmax);
+            memcpy(newnfa, ctx->nfa, sizeof(nfa_insn)*ctx->nfap);
+            ctx->nfa = newnfa;
+            ctx->nfamax = newmax;
+        }
+    }
+    int pc = ctx->nfap++;
+    ctx->nfa[pc].op = op;
+    ctx->nfa[pc].arg = arg;
+    ctx->nfa[pc].x = x;
+    ctx->nfa[pc].y = y;
+    return pc;
+}
+
+static void rc4_patch(regcomp_ctx *ctx, int pc, int x, int y)
+{
+    if (ctx->nfafailp) return;
+    ctx->nfa[pc].x = x;
+    ctx->nfa[pc].y = y;
+}
+
+static void rc4_rec(regcomp_ctx *ctx, ScmObj ast, int lastp);
+
+/* In the reverse program, the items of a sequence is emitted in reverse
+   order, but LASTP still refers to the last item in the original order. */
+static void rc4_seq(regcomp_ctx *ctx, ScmObj seq, int lastp)
+{
+    ScmObj cp;
+    if (ctx->reversep) {
+        ScmObj rseq = Scm_Reverse(seq);
+        SCM_FOR_EACH(cp, rseq) {
+            rc4_rec(ctx, SCM_CAR(cp), lastp && SCM_EQ(cp, rseq));
+        }
+    } else {
+        SCM_FOR_EACH(cp, seq) {
+            rc4_rec(ctx, SCM_CAR(cp), lastp && SCM_NULLP(SCM_CDR(cp)));
+        }
+    }
+}
+
+/* Emits the optional part of repetition; COUNT is the max number of
+   copies, or -1 for unlimited repetition. */
+static void rc4_rep_optional(regcomp_ctx *ctx, ScmObj item, int count,
+                             int greedy)
+{
+    if (count < 0) {
+        /* loop: SPLIT body, next    (rep-min: SPLIT next, body)
+           body: <item>
+                 JUMP loop
+           next:
+        */
+        int loop = rc4_emit(ctx, NFA_SPLIT, 0, 0, 0);
+        rc4_seq(ctx, item, FALSE);
+        rc4_emit(ctx, NFA_JUMP, 0, loop, 0);
+        if (greedy) rc4_patch(ctx, loop, loop+1, ctx->nfap);
+        else        rc4_patch(ctx, loop, ctx->nfap, loop+1);
+        return;
+    }
+
+    /* Like rc3_minmax, we choose the number of repetition first, trying
+       from the largest (rep) or the smallest (rep-min), then jump into
+       the chain of copies.
+                 SPLIT #k0, #d1
+           #d1:  SPLIT #k1, #d2
+                  :
+           #dn:  JUMP #kn
+           #c0:  <item>
+           #c1:  <item>
+                  :
+           #cN:
+       where #ki is the entry of the chain that leaves the chosen number
+       of copies to match.
+    */
+    int entries[MAX_LIMITED_REPEAT+1];
+    if (count > MAX_LIMITED_REPEAT) {
+        ctx->nfafailp = TRUE;
+        return;
+    }
+    int dispatch = ctx->nfap;
+    for (int i=0; i<count; i++) rc4_emit(ctx, NFA_SPLIT, 0, 0, 0);
+    rc4_emit(ctx, NFA_JUMP, 0, 0, 0);
+    for (int i=0; i<count; i++) {
+        entries[i] = ctx->nfap;
+        rc4_seq(ctx, item, FALSE);
+    }
+    entries[count] = ctx->nfap;
+    for (int i=0; i<=count; i++) {
+        int k = greedy? count-i : i; /* # of copies to match */
+        rc4_patch(ctx, dispatch+i, entries[count-k], dispatch+i+1);
+    }
+}
+
+/* The mandatory copies come first in the forward program, and last in
+   the reverse program. */
+static void rc4_rep(regcomp_ctx *ctx, ScmObj ast)
+{
+    ScmObj min = SCM_CADR(ast), max = SCM_CAR(SCM_CDDR(ast));
+    ScmObj item = SCM_CDR(SCM_CDDR(ast));
+    int greedy = !SCM_EQ(SCM_CAR(ast), SCM_SYM_REP_MIN);
+    int multip = SCM_FALSEP(max) || SCM_INT_VALUE(max) > 1;
+    int m = SCM_INT_VALUE(min);
+    int count = SCM_FALSEP(max)? -1 : SCM_INT_VALUE(max) - m;
+
+    if (ctx->reversep && count != 0) {
+        rc4_rep_optional(ctx, item, count, greedy);
+    }
+    /* See rc3_seq_rep for LASTP. */
+    for (int i=0; i<m; i++) {
+        rc4_seq(ctx, item, multip && i == (ctx->reversep? 0 : m-1));
+    }
+    if (!ctx->reversep && count != 0) {
+        rc4_rep_optional(ctx, item, count, greedy);
+    }
+}
+
+static void rc4_rec(regcomp_ctx *ctx, ScmObj ast, int lastp)
+{
+    if (ctx->nfafailp) return;
+
+    if (!SCM_PAIRP(ast)) {
+        if (SCM_CHARP(ast)) {
+            rc4_emit(ctx, ctx->casefoldp? NFA_CHAR_CI : NFA_CHAR,
+                     (int)SCM_CHAR_VALUE(ast), 0, 0);
+        } else if (SCM_CHAR_SET_P(ast)) {
+            rc4_emit(ctx, NFA_SET, rc3_charset_index(ctx->rx, ast), 0, 0);
+        } else if (SCM_EQ(ast, SCM_SYM_ANY)) {
+            rc4_emit(ctx, NFA_ANY, 0, 0, 0);
+        } else if (SCM_EQ(ast, SCM_SYM_BOL)) {
+            rc4_emit(ctx, ctx->reversep? NFA_EDGE_NEXT : NFA_EDGE_PREV,
+                     0, 0, 0);
+        } else if (SCM_EQ(ast, SCM_SYM_EOL)) {
+            if (lastp) {
+                rc4_emit(ctx, ctx->reversep? NFA_EDGE_PREV : NFA_EDGE_NEXT,
+                         0, 0, 0);
+            } else {
+                rc4_emit(ctx, NFA_CHAR, '$', 0, 0);
+            }
+        } else if (SCM_EQ(ast, SCM_SYM_WB)) {
+            rc4_emit(ctx, NFA_WB, 0, 0, 0);
+        } else if (SCM_EQ(ast, SCM_SYM_NWB)) {
+            rc4_emit(ctx, NFA_NWB, 0, 0, 0);
+        } else {
+            ctx->nfafailp = TRUE;
+        }
+        return;
+    }
+
+    ScmObj type = SCM_CAR(ast);
+    if (SCM_EQ(type, SCM_SYM_COMP)) {
+        rc4_emit(ctx, NFA_NSET, rc3_charset_index(ctx->rx, SCM_CDR(ast)),
+                 0, 0);
+        return;
+    }
+    if (SCM_EQ(type, SCM_SYM_SEQ)) {
+        rc4_seq(ctx, SCM_CDR(ast), lastp);
+        return;
+    }
+    if (SCM_INTP(type)) {
+        /* The reverse program doesn't need submatches. */
+        int grpno = SCM_INT_VALUE(type);
+        if (!ctx->reversep) rc4_emit(ctx, NFA_SAVE, grpno*2, 0, 0);
+        rc4_seq(ctx, SCM_CDDR(ast), lastp);
+        if (!ctx->reversep) rc4_emit(ctx, NFA_SAVE, grpno*2+1, 0, 0);
+        return;
+    }
+    if (SCM_EQ(type, SCM_SYM_SEQ_UNCASE) || SCM_EQ(type, SCM_SYM_SEQ_CASE)) {
+        int oldcase = ctx->casefoldp;
+        ctx->casefoldp = SCM_EQ(type, SCM_SYM_SEQ_UNCASE);
+        rc4_seq(ctx, SCM_CDR(ast), lastp);
+        ctx->casefoldp = oldcase;
+        return;
+    }
+    if (SCM_EQ(type, SCM_SYM_REP_WHILE)) {
+        /* Pass 2 only introduces rep-while when it doesn't change the
+           result of matching, so we can treat it as rep.  If rep-while
+           comes from a user-provided AST, it means possessive match,
+           which NFA can't express. */
+        if (!ctx->optimizedp) {
+            ctx->nfafailp = TRUE;
+            return;
+        }
+        rc4_rep(ctx, ast);
+        return;
+    }
+    if (SCM_EQ(type, SCM_SYM_REP) || SCM_EQ(type, SCM_SYM_REP_MIN)) {
+        rc4_rep(ctx, ast);
+        return;
+    }
+    if (SCM_EQ(type, SCM_SYM_ALT)) {
+        /*     SPLIT #0, #1
+           #0: <alt0>
+               JUMP next
+           #1: SPLIT #2, #3
+                :
+           #n: <altN>
+           next:
+        */
+        ScmObj clause, jumps = SCM_NIL;
+        if (!SCM_PAIRP(SCM_CDR(ast))) {
+            rc4_emit(ctx, NFA_FAIL, 0, 0, 0);
+            return;
+        }
+        for (clause = SCM_CDR(ast);
+             SCM_PAIRP(SCM_CDR(clause));
+             clause = SCM_CDR(clause)) {
+            int split = rc4_emit(ctx, NFA_SPLIT, 0, 0, 0);
+            rc4_rec(ctx, SCM_CAR(clause), lastp);
+            jumps = Scm_Cons(SCM_MAKE_INT(rc4_emit(ctx, NFA_JUMP, 0, 0, 0)),
+                             jumps);
+            rc4_patch(ctx, split, split+1, ctx->nfap);
+        }
+        rc4_rec(ctx, SCM_CAR(clause), lastp);
+        SCM_FOR_EACH(jumps, jumps) {
+            rc4_patch(ctx, SCM_INT_VALUE(SCM_CAR(jumps)), ctx->nfap, 0);
+        }
+        return;
+    }
+    /* backref, cpat, once, assert, nassert and lookbehind need
+       backtracking. */
+    ctx->nfafailp = TRUE;
+}
+
+/* Partition ASCII chars into classes, so that the chars in the same
+   class can't be distinguished by any instruction of the program.
+   DFA transitions are computed per class. */
+static void rc4_setup_classes(nfa_prog *prog)
+{
+    unsigned char cls[128], ncls[128];
+    int map[256];
+    int numClasses = 1, uniform = TRUE;
+
+    for (int c=0; c<128; c++) {
+        cls[c] = (prog->wordp && is_word_constituent(c))? 1 : 0;
+    }
+    if (prog->wordp) numClasses = 2;
+
+    for (int pc=0; pc<prog->numInsns; pc++) {
+        const nfa_insn *insn = &prog->insns[pc];
+        switch (insn->op) {
+        case NFA_CHAR: case NFA_CHAR_CI:
+            if (insn->arg >= 0x80) uniform = FALSE;
+            break;
+        case NFA_SET: case NFA_NSET:
+            if (SCM_CHAR_SET_LARGE_P(prog->sets[insn->arg])) {
+                uniform = FALSE;
+            }
+            break;
+        default:
+            continue;
+        }
+        int n = 0;
+        for (int i=0; i<numClasses*2; i++) map[i] = -1;
+        for (int c=0; c<128; c++) {
+            int key = cls[c]*2 + (nfa_char_match(prog, insn, c)? 1 : 0);
+            if (map[key] < 0) map[key] = n++;
+            ncls[c] = (unsigned char)map[key];
+        }
+        memcpy(cls, ncls, sizeof(cls));
+        numClasses = n;
+    }
+    memcpy(prog->asciiClass, cls, sizeof(cls));
+    /* Non-ASCII chars are all word-constituent, and can share a class
+       unless the program has non-ASCII chars or large charsets. */
+    if (uniform) {
+        prog->nonasciiClass = numClasses++;
+    } else {
+        prog->nonasciiClass = -1;
+    }
+    prog->numClasses = numClasses;
+}
+
+/* Sets up the rest of PROG, whose insns, sets and flags are filled. */
+static void rc4_prog_init(nfa_prog *prog)
+{
+    prog->wordp = FALSE;
+    for (int pc=0; pc<prog->numInsns; pc++) {
+        if (prog->insns[pc].op == NFA_WB || prog->insns[pc].op == NFA_NWB) {
+            prog->wordp = TRUE;
+        }
+    }
+    rc4_setup_classes(prog);
+    prog->cache = (ScmAtomicWord)make_dfa_cache();
+    prog->marks = SCM_NEW_ATOMIC_ARRAY(int, prog->numInsns);
+    memset(prog->marks, 0, sizeof(int)*prog->numInsns);
+    prog->markgen = 0;
+    prog->stack = SCM_NEW_ATOMIC_ARRAY(int, prog->numInsns*2+2);
+    prog->work = SCM_NEW_ATOMIC_ARRAY(int, prog->numInsns+1);
+    prog->work2 = SCM_NEW_ATOMIC_ARRAY(int, prog->numInsns+1);
+}
+
+static nfa_prog *rc4_prog(regcomp_ctx *ctx, ScmObj ast, int reversep)
+{
+    ctx->reversep = reversep;
+    ctx->nfafailp = FALSE;
+    ctx->nfamax = 32;
+    ctx->nfa = SCM_NEW_ATOMIC_ARRAY(nfa_insn, ctx->nfamax);
+    ctx->nfap = 0;
+    ctx->casefoldp = ctx->rx->flags & SCM_REGEXP_CASE_FOLD;
+    rc4_rec(ctx, ast, TRUE);
+    rc4_emit(ctx, NFA_MATCH, 0, 0, 0);
+    if (ctx->nfafailp) return NULL;
+
+    nfa_prog *prog = SCM_NEW(nfa_prog);
+    prog->rx = ctx->rx;
+    prog->insns = ctx->nfa;
+    prog->numInsns = ctx->nfap;
+    prog->sets = ctx->rx->sets;
+    prog->reversep = reversep;
+    prog->unanchored =
+        !reversep && !(ctx->rx->flags & SCM_REGEXP_BOL_ANCHORED);
+    prog->setp = FALSE;
+    rc4_prog_init(prog);
+    return prog;
+}
+
+/* pass 4 */
+static void *rc4(regcomp_ctx *ctx, ScmObj ast)
+{
+    nfa_prog *fwd = rc4_prog(ctx, ast, FALSE);
+    if (fwd == NULL) return NULL;
+    nfa_prog *rev = rc4_prog(ctx, ast, TRUE);
+    if (rev == NULL) return NULL;
+    regexp_dfa *dfa = SCM_NEW(regexp_dfa);
+    dfa->forward = fwd;
+    dfa->reverse = rev;
+    return dfa;
+}
+
 /* For debug */
 void Scm_RegDump(ScmRegexp *rx)
 {
@@ -1914,6 +2489,10 @@ void Scm_RegDump(ScmRegexp *rx)
         Scm_Printf(SCM_CUROUT, ",BOL_ANCHORED");
     if (rx->flags&SCM_REGEXP_SIMPLE_PREFIX)
         Scm_Printf(SCM_CUROUT, ",SIMPLE_PREFIX");
+    if (rx->flags&SCM_REGEXP_LITERAL_PREFIX)
+        Scm_Printf(SCM_CUROUT, ",LITERAL_PREFIX");
+    if (rx->dfa)
+        Scm_Printf(SCM_CUROUT, ",DFA");
     Scm_Printf(SCM_CUROUT, ")\n");
     Scm_Printf(SCM_CUROUT, " laset = %S\n", rx->laset);
     Scm_Printf(SCM_CUROUT, "  must = ");
@@ -2261,6 +2840,8 @@ ScmObj Scm_RegComp(ScmString *pattern, int flags)
 
     /* pass 2 : optimization */
     ast = rc2_optimize(ast, SCM_NIL);
+    cctx.optimizedp = TRUE;
+    rc_setup_must_match(&cctx, ast);
 
     /* pass 3 : generate bytecode */
     return rc3(&cctx, ast);
@@ -2281,6 +2862,7 @@ ScmObj Scm_RegCompFromAST(ScmObj ast)
     ast = rc_setup_context(&cctx, ast);
     rc_setup_charsets(rx, &cctx);
     rx->numGroups = cctx.grpcount;
+    rc_setup_must_match(&cctx, ast);
 
     /* pass 3 */
     return rc3(&cctx, ast);
@@ -2300,6 +2882,9 @@ ScmObj Scm_RegCompFromAST(ScmObj ast)
  * My preliminary test showed that using C-stack & longjmp is faster than
  * allocating and maintaining the stack by myself.   Further test is required
  * for practical case, though.
+ *
+ * The regexps that don't need backtracking are run by the lazy DFA
+ * matcher instead (see below), which doesn't have these problems.
  */
 
 struct match_ctx {
@@ -2790,6 +3375,22 @@ static ScmObj make_match(ScmRegexp *rx, ScmString *orig,
     return SCM_OBJ(rm);
 }
 
+static struct ScmRegMatchSub **alloc_submatches(int numGroups)
+{
+    struct ScmRegMatchSub **matches =
+        SCM_NEW_ARRAY(struct ScmRegMatchSub *, numGroups);
+
+    for (int i = 0; i < numGroups; i++) {
+        matches[i] = SCM_NEW(struct ScmRegMatchSub);
+        matches[i]->start = -1;
+        matches[i]->length = -1;
+        matches[i]->after = -1;
+        matches[i]->startp = NULL;
+        matches[i]->endp = NULL;
+    }
+    return matches;
+}
+
 static ScmObj rex(ScmRegexp *rx, ScmString *orig,
                   const char *start, const char *end)
 {
@@ -2802,16 +3403,7 @@ static ScmObj rex(ScmRegexp *rx, ScmString *orig,
     ctx.stop = end;
     ctx.begin_stack = (void*)&ctx;
     ctx.cont = &cont;
-    ctx.matches = SCM_NEW_ARRAY(struct ScmRegMatchSub *, rx->numGroups);
-
-    for (int i = 0; i < rx->numGroups; i++) {
-        ctx.matches[i] = SCM_NEW(struct ScmRegMatchSub);
-        ctx.matches[i]->start = -1;
-        ctx.matches[i]->length = -1;
-        ctx.matches[i]->after = -1;
-        ctx.matches[i]->startp = NULL;
-        ctx.matches[i]->endp = NULL;
-    }
+    ctx.matches = alloc_submatches(rx->numGroups);
 
     if (sigsetjmp(cont, FALSE) == 0) {
         rex_rec(ctx.codehead, start, &ctx);
@@ -2820,6 +3412,613 @@ static ScmObj rex(ScmRegexp *rx, ScmString *orig,
     return make_match(rx, orig, &ctx);
 }
 
+/*----------------------------------------------------------------------
+ * Lazy DFA matcher
+ */
+
+/* The NFA programs created by pass 4 are run as a DFA.  A DFA state
+ * is a list of NFA threads in the order of priority, and the char
+ * context of the last char consumed.  The threads point to the
+ * instructions right after the consumed char.  Their epsilon closure
+ * is taken when the next char is known, since assertions depend on it.
+ *
+ * DFA states and transitions are created when they're first needed,
+ * and cached in the program.  ASCII chars are grouped into classes
+ * (see rc4_setup_classes) and each state has a transition table indexed
+ * by class.  Non-ASCII chars share a class if the program can't tell
+ * them apart; otherwise, each state memoizes a few recent transitions.
+ *
+ * The forward program is unanchored; a thread starting from the
+ * beginning of the program is added with the lowest priority at every
+ * position, until any match is found.  Once a thread matches, the
+ * threads with lower priority are discarded.  The last match found
+ * while running the DFA is the leftmost match the backtracking matcher
+ * would find.  The reverse program runs backward from the end of the
+ * match and finds the longest match, which gives the leftmost beginning.
+ *
+ * Cached transitions are read without locking.  New states are computed
+ * while holding dfa_mutex, and transitions are stored atomically after
+ * the target state is fully set up.  If a program has too many states,
+ * we just switch to a fresh cache; the states in the old one remain
+ * valid for the matchers that are still using them.
+ */
+
+#define DFA_MATCHED     (1L<<0) /* A thread matched right before the
+                                   char leading to this state */
+#define DFA_FOUND       (1L<<1) /* A match has been found so far */
+
+#define DFA_MEMO_SIZE   8       /* # of memoized transitions for non-ASCII
+                                   chars per state */
+#define DFA_MAX_STATES  2000    /* Max # of states per cache */
+
+typedef struct dfa_state_rec {
+    struct dfa_state_rec *chain; /* next state in the hash bucket */
+    u_long hashval;
+    int flags;
+    int prev;                   /* char context of the last char */
+    int numThreads;
+    int numMatches;             /* regexp set only; # of regexps matched
+                                   right before the char leading to this
+                                   state */
+    int *threads;               /* program counters, followed by the indexes
+                                   of the matched regexps in a regexp set */
+    ScmAtomicVar eof;           /* 0: not known yet, 1: no match at the end
+                                   of input, 2: match at the end of input.
+                                   For a regexp set, a state whose matches
+                                   are the ones at the end of input. */
+    ScmAtomicVar memo[DFA_MEMO_SIZE]; /* dfa_memo */
+    ScmAtomicVar next[1];       /* transitions indexed by char class.
+                                   variable length. */
+} dfa_state;
+
+typedef struct dfa_memo_rec {
+    ScmChar ch;
+    dfa_state *state;
+} dfa_memo;
+
+typedef struct dfa_cache_rec {
+    dfa_state **buckets;
+    int numBuckets;
+    int numStates;
+    ScmAtomicVar start[3];      /* start states for each initial context */
+} dfa_cache;
+
+static ScmInternalMutex dfa_mutex;
+static int use_dfa = TRUE;
+
+int Scm__RegexpUseDFA(int flag)
+{
+    int prev = use_dfa;
+    if (flag >= 0) use_dfa = flag;
+    return prev;
+}
+
+static void *make_dfa_cache(void)
+{
+    dfa_cache *cache = SCM_NEW(dfa_cache);
+    cache->numBuckets = 64;
+    cache->buckets = SCM_NEW_ARRAY(dfa_state*, cache->numBuckets);
+    cache->numStates = 0;
+    return cache;
+}
+
+static inline int char_context(nfa_prog *prog, ScmChar ch)
+{
+    if (prog->wordp && (ch >= 0x80 || is_word_constituent((unsigned char)ch))) {
+        return CTX_WORD;
+    }
+    return CTX_NONWORD;
+}
+
+static int nfa_char_match(nfa_prog *prog, const nfa_insn *insn, ScmChar ch)
+{
+    switch (insn->op) {
+    case NFA_CHAR:
+        return ch == insn->arg;
+    case NFA_CHAR_CI:
+        /* Like RE_MATCH1_CI, a single-byte char only matches a
+           single-byte char. */
+        if (SCM_CHAR_NBYTES(insn->arg) == 1 && SCM_CHAR_NBYTES(ch) != 1) {
+            return FALSE;
+        }
+        return SCM_CHAR_DOWNCASE(ch) == insn->arg;
+    case NFA_SET:
+        return Scm_CharSetContains(prog->sets[insn->arg], ch);
+    case NFA_NSET:
+        return !Scm_CharSetContains(prog->sets[insn->arg], ch);
+    case NFA_ANY:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/* Check an assertion, given the contexts before and after the position.
+   Word boundary follows is_word_boundary(). */
+static inline int nfa_assert(int op, int prev, int next)
+{
+    int wb = (prev == CTX_EDGE || next == CTX_EDGE || prev != next);
+    switch (op) {
+    case NFA_EDGE_PREV: return prev == CTX_EDGE;
+    case NFA_EDGE_NEXT: return next == CTX_EDGE;
+    case NFA_WB:        return wb;
+    case NFA_NWB:       return !wb;
+    default:            return FALSE;
+    }
+}
+
+static int nfa_new_mark(nfa_prog *prog)
+{
+    if (++prog->markgen <= 0) {
+        memset(prog->marks, 0, sizeof(int)*prog->numInsns);
+        prog->markgen = 1;
+    }
+    return prog->markgen;
+}
+
+/* Takes the epsilon closure of THREADS under the given contexts, and
+   stores the reachable char-consuming instructions in OUT, in the order
+   of priority.  Returns TRUE if NFA_MATCH is reachable.  In the forward
+   program, threads with lower priority than the match are cut off.
+   In the program of a regexp set, reachable NFA_MATCHes are also stored
+   in OUT, so that the caller can tell which regexps matched.
+   Must be called with dfa_mutex held. */
+static int dfa_closure(nfa_prog *prog, const int *threads, int numThreads,
+                       int prev, int next, int *out, int *numOut)
+{
+    int *marks = prog->marks, *stack = prog->stack;
+    int gen = nfa_new_mark(prog);
+    int sp = 0, n = 0, matched = FALSE;
+
+    for (int i=0; i<numThreads; i++) {
+        stack[sp++] = threads[i];
+        while (sp > 0) {
+            int pc = stack[--sp];
+            if (marks[pc] == gen) continue;
+            marks[pc] = gen;
+            const nfa_insn *insn = &prog->insns[pc];
+            switch (insn->op) {
+            case NFA_JUMP:
+                stack[sp++] = insn->x;
+                break;
+            case NFA_SPLIT:
+                stack[sp++] = insn->y;
+                stack[sp++] = insn->x;
+                break;
+            case NFA_SAVE:
+                stack[sp++] = pc+1;
+                break;
+            case NFA_FAIL:
+                break;
+            case NFA_MATCH:
+                matched = TRUE;
+                if (prog->setp) out[n++] = pc;
+                else if (!prog->reversep) goto out;
+                break;
+            case NFA_EDGE_PREV: case NFA_EDGE_NEXT:
+            case NFA_WB: case NFA_NWB:
+                if (nfa_assert(insn->op, prev, next)) stack[sp++] = pc+1;
+                break;
+            default:
+                out[n++] = pc;
+            }
+        }
+    }
+ out:
+    *numOut = n;
+    return matched;
+}
+
+static u_long dfa_hash(int flags, int prev, const int *threads, int n, int m)
+{
+    u_long h = (u_long)flags*31 + (u_long)prev;
+    h = h*31 + (u_long)m;
+    for (int i=0; i<n+m; i++) h = h*31 + (u_long)threads[i];
+    return h;
+}
+
+/* Returns a state with the given properties, creating it if necessary.
+   THREADS has N program counters followed by M indexes of matched
+   regexps.  Must be called with dfa_mutex held. */
+static dfa_state *dfa_intern(nfa_prog *prog, int flags, int prev,
+                             const int *threads, int n, int m)
+{
+    dfa_cache *cache = (dfa_cache*)AO_load(&prog->cache);
+    u_long h = dfa_hash(flags, prev, threads, n, m);
+
+    for (dfa_state *s = cache->buckets[h % cache->numBuckets];
+         s; s = s->chain) {
+        if (s->hashval == h && s->flags == flags && s->prev == prev
+            && s->numThreads == n && s->numMatches == m
+            && memcmp(s->threads, threads, sizeof(int)*(n+m)) == 0) {
+            return s;
+        }
+    }
+
+    if (cache->numStates >= DFA_MAX_STATES) {
+        cache = (dfa_cache*)make_dfa_cache();
+        AO_store_full(&prog->cache, (ScmAtomicWord)cache);
+    } else if (cache->numStates >= cache->numBuckets*2) {
+        int newsize = cache->numBuckets*4;
+        dfa_state **newb = SCM_NEW_ARRAY(dfa_state*, newsize);
+        for (int i=0; i<cache->numBuckets; i++) {
+            dfa_state *s = cache->buckets[i], *next;
+            for (; s; s = next) {
+                next = s->chain;
+                s->chain = newb[s->hashval % newsize];
+                newb[s->hashval % newsize] = s;
+            }
+        }
+        cache->buckets = newb;
+        cache->numBuckets = newsize;
+    }
+
+    dfa_state *s = SCM_NEW2(dfa_state*, sizeof(dfa_state)
+                            + sizeof(ScmAtomicVar)*(prog->numClasses-1));
+    s->hashval = h;
+    s->flags = flags;
+    s->prev = prev;
+    s->numThreads = n;
+    s->numMatches = m;
+    s->threads = SCM_NEW_ATOMIC_ARRAY(int, n+m);
+    memcpy(s->threads, threads, sizeof(int)*(n+m));
+    s->chain = cache->buckets[h % cache->numBuckets];
+    cache->buckets[h % cache->numBuckets] = s;
+    cache->numStates++;
+    return s;
+}
+
+/* Computes the transition from S by CH.  Must be called with dfa_mutex
+   held. */
+static dfa_state *dfa_compute(nfa_prog *prog, dfa_state *s, ScmChar ch)
+{
+    int *reach = prog->work, *next = prog->work2;
+    int numReach, numNext = 0;
+    int context = char_context(prog, ch);
+    int matched = dfa_closure(prog, s->threads, s->numThreads,
+                              s->prev, context, reach, &numReach);
+    int flags = (s->flags & DFA_FOUND) | (matched? DFA_MATCHED : 0);
+    /* A regexp set keeps looking for the other regexps. */
+    if (matched && prog->unanchored && !prog->setp) flags |= DFA_FOUND;
+
+    int gen = nfa_new_mark(prog);
+    for (int i=0; i<numReach; i++) {
+        int pc = reach[i];
+        if (nfa_char_match(prog, &prog->insns[pc], ch)
+            && prog->marks[pc+1] != gen) {
+            prog->marks[pc+1] = gen;
+            next[numNext++] = pc+1;
+        }
+    }
+    if (prog->unanchored && !(flags & DFA_FOUND) && prog->marks[0] != gen) {
+        next[numNext++] = 0;
+    }
+    int numMatches = 0;
+    if (prog->setp) {
+        for (int i=0; i<numReach; i++) {
+            const nfa_insn *insn = &prog->insns[reach[i]];
+            if (insn->op == NFA_MATCH) next[numNext+numMatches++] = insn->arg;
+        }
+    }
+    return dfa_intern(prog, flags, context, next, numNext, numMatches);
+}
+
+/* Slow path of transition.  CLS is the char class of CH, or -1 if CH
+   is a non-ASCII char that needs to be examined individually. */
+static dfa_state *dfa_transit(nfa_prog *prog, dfa_state *s, ScmChar ch,
+                              int cls)
+{
+    dfa_state *t = NULL;
+    (void)SCM_INTERNAL_MUTEX_LOCK(dfa_mutex);
+    if (cls >= 0) t = (dfa_state*)AO_load(&s->next[cls]);
+    if (t == NULL) {
+        t = dfa_compute(prog, s, ch);
+        if (cls >= 0) {
+            AO_store_full(&s->next[cls], (ScmAtomicWord)t);
+        } else {
+            dfa_memo *m = SCM_NEW(dfa_memo);
+            m->ch = ch;
+            m->state = t;
+            AO_store_full(&s->memo[(u_long)ch % DFA_MEMO_SIZE],
+                          (ScmAtomicWord)m);
+        }
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(dfa_mutex);
+    return t;
+}
+
+static inline dfa_state *dfa_next(nfa_prog *prog, dfa_state *s, ScmChar ch)
+{
+    int cls = (ch < 0x80)? prog->asciiClass[ch] : prog->nonasciiClass;
+    if (cls >= 0) {
+        dfa_state *t = (dfa_state*)AO_load(&s->next[cls]);
+        if (t) return t;
+    } else {
+        dfa_memo *m =
+            (dfa_memo*)AO_load(&s->memo[(u_long)ch % DFA_MEMO_SIZE]);
+        if (m && m->ch == ch) return m->state;
+    }
+    return dfa_transit(prog, s, ch, cls);
+}
+
+static dfa_state *dfa_start(nfa_prog *prog, int context)
+{
+    dfa_cache *cache = (dfa_cache*)AO_load(&prog->cache);
+    dfa_state *s = (dfa_state*)AO_load(&cache->start[context]);
+    if (s) return s;
+
+    (void)SCM_INTERNAL_MUTEX_LOCK(dfa_mutex);
+    int pc0 = 0;
+    s = dfa_intern(prog, 0, context, &pc0, 1, 0);
+    cache = (dfa_cache*)AO_load(&prog->cache);
+    AO_store_full(&cache->start[context], (ScmAtomicWord)s);
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(dfa_mutex);
+    return s;
+}
+
+/* Returns TRUE if a thread in S matches at the end of input. */
+static int dfa_eof(nfa_prog *prog, dfa_state *s)
+{
+    ScmAtomicWord r = AO_load(&s->eof);
+    if (r == 0) {
+        int n;
+        (void)SCM_INTERNAL_MUTEX_LOCK(dfa_mutex);
+        r = dfa_closure(prog, s->threads, s->numThreads, s->prev, CTX_EDGE,
+                        prog->work, &n)? 2 : 1;
+        AO_store_full(&s->eof, r);
+        (void)SCM_INTERNAL_MUTEX_UNLOCK(dfa_mutex);
+    }
+    return r == 2;
+}
+
+/* Runs the forward program over [from, stop) and returns the end of
+   the leftmost match, or NULL if there's no match.  INPUT is the
+   beginning of the input, and no match should begin before FROM. */
+static const char *dfa_forward(nfa_prog *prog, const char *input,
+                               const char *from, const char *stop)
+{
+    int context = CTX_EDGE;
+    if (from > input) {
+        const char *q;
+        ScmChar ch;
+        SCM_CHAR_BACKWARD(from, input, q);
+        SCM_CHAR_GET(q, ch);
+        context = char_context(prog, ch);
+    }
+    dfa_state *s = dfa_start(prog, context), *t;
+    const char *p = from, *last = NULL;
+
+    while (p < stop) {
+        const char *q = p;
+        unsigned char b = (unsigned char)*p;
+        if (b < 0x80) {
+            t = (dfa_state*)AO_load(&s->next[prog->asciiClass[b]]);
+            if (t == NULL) t = dfa_transit(prog, s, b, prog->asciiClass[b]);
+            p++;
+        } else {
+            ScmChar ch;
+            SCM_CHAR_GET(p, ch);
+            t = dfa_next(prog, s, ch);
+            p += SCM_CHAR_NBYTES(ch);
+        }
+        if (t->flags & DFA_MATCHED) last = q;
+        if (t->numThreads == 0) return last;
+        s = t;
+    }
+    if (dfa_eof(prog, s)) last = stop;
+    return last;
+}
+
+/* Runs the reverse program from END toward INPUT, and returns the
+   leftmost position from which the match can reach END. */
+static const char *dfa_backward(nfa_prog *prog, const char *input,
+                                const char *stop, const char *end)
+{
+    ScmChar ch;
+    int context = CTX_EDGE;
+    if (end < stop) {
+        SCM_CHAR_GET(end, ch);
+        context = char_context(prog, ch);
+    }
+    dfa_state *s = dfa_start(prog, context);
+    const char *p = end, *last = NULL;
+
+    while (p > input) {
+        const char *q;
+        SCM_CHAR_BACKWARD(p, input, q);
+        SCM_ASSERT(q != NULL);
+        SCM_CHAR_GET(q, ch);
+        dfa_state *t = dfa_next(prog, s, ch);
+        if (t->flags & DFA_MATCHED) last = p;
+        if (t->numThreads == 0) return last;
+        s = t;
+        p = q;
+    }
+    if (dfa_eof(prog, s)) last = input;
+    return last;
+}
+
+/* Once we know the boundary of the match, we find submatches by running
+ * the forward program as an NFA simulation (Pike VM) over the matched
+ * region.  Each thread carries its own copy of submatch slots.  Threads
+ * are kept in the order of priority, and at most one thread exists
+ * per instruction, so it runs in O(input size * program size) time.
+ */
+typedef struct pike_list_rec {
+    int numThreads;
+    int *pcs;
+    const char **slots;         /* numSlots entries per thread */
+} pike_list;
+
+typedef struct pike_entry_rec {
+    int pc;                     /* instruction to visit, or -1 to restore */
+    int slot;
+    const char *val;
+} pike_entry;
+
+typedef struct pike_ctx_rec {
+    nfa_prog *prog;
+    int numSlots;
+    int *marks;
+    int markgen;
+    pike_entry *stack;
+} pike_ctx;
+
+/* Add threads reachable from PC with SLOTS at position POS to LIST.
+   SLOTS is modified during the operation, but restored at the end. */
+static void pike_add(pike_ctx *ctx, pike_list *list, int pc,
+                     const char **slots, const char *pos,
+                     int prev, int next)
+{
+    const nfa_insn *insns = ctx->prog->insns;
+    pike_entry *stack = ctx->stack;
+    int sp = 0;
+
+    stack[sp].pc = pc;
+    sp++;
+    while (sp > 0) {
+        pike_entry *e = &stack[--sp];
+        if (e->pc < 0) {
+            slots[e->slot] = e->val;
+            continue;
+        }
+        pc = e->pc;
+        if (ctx->marks[pc] == ctx->markgen) continue;
+        ctx->marks[pc] = ctx->markgen;
+        const nfa_insn *insn = &insns[pc];
+        switch (insn->op) {
+        case NFA_JUMP:
+            stack[sp++].pc = insn->x;
+            break;
+        case NFA_SPLIT:
+            stack[sp++].pc = insn->y;
+            stack[sp++].pc = insn->x;
+            break;
+        case NFA_SAVE:
+            stack[sp].pc = -1;
+            stack[sp].slot = insn->arg;
+            stack[sp].val = slots[insn->arg];
+            sp++;
+            slots[insn->arg] = pos;
+            stack[sp++].pc = pc+1;
+            break;
+        case NFA_FAIL:
+            break;
+        case NFA_EDGE_PREV: case NFA_EDGE_NEXT:
+        case NFA_WB: case NFA_NWB:
+            if (nfa_assert(insn->op, prev, next)) stack[sp++].pc = pc+1;
+            break;
+        default:
+            list->pcs[list->numThreads] = pc;
+            memcpy(&list->slots[list->numThreads * ctx->numSlots], slots,
+                   sizeof(const char*) * ctx->numSlots);
+            list->numThreads++;
+        }
+    }
+}
+
+/* Finds submatches of the match [FROM, TO) and set them to MATCHES.
+   Returns FALSE if it can't find the match, which shouldn't happen. */
+static int pike_submatch(nfa_prog *prog, const char *input, const char *stop,
+                         const char *from, const char *to,
+                         struct ScmRegMatchSub **matches)
+{
+    int numGroups = prog->rx->numGroups;
+    int numSlots = numGroups*2, n = prog->numInsns;
+    pike_ctx ctx;
+    pike_list lists[2];
+    pike_list *clist = &lists[0], *nlist = &lists[1];
+    const char **slots = SCM_NEW_ATOMIC_ARRAY(const char*, numSlots);
+    ScmChar ch;
+
+    ctx.prog = prog;
+    ctx.numSlots = numSlots;
+    ctx.marks = SCM_NEW_ATOMIC_ARRAY(int, n);
+    memset(ctx.marks, 0, sizeof(int)*n);
+    ctx.markgen = 1;
+    ctx.stack = SCM_NEW_ATOMIC_ARRAY(pike_entry, n*2+2);
+    for (int i=0; i<2; i++) {
+        lists[i].numThreads = 0;
+        lists[i].pcs = SCM_NEW_ATOMIC_ARRAY(int, n);
+        lists[i].slots = SCM_NEW_ATOMIC_ARRAY(const char*, n*numSlots);
+    }
+    for (int i=0; i<numSlots; i++) slots[i] = NULL;
+
+    int prev = CTX_EDGE, next = CTX_EDGE;
+    if (from > input) {
+        const char *q;
+        SCM_CHAR_BACKWARD(from, input, q);
+        SCM_CHAR_GET(q, ch);
+        prev = char_context(prog, ch);
+    }
+    if (from < stop) {
+        SCM_CHAR_GET(from, ch);
+        next = char_context(prog, ch);
+    }
+    pike_add(&ctx, clist, 0, slots, from, prev, next);
+
+    for (const char *p = from; p < to; ) {
+        SCM_CHAR_GET(p, ch);
+        p += SCM_CHAR_NBYTES(ch);
+        prev = char_context(prog, ch);
+        next = CTX_EDGE;
+        if (p < stop) {
+            ScmChar nch;
+            SCM_CHAR_GET(p, nch);
+            next = char_context(prog, nch);
+        }
+        ctx.markgen++;
+        nlist->numThreads = 0;
+        for (int i=0; i<clist->numThreads; i++) {
+            const nfa_insn *insn = &prog->insns[clist->pcs[i]];
+            if (insn->op == NFA_MATCH) break; /* cut lower priority ones */
+            if (!nfa_char_match(prog, insn, ch)) continue;
+            memcpy(slots, &clist->slots[i*numSlots],
+                   sizeof(const char*)*numSlots);
+            pike_add(&ctx, nlist, clist->pcs[i]+1, slots, p, prev, next);
+        }
+        pike_list *tmp = clist; clist = nlist; nlist = tmp;
+    }
+
+    for (int i=0; i<clist->numThreads; i++) {
+        if (prog->insns[clist->pcs[i]].op != NFA_MATCH) continue;
+        const char **r = &clist->slots[i*numSlots];
+        for (int g=0; g<numGroups; g++) {
+            matches[g]->startp = r[g*2];
+            matches[g]->endp = r[g*2+1];
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static ScmObj rex_dfa(ScmRegexp *rx, ScmString *orig,
+                      const char *start, const char *from, const char *end)
+{
+    regexp_dfa *dfa = (regexp_dfa*)rx->dfa;
+    const char *mend = dfa_forward(dfa->forward, start, from, end);
+    if (mend == NULL) return SCM_FALSE;
+    const char *mstart = dfa_backward(dfa->reverse, start, end, mend);
+    SCM_ASSERT(mstart != NULL);
+
+    struct match_ctx ctx;
+    ctx.rx = rx;
+    ctx.input = start;
+    ctx.stop = end;
+    ctx.matches = alloc_submatches(rx->numGroups);
+    if (rx->numGroups > 1) {
+        if (!pike_submatch(dfa->forward, start, end, mstart, mend,
+                           ctx.matches)) {
+            /* Shouldn't happen, but just in case. */
+            return rex(rx, orig, mstart, end);
+        }
+    } else {
+        ctx.matches[0]->startp = mstart;
+        ctx.matches[0]->endp = mend;
+    }
+    return make_match(rx, orig, &ctx);
+}
+
 /* advance start pointer while the character matches (skip_match=TRUE) or does
    not match (skip_match=FALSE), until start pointer hits limit. */
 static inline const char *skip_input(const char *start, const char *limit,
@@ -2838,6 +4037,31 @@ static inline const char *skip_input(const char *start, const char *limit,
     return limit;
 }
 
+static int use_prefilter = TRUE;
+
+int Scm__RegexpUsePrefilter(int flag)
+{
+    int prev = use_prefilter;
+    if (flag >= 0) use_prefilter = flag;
+    return prev;
+}
+
+/* Returns the first occurrence of the literal LIT of SIZE bytes in
+   [start, end), or NULL.  We look for the first byte with memchr, which
+   is usually well tuned. */
+static const char *find_literal(const char *start, const char *end,
+                                const char *lit, int size)
+{
+    const char *p = start, *limit = end - size;
+    while (p <= limit) {
+        p = memchr(p, (unsigned char)lit[0], limit - p + 1);
+        if (p == NULL) return NULL;
+        if (memcmp(p+1, lit+1, size-1) == 0) return p;
+        p++;
+    }
+    return NULL;
+}
+
 /*----------------------------------------------------------------------
  * entry point
  */
@@ -2853,26 +4077,39 @@ ScmObj Scm_RegExec(ScmRegexp *rx, ScmString *str)
     if (SCM_STRING_INCOMPLETE_P(str)) {
         Scm_Error("incomplete string is not allowed: %S", str);
     }
-#if 0
-    /* Disabled for now; we need to use more heuristics to determine
-       when we should apply mustMatch.  For example, if the regexp
-       begins with BOL assertion and constant string, then it would be
-       faster to go for rex directly. */
-    if (rx->mustMatch) {
-        /* Prescreening.  If the input string doesn't contain mustMatch
-           string, it can't match the entire expression. */
-        if (SCM_FALSEP(Scm_StringScan(str, rx->mustMatch,
-                                      SCM_STRING_SCAN_INDEX))) {
-            return SCM_FALSE;
-        }
+    /* Prescreening.  If the input doesn't contain the required literal,
+       it can't match.  If every match begins with the literal, we can
+       skip to its first occurrence.  We don't bother if rx matches only
+       at the beginning, for it would be faster to go for rex directly. */
+    const char *first = NULL;   /* first occurrence of the literal prefix */
+    if (rx->mustMatch && use_prefilter
+        && !(rx->flags & SCM_REGEXP_BOL_ANCHORED)) {
+        const char *p = find_literal(start, end, SCM_STRING_BODY_START(mb),
+                                     mustMatchLen);
+        if (p == NULL) return SCM_FALSE;
+        if (rx->flags & SCM_REGEXP_LITERAL_PREFIX) first = p;
+    }
+
+    if (rx->dfa && use_dfa) {
+        return rex_dfa(rx, str, start, first? first : start, end);
     }
-#endif
     /* short cut : if rx matches only at the beginning of the string,
        we only run from the beginning of the string */
     if (rx->flags & SCM_REGEXP_BOL_ANCHORED) {
         return rex(rx, str, start, end);
     }
 
+    /* jump from an occurrence of the literal prefix to the next. */
+    if (first) {
+        while (first != NULL) {
+            ScmObj r = rex(rx, str, first, end);
+            if (!SCM_FALSEP(r)) return r;
+            first = find_literal(first + SCM_CHAR_NFOLLOWS(*first) + 1, end,
+                                 SCM_STRING_BODY_START(mb), mustMatchLen);
+        }
+        return SCM_FALSE;
+    }
+
     /* if we have lookahead-set, we may be able to skip input efficiently. */
     if (!SCM_FALSEP(rx->laset)) {
         if (rx->flags & SCM_REGEXP_SIMPLE_PREFIX) {
@@ -2904,6 +4141,188 @@ ScmObj Scm_RegExec(ScmRegexp *rx, ScmString *str)
     return SCM_FALSE;
 }
 
+/*=======================================================================
+ * Regexp set
+ */
+
+/* A regexp set combines the forward programs of its regexps into one
+ * program, which begins with a chain of SPLITs to each of them, and
+ * whose NFA_MATCHes tell which regexp matched.  It is run by the lazy
+ * DFA matcher just like a single regexp, except that a match doesn't
+ * cut other threads.  The matched regexps are recorded in DFA states
+ * (see dfa_compute), so a single scan of the input tells all the
+ * regexps that match it.  The scan stops as soon as every regexp has
+ * matched.
+ */
+
+static void regexp_set_print(ScmObj obj, ScmPort *port,
+                             ScmWriteContext *ctx SCM_UNUSED)
+{
+    Scm_Printf(port, "#<regexp-set %d>", SCM_REGEXP_SET(obj)->numRegexps);
+}
+
+ScmObj Scm_MakeRegexpSet(ScmObj regexps)
+{
+    int numRegexps = Scm_Length(regexps);
+    if (numRegexps < 0) {
+        Scm_Error("proper list of regexps required, but got: %S", regexps);
+    }
+    ScmRegexp **rxs = SCM_NEW_ARRAY(ScmRegexp*, numRegexps);
+    int numInsns = (numRegexps > 0)? numRegexps : 1, numSets = 0, k = 0;
+    ScmObj cp;
+    SCM_FOR_EACH(cp, regexps) {
+        ScmObj rx = SCM_CAR(cp);
+        if (!SCM_REGEXPP(rx)) Scm_Error("regexp required, but got: %S", rx);
+        if (SCM_REGEXP(rx)->dfa == NULL) {
+            Scm_Error("regexp requires backtracking and can't be a member "
+                      "of a regexp set: %S", rx);
+        }
+        numInsns += ((regexp_dfa*)SCM_REGEXP(rx)->dfa)->forward->numInsns;
+        numSets += SCM_REGEXP(rx)->numSets;
+        rxs[k++] = SCM_REGEXP(rx);
+    }
+
+    nfa_prog *prog = SCM_NEW(nfa_prog);
+    prog->rx = NULL;
+    prog->insns = SCM_NEW_ATOMIC_ARRAY(nfa_insn, numInsns);
+    prog->numInsns = numInsns;
+    prog->sets = SCM_NEW_ARRAY(ScmCharSet*, numSets);
+    prog->reversep = FALSE;
+    prog->unanchored = TRUE;
+    prog->setp = TRUE;
+
+    nfa_insn *insns = prog->insns;
+    int pc = (numRegexps > 0)? numRegexps : 1, setbase = 0;
+    insns[0].op = NFA_FAIL;     /* for an empty set */
+    insns[0].arg = insns[0].x = insns[0].y = 0;
+    for (k=0; k<numRegexps; k++) {
+        nfa_prog *fwd = ((regexp_dfa*)rxs[k]->dfa)->forward;
+        insns[k].op = (k < numRegexps-1)? NFA_SPLIT : NFA_JUMP;
+        insns[k].arg = 0;
+        insns[k].x = pc;
+        insns[k].y = k+1;
+        for (int i=0; i<fwd->numInsns; i++) {
+            nfa_insn *insn = &insns[pc+i];
+            *insn = fwd->insns[i];
+            switch (insn->op) {
+            case NFA_SPLIT: insn->x += pc; insn->y += pc; break;
+            case NFA_JUMP:  insn->x += pc; break;
+            case NFA_SET: case NFA_NSET: insn->arg += setbase; break;
+            case NFA_MATCH: insn->arg = k; break;
+            }
+        }
+        for (int i=0; i<rxs[k]->numSets; i++) {
+            prog->sets[setbase+i] = rxs[k]->sets[i];
+        }
+        pc += fwd->numInsns;
+        setbase += rxs[k]->numSets;
+    }
+    rc4_prog_init(prog);
+
+    ScmRegexpSet *rs = SCM_NEW(ScmRegexpSet);
+    SCM_SET_CLASS(rs, SCM_CLASS_REGEXP_SET);
+    rs->numRegexps = numRegexps;
+    rs->regexps = rxs;
+    rs->prog = prog;
+    return SCM_OBJ(rs);
+}
+
+/* Returns a state whose matches are the regexps matching at the end of
+   input after S. */
+static dfa_state *regexp_set_eof(nfa_prog *prog, dfa_state *s)
+{
+    dfa_state *e = (dfa_state*)AO_load(&s->eof);
+    if (e == NULL) {
+        int *reach = prog->work, *matches = prog->work2;
+        int numReach, numMatches = 0;
+        (void)SCM_INTERNAL_MUTEX_LOCK(dfa_mutex);
+        dfa_closure(prog, s->threads, s->numThreads, s->prev, CTX_EDGE,
+                    reach, &numReach);
+        for (int i=0; i<numReach; i++) {
+            const nfa_insn *insn = &prog->insns[reach[i]];
+            if (insn->op == NFA_MATCH) matches[numMatches++] = insn->arg;
+        }
+        e = dfa_intern(prog, 0, CTX_EDGE, matches, 0, numMatches);
+        AO_store_full(&s->eof, (ScmAtomicWord)e);
+        (void)SCM_INTERNAL_MUTEX_UNLOCK(dfa_mutex);
+    }
+    return e;
+}
+
+/* Marks the regexps matched in S, and returns the updated # of regexps
+   that haven't matched yet. */
+static inline int regexp_set_record(dfa_state *s, char *matched,
+                                    int remaining)
+{
+    for (int i=0; i<s->numMatches; i++) {
+        int k = s->threads[s->numThreads+i];
+        if (!matched[k]) {
+            matched[k] = TRUE;
+            remaining--;
+        }
+    }
+    return remaining;
+}
+
+/* Returns a list of indexes of the regexps in RS that match INPUT,
+   which is either a string or an input port.  A port is read until
+   every regexp has matched, or EOF is reached. */
+ScmObj Scm_RegexpSetMatch(ScmRegexpSet *rs, ScmObj input)
+{
+    nfa_prog *prog = (nfa_prog*)rs->prog;
+    int remaining = rs->numRegexps;
+    char *matched = SCM_NEW_ATOMIC_ARRAY(char, remaining+1);
+    memset(matched, 0, remaining+1);
+    dfa_state *s = dfa_start(prog, CTX_EDGE), *t;
+
+    if (SCM_STRINGP(input)) {
+        if (SCM_STRING_INCOMPLETE_P(input)) {
+            Scm_Error("incomplete string is not allowed: %S", input);
+        }
+        const ScmStringBody *b = SCM_STRING_BODY(input);
+        const char *p = SCM_STRING_BODY_START(b);
+        const char *end = p + SCM_STRING_BODY_SIZE(b);
+        while (remaining > 0 && p < end) {
+            unsigned char c = (unsigned char)*p;
+            if (c < 0x80) {
+                t = (dfa_state*)AO_load(&s->next[prog->asciiClass[c]]);
+                if (t == NULL) t = dfa_transit(prog, s, c, prog->asciiClass[c]);
+                p++;
+            } else {
+                ScmChar ch;
+                SCM_CHAR_GET(p, ch);
+                t = dfa_next(prog, s, ch);
+                p += SCM_CHAR_NBYTES(ch);
+            }
+            if (t->numMatches > 0) {
+                remaining = regexp_set_record(t, matched, remaining);
+            }
+            s = t;
+        }
+    } else if (SCM_IPORTP(input)) {
+        while (remaining > 0) {
+            ScmChar ch = Scm_Getc(SCM_PORT(input));
+            if (ch == EOF) break;
+            t = dfa_next(prog, s, ch);
+            if (t->numMatches > 0) {
+                remaining = regexp_set_record(t, matched, remaining);
+            }
+            s = t;
+        }
+    } else {
+        Scm_Error("string or input port required, but got: %S", input);
+    }
+    if (remaining > 0) {
+        regexp_set_record(regexp_set_eof(prog, s), matched, remaining);
+    }
+
+    ScmObj h = SCM_NIL, tail = SCM_NIL;
+    for (int k=0; k<rs->numRegexps; k++) {
+        if (matched[k]) SCM_APPEND1(h, tail, SCM_MAKE_INT(k));
+    }
+    return h;
+}
+
 /*=======================================================================
  * Retrieving matches
  */
@@ -3093,4 +4512,5 @@ void Scm_RegMatchDump(ScmRegMatch *rm)
 
 void Scm__InitRegexp(void)
 {
+    SCM_INTERNAL_MUTEX_INIT(dfa_mutex);
 }
@@ -33,6 +33,7 @@
 
 #define LIBGAUCHE_BODY
 #include "gauche.h"
+#include "gauche/priv/atomicP.h"
 
 #include <string.h>
 #include <ctype.h>
@@ -468,6 +469,148 @@ static const char *forward_pos(const char *current, ScmSmallInt offset)
     return current;
 }
 
+/*
+ * Character index
+ *
+ *   Finding the position of the k-th character of a multibyte string
+ *   requires scanning from the beginning.  To avoid making loops over
+ *   long strings quadratic, we attach a sparse index to the string body;
+ *   offsets[i] is the byte offset of the (i << shift)-th character.
+ *   Since a string body is never modified once created (string mutation
+ *   replaces the body), the index stays valid as long as the body lives.
+ *
+ *   The index is allocated when a position farther than the interval
+ *   is first looked up in a long enough body, and filled incrementally
+ *   up to the farthest position looked up so far, so a single lookup
+ *   never costs more than scanning up to that position.  The index may
+ *   be filled by more than one thread at the same time, but they write
+ *   the same values; 'built' is only advanced after the entries below
+ *   it are written, so a reader never sees an unfilled entry.
+ *
+ *   Bodies outside of the GC heap, notably the ones of the string
+ *   literals in precompiled code, can be in read-only memory, so we
+ *   never attach an index to them; access to them just scans.
+ *
+ *   The interval is a trade-off between memory and speed.  The default
+ *   (32 characters) costs 4 bytes per 32 characters.  It can be changed
+ *   by Scm_StringIndexInterval; setting 0 disables automatic indexing.
+ */
+
+typedef struct string_index_rec {
+    int shift;                  /* log2 of the interval */
+    ScmAtomicVar built;         /* # of valid entries in offsets[] */
+    ScmSmallInt numEntries;
+    uint32_t offsets[1];
+} string_index;
+
+#define STRING_INDEX_SHIFT_DEFAULT  5
+#define STRING_INDEX_SHIFT_MAX      16
+
+static int string_index_shift = STRING_INDEX_SHIFT_DEFAULT; /* 0: disabled */
+
+/* Set the interval of checkpoints of character index to N characters,
+   which is rounded up to power of 2.  0 disables building index
+   automatically.  Negative N doesn't change the setting.  Returns
+   the previous value. */
+ScmSmallInt Scm_StringIndexInterval(ScmSmallInt n)
+{
+    ScmSmallInt prev = string_index_shift? (1L<<string_index_shift) : 0;
+    if (n == 0) {
+        string_index_shift = 0;
+    } else if (n > 0) {
+        int shift = 1;
+        while ((1L<<shift) < n && shift < STRING_INDEX_SHIFT_MAX) shift++;
+        string_index_shift = shift;
+    }
+    return prev;
+}
+
+/* Returns NULL if B can't have an index. */
+static string_index *make_string_index(const ScmStringBody *b, int shift)
+{
+    if (GC_base((void*)b) == NULL) return NULL;
+    ScmSmallInt n = (SCM_STRING_BODY_LENGTH(b) >> shift) + 1;
+    string_index *ix =
+        SCM_NEW_ATOMIC2(string_index*,
+                        sizeof(string_index) + sizeof(uint32_t)*(n-1));
+    ix->shift = shift;
+    ix->numEntries = n;
+    ix->offsets[0] = 0;
+    AO_store_full(&ix->built, 1);
+    /* Benign race: if another thread attaches an index at the same time,
+       one of them is discarded. */
+    ((ScmStringBody*)b)->index = ix;
+    return ix;
+}
+
+/* Make sure offsets[k] is valid. */
+static void fill_string_index(const ScmStringBody *b, string_index *ix,
+                              ScmSmallInt k)
+{
+    ScmSmallInt i = (ScmSmallInt)AO_load(&ix->built);
+    if (k < i) return;
+    const char *start = SCM_STRING_BODY_START(b);
+    const char *p = start + ix->offsets[i-1];
+    for (; i <= k; i++) {
+        p = forward_pos(p, 1L << ix->shift);
+        ix->offsets[i] = (uint32_t)(p - start);
+    }
+    AO_store_full(&ix->built, (ScmAtomicWord)i);
+}
+
+/* Returns the pointer to the offset-th character of a complete body B.
+   Args assumed in boundary. */
+static const char *body_pos(const ScmStringBody *b, ScmSmallInt offset)
+{
+    if (SCM_STRING_BODY_SINGLE_BYTE_P(b)) {
+        return SCM_STRING_BODY_START(b) + offset;
+    }
+    string_index *ix = (string_index*)b->index;
+    if (ix == NULL) {
+        int shift = string_index_shift;
+        if (shift == 0 || offset < (1L<<shift)
+            || SCM_STRING_BODY_SIZE(b) > (ScmSmallInt)UINT32_MAX) {
+            return forward_pos(SCM_STRING_BODY_START(b), offset);
+        }
+        ix = make_string_index(b, shift);
+        if (ix == NULL) return forward_pos(SCM_STRING_BODY_START(b), offset);
+    }
+    ScmSmallInt k = offset >> ix->shift;
+    fill_string_index(b, ix, k);
+    return forward_pos(SCM_STRING_BODY_START(b) + ix->offsets[k],
+                       offset & ((1L<<ix->shift)-1));
+}
+
+/* Build the whole index of STR now, regardless of the automatic indexing
+   setting.  Useful if STR is going to be accessed randomly by multiple
+   threads.  Returns STR. */
+ScmObj Scm_StringBuildIndex(ScmString *str)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(str);
+    if (!Scm_StringBodyFastIndexableP(b)) {
+        string_index *ix = (string_index*)b->index;
+        if (ix == NULL) {
+            ix = make_string_index(b, (string_index_shift
+                                       ? string_index_shift
+                                       : STRING_INDEX_SHIFT_DEFAULT));
+        }
+        if (ix) fill_string_index(b, ix, ix->numEntries-1);
+    }
+    return SCM_OBJ(str);
+}
+
+/* Returns TRUE if random access to B is O(1), that is, B is single-byte
+   or incomplete, or B has the index fully built. */
+int Scm_StringBodyFastIndexableP(const ScmStringBody *b)
+{
+    if (SCM_STRING_BODY_SINGLE_BYTE_P(b) || SCM_STRING_BODY_INCOMPLETE_P(b)) {
+        return TRUE;
+    }
+    string_index *ix = (string_index*)b->index;
+    return (ix != NULL
+            && (ScmSmallInt)AO_load(&ix->built) == ix->numEntries);
+}
+
 /* string-ref.
  * If POS is out of range,
  *   - returns SCM_CHAR_INVALID if range_error is FALSE
@@ -496,7 +639,7 @@ ScmChar Scm_StringRef(ScmString *str, ScmSmallInt pos, int range_error)
     if (SCM_STRING_BODY_SINGLE_BYTE_P(b)) {
         return (ScmChar)(((unsigned char *)SCM_STRING_BODY_START(b))[pos]);
     } else {
-        const char *p = forward_pos(SCM_STRING_BODY_START(b), pos);
+        const char *p = body_pos(b, pos);
         ScmChar c;
         SCM_CHAR_GET(p, c);
         return c;
@@ -534,7 +677,7 @@ const char *Scm_StringBodyPosition(const ScmStringBody *b, ScmSmallInt offset)
     if (SCM_STRING_BODY_INCOMPLETE_P(b)) {
         return (SCM_STRING_BODY_START(b)+offset);
     } else {
-        return (forward_pos(SCM_STRING_BODY_START(b), offset));
+        return body_pos(b, offset);
     }
 }
 
@@ -776,12 +919,13 @@ static ScmObj substring(const ScmStringBody *xb,
                                 flags));
     } else {
         const char *s, *e;
-        if (start) s = forward_pos(SCM_STRING_BODY_START(xb), start);
+        if (start) s = body_pos(xb, start);
         else s = SCM_STRING_BODY_START(xb);
         if (len == end) {
             e = SCM_STRING_BODY_START(xb) + SCM_STRING_BODY_SIZE(xb);
         } else {
-            e = forward_pos(s, end - start);
+            if (xb->index) e = body_pos(xb, end);
+            else           e = forward_pos(s, end - start);
             flags &= ~SCM_STRING_TERMINATED;
         }
         return SCM_OBJ(make_str((ScmSmallInt)(end - start),
@@ -1401,12 +1545,12 @@ ScmObj Scm_MakeStringPointer(ScmString *src, ScmSmallInt index,
         ptr = sptr + index;
         effective_size = end - start;
     } else {
-        sptr = forward_pos(SCM_STRING_BODY_START(srcb), start);
-        ptr = forward_pos(sptr, index);
+        sptr = body_pos(srcb, start);
+        ptr = body_pos(srcb, start + index);
         if (end == len) {
             eptr = SCM_STRING_BODY_START(srcb) + SCM_STRING_BODY_SIZE(srcb);
         } else {
-            eptr = forward_pos(sptr, end - start);
+            eptr = body_pos(srcb, end);
         }
         effective_size = eptr - ptr;
     }
@@ -1481,8 +1625,20 @@ ScmObj Scm_StringPointerSet(ScmStringPointer *sp, ScmSmallInt index)
         sp->current = sp->start + index;
     } else {
         if (index > sp->length) goto badindex;
+        /* Move from the current position if it's closer than the start. */
+        if (index >= sp->index) {
+            sp->current = forward_pos(sp->current, index - sp->index);
+        } else if (index > sp->index - index) {
+            for (ScmSmallInt i = sp->index; i > index; i--) {
+                const char *prev;
+                SCM_CHAR_BACKWARD(sp->current, sp->start, prev);
+                SCM_ASSERT(prev != NULL);
+                sp->current = prev;
+            }
+        } else {
+            sp->current = forward_pos(sp->start, index);
+        }
         sp->index = index;
-        sp->current = forward_pos(sp->start, index);
     }
     return SCM_OBJ(sp);
   badindex:
@@ -2317,6 +2317,509 @@ ScmObj Scm_SysSelectX(ScmObj rfds, ScmObj wfds, ScmObj efds, ScmObj timeout)
 
 #endif /* HAVE_SELECT */
 
+/*===============================================================
+ * poll/epoll
+ */
+
+/* A poller keeps the set of descriptors to watch in the kernel (epoll)
+ * or in an array passed to poll(2) as is, so that we don't need to
+ * rebuild fdsets for every wait, and the number of descriptors isn't
+ * limited by FD_SETSIZE.  Waiting with epoll costs O(# of ready fds);
+ * with poll it is O(# of registered fds), but still without the setup
+ * cost of select.
+ *
+ * In the edge-triggered mode, an event is reported only when the
+ * condition newly arises.  Epoll supports it natively.  With poll,
+ * we emulate it by dropping the conditions once reported from the
+ * events to watch, so that poll doesn't return at once for them.
+ * Since poll(2) reports hangups and errors regardless of the events,
+ * an fd is parked by negating it after they are reported.  Dropped
+ * conditions are watched again when the fd is set again, or when a
+ * probing poll with zero timeout at the beginning of a wait finds
+ * them cleared.
+ *
+ * Epoll refuses regular files and some other descriptors (EPERM),
+ * for they are always ready.  We keep them aside, and report them
+ * ready on every wait as select and poll do (only once after they
+ * are set in the edge-triggered mode).
+ */
+
+#ifdef HAVE_POLL
+#include <poll.h>
+#ifdef HAVE_EPOLL_CREATE1
+#include <sys/epoll.h>
+#endif
+
+enum {
+    POLLER_EPOLL,
+    POLLER_POLL
+};
+
+#define POLLER_R  1
+#define POLLER_W  2
+#define POLLER_X  4
+#define POLLER_ALWAYS 8         /* epoll backend: fd is in always[] */
+
+typedef struct poller_always_rec {
+    int fd;
+    int reported;               /* for edge-triggered mode */
+} poller_always;
+
+struct ScmSysPollerRec {
+    SCM_HEADER;
+    int backend;                /* POLLER_EPOLL or POLLER_POLL */
+    int edge;                   /* TRUE if edge-triggered */
+    int epfd;                   /* epoll descriptor, or -1 */
+    int closed;
+    int numfds;                 /* # of registered descriptors */
+    int maskSize;
+    u_char *masks;              /* fd -> registered POLLER_* flags */
+    /* poll backend.  Registered descriptors are packed in pfds. */
+    int pfdSize;
+    struct pollfd *pfds;
+    short *reported;            /* revents reported and still pending, for
+                                   emulating edge-triggered mode */
+    int *index;                 /* fd -> index in pfds */
+    /* epoll backend */
+    int evSize;
+    void *evs;                  /* buffer for epoll_wait */
+    int numAlways;              /* descriptors epoll doesn't accept */
+    int alwaysSize;
+    poller_always *always;
+};
+
+static ScmObj sym_r, sym_w, sym_x, sym_epoll, sym_poll;
+static ScmObj poller_flags[8];  /* POLLER_* flags -> list of symbols */
+
+static void poller_print(ScmObj obj, ScmPort *port,
+                         ScmWriteContext *ctx SCM_UNUSED)
+{
+    ScmSysPoller *p = SCM_SYS_POLLER(obj);
+    Scm_Printf(port, "#<sys-poller %S%s %d fds%s>",
+               Scm_SysPollerBackend(p), (p->edge? " edge-triggered" : ""),
+               p->numfds, (p->closed? " (closed)" : ""));
+}
+
+static void poller_finalize(ScmObj obj, void *data SCM_UNUSED)
+{
+    Scm_SysPollerClose(SCM_SYS_POLLER(obj));
+}
+
+static ScmObj poller_allocate(ScmClass *klass, ScmObj initargs)
+{
+    ScmObj backend = SCM_GET_KEYWORD("backend", initargs, SCM_FALSE);
+    ScmObj edge = SCM_GET_KEYWORD("edge-triggered", initargs, SCM_FALSE);
+    ScmSysPoller *p = SCM_NEW_INSTANCE(ScmSysPoller, klass);
+
+    if (SCM_FALSEP(backend)) {
+#ifdef HAVE_EPOLL_CREATE1
+        backend = sym_epoll;
+#else
+        backend = sym_poll;
+#endif
+    }
+    if (SCM_EQ(backend, sym_poll)) {
+        p->backend = POLLER_POLL;
+        p->epfd = -1;
+    } else if (SCM_EQ(backend, sym_epoll)) {
+#ifdef HAVE_EPOLL_CREATE1
+        int r;
+        SCM_SYSCALL(r, epoll_create1(EPOLL_CLOEXEC));
+        if (r < 0) Scm_SysError("epoll_create1 failed");
+        p->backend = POLLER_EPOLL;
+        p->epfd = r;
+#else
+        Scm_Error("epoll isn't supported on this platform");
+#endif
+    } else {
+        Scm_Error("backend must be either epoll, poll or #f, but got: %S",
+                  backend);
+    }
+    p->edge = !SCM_FALSEP(edge);
+    p->closed = FALSE;
+    p->numfds = 0;
+    p->maskSize = 0;
+    p->masks = NULL;
+    p->pfdSize = 0;
+    p->pfds = NULL;
+    p->reported = NULL;
+    p->index = NULL;
+    p->evSize = 0;
+    p->evs = NULL;
+    p->numAlways = p->alwaysSize = 0;
+    p->always = NULL;
+    if (p->epfd >= 0) {
+        Scm_RegisterFinalizer(SCM_OBJ(p), poller_finalize, NULL);
+    }
+    return SCM_OBJ(p);
+}
+
+SCM_DEFINE_BUILTIN_CLASS(Scm_SysPollerClass, poller_print, NULL, NULL,
+                         poller_allocate, SCM_CLASS_DEFAULT_CPL);
+
+static void poller_check(ScmSysPoller *p)
+{
+    if (p->closed) Scm_Error("sys-poller already closed: %S", SCM_OBJ(p));
+}
+
+/* Make masks and index cover fd */
+static void poller_ensure_fd(ScmSysPoller *p, int fd)
+{
+    if (fd < p->maskSize) return;
+    int size = (p->maskSize > 0)? p->maskSize : 64;
+    while (size <= fd) size *= 2;
+    u_char *masks = SCM_NEW_ATOMIC_ARRAY(u_char, size);
+    memset(masks, 0, size);
+    if (p->maskSize > 0) memcpy(masks, p->masks, p->maskSize);
+    p->masks = masks;
+    if (p->backend == POLLER_POLL) {
+        int *index = SCM_NEW_ATOMIC_ARRAY(int, size);
+        if (p->maskSize > 0) memcpy(index, p->index, sizeof(int)*p->maskSize);
+        p->index = index;
+    }
+    p->maskSize = size;
+}
+
+static short poll_events(int flags)
+{
+    return (short)(((flags & POLLER_R)? POLLIN : 0)
+                   | ((flags & POLLER_W)? POLLOUT : 0)
+                   | ((flags & POLLER_X)? POLLPRI : 0));
+}
+
+/* Translate revents to POLLER_* flags.  Errors and hangups are reported
+   as readable and writable, as select does, so that the handler will
+   notice them by reading or writing. */
+static int poll_revents(int revents, int flags)
+{
+    int r = 0;
+    if (revents & (POLLIN|POLLHUP|POLLERR|POLLNVAL)) r |= POLLER_R;
+    if (revents & (POLLOUT|POLLHUP|POLLERR|POLLNVAL)) r |= POLLER_W;
+    if (revents & POLLPRI) r |= POLLER_X;
+    return r & flags;
+}
+
+/* Poll backend, edge-triggered mode: the fd of pfds[i], which is
+   negated while parked. */
+static inline int pfd_fd(const struct pollfd *pfd)
+{
+    return (pfd->fd < 0)? ~pfd->fd : pfd->fd;
+}
+
+/* Poll backend: set up pfds[i] to watch FLAGS except the conditions
+   already reported. */
+static void poll_arm(ScmSysPoller *p, int i, int flags)
+{
+    int fd = pfd_fd(&p->pfds[i]);
+    short rep = p->reported[i];
+    short events = poll_events(flags) & ~rep;
+    p->pfds[i].events = events;
+    if (rep & (POLLHUP|POLLERR|POLLNVAL)) {
+        p->pfds[i].fd = ~fd;
+    } else {
+        p->pfds[i].fd = fd;
+    }
+}
+
+/* Poll backend, edge-triggered mode: watch again the reported
+   conditions that are no longer pending. */
+static void poll_rearm(ScmSysPoller *p)
+{
+    int i, n;
+    for (i=0; i<p->numfds; i++) {
+        if (p->reported[i]) break;
+    }
+    if (i == p->numfds) return;
+    for (i=0; i<p->numfds; i++) {
+        int fd = pfd_fd(&p->pfds[i]);
+        p->pfds[i].fd = fd;
+        p->pfds[i].events = poll_events(p->masks[fd]);
+    }
+    SCM_SYSCALL(n, poll(p->pfds, p->numfds, 0));
+    if (n < 0) Scm_SysError("poll failed");
+    for (i=0; i<p->numfds; i++) {
+        p->reported[i] &= p->pfds[i].revents;
+        poll_arm(p, i, p->masks[p->pfds[i].fd]);
+    }
+}
+
+#ifdef HAVE_EPOLL_CREATE1
+static int epoll_ctl_int(ScmSysPoller *p, int op, int fd, int flags)
+{
+    struct epoll_event ev;
+    int r;
+    ev.events = ((flags & POLLER_R)? EPOLLIN : 0)
+        | ((flags & POLLER_W)? EPOLLOUT : 0)
+        | ((flags & POLLER_X)? EPOLLPRI : 0)
+        | (p->edge? EPOLLET : 0);
+    ev.data.fd = fd;
+    SCM_SYSCALL(r, epoll_ctl(p->epfd, op, fd, &ev));
+    return r;
+}
+
+static void poller_add_always(ScmSysPoller *p, int fd)
+{
+    if (p->numAlways == p->alwaysSize) {
+        int size = (p->alwaysSize > 0)? p->alwaysSize*2 : 4;
+        poller_always *a = SCM_NEW_ATOMIC_ARRAY(poller_always, size);
+        if (p->numAlways > 0) {
+            memcpy(a, p->always, sizeof(poller_always)*p->numAlways);
+        }
+        p->always = a;
+        p->alwaysSize = size;
+    }
+    p->always[p->numAlways].fd = fd;
+    p->always[p->numAlways].reported = FALSE;
+    p->numAlways++;
+}
+
+static void poller_delete_always(ScmSysPoller *p, int fd)
+{
+    for (int i=0; i<p->numAlways; i++) {
+        if (p->always[i].fd == fd) {
+            p->always[i] = p->always[--p->numAlways];
+            return;
+        }
+    }
+}
+
+/* Register fd with epoll, or update its conditions.  We don't trust
+   OLDFLAGS to tell whether the kernel knows fd, for fd may have been
+   closed (which removes it from epoll) and its number reused since.
+   Returns the flags to record. */
+static int epoll_set(ScmSysPoller *p, int fd, int oldflags, int newflags)
+{
+    if (oldflags & POLLER_ALWAYS) {
+        poller_delete_always(p, fd);
+        oldflags = 0;
+    }
+    if (newflags == 0) {
+        /* If fd has already been closed, the kernel has removed it. */
+        if (oldflags != 0
+            && epoll_ctl_int(p, EPOLL_CTL_DEL, fd, 0) < 0
+            && errno != EBADF && errno != ENOENT) {
+            Scm_SysError("epoll_ctl failed on fd %d", fd);
+        }
+        return 0;
+    }
+
+    int r;
+    if (oldflags == 0) {
+        r = epoll_ctl_int(p, EPOLL_CTL_ADD, fd, newflags);
+        if (r < 0 && errno == EEXIST) {
+            r = epoll_ctl_int(p, EPOLL_CTL_MOD, fd, newflags);
+        }
+    } else {
+        r = epoll_ctl_int(p, EPOLL_CTL_MOD, fd, newflags);
+        if (r < 0 && errno == ENOENT) {
+            r = epoll_ctl_int(p, EPOLL_CTL_ADD, fd, newflags);
+        }
+    }
+    if (r < 0) {
+        if (errno == EPERM) {
+            poller_add_always(p, fd);
+            return newflags|POLLER_ALWAYS;
+        }
+        Scm_SysError("epoll_ctl failed on fd %d", fd);
+    }
+    return newflags;
+}
+
+static int epoll_revents(uint32_t events, int flags)
+{
+    int r = 0;
+    if (events & (EPOLLIN|EPOLLHUP|EPOLLERR)) r |= POLLER_R;
+    if (events & (EPOLLOUT|EPOLLHUP|EPOLLERR)) r |= POLLER_W;
+    if (events & EPOLLPRI) r |= POLLER_X;
+    return r & flags;
+}
+#endif /*HAVE_EPOLL_CREATE1*/
+
+/* Set the conditions to watch on fd.  Flags is a list of symbols
+   r, w and x.  If it is empty, fd is removed from the poller. */
+void Scm_SysPollerSet(ScmSysPoller *p, int fd, ScmObj flags)
+{
+    int newflags = 0;
+    ScmObj cp;
+    poller_check(p);
+    if (fd < 0) Scm_Error("bad file descriptor: %d", fd);
+    SCM_FOR_EACH(cp, flags) {
+        ScmObj f = SCM_CAR(cp);
+        if (SCM_EQ(f, sym_r))      newflags |= POLLER_R;
+        else if (SCM_EQ(f, sym_w)) newflags |= POLLER_W;
+        else if (SCM_EQ(f, sym_x)) newflags |= POLLER_X;
+        else Scm_Error("flag must be one of r, w or x, but got: %S", f);
+    }
+    if (newflags == 0 && fd >= p->maskSize) return;
+    poller_ensure_fd(p, fd);
+    int oldflags = p->masks[fd];
+
+#ifdef HAVE_EPOLL_CREATE1
+    if (p->backend == POLLER_EPOLL) {
+        /* Even if the flags are the same, the kernel may have dropped
+           fd, so we always let it know. */
+        newflags = epoll_set(p, fd, oldflags, newflags);
+    } else
+#endif /*HAVE_EPOLL_CREATE1*/
+    {
+        /* Setting fd again re-arms the conditions reported in the
+           edge-triggered mode. */
+        if (oldflags == 0) {
+            if (p->numfds == p->pfdSize) {
+                int size = (p->pfdSize > 0)? p->pfdSize*2 : 16;
+                struct pollfd *pfds = SCM_NEW_ATOMIC_ARRAY(struct pollfd, size);
+                short *reported = SCM_NEW_ATOMIC_ARRAY(short, size);
+                if (p->numfds > 0) {
+                    memcpy(pfds, p->pfds, sizeof(struct pollfd)*p->numfds);
+                    memcpy(reported, p->reported, sizeof(short)*p->numfds);
+                }
+                p->pfds = pfds;
+                p->reported = reported;
+                p->pfdSize = size;
+            }
+            int i = p->numfds;
+            p->pfds[i].fd = fd;
+            p->pfds[i].events = poll_events(newflags);
+            p->pfds[i].revents = 0;
+            p->reported[i] = 0;
+            p->index[fd] = i;
+        } else if (newflags == 0) {
+            int i = p->index[fd], last = p->numfds-1;
+            p->pfds[i] = p->pfds[last];
+            p->reported[i] = p->reported[last];
+            p->index[pfd_fd(&p->pfds[i])] = i;
+        } else {
+            int i = p->index[fd];
+            p->reported[i] = 0;
+            poll_arm(p, i, newflags);
+        }
+    }
+
+    if (oldflags == 0) p->numfds++;
+    else if (newflags == 0) p->numfds--;
+    p->masks[fd] = (u_char)newflags;
+}
+
+static int poller_timeout(ScmObj timeout)
+{
+    struct timeval tv;
+    if (select_timeval(timeout, &tv) == NULL) return -1;
+    if (tv.tv_sec >= INT_MAX/1000 - 1) return INT_MAX;
+    return (int)(tv.tv_sec*1000 + (tv.tv_usec + 999)/1000);
+}
+
+/* Wait until some of the registered conditions are met, or timeout
+   expires.  Timeout is the same as select.  Returns a list of
+   (fd flag ...), where flags are the conditions met among r, w and x.
+   Returns () on timeout. */
+ScmObj Scm_SysPollerWait(ScmSysPoller *p, ScmObj timeout)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    int ms = poller_timeout(timeout);
+    int n;
+    poller_check(p);
+
+#ifdef HAVE_EPOLL_CREATE1
+    if (p->backend == POLLER_EPOLL) {
+        /* Events that don't fit are reported by the next wait. */
+        int maxevents = (p->numfds == 0)? 1
+            : (p->numfds < 1024)? p->numfds : 1024;
+        if (p->evSize < maxevents) {
+            p->evs = SCM_NEW_ATOMIC_ARRAY(struct epoll_event, maxevents);
+            p->evSize = maxevents;
+        }
+        struct epoll_event *evs = (struct epoll_event*)p->evs;
+        /* Descriptors kept aside are ready now, so don't block. */
+        for (int i=0; i<p->numAlways; i++) {
+            if (!p->edge || !p->always[i].reported) {
+                ms = 0;
+                break;
+            }
+        }
+        SCM_SYSCALL(n, epoll_wait(p->epfd, evs, maxevents, ms));
+        if (n < 0) Scm_SysError("epoll_wait failed");
+        for (int i=0; i<n; i++) {
+            int fd = evs[i].data.fd;
+            int flags = (fd < p->maskSize)? p->masks[fd] : 0;
+            int r = epoll_revents(evs[i].events, flags);
+            if (r) SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT(fd),
+                                              poller_flags[r]));
+        }
+        for (int i=0; i<p->numAlways; i++) {
+            if (p->edge && p->always[i].reported) continue;
+            p->always[i].reported = TRUE;
+            int fd = p->always[i].fd;
+            int r = p->masks[fd] & (POLLER_R|POLLER_W);
+            if (r) SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT(fd),
+                                              poller_flags[r]));
+        }
+        return h;
+    }
+#endif /*HAVE_EPOLL_CREATE1*/
+
+    if (p->edge) poll_rearm(p);
+    SCM_SYSCALL(n, poll(p->pfds, p->numfds, ms));
+    if (n < 0) Scm_SysError("poll failed");
+    for (int i=0; i<p->numfds; i++) {
+        short revents = p->pfds[i].revents;
+        if (revents == 0) continue;
+        int fd = pfd_fd(&p->pfds[i]);
+        if (p->edge) {
+            /* Parked or dropped conditions aren't in revents, so these
+               are all fresh.  Stop watching them. */
+            p->reported[i] |= revents;
+            poll_arm(p, i, p->masks[fd]);
+        }
+        int r = poll_revents(revents, p->masks[fd]);
+        if (r) SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT(fd), poller_flags[r]));
+    }
+    return h;
+}
+
+ScmObj Scm_SysPollerBackend(ScmSysPoller *p)
+{
+    return (p->backend == POLLER_EPOLL)? sym_epoll : sym_poll;
+}
+
+/* Releases the resource.  The registered descriptors are not closed. */
+void Scm_SysPollerClose(ScmSysPoller *p)
+{
+    if (p->closed) return;
+    p->closed = TRUE;
+    if (p->epfd >= 0) {
+        close(p->epfd);
+        p->epfd = -1;
+    }
+    p->numfds = 0;
+    p->maskSize = p->pfdSize = 0;
+    p->masks = NULL;
+    p->pfds = NULL;
+    p->reported = NULL;
+    p->index = NULL;
+    p->evSize = 0;
+    p->evs = NULL;
+    p->numAlways = p->alwaysSize = 0;
+    p->always = NULL;
+}
+
+static void init_poller(ScmModule *mod)
+{
+    sym_r = SCM_INTERN("r");
+    sym_w = SCM_INTERN("w");
+    sym_x = SCM_INTERN("x");
+    sym_epoll = SCM_INTERN("epoll");
+    sym_poll = SCM_INTERN("poll");
+    for (int i=0; i<8; i++) {
+        ScmObj flags = SCM_NIL;
+        if (i & POLLER_X) flags = Scm_Cons(sym_x, flags);
+        if (i & POLLER_W) flags = Scm_Cons(sym_w, flags);
+        if (i & POLLER_R) flags = Scm_Cons(sym_r, flags);
+        poller_flags[i] = flags;
+    }
+    Scm_InitStaticClass(&Scm_SysPollerClass, "<sys-poller>", mod, NULL, 0);
+}
+#endif /* HAVE_POLL */
+
 /*===============================================================
  * Environment
  */
@@ -3226,6 +3729,9 @@ void Scm__InitSystem(void)
     Scm_InitStaticClass(&Scm_SysPasswdClass, "<sys-passwd>", mod, pwd_slots, 0);
 #ifdef HAVE_SELECT
     Scm_InitStaticClass(&Scm_SysFdsetClass, "<sys-fdset>", mod, NULL, 0);
+#endif
+#ifdef HAVE_POLL
+    init_poller(mod);
 #endif
     SCM_INTERNAL_MUTEX_INIT(env_mutex);
     Scm_HashCoreInitSimple(&env_strings, SCM_HASH_STRING, 0, NULL);
@@ -38,7 +38,9 @@
 #include "gauche/priv/builtin-syms.h"
 #include "gauche/priv/vmP.h"
 #include "gauche/priv/identifierP.h"
+#include "gauche/priv/classP.h"
 #include "gauche/priv/parameterP.h"
+#include "gauche/priv/jitP.h"
 #include "gauche/code.h"
 #include "gauche/vminsn.h"
 #include "gauche/prof.h"
@@ -242,6 +244,7 @@ ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name)
     v->customErrorReporter = (proto? proto->customErrorReporter : SCM_FALSE);
 
     v->evalSituation = SCM_VM_EXECUTING;
+    v->compileEffects = 0;
 
     sigemptyset(&v->sigMask);
     Scm_SignalQueueInit(&v->sigq);
@@ -308,6 +311,7 @@ int Scm_AttachVM(ScmVM *vm)
     }
     vm->state = SCM_VM_RUNNABLE;
     vm_register(vm);
+    Scm__ProfilerAttachVM(vm);
     return TRUE;
 #else  /* no threads */
     return FALSE;
@@ -322,6 +326,7 @@ void Scm_DetachVM(ScmVM *vm)
 {
 #ifdef GAUCHE_HAS_THREADS
     if (vm != NULL) {
+        Scm__ProfilerDetachVM(vm);
         (void)SCM_INTERNAL_THREAD_SETSPECIFIC(Scm_VMKey(), NULL);
         vm_unregister(vm);
     }
@@ -415,6 +420,24 @@ static void vm_unregister(ScmVM *vm)
     SCM_INTERNAL_MUTEX_UNLOCK(vm_table_mutex);
 }
 
+/* Returns a list of live VMs, including the primordial one.
+   The profiler uses this to reach every thread (see prof.c). */
+ScmObj Scm__VMList(void)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    ScmHashIter iter;
+    ScmDictEntry *e;
+
+    if (rootVM) SCM_APPEND1(h, t, SCM_OBJ(rootVM));
+    SCM_INTERNAL_MUTEX_LOCK(vm_table_mutex);
+    Scm_HashIterInit(&iter, &vm_table);
+    while ((e = Scm_HashIterNext(&iter)) != NULL) {
+        if ((ScmVM*)e->key != rootVM) SCM_APPEND1(h, t, SCM_OBJ(e->key));
+    }
+    SCM_INTERNAL_MUTEX_UNLOCK(vm_table_mutex);
+    return h;
+}
+
 /*====================================================================
  * VM interpreter
  *
@@ -564,6 +587,30 @@ static void vm_unregister(ScmVM *vm)
         }                                                               \
     } while (0)
 
+/* Enter the native code of the current closure, if any.  JIT_CALL is
+   used at the entry of a closure; it also counts the calls to find hot
+   closures.  JIT_RESUME is used when we return to a compiled code, and
+   after JUMP and LOCAL-ENV-JUMP, so that a loop gets back to the native
+   code after a side exit.  See jit.c. */
+#if defined(SCM_JIT_AVAILABLE)
+#define JIT_CALL()                                                      \
+    do {                                                                \
+        if (SCM_VM_RUNTIME_FLAG_IS_SET(vm, SCM_ENABLE_JIT)) {           \
+            PC = Scm__JITCall(vm, BASE);                                \
+        }                                                               \
+    } while (0)
+#define JIT_RESUME()                                                    \
+    do {                                                                \
+        if (BASE != NULL && BASE->native != NULL                        \
+            && SCM_VM_RUNTIME_FLAG_IS_SET(vm, SCM_ENABLE_JIT)) {        \
+            PC = Scm__JITResume(vm, BASE);                              \
+        }                                                               \
+    } while (0)
+#else  /*!SCM_JIT_AVAILABLE*/
+#define JIT_CALL()    /*empty*/
+#define JIT_RESUME()  /*empty*/
+#endif /*!SCM_JIT_AVAILABLE*/
+
 /* return operation. */
 #define RETURN_OP()                                     \
     do {                                                \
@@ -571,6 +618,7 @@ static void vm_unregister(ScmVM *vm)
             return; /* no more continuations */         \
         }                                               \
         POP_CONT();                                     \
+        JIT_RESUME();                                   \
     } while (0)
 
 /* push environment header to finish the environment frame.
@@ -2700,6 +2748,15 @@ static void process_queued_requests(ScmVM *vm)
     if (vm->signalPending)   Scm_SigCheck(vm);
     if (vm->finalizerPending) Scm_VMFinalizerRun(vm);
 
+    /* The sampling profiler asks us to collect its samples. */
+    if (vm->prof && vm->prof->flushRequested) {
+        Scm_ProfilerSampleBufferFlush(vm);
+    }
+    /* The profiler asks us to block or unblock SIGPROF. */
+    if (vm->prof && vm->prof->sigmaskRequested) {
+        Scm__ProfilerUpdateSigmask(vm);
+    }
+
     /* VM STOP is required from other thread.
        See Scm_ThreadStop() in ext/threads/threads.c */
     if (vm->stopRequest) {
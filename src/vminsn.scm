@@ -426,7 +426,7 @@
 ;;  Jump to <addr>.
 ;;
 (define-insn JUMP      0 addr #f
-  (begin (FETCH-LOCATION PC) CHECK-INTR NEXT))
+  (begin (FETCH-LOCATION PC) CHECK-INTR (JIT-RESUME) NEXT))
 
 ;; RET
 ;;  Pop the continuation stack.
@@ -527,6 +527,7 @@
     (local_env_shift vm (SCM_VM_INSN_ARG code))
     (FETCH-LOCATION PC)
     CHECK-INTR
+    (JIT-RESUME)
     NEXT))
 
 ;; LOCAL-ENV-CALL(depth)
@@ -1144,8 +1145,30 @@
       (when (or (< (SCM_INT_VALUE k) 0)
                 (>= (SCM_INT_VALUE k) (SCM_UVECTOR_SIZE vec)))
         ($vm-err "uvector-ref index out of range: %S" k))
-      ($result (Scm_VMUVectorRef (SCM_UVECTOR vec) utype (SCM_INT_VALUE k)
-                                 SCM_UNBOUND)))))
+      (if (== utype SCM_UVECTOR_F64)
+        ($result:f (aref (SCM_F64VECTOR_ELEMENTS vec) (SCM_INT_VALUE k)))
+        ($result (Scm_VMUVectorRef (SCM_UVECTOR vec) utype (SCM_INT_VALUE k)
+                                   SCM_UNBOUND))))))
+
+;; The value is stored without being boxed if it's a flonum for
+;; f64vector; otherwise we leave it to Scm_UVectorSet.
+(define-insn UVEC-SET    1 none #f    ; uvector-set!
+  (let* ([vec] [ind] [v VAL0]
+         [utype::int (SCM_VM_INSN_ARG code)])
+    (POP-ARG ind)
+    (POP-ARG vec)
+    (unless (SCM_UVECTOR_SUBTYPE_P vec utype)
+      ($vm-err "%s required, but got %S" (Scm_UVectorTypeName utype) vec))
+    ($type-check ind SCM_INTP "fixnum")
+    (let* ([k::ScmSmallInt (SCM_INT_VALUE ind)])
+      (if (and (== utype SCM_UVECTOR_F64)
+               (SCM_FLONUMP v)
+               (not (SCM_UVECTOR_IMMUTABLE_P vec))
+               (>= k 0)
+               (< k (SCM_UVECTOR_SIZE vec)))
+        (set! (aref (SCM_F64VECTOR_ELEMENTS vec) k) (SCM_FLONUM_VALUE v))
+        (Scm_UVectorSet (SCM_UVECTOR vec) utype k v SCM_CLAMP_ERROR))
+      ($result SCM_UNDEFINED))))
 
 ;; not enough evidence yet to support this is worth
 ;; (define-insn UVEC-REFI   1 none #f    ; uvector-ref, index in arg.
@@ -1224,6 +1247,24 @@
 
 (define-insn LREF-VAL0-NUMADD2 2 none #f ($arg-source lref ($insn-body NUMADD2)))
 
+;; Flonum arithmetic.  The compiler emits these instead of NUMADD2 and
+;; NUMSUB2 when it knows one of the operands yields a flonum, e.g. the
+;; result of f64vector-ref (see pass5/flonum-iform? in compile-5.scm).
+;; We skip the fixnum path; if the guess is wrong, the generic routine
+;; handles it.  NUMMUL2 and NUMDIV2 have no fixnum path to begin with,
+;; and already keep the result unboxed when an operand is a flonum.
+(define-insn NUMFADD2    0 none #f      ; +, flonum operands
+  ($w/argp arg
+    (if (and (SCM_FLONUMP arg) (SCM_FLONUMP VAL0))
+      ($result:f (+ (SCM_FLONUM_VALUE arg) (SCM_FLONUM_VALUE VAL0)))
+      ($result (Scm_Add arg VAL0)))))
+
+(define-insn NUMFSUB2    0 none #f      ; -, flonum operands
+  ($w/argp arg
+    (if (and (SCM_FLONUMP arg) (SCM_FLONUMP VAL0))
+      ($result:f (- (SCM_FLONUM_VALUE arg) (SCM_FLONUM_VALUE VAL0)))
+      ($result (Scm_Sub arg VAL0)))))
+
 (define-insn NEGATE  0 none #f          ; -  (unary)
   ($w/argr v
     (cond
@@ -1356,22 +1397,24 @@
       (SCM_FLONUM_ENSURE_MEM VAL0)
       ($result (Scm_VMSlotSet obj slot VAL0)))))
 
+;; SLOT-REFC, SLOT-SETC
+;;   The operand is the slot name at first.  It is replaced with
+;;   a slot cache that remembers the accessors used at this site.
+;;   See Scm__VMSlotRefC in class.c.
 (define-insn SLOT-REFC   0 obj #f       ; slot-ref with constant slot name
-  (let* ((slot))
-    (FETCH-OPERAND slot)
+  (let* ((site::ScmWord* PC))
     INCR-PC
     (TAIL-CALL-INSTRUCTION)
     (SCM_FLONUM_ENSURE_MEM VAL0)
-    ($result (Scm_VMSlotRef VAL0 slot FALSE))))
+    ($result (Scm__VMSlotRefC VAL0 site (-> vm base)))))
 
 (define-insn SLOT-SETC   0 obj #f       ; slot-set! with constant slot name
-  (let* ((slot))
-    (FETCH-OPERAND slot)
+  (let* ((site::ScmWord* PC))
     INCR-PC
     ($w/argp obj
       (TAIL-CALL-INSTRUCTION)
       (SCM_FLONUM_ENSURE_MEM VAL0)
-      ($result (Scm_VMSlotSet obj slot VAL0)))))
+      ($result (Scm__VMSlotSetC obj VAL0 site (-> vm base))))))
 
 ;;
 ;; Dynamic handlers
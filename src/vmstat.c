@@ -34,6 +34,8 @@
 /* This file is included from vm.c */
 
 #ifdef COUNT_INSN_FREQUENCY
+#include <fcntl.h>
+
 /* for statistics */
 static u_long insn1_freq[SCM_VM_NUM_INSNS];
 static u_long insn2_freq[SCM_VM_NUM_INSNS][SCM_VM_NUM_INSNS];
@@ -42,11 +44,80 @@ static u_long insn2_freq[SCM_VM_NUM_INSNS][SCM_VM_NUM_INSNS];
 static u_long lref_freq[LREF_FREQ_COUNT_MAX][LREF_FREQ_COUNT_MAX];
 static u_long lset_freq[LREF_FREQ_COUNT_MAX][LREF_FREQ_COUNT_MAX];
 
+/* Sequences of instructions that are adjacent in the code vector and
+   executed in a row, i.e. the candidates of superinstructions.
+   Unlike insn2_freq, which counts the dynamic succession, we don't
+   count the pair if the first one jumps.  The pairs and triples are
+   kept in a hash table keyed by insn codes; when it gets full we
+   stop adding new sequences.  src/gensuperinsn reads the result. */
+#define INSN_SEQ_TABLE_SIZE  (1L<<16)
+#define INSN_SEQ_RADIX (SCM_VM_NUM_INSNS+1)
+#define INSN_SEQ_NONE  SCM_VM_NUM_INSNS /* as 'c' of a pair */
+#define INSN_SEQ_KEY(a, b, c) \
+    ((((u_long)(a)*INSN_SEQ_RADIX + (b))*INSN_SEQ_RADIX + (c)) + 1)
+
+static struct {
+    u_long key;                 /* INSN_SEQ_KEY, 0 for an empty entry */
+    u_long count;
+} insn_seq_freq[INSN_SEQ_TABLE_SIZE];
+static u_long insn_seq_used = 0;
+
+static const ScmWord *insn_seq_pc[2];   /* last two insns executed */
+
+static void insn_seq_count(u_long key)
+{
+    u_long i = (key * 2654435761UL) & (INSN_SEQ_TABLE_SIZE-1);
+    for (;;) {
+        if (insn_seq_freq[i].key == key) {
+            insn_seq_freq[i].count++;
+            return;
+        }
+        if (insn_seq_freq[i].key == 0) {
+            if (insn_seq_used >= INSN_SEQ_TABLE_SIZE/4*3) return;
+            insn_seq_freq[i].key = key;
+            insn_seq_freq[i].count = 1;
+            insn_seq_used++;
+            return;
+        }
+        i = (i+1) & (INSN_SEQ_TABLE_SIZE-1);
+    }
+}
+
+/* Returns TRUE if the insn at PC falls through to NEXT. */
+static int insn_falls_through(const ScmWord *pc, const ScmWord *next)
+{
+    if (pc == NULL) return FALSE;
+    u_int code = SCM_VM_INSN_CODE(*pc);
+    switch (Scm_VMInsnOperandType(code)) {
+    case SCM_VM_OPERAND_NONE:     return next == pc + 1;
+    case SCM_VM_OPERAND_OBJ_ADDR: return next == pc + 3;
+    default:                      return next == pc + 2;
+    }
+}
+
+static void count_insn_sequence(const ScmWord *pc)
+{
+    if (insn_falls_through(insn_seq_pc[1], pc)) {
+        u_int b = SCM_VM_INSN_CODE(*insn_seq_pc[1]);
+        u_int c = SCM_VM_INSN_CODE(*pc);
+        insn_seq_count(INSN_SEQ_KEY(b, c, INSN_SEQ_NONE));
+        if (insn_falls_through(insn_seq_pc[0], insn_seq_pc[1])) {
+            u_int a = SCM_VM_INSN_CODE(*insn_seq_pc[0]);
+            insn_seq_count(INSN_SEQ_KEY(a, b, c));
+        }
+        insn_seq_pc[0] = insn_seq_pc[1];
+    } else {
+        insn_seq_pc[0] = NULL;
+    }
+    insn_seq_pc[1] = pc;
+}
+
 static ScmWord fetch_insn_counting(ScmVM *vm, ScmWord code)
 {
     if (vm->base && vm->pc != vm->base->code) {
         insn2_freq[SCM_VM_INSN_CODE(code)][SCM_VM_INSN_CODE(*vm->pc)]++;
     }
+    count_insn_sequence(vm->pc);
     code = *vm->pc++;
     insn1_freq[SCM_VM_INSN_CODE(code)]++;
     switch (SCM_VM_INSN_CODE(code)) {
@@ -87,34 +158,66 @@ static ScmWord fetch_insn_counting(ScmVM *vm, ScmWord code)
     return code;
 }
 
+/* The result is written to the current output port, or appended
+   to the file named by the environment variable
+   GAUCHE_INSN_FREQUENCY_FILE, so that the runs of a workload can be
+   accumulated. */
 static void dump_insn_frequency(void *data)
 {
-    Scm_Printf(SCM_CUROUT, "(:instruction-frequencies (");
+    ScmPort *out = SCM_CUROUT;
+    const char *file = Scm_GetEnv("GAUCHE_INSN_FREQUENCY_FILE");
+    if (file != NULL) {
+        ScmObj p = Scm_OpenFilePort(file, O_WRONLY|O_CREAT|O_APPEND,
+                                    SCM_PORT_BUFFER_FULL, 0666);
+        if (SCM_FALSEP(p)) return;
+        out = SCM_PORT(p);
+    }
+
+    Scm_Printf(out, "(:instruction-frequencies (");
     for (int i=0; i<SCM_VM_NUM_INSNS; i++) {
-        Scm_Printf(SCM_CUROUT, "(%s %d", Scm_VMInsnName(i), insn1_freq[i]);
+        Scm_Printf(out, "(%s %lu", Scm_VMInsnName(i), insn1_freq[i]);
         for (int j=0; j<SCM_VM_NUM_INSNS; j++) {
-            Scm_Printf(SCM_CUROUT, " %d", insn2_freq[i][j]);
+            Scm_Printf(out, " %lu", insn2_freq[i][j]);
         }
-        Scm_Printf(SCM_CUROUT, ")\n");
+        Scm_Printf(out, ")\n");
     }
-    Scm_Printf(SCM_CUROUT, ")\n :lref-frequencies (");
+    Scm_Printf(out, ")\n :lref-frequencies (");
     for (int i=0; i<LREF_FREQ_COUNT_MAX; i++) {
-        Scm_Printf(SCM_CUROUT, "(");
+        Scm_Printf(out, "(");
         for (int j=0; j<LREF_FREQ_COUNT_MAX; j++) {
-            Scm_Printf(SCM_CUROUT, "%d ", lref_freq[i][j]);
+            Scm_Printf(out, "%lu ", lref_freq[i][j]);
         }
-        Scm_Printf(SCM_CUROUT, ")\n");
+        Scm_Printf(out, ")\n");
     }
-    Scm_Printf(SCM_CUROUT, ")\n :lset-frequencies (");
+    Scm_Printf(out, ")\n :lset-frequencies (");
     for (int i=0; i<LREF_FREQ_COUNT_MAX; i++) {
-        Scm_Printf(SCM_CUROUT, "(");
+        Scm_Printf(out, "(");
         for (int j=0; j<LREF_FREQ_COUNT_MAX; j++) {
-            Scm_Printf(SCM_CUROUT, "%d ", lset_freq[i][j]);
+            Scm_Printf(out, "%lu ", lset_freq[i][j]);
+        }
+        Scm_Printf(out, ")\n");
+    }
+    Scm_Printf(out, ")\n :sequence-frequencies (");
+    for (u_long i=0; i<INSN_SEQ_TABLE_SIZE; i++) {
+        u_long key = insn_seq_freq[i].key;
+        if (key == 0) continue;
+        key--;
+        u_int c = (u_int)(key % INSN_SEQ_RADIX);
+        u_int b = (u_int)((key / INSN_SEQ_RADIX) % INSN_SEQ_RADIX);
+        u_int a = (u_int)(key / INSN_SEQ_RADIX / INSN_SEQ_RADIX);
+        if (c == INSN_SEQ_NONE) {
+            Scm_Printf(out, "((%s %s) %lu)\n",
+                       Scm_VMInsnName(a), Scm_VMInsnName(b),
+                       insn_seq_freq[i].count);
+        } else {
+            Scm_Printf(out, "((%s %s %s) %lu)\n",
+                       Scm_VMInsnName(a), Scm_VMInsnName(b),
+                       Scm_VMInsnName(c), insn_seq_freq[i].count);
         }
-        Scm_Printf(SCM_CUROUT, ")\n");
     }
-    Scm_Printf(SCM_CUROUT, ")\n");
-    Scm_Printf(SCM_CUROUT, ")\n");
+    Scm_Printf(out, ")\n");
+    Scm_Printf(out, ")\n");
+    if (out != SCM_CUROUT) Scm_ClosePort(out);
 }
 
 #endif /*COUNT_INSN_FREQUENCY*/
@@ -0,0 +1,118 @@
+;;
+;; Bignum multiplication and division with schoolbook, Karatsuba,
+;; Toom-3 and recursive division, decimal conversion with and without
+;; recursive splitting, and their crossover points
+;;
+
+;; Run as 'gosh bignum-performance.scm [max-words]'.
+;; For each operand size (in 64-bit words) the time of one operation is
+;; shown for each algorithm, then the smallest size from which the faster
+;; algorithm keeps winning is reported.  Use it to tune the thresholds
+;; in src/bignum.c for a new platform.
+
+(use gauche.time)
+
+(define %karatsuba (with-module gauche.internal %bignum-karatsuba-threshold))
+(define %toom3     (with-module gauche.internal %bignum-toom3-threshold))
+(define %div       (with-module gauche.internal %bignum-div-threshold))
+(define %radix     (with-module gauche.internal %bignum-radix-conv-threshold))
+
+(define *huge* 100000000)
+
+(define (make-big nwords seed)
+  (let loop ([i 0] [x seed] [acc 1])
+    (if (= i nwords)
+      acc
+      (let1 x (modulo (+ (* x 6364136223846793005) 1442695040888963407)
+                      (expt 2 64))
+        (loop (+ i 1) x (+ (* acc (expt 2 64)) x))))))
+
+;; Returns cpu seconds per call of THUNK, with the given thresholds.
+(define (measure thunk k t d)
+  (let ([k0 (%karatsuba k)] [t0 (%toom3 t)] [d0 (%div d)])
+    (let1 r (time-this '(cpu 1) thunk)
+      (%karatsuba k0) (%toom3 t0) (%div d0)
+      (/ (+ (time-result-user r) (time-result-sys r))
+         (time-result-count r)))))
+
+(define (sizes max-words)
+  (let loop ([n 8] [r '()])
+    (if (> n max-words)
+      (reverse r)
+      (loop (ceiling->exact (* n 1.5)) (cons n r)))))
+
+;; ROWS is a list of (size time-a time-b).  Returns the smallest size
+;; from which time-b is consistently smaller than time-a.
+(define (crossover rows)
+  (let loop ([rows (reverse rows)] [found #f])
+    (cond [(null? rows) (or found "none")]
+          [(< (caddr (car rows)) (cadar rows)) (loop (cdr rows) (caar rows))]
+          [else (or found "none")])))
+
+(define (usec t) (format "~10,2f" (* t 1e6)))
+
+(define (bench-mul max-words)
+  (print "Multiplication (usec per operation)")
+  (print "  words  schoolbook   karatsuba       toom3")
+  (let1 rows
+      (map (^n (let ([a (make-big n 1)] [b (make-big n 2)])
+                 (let ([s (measure (^[] (* a b)) *huge* *huge* *huge*)]
+                       [k (measure (^[] (* a b)) 4 *huge* *huge*)]
+                       [t (measure (^[] (* a b)) 4 6 *huge*)])
+                   (print (format "~7d" n) " " (usec s) "  " (usec k)
+                          "  " (usec t))
+                   (list n s k t))))
+           (sizes max-words))
+    (print "Karatsuba wins from "
+           (crossover (map (^r (list (car r) (cadr r) (caddr r))) rows))
+           " words (current threshold " (%karatsuba) ")")
+    (print "Toom-3 wins from "
+           (crossover (map (^r (list (car r) (caddr r) (cadddr r))) rows))
+           " words (current threshold " (%toom3) ")")))
+
+(define (bench-div max-words)
+  (print "Division of 2n words by n words (usec per operation)")
+  (print "  words  schoolbook   recursive")
+  (let1 rows
+      (map (^n (let ([a (make-big (* n 2) 3)] [b (make-big n 4)])
+                 (let ([s (measure (^[] (quotient&remainder a b))
+                                   (%karatsuba) (%toom3) *huge*)]
+                       [r (measure (^[] (quotient&remainder a b))
+                                   (%karatsuba) (%toom3) 4)])
+                   (print (format "~7d" n) " " (usec s) "  " (usec r))
+                   (list n s r))))
+           (sizes max-words))
+    (print "Recursive division wins from " (crossover rows)
+           " words (current threshold " (%div) ")")))
+
+(define (bench-conv max-words)
+  (define (measure-conv thunk threshold)
+    (let1 orig (%radix threshold)
+      (begin0 (measure thunk (%karatsuba) (%toom3) (%div))
+              (%radix orig))))
+  (print "Decimal conversion (usec per operation)")
+  (print "  words   to-string   recursive  from-string   recursive")
+  (let1 rows
+      (map (^n (let* ([a (make-big n 5)]
+                      [s (number->string a)])
+                 (let ([ts (measure-conv (^[] (number->string a)) *huge*)]
+                       [tr (measure-conv (^[] (number->string a)) 2)]
+                       [fs (measure-conv (^[] (string->number s)) *huge*)]
+                       [fr (measure-conv (^[] (string->number s)) 2)])
+                   (print (format "~7d" n) " " (usec ts) "  " (usec tr)
+                          "   " (usec fs) "  " (usec fr))
+                   (list n ts tr fs fr))))
+           (sizes max-words))
+    (print "Recursive number->string wins from "
+           (crossover (map (^r (list (car r) (cadr r) (caddr r))) rows))
+           " words (current threshold " (%radix) ")")
+    (print "Recursive string->number wins from "
+           (crossover (map (^r (list (car r) (cadddr r) (list-ref r 4))) rows))
+           " words")))
+
+(define (main args)
+  (define max-words (if (null? (cdr args)) 2048 (string->number (cadr args))))
+  (bench-mul max-words)
+  (bench-div max-words)
+  (bench-conv max-words)
+  0)
@@ -200,6 +200,60 @@
 (use control.mapper)
 (test-module 'control.mapper)
 
+;;--------------------------------------------------------------------
+;; control.psort
+;;
+(test-section "control.psort")
+(use control.psort)
+(use gauche.uvector)
+(test-module 'control.psort)
+
+(let ([data (let loop ([i 0] [x 1] [r '()])
+              (if (= i 500)
+                r
+                (let1 x (modulo (+ (* x 1103515245) 12345) 2147483648)
+                  (loop (+ i 1) x (cons (- (modulo x 1000) 500) r)))))])
+  (define (psort-test name cmp key)
+    (let ([exp (stable-sort data cmp key)])
+      (dolist [nthreads '(1 2 3 8)]
+        (parameterize ([psort-threads nthreads]
+                       [psort-threshold 100])
+          (test* #"psort ~name (~nthreads threads, list)" exp
+                 (psort data cmp key))
+          (test* #"psort ~name (~nthreads threads, vector)" exp
+                 (vector->list (psort (list->vector data) cmp key)))
+          (test* #"psort ~name (~nthreads threads, s32vector)" exp
+                 (s32vector->list (psort (list->s32vector data) cmp key)))
+          (test* #"psort! ~name (~nthreads threads, list)" exp
+                 (psort! (list-copy data) cmp key))
+          (test* #"psort! ~name (~nthreads threads, vector)" exp
+                 (let1 v (list->vector data)
+                   (psort! v cmp key)
+                   (vector->list v)))))))
+  (psort-test "default" #f identity)
+  (psort-test ">" > identity)
+  (psort-test "comparator" integer-comparator identity)
+  ;; stability
+  (psort-test "key" < (^x (quotient x 10)))
+  (psort-test "key (lambda)" (^[a b] (< a b)) (^x (modulo x 7)))
+  ;; merges split at ties and at the ends of runs
+  (psort-test "key (all equal)" < (^x 0))
+  (let1 sorted (stable-sort data)
+    (test* "psort sorted input (8 threads)" sorted
+           (parameterize ([psort-threads 8] [psort-threshold 100])
+             (psort sorted)))
+    (test* "psort reversed input (8 threads)" sorted
+           (parameterize ([psort-threads 8] [psort-threshold 100])
+             (psort (reverse sorted)))))
+
+  (test* "psort error propagation" (test-error)
+         (parameterize ([psort-threads 4]
+                        [psort-threshold 100])
+           (psort (list->vector data)
+                  (^[a b]
+                    (if (memv (car data) (list a b)) (error "boo") (< a b))))))
+  )
+
 
 (test-end)
 
@@ -33,4 +33,71 @@
                      [_ #f])
                    (call/cc (^x (ra x) #f))))
 
+;;----------------------------------------------------------
+(test-section "profiler")
+
+(use gauche.vm.profiler)
+
+(define (prof-leaf n) (if (= n 0) 0 (+ 1 (prof-leaf (- n 1)))))
+(define (prof-outer) (dotimes [i 20000] (prof-leaf 50)))
+
+(define *stacks*
+  (begin
+    (profiler-start :period 1000)
+    (prof-outer)
+    (begin0 (profiler-get-stacks)
+            (profiler-reset))))
+
+(test* "stack samples" #t
+       (and (pair? *stacks*)
+            (every (^s (and (pair? (car s))
+                            (exact-integer? (cdr s))
+                            (positive? (cdr s))))
+                   *stacks*)))
+
+(test* "outermost caller first" #t
+       (any (^s (let ([o (list-index (cut eq? 'prof-outer <>) (car s))]
+                      [l (list-index (cut eq? 'prof-leaf <>) (car s))])
+                  (and o l (< o l))))
+            *stacks*))
+
+(test* "collapsed stacks" #t
+       (let1 lines
+           (begin
+             (profiler-start :period 1000)
+             (prof-outer)
+             (begin0 (string-split
+                      (with-output-to-string profiler-write-collapsed-stacks)
+                      #\newline)
+                     (profiler-reset)))
+         (and (every (^l (or (equal? l "") (#/^[^\n]+ \d+$/ l))) lines)
+              (any #/prof-outer;.*prof-leaf \d+$/ lines)
+              #t)))
+
+(define-class <alloc-test> () (a))
+(define (alloc-conses n)
+  (let loop ([i 0] [r '()]) (if (= i n) r (loop (+ i 1) (cons i r)))))
+(define (alloc-instances n) (dotimes [i n] (make <alloc-test>)))
+
+(let1 r (begin
+          (alloc-profiler-start :interval 1)
+          (alloc-conses 1000)
+          (alloc-instances 100)
+          (begin0 (alloc-profiler-get-result)
+                  (alloc-profiler-reset)))
+  (test* "allocation sites (pairs)" #t
+         (match (find (^e (and (string-scan (car e) "alloc-conses")
+                               (equal? (cadr e) "ScmPair")))
+                      r)
+           [(_ _ bytes objects samples)
+            (and (>= objects 1000) (>= bytes (* objects 8)) (= samples objects))]
+           [_ #f]))
+  ;; an instance may be allocated in the method of make, so we don't
+  ;; care the site.
+  (test* "allocation kinds (instances)" #t
+         (>= (fold (^[e n] (if (eq? (cadr e) '<alloc-test>) (+ n (cadddr e)) n))
+                   0 r)
+             100))
+  (test* "allocation profiler reset" '() (alloc-profiler-get-result)))
+
 (test-end)
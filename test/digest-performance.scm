@@ -0,0 +1,57 @@
+;;
+;; Message digest benchmark
+;;
+
+;; Run as 'gosh digest-performance.scm'.  Shows the throughput (MB/s)
+;; of each digest algorithm over a string, a u8vector and a string port,
+;; and, for SHA-1 and SHA-256, with and without the SHA extensions of
+;; the CPU (see ext/digest/shani.c).  The non-cryptographic hashes of
+;; rfc.fasthash are measured as well, with CRC32C run with and without
+;; the SSE4.2 crc32 instruction.
+
+(use gauche.time)
+(use gauche.uvector)
+(use rfc.md5)
+(use rfc.sha)
+(use rfc.fasthash)
+
+(define-constant *size* (* 16 1024 1024))
+
+(define accel-set! (with-module rfc.sha %sha-hardware-acceleration-set!))
+(define crc-hw-set!
+  (with-module rfc.fasthash %crc32c-hardware-acceleration-set!))
+
+(define (mb/s thunk)
+  (let1 r (time-this 5 thunk)
+    (/. (* *size* (time-result-count r))
+        (* 1024 1024 (max (time-result-real r) 1e-6)))))
+
+(define (bench name digest digest-string v s)
+  (format #t "~10a string ~8,1f  u8vector ~8,1f  port ~8,1f MB/s\n"
+          name
+          (mb/s (^[] (digest-string s)))
+          (mb/s (^[] (digest-string v)))
+          (mb/s (^[] (with-input-from-string s digest)))))
+
+(define (main args)
+  (let* ([v (rlet1 v (make-u8vector *size*)
+              (dotimes [i *size*] (u8vector-set! v i (logand i 255))))]
+         [s (u8vector->string v)]
+         [hw (accel-set! #t)])
+    (print "SHA extensions: " (if hw "available" "not available"))
+    (bench "md5" md5-digest md5-digest-string v s)
+    (dolist [accel (if hw '(#f #t) '(#f))]
+      (accel-set! accel)
+      (let1 suffix (if accel " (hw)" "")
+        (bench #"sha1~suffix" sha1-digest sha1-digest-string v s)
+        (bench #"sha256~suffix" sha256-digest sha256-digest-string v s)))
+    (bench "sha512" sha512-digest sha512-digest-string v s)
+    (bench "xxhash64" xxhash64-digest xxhash64-digest-string v s)
+    (bench "xxh3" xxh3-digest xxh3-digest-string v s)
+    (bench "murmur3" murmurhash3-digest murmurhash3-digest-string v s)
+    (let1 hw (crc-hw-set! #t)
+      (dolist [accel (if hw '(#f #t) '(#f))]
+        (crc-hw-set! accel)
+        (bench (if accel "crc32c (hw)" "crc32c")
+               crc32c-digest crc32c-digest-string v s))))
+  0)
@@ -3,9 +3,11 @@
 ;;
 
 
-;; As of 0.9.7, dispatcher is on for 'ref' and 'object-apply'.
-;; It can be turned off by setting GAUCHE_DISABLE_GENERIC_DISPATCHER env var
-;; at the initialization.  Run this script with and without it 
+;; Dispatcher is on for 'ref' and 'object-apply' from the start, and
+;; other generic functions get it automatically when they meet the criteria
+;; (see dispatch.c).  It can be turned off by setting
+;; GAUCHE_DISABLE_GENERIC_DISPATCHER env var at the initialization.
+;; Run this script with and without it.
 
 (use gauche.sequence)
 (use gauche.parameter)
@@ -29,6 +31,14 @@
        ))))
         
 
+;; Same as unroll, but calls FN with just OBJ
+(define-syntax unroll1
+  (er-macro-transformer
+   (^[f r c]
+     (match (cdr f)
+       [(fn obj)
+        `(begin ,@(map (^[i] (quasirename r (,fn ,obj))) (iota 10000)))]))))
+
 (define (do-vector v)
   (dotimes [1000] (unroll vector-ref v)))
 
@@ -51,6 +61,36 @@
 (define (do-proc)
   (dotimes [1000] (unroll proc)))
 
+;; Slot access and a user-defined generic function with several methods.
+(define-class <point> ()
+  ((x :init-value 1 :accessor point-x)
+   (y :init-value 2)))
+
+(define (do-slot-ref p)
+  (dotimes [1000] (unroll1 slot-ref-x p)))
+(define (slot-ref-x p) (slot-ref p 'x))
+
+(define (do-ref-slot p)
+  (dotimes [1000] (unroll1 ref-x p)))
+(define (ref-x p) (ref p 'x))
+
+(define (do-accessor p)
+  (dotimes [1000] (unroll1 point-x p)))
+
+(define-method describe-it ((x <integer>)) 'integer)
+(define-method describe-it ((x <string>)) 'string)
+(define-method describe-it ((x <symbol>)) 'symbol)
+(define-method describe-it ((x <point>)) 'point)
+(define-method describe-it ((x <vector>)) 'vector)
+(define-method describe-it ((x <pair>)) 'pair)
+
+(define (do-custom p)
+  (dotimes [1000] (unroll1 describe-it p)))
+
+(define (show-dispatcher-info gf)
+  (let1 info ((with-module gauche.object generic-dispatcher-info) gf)
+    (format #t "~20a: ~s\n" (~ gf'name) info)))
+
 
 (define (bench)
   (define v (make-vector 10))
@@ -65,16 +105,22 @@
                        (proc-call    . ,(cut do-proc))
                        (parameter    . ,(cut do-param))
                        ))
+  (define p (make <point>))
+  (time-these/report 1
+                     `((slot-ref     . ,(cut do-slot-ref p))
+                       (ref-slot     . ,(cut do-ref-slot p))
+                       (accessor     . ,(cut do-accessor p))
+                       (custom-gf    . ,(cut do-custom p))
+                       ))
+  (for-each show-dispatcher-info (list ref object-apply point-x describe-it))
   )
 
 (define (main args)
-  (print "With dispatcher")
-  (bench)
-  ((with-module gauche.object generic-invalidate-dispatcher!) ref)
-  ((with-module gauche.object generic-invalidate-dispatcher!) object-apply)
-  (print "Without dispatcher")
+  (print (if (sys-getenv "GAUCHE_DISABLE_GENERIC_DISPATCHER")
+           "Without dispatcher"
+           "With dispatcher"))
   (bench)
-  )
+  0)
 
 #|
 in Scm_SortMethods shortcut for method length=1 list
@@ -0,0 +1,111 @@
+;;
+;; Flonum arithmetic benchmark
+;;
+
+;; Run as 'gosh flonum-performance.scm'.  Each benchmark runs the same
+;; algorithm on <vector> of flonums and on <f64vector>.  The former
+;; boxes every flonum stored into the vector and goes through the generic
+;; arithmetic instructions, while the latter is compiled into UVEC-REF,
+;; UVEC-SET and the flonum instructions (NUMFADD2 etc.) that keep the
+;; intermediate values unboxed.
+
+(use gauche.time)
+(use gauche.uvector)
+
+;;
+;; Matrix multiply, C = A * B, all N x N in row-major order
+;;
+
+(define (matmul-vector a b c n)
+  (dotimes [i n]
+    (dotimes [j n]
+      (let loop ([k 0] [s 0.0])
+        (if (= k n)
+          (vector-set! c (+ (* i n) j) s)
+          (loop (+ k 1)
+                (+ s (* (vector-ref a (+ (* i n) k))
+                        (vector-ref b (+ (* k n) j))))))))))
+
+(define (matmul-f64vector a b c n)
+  (dotimes [i n]
+    (dotimes [j n]
+      (let loop ([k 0] [s 0.0])
+        (if (= k n)
+          (f64vector-set! c (+ (* i n) j) s)
+          (loop (+ k 1)
+                (+ s (* (f64vector-ref a (+ (* i n) k))
+                        (f64vector-ref b (+ (* k n) j))))))))))
+
+;;
+;; N-body, advancing the planets of the solar system.
+;; Each body has 7 elements: x, y, z, vx, vy, vz and mass.
+;;
+
+(define-syntax define-advance
+  (syntax-rules ()
+    [(_ name ref put!)
+     (define (name bodies nbodies dt)
+       (dotimes [i nbodies]
+         (let1 bi (* i 7)
+           (do ([j (+ i 1) (+ j 1)])
+               [(= j nbodies)]
+             (let* ([bj (* j 7)]
+                    [dx (- (ref bodies bi) (ref bodies bj))]
+                    [dy (- (ref bodies (+ bi 1)) (ref bodies (+ bj 1)))]
+                    [dz (- (ref bodies (+ bi 2)) (ref bodies (+ bj 2)))]
+                    [d2 (+ (* dx dx) (* dy dy) (* dz dz))]
+                    [mag (/ dt (* d2 (sqrt d2)))]
+                    [mi (* (ref bodies (+ bi 6)) mag)]
+                    [mj (* (ref bodies (+ bj 6)) mag)])
+               (put! bodies (+ bi 3) (- (ref bodies (+ bi 3)) (* dx mj)))
+               (put! bodies (+ bi 4) (- (ref bodies (+ bi 4)) (* dy mj)))
+               (put! bodies (+ bi 5) (- (ref bodies (+ bi 5)) (* dz mj)))
+               (put! bodies (+ bj 3) (+ (ref bodies (+ bj 3)) (* dx mi)))
+               (put! bodies (+ bj 4) (+ (ref bodies (+ bj 4)) (* dy mi)))
+               (put! bodies (+ bj 5) (+ (ref bodies (+ bj 5)) (* dz mi)))))))
+       (dotimes [i nbodies]
+         (let1 bi (* i 7)
+           (dotimes [k 3]
+             (put! bodies (+ bi k)
+                   (+ (ref bodies (+ bi k)) (* dt (ref bodies (+ bi k 3)))))))))]))
+
+(define-advance advance-vector vector-ref vector-set!)
+(define-advance advance-f64vector f64vector-ref f64vector-set!)
+
+(define *planets*
+  '((0.0 0.0 0.0 0.0 0.0 0.0 39.47841760435743)
+    (4.84143144246472090e+00 -1.16032004402742839e+00 -1.03622044471123109e-01
+     6.06326392995832020e-01 2.81198684491626025e+00 -2.52183616598876385e-02
+     3.76936748703894930e-02)
+    (8.34336671824457987e+00 4.12479856412430479e+00 -4.03523417114321381e-01
+     -1.01077434617879020e+00 1.82566237123041186e+00 8.41576137658415351e-03
+     1.12863261319687668e-02)
+    (1.28943695621391310e+01 -1.51111514016986312e+01 -2.23307578892655734e-01
+     1.08279100644154271e+00 8.68713018169608157e-01 -1.08326400686750974e-02
+     1.72372405705936483e-03)
+    (1.53796971148509165e+01 -2.59193146099879641e+01 1.79258772950371181e-01
+     9.79090732243897978e-01 5.94698998647676060e-01 -3.47559558220643790e-02
+     2.03368686992463060e-03)))
+
+(define (bench name n vthunk fthunk)
+  (print name)
+  (time-these/report n `((vector . ,vthunk)
+                         (f64vector . ,fthunk))))
+
+(define (main args)
+  (let* ([n 40]
+         [src (list-tabulate (* n n) (^i (inexact (/ (modulo i 17) 7))))]
+         [va (list->vector src)] [vb (list->vector src)]
+         [vc (make-vector (* n n) 0.0)]
+         [fa (list->f64vector src)] [fb (list->f64vector src)]
+         [fc (make-f64vector (* n n) 0.0)])
+    (bench "matrix multiply (40x40)" 20
+           (^[] (matmul-vector va vb vc n))
+           (^[] (matmul-f64vector fa fb fc n))))
+  (let ([vbodies (list->vector (apply append *planets*))]
+        [fbodies (list->f64vector (apply append *planets*))]
+        [nbodies (length *planets*)])
+    (bench "n-body (1000 steps)" 20
+           (^[] (dotimes [i 1000] (advance-vector vbodies nbodies 0.01)))
+           (^[] (dotimes [i 1000] (advance-f64vector fbodies nbodies 0.01)))))
+  0)
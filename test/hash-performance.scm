@@ -0,0 +1,35 @@
+;;
+;; Compare hash table layouts
+;;
+
+;; Run as 'gosh hash-performance.scm [num-keys]'.
+
+(use gauche.time)
+
+(define (keys-of type n)
+  (case type
+    [(eq?)      (map (^i (string->symbol #"key~i")) (iota n))]
+    [(string=?) (map (^i #"key~i") (iota n))]
+    [else       (iota n)]))
+
+(define (insert type layout keys)
+  (^[] (let1 h (make-hash-table type 0 layout)
+         (dolist [k keys] (hash-table-put! h k #t)))))
+
+(define (lookup type layout keys)
+  (let1 h (make-hash-table type 0 layout)
+    (dolist [k keys] (hash-table-put! h k #t))
+    (^[] (dolist [k keys] (hash-table-get h k #f)))))
+
+(define (main args)
+  (define n (if (null? (cdr args)) 1000000 (string->number (cadr args))))
+  (dolist [type '(eq? eqv? string=?)]
+    (let1 keys (keys-of type n)
+      (print #"~|type| table with ~n keys")
+      ($ time-these/report '(cpu 3)
+         `((insert/chained . ,(insert type 'chained keys))
+           (insert/open    . ,(insert type 'open-addressing keys))
+           (insert/incr    . ,(insert type 'incremental keys))
+           (lookup/chained . ,(lookup type 'chained keys))
+           (lookup/open    . ,(lookup type 'open-addressing keys))))))
+  0)
@@ -6,6 +6,7 @@
 (use srfi-1)
 (use srfi-13)
 (use gauche.uvector)
+(use gauche.dictionary)
 
 ;; Note: test/object.scm contains extra tests of hashtables using
 ;; object-equal? and object-hash overload.
@@ -466,6 +467,85 @@
                 (iota 20))
     (every (cut hash-table-contains? h <> ) (iota 20))))
 
+;;------------------------------------------------------------------
+(test-section "table layouts")
+
+(define (test-layout layout type keygen)
+  (define h (make-hash-table type 0 layout))
+  (define keys (map keygen (iota 1000)))
+  (test* #"~|type| ~|layout| layout" layout
+         (get-keyword :layout (hash-table-stat h)))
+  (test* #"~|type| ~|layout| put & get" #t
+         (begin
+           (for-each (^[k] (hash-table-put! h k k)) keys)
+           (and (= (hash-table-num-entries h) 1000)
+                (every (^[k] (equal? (hash-table-get h k) k)) keys))))
+  (test* #"~|type| ~|layout| delete" '(500 #f)
+         (begin
+           (for-each (^[k] (hash-table-delete! h k)) (take keys 500))
+           (list (hash-table-num-entries h)
+                 (any (cut hash-table-exists? h <>) (take keys 500)))))
+  (test* #"~|type| ~|layout| reinsert" 1000
+         (begin
+           (for-each (^[k] (hash-table-put! h k 'x)) (take keys 500))
+           (hash-table-num-entries h)))
+  (test* #"~|type| ~|layout| update! with rehash" 'y
+         (let1 k (keygen 'update)
+           (hash-table-update! h k
+                               (^v (dotimes [i 1000]
+                                     (hash-table-put! h (keygen (+ i 1000)) i))
+                                   'y)
+                               #f)
+           (hash-table-get h k)))
+  (test* #"~|type| ~|layout| delete during iteration" '(0 ())
+         (begin
+           (hash-table-for-each h (^[k v] (hash-table-delete! h k)))
+           (list (hash-table-num-entries h) (hash-table-keys h))))
+  (test* #"~|type| ~|layout| copy" #t
+         (begin
+           (for-each (^[k] (hash-table-put! h k k)) keys)
+           (let1 h2 (hash-table-copy h)
+             (hash-table-clear! h)
+             (and (eq? (get-keyword :layout (hash-table-stat h2)) layout)
+                  (= (hash-table-num-entries h) 0)
+                  (every (^[k] (equal? (hash-table-get h2 k) k)) keys))))))
+
+(dolist [layout '(chained open-addressing incremental)]
+  (test-layout layout 'eq? (^i (if (number? i) (string->symbol #"k~i") i)))
+  (test-layout layout 'eqv? (^i (if (number? i) (+ i 0.5) i)))
+  (test-layout layout 'equal? (^i (list i (x->string i))))
+  (test-layout layout 'string=? (^i (x->string i)))
+  (test-layout layout (make-comparator integer? = #f (^i (quotient i 3)))
+               (^i (if (number? i) i -1))))
+
+;; Check operations while the incremental rehash is in progress.
+;; The table is extended when it gets 3*4^k+1 entries.
+(let ([h (make-hash-table 'eqv? 0 'incremental)]
+      [n (+ (* 3 (expt 4 6)) 1)])
+  (dotimes [i n] (hash-table-put! h i (- i)))
+  (test* "incremental rehash in progress" #t
+         (positive? (get-keyword :rehash-remaining (hash-table-stat h))))
+  (test* "incremental rehash get" #t
+         (every (^i (eqv? (hash-table-get h i) (- i))) (iota n)))
+  (test* "incremental rehash iteration" n
+         (length (hash-table-keys h)))
+  (test* "incremental rehash copy" #t
+         (let1 h2 (hash-table-copy h)
+           (and (zero? (get-keyword :rehash-remaining (hash-table-stat h2)))
+                (every (^i (eqv? (hash-table-get h2 i) (- i))) (iota n)))))
+  (test* "incremental rehash delete" (quotient n 2)
+         (begin
+           (dotimes [i n] (when (even? i) (hash-table-delete! h i)))
+           (hash-table-num-entries h)))
+  (test* "incremental rehash finishes" '(0 #t)
+         (begin
+           (dotimes [i n] (hash-table-put! h (+ i n) i))
+           (list (get-keyword :rehash-remaining (hash-table-stat h))
+                 (every (^i (eqv? (hash-table-get h (+ i n)) i)) (iota n))))))
+
+(test* "unsupported layout" (test-error)
+       (make-hash-table 'eq? 0 'no-such-layout))
+
 ;;------------------------------------------------------------------
 (test-section "iterators")
 
@@ -514,6 +594,99 @@
        (hash-table-find h-it (^[k v] (and (eq? k 'e) (* v 2)))
                         (^[] 'oops)))
 
+;;------------------------------------------------------------------
+(test-section "concurrent hash table")
+
+(define (test-concurrent-table type keygen)
+  (let ([h (make-concurrent-hash-table type)]
+        [n 5000])
+    (test* #"concurrent-hash-table? (~type)" #t
+           (concurrent-hash-table? h))
+    (test* #"put!/get (~type)" #t
+           (begin
+             (dotimes [i n] (concurrent-hash-table-put! h (keygen i) i))
+             (every (^i (eqv? (concurrent-hash-table-get h (keygen i)) i))
+                    (iota n))))
+    (test* #"num-entries (~type)" n
+           (concurrent-hash-table-num-entries h))
+    (test* #"get fallback (~type)" 'none
+           (concurrent-hash-table-get h (keygen (+ n 1)) 'none))
+    (test* #"get error (~type)" (test-error)
+           (concurrent-hash-table-get h (keygen (+ n 1))))
+    (test* #"delete! (~type)" '(#t #f #f 2500)
+           (begin
+             (dotimes [i n] (when (even? i)
+                              (concurrent-hash-table-delete! h (keygen i))))
+             (list (concurrent-hash-table-exists? h (keygen 1))
+                   (concurrent-hash-table-exists? h (keygen 2))
+                   (concurrent-hash-table-delete! h (keygen 2))
+                   (concurrent-hash-table-num-entries h))))
+    (test* #"re-put! (~type)" '(-2 5000)
+           (begin
+             (dotimes [i n] (when (even? i)
+                              (concurrent-hash-table-put! h (keygen i) (- i))))
+             (list (concurrent-hash-table-get h (keygen 2))
+                   (concurrent-hash-table-num-entries h))))
+    (test* #"keys (~type)" #t
+           (lset= equal? (map keygen (iota n)) (concurrent-hash-table-keys h)))
+    (test* #"clear! (~type)" '(0 #f)
+           (begin
+             (concurrent-hash-table-clear! h)
+             (list (concurrent-hash-table-num-entries h)
+                   (concurrent-hash-table-exists? h (keygen 1)))))))
+
+(test-concurrent-table 'eq? (^i (string->symbol #"k~i")))
+(test-concurrent-table 'eqv? (^i (* i 1.5)))
+(test-concurrent-table 'equal? (^i (list i (number->string i))))
+(test-concurrent-table 'string=? (^i (number->string i)))
+(test-concurrent-table (make-comparator integer? = #f (^i (* i 7)))
+                       identity)
+
+(let1 h (make-concurrent-hash-table 'eqv?)
+  (test* "adjoin!/replace!" '(1 #f 3)
+         (begin
+           (concurrent-hash-table-adjoin! h 'a 1)
+           (concurrent-hash-table-adjoin! h 'a 2)
+           (concurrent-hash-table-replace! h 'b 2)
+           (concurrent-hash-table-put! h 'c 0)
+           (concurrent-hash-table-replace! h 'c 3)
+           (list (concurrent-hash-table-get h 'a)
+                 (concurrent-hash-table-get h 'b #f)
+                 (concurrent-hash-table-get h 'c))))
+  (test* "compare-and-swap!" '(#f #f #t #t #f)
+         (list (concurrent-hash-table-compare-and-swap! h 'd 'nope 1)
+               (concurrent-hash-table-compare-and-swap! h 'a 2 3)
+               (concurrent-hash-table-compare-and-swap! h 'a 1 2)
+               (concurrent-hash-table-compare-and-swap! h 'a 2)
+               (concurrent-hash-table-exists? h 'a)))
+  (test* "update!" '(11 (x) 1)
+         (begin
+           (concurrent-hash-table-put! h 'a 1)
+           (concurrent-hash-table-update! h 'a (cut + <> 10))
+           (concurrent-hash-table-push! h 'e 'x)
+           (list (concurrent-hash-table-get h 'a)
+                 (concurrent-hash-table-get h 'e)
+                 (concurrent-hash-table-update! h 'f (cut + <> 1) 0))))
+  (test* "update! error" (test-error)
+         (concurrent-hash-table-update! h 'g identity))
+  (test* "pop!" '(x () none)
+         (list (concurrent-hash-table-pop! h 'e)
+               (concurrent-hash-table-get h 'e)
+               (concurrent-hash-table-pop! h 'e 'none)))
+  (test* "fold" '((a . 11) (c . 3) (e) (f . 1))
+         (sort (concurrent-hash-table-fold h acons '())
+               (^[x y] (string<? (x->string (car x)) (x->string (car y))))))
+  (test* "dictionary interface" '(11 #t (c . 4))
+         (list (dict-get h 'a)
+               (begin (dict-put! h 'c 4) (dict-exists? h 'c))
+               (assq 'c (dict->alist h))))
+  (test* "concurrent-hash-table-comparator" #t
+         (eq? (concurrent-hash-table-comparator h) eqv-comparator))
+  (test* "alist->concurrent-hash-table" '(b a)
+         (let1 h (alist->concurrent-hash-table '((5 . b) (3 . a)) 'eqv?)
+           (list (concurrent-hash-table-get h 5)
+                 (concurrent-hash-table-get h 3)))))
+
 ;;------------------------------------------------------------------
 (test-section "compare as sets")
 
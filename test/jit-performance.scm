@@ -0,0 +1,61 @@
+;;
+;; Native code compilation benchmark
+;;
+
+;; Run as 'gosh jit-performance.scm'.  Each benchmark runs with and
+;; without native code compilation (-fjit, see src/jit.c).  The
+;; procedures are warmed up before timing, so that they are already
+;; compiled in the 'jit' runs.
+
+(use gauche.time)
+
+(define (fib n)
+  (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+
+(define (tak x y z)
+  (if (not (< y x))
+    z
+    (tak (tak (- x 1) y z) (tak (- y 1) z x) (tak (- z 1) x y))))
+
+(define (sum-to n)
+  (let loop ([i 0] [s 0])
+    (if (< i n) (loop (+ i 1) (+ s i)) s)))
+
+(define (count-down n)
+  (let loop ([n n])
+    (if (= n 0) 'done (loop (- n 1)))))
+
+(define (len lis)
+  (let loop ([lis lis] [n 0])
+    (if (null? lis) n (loop (cdr lis) (+ n 1)))))
+
+(define (my-assq x alist)
+  (cond [(null? alist) #f]
+        [(eq? x (caar alist)) (car alist)]
+        [else (my-assq x (cdr alist))]))
+
+(define *list* (iota 1000))
+(define *alist* (map (^i (cons i i)) (iota 100)))
+
+(define (jit-bench thunk)
+  (^[] ((with-module gauche.vm.code vm-jit-enable!) #t) (thunk)))
+(define (vm-bench thunk)
+  (^[] ((with-module gauche.vm.code vm-jit-enable!) #f) (thunk)))
+
+(define (bench name n thunk)
+  (print name)
+  ((jit-bench thunk))                   ;warm up
+  (time-these/report n `((vm . ,(vm-bench thunk))
+                         (jit . ,(jit-bench thunk)))))
+
+(define (main args)
+  (unless ((with-module gauche.vm.code vm-jit-available?))
+    (print "Native code compilation isn't available on this platform.")
+    (exit 0))
+  (bench "fib" 20 (^[] (fib 25)))
+  (bench "tak" 20 (^[] (tak 18 12 6)))
+  (bench "sum-to (named let)" 200 (^[] (dotimes [i 2000] (sum-to 100))))
+  (bench "count-down" 200 (^[] (dotimes [i 2000] (count-down 100))))
+  (bench "list length" 200 (^[] (dotimes [i 200] (len *list*))))
+  (bench "assq" 200 (^[] (dotimes [i 2000] (my-assq 99 *alist*))))
+  0)
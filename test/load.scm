@@ -399,6 +399,88 @@
 
 (rmrf "test.o")
 
+;; Code cache -----------------------------------
+
+(test-section "code cache")
+
+;; The macro counts how many times the form using it is compiled.
+(define-module cc-helper
+  (export cc-count-expand)
+  (define *expanded* 0)
+  (define-macro (cc-count-expand x) (inc! *expanded*) x))
+
+(rmrf "test.o")
+(sys-mkdir "test.o" #o777)
+(sys-mkdir "test.o/cache" #o777)
+(define (write-cc-source val)
+  (with-output-to-file "test.o/cc.scm"
+    (^[]
+      (write '(define-module cc-test
+                (import cc-helper)
+                (export cc-val cc-twice cc-str)))
+      (write '(select-module cc-test))
+      (write '(define-syntax twice
+                (syntax-rules () [(_ x) (list x x)])))
+      (write `(define cc-val (cc-count-expand ,val)))
+      (write '(define (cc-twice x) (twice (+ x 1))))
+      (write '(define cc-str (let1 s "abc" (cons s #/a+/)))))))
+
+(define (load-cc)
+  (load "test.o/cc")
+  (let1 m (find-module 'cc-test)
+    (list (with-module cc-helper *expanded*)
+          (eval 'cc-val m)
+          (eval '(cc-twice 1) m)
+          (eval '(car cc-str) m)
+          (eval '(regexp->string (cdr cc-str)) m)
+          (length (remove (^f (member f '("." "..")))
+                          (sys-readdir "test.o/cache"))))))
+
+(unwind-protect
+    (begin
+      (set-code-cache-directory! "test.o/cache")
+      (write-cc-source 1)
+      (test* "code cache (first load)" '(1 1 (2 2) "abc" "a+" 1)
+             (load-cc))
+      (test* "code cache (cached load)" '(1 1 (2 2) "abc" "a+" 1)
+             (load-cc))
+      (write-cc-source 2)
+      (test* "code cache (modified source)" '(2 2 (2 2) "abc" "a+" 1)
+             (load-cc))
+      (test* "code cache (cached load again)" '(2 2 (2 2) "abc" "a+" 1)
+             (load-cc))
+      ;; mtime differs but the content doesn't; the cache is still valid
+      (let1 t (- (sys-time) 100) (sys-utime "test.o/cc.scm" t t))
+      (test* "code cache (touched source)" '(2 2 (2 2) "abc" "a+" 1)
+             (load-cc))
+      (dolist [f (sys-readdir "test.o/cache")]
+        (unless (member f '("." ".."))
+          (with-output-to-file #"test.o/cache/~f"
+            (^[] (display "garbage"))
+            :if-exists :append)))
+      (test* "code cache (corrupted cache)" '(3 2 (2 2) "abc" "a+" 1)
+             (load-cc))
+      ;; -fdebug-compiler output is the same with or without the cache
+      (test* "code cache (debug-compiler output)" #t
+             (let1 dump-lines
+                 (^[] (length (string-split
+                               (with-output-to-string
+                                 (^[] (load "test.o/cc")))
+                               #\newline)))
+               (with-module gauche.internal
+                 (vm-compiler-flag-set! SCM_COMPILE_SHOWRESULT))
+               (unwind-protect
+                   (let1 cached (dump-lines)
+                     (set-code-cache-directory! #f)
+                     (let1 uncached (dump-lines)
+                       (set-code-cache-directory! "test.o/cache")
+                       (and (> cached 1) (= cached uncached))))
+                 (with-module gauche.internal
+                   (vm-compiler-flag-clear! SCM_COMPILE_SHOWRESULT))))))
+  (set-code-cache-directory! #f))
+
+(rmrf "test.o")
+
 ;; Load-path hook -----------------------------------
 
 (test-section "load-path hook")
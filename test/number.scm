@@ -493,6 +493,39 @@
         "-340282366920938463463374607431768211457")
       (i-tester2 (exp2 127)))
 
+;; Large numbers are converted by recursive splitting.
+(let ()
+  (define threshold
+    (with-module gauche.internal %bignum-radix-conv-threshold))
+  (define (with-threshold n thunk)
+    (let1 orig (threshold)
+      (dynamic-wind (^[] (threshold n)) thunk (^[] (threshold orig)))))
+  (define big (- (fold * 1 (iota 700 1)) (expt 7 2000)))
+
+  (test* "power of radix" (string-append "1" (make-string 3000 #\0))
+         (with-threshold 2 (^[] (number->string (expt 10 3000)))))
+  (test* "power of radix minus 1" (make-string 2000 #\2)
+         (with-threshold 2 (^[] (number->string (- (expt 3 2000) 1) 3))))
+  (dolist [radix '(2 3 7 8 10 16 31 32 36)]
+    (test* #"radix ~radix conversion"
+           (with-threshold 1000000 (^[] (number->string big radix)))
+           (with-threshold 2 (^[] (number->string big radix))))
+    (test* #"radix ~radix roundtrip" (list big (- big))
+           (with-threshold 2
+             (^[] (list (string->number (number->string big radix) radix)
+                        (string->number (number->string (- big) radix)
+                                        radix))))))
+  (test* "leading zeros and underscores" (abs big)
+         (with-threshold 2
+           (^[] (string->number
+                 (string-append "#d000"
+                                (regexp-replace-all #/(\d{7})/
+                                                    (number->string (abs big))
+                                                    "\\1_"))))))
+  (let1 n (quotient big (expt 10 1400))
+    (test* "big integer part of flonum" (exact->inexact n)
+           (string->number (string-append (number->string n) ".5")))))
+
 ;;------------------------------------------------------------------
 (test-section "number->string customization")
 
@@ -1659,6 +1692,64 @@
   (do-exactness 7 9)
   )
 
+;;------------------------------------------------------------------
+(test-section "large bignum multiplication and division")
+
+;; Karatsuba, Toom-3 and the recursive division must agree with
+;; the schoolbook algorithms.
+(let ()
+  (define karatsuba (with-module gauche.internal %bignum-karatsuba-threshold))
+  (define toom3 (with-module gauche.internal %bignum-toom3-threshold))
+  (define div (with-module gauche.internal %bignum-div-threshold))
+  (define (with-thresholds k t d thunk)
+    (let ([k0 (karatsuba)] [t0 (toom3)] [d0 (div)])
+      (dynamic-wind
+        (^[] (karatsuba k) (toom3 t) (div d))
+        thunk
+        (^[] (karatsuba k0) (toom3 t0) (div d0)))))
+  (define (schoolbook thunk)
+    (with-thresholds 1000000 1000000 1000000 thunk))
+  ;; pseudo random n-word number, with some runs of 0s and 1s
+  (define (make-big nwords seed)
+    (let loop ([i 0] [x seed] [acc 1])
+      (if (= i nwords)
+        acc
+        (let1 x (modulo (+ (* x 6364136223846793005) 1442695040888963407)
+                        (expt 2 64))
+          (loop (+ i 1) x
+                (+ (* acc (expt 2 64))
+                   (case (modulo x 7)
+                     [(0) 0]
+                     [(1) (- (expt 2 64) 1)]
+                     [else x])))))))
+  (define (ops a b)
+    (list (* a b) (* a a)
+          (receive (q r) (quotient&remainder a b) (list q r))
+          (modulo (- a) b)
+          (quotient (* a b) b)))
+
+  (dolist [sizes '((5 5) (40 33) (100 100) (130 70) (300 299) (700 200)
+                   (1000 13))]
+    (let ([a (make-big (car sizes) (+ (car sizes) 1))]
+          [b (make-big (cadr sizes) (cadr sizes))])
+      (test* #"bignum ops ~|sizes|"
+             (schoolbook (^[] (ops a b)))
+             (with-thresholds 4 6 4 (^[] (ops a b))))
+      (test* #"bignum ops ~|sizes| (default thresholds)"
+             (schoolbook (^[] (ops a b)))
+             (ops a b))))
+
+  (let ([a (- (expt 2 (* 64 300)) 1)]
+        [b (- (expt 2 (* 64 150)) 1)])
+    (test* "bignum ops all ones"
+           (schoolbook (^[] (ops a b)))
+           (with-thresholds 4 6 4 (^[] (ops a b)))))
+  (test* "bignum exact quotient" 1
+         (with-thresholds 4 6 4
+           (^[] (let1 f (fold * 1 (iota 2000 1))
+                  (quotient f (* (fold * 1 (iota 1000 1))
+                                 (fold * 1 (iota 1000 1001)))))))))
+
 ;;------------------------------------------------------------------
 (test-section "div and mod")
 
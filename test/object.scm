@@ -420,6 +420,48 @@
        (cons (acc-dis-1 (make <acc-dis-1>) #f)
              (acc-dis-1 (make <acc-dis-1>) 2)))
 
+(define-generic auto-dis)
+(define-method auto-dis ((x <integer>)) 'integer)
+(define-method auto-dis ((x <string>)) 'string)
+(define-method auto-dis ((x <symbol>)) 'symbol)
+(define-method auto-dis ((x <char>)) 'char)
+(define-method auto-dis ((x <pair>)) 'pair)
+(define-method auto-dis ((x <vector>)) 'vector)
+(define-method auto-dis ((x <integer>) (y <symbol>)) 'integer-symbol)
+(define-method auto-dis (x (y <string>)) 'top-string)
+
+(define (auto-dis-state gf)
+  (and-let1 info ((with-module gauche.object generic-dispatcher-info) gf)
+    (get-keyword :state info)))
+
+(define (auto-dis-run)
+  (list (map auto-dis '(1 "a" a #\a (1) #(1)))
+        (auto-dis 1 'x)
+        (auto-dis 1 "s")))        ;table has (<integer> 2), but not applicable
+
+(let1 expected '((integer string symbol char pair vector)
+                 integer-symbol top-string)
+  (test* "automatic dispatcher (observing)" `(,expected observing)
+         (list (auto-dis-run) (auto-dis-state auto-dis)))
+  (dotimes [2000] (auto-dis 1))
+  (test* "automatic dispatcher (active)" `(active ,expected)
+         (list (auto-dis-state auto-dis) (auto-dis-run)))
+  (dotimes [2000] (auto-dis 1))
+  (test* "automatic dispatcher (settled)" `(settled ,expected)
+         (list (auto-dis-state auto-dis) (auto-dis-run))))
+
+(define-method auto-dis ((x <real>)) 'real)
+(test* "automatic dispatcher (method added)" '(#f real integer)
+       (let* ([state (auto-dis-state auto-dis)]
+              [r (auto-dis 1.5)])
+         (list state r (auto-dis 1))))
+
+(define-method auto-dis-few ((x <integer>)) 'integer)
+(define-method auto-dis-few ((x <string>)) 'string)
+(test* "automatic dispatcher (retired)" '(retired integer)
+       (begin (dotimes [2000] (auto-dis-few 1))
+              (list (auto-dis-state auto-dis-few) (auto-dis-few 1))))
+
 
 ;;----------------------------------------------------------------
 (test-section "module and accessor")
@@ -693,6 +735,72 @@
              (method-link-check redef-test2 <w>)))
 
 
+;;----------------------------------------------------------------
+(test-section "inline caches")
+
+;; Slot access with a constant slot name and generic function calls
+;; remember what they found per call site.  Make sure the caches follow
+;; the changes of classes and methods.
+
+(define-class <ic-a> () ((p :init-value 'a-p) (q :init-value 'a-q)))
+(define-class <ic-b> () ((q :init-value 'b-q) (p :init-value 'b-p)))
+(define-class <ic-c> (<ic-a>) ((r :init-value 'c-r)))
+(define-class <ic-d> () ((z :init-value 'd-z) (p :init-value 'd-p)))
+(define-class <ic-e> ()
+  ((p :allocation :virtual
+      :slot-ref (^_ 'e-p)
+      :slot-set! (^(o v) #f))))
+
+(define (ic-p obj) (slot-ref obj 'p))
+(define (ic-p-set! obj v) (slot-set! obj 'p v))
+(define (ic-make-all) (map make (list <ic-a> <ic-b> <ic-c> <ic-d> <ic-e>)))
+
+(test* "slot-ref cache (polymorphic)"
+       '((a-p b-p a-p d-p e-p) (a-p b-p a-p d-p e-p))
+       (let1 objs (ic-make-all)
+         (list (map ic-p objs) (map ic-p objs))))
+
+(test* "slot-set! cache (polymorphic)" '(1 2 3 4 e-p)
+       (let1 objs (ic-make-all)
+         (for-each ic-p-set! objs '(1 2 3 4 5))
+         (map ic-p objs)))
+
+(define-method ic-gf (x) 'top)
+(define-method ic-gf ((x <ic-b>)) 'b)
+(define ic-objs (list (make <ic-b>) (make <ic-d>) 1))
+(define (ic-gf-run) (map (^o (ic-gf o)) ic-objs))
+
+(test* "call site cache" '((b top top) (b top top))
+       (list (ic-gf-run) (ic-gf-run)))
+
+(define-method ic-gf ((x <ic-d>)) 'd)
+(test* "call site cache (method added)" '(b d top) (ic-gf-run))
+
+(define-method ic-gf ((x <integer>)) (list 'int (next-method)))
+(test* "call site cache (next method)" '(b d (int top)) (ic-gf-run))
+
+(test* "call site cache (method deleted)" '(b top (int top))
+       (begin
+         (delete-method! ic-gf
+                         (find (^m (equal? (ref m 'specializers) (list <ic-d>)))
+                               (ref ic-gf 'methods)))
+         (ic-gf-run)))
+
+(define ic-a1 (make <ic-a>))
+(test* "slot-ref cache (before redefinition)" 'a-p (ic-p ic-a1))
+(test* "slot-ref cache (redefinition)" '(a-p a-p2 n)
+       (begin
+         (eval '(define-class <ic-a> ()
+                  ((n :init-value 'n) (p :init-value 'a-p2)))
+               (current-module))
+         (list (ic-p ic-a1) (ic-p (make <ic-a>)) (slot-ref ic-a1 'n))))
+(test* "slot-ref cache (slot removed)" (test-error)
+       (begin
+         (eval '(define-class <ic-a> () ((n :init-value 'n)))
+               (current-module))
+         (ic-p ic-a1)))
+
+
 ;;----------------------------------------------------------------
 (test-section "object comparison protocol")
 
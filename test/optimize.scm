@@ -94,6 +94,38 @@
        '(((LREF0-PUSH)) ((CONSTI 0)) ((UVEC-REF 1)) ((RET)))
        (proc->insn/split (late-inline-test-1 u8vector-ref)))
 
+;; flonum arithmetic
+(test* "uvector-set! inlining" '(((LREF2-PUSH)) ((LREF1-PUSH)) ((LREF0))
+                                 ((UVEC-SET 10)) ((RET)))
+       (proc->insn/split (^[v i x] (f64vector-set! v i x))))
+(test* "flonum arithmetic" '(NUMMUL2 NUMFADD2)
+       (let1 p (^[v w i] (+ (* (f64vector-ref v i) 2.0) (f64vector-ref w i)))
+         (append-map (^o (map caar (filter-insn p o))) '(NUMMUL2 NUMFADD2))))
+(test* "flonum arithmetic (let-bound)" '(NUMFSUB2)
+       (let1 p (^[v i] (let1 x (f64vector-ref v i) (- x (car v))))
+         (map caar (filter-insn p 'NUMFSUB2))))
+(let ([addref (^[v i x] (+ (f64vector-ref v i) x))]
+      [scale! (^[v i x] (f64vector-set! v i (* (f64vector-ref v i) x)))]
+      [v (f64vector 1.5 2.5)])
+  (test* "flonum arithmetic (flonum)" 4.0 (addref v 0 2.5))
+  (test* "flonum arithmetic (fixnum)" 3.5 (addref v 1 1))
+  (test* "flonum arithmetic (ratnum)" 2.0 (addref v 0 1/2))
+  (test* "flonum arithmetic (complex)" 2.5+1.0i (addref v 1 0+1.0i))
+  (test* "inlined f64vector-set!" '#f64(3.0 2.5)
+         (begin (scale! v 0 2.0) v))
+  (test* "inlined f64vector-set! (exact)" '#f64(6.0 2.5)
+         (begin (scale! v 0 2) v))
+  (test* "inlined f64vector-set! (out of range)" (test-error)
+         (scale! v 2 2.0))
+  (test* "inlined f64vector-set! (immutable)" (test-error)
+         (scale! '#f64(1.0) 0 2.0))
+  (test* "inlined u8vector-set!" '#u8(0 255)
+         (let1 u (make-u8vector 2 0)
+           ((^[u i x] (u8vector-set! u i x)) u 1 255)
+           u))
+  (test* "inlined u8vector-set! (out of range)" (test-error)
+         ((^[u i x] (u8vector-set! u i x)) (make-u8vector 2 0) 1 256)))
+
 (test-section "lambda lifting")
 
 ;; bug reported by teppey
@@ -192,5 +224,71 @@
          (foo)))
 
 
+;;-----------------------------------------------------------------
+(test-section "native code")
+
+;; These run the same with or without native code; we check the native
+;; code gives the same results, including the cases it leaves to the VM.
+
+(define (with-jit thunk)
+  (let1 prev ((with-module gauche.vm.code vm-jit-enabled?))
+    (unwind-protect
+        (begin ((with-module gauche.vm.code vm-jit-enable!) #t)
+               (thunk))
+      ((with-module gauche.vm.code vm-jit-enable!) prev))))
+
+;; Calls PROC enough times to make it hot, then returns the result
+;; of the last call.
+(define (hot proc . args)
+  (with-jit (^[] (dotimes [i 2000] (apply proc args)) (apply proc args))))
+
+(define (jit-fib n)
+  (if (< n 2) n (+ (jit-fib (- n 1)) (jit-fib (- n 2)))))
+(define (jit-add a b) (+ a b))
+(define (jit-sub a b) (- a b))
+(define (jit-inc a) (+ a 1))
+(define (jit-lt a b) (< a b))
+(define (jit-sum n)
+  (let loop ([i 0] [s 0])
+    (if (< i n) (loop (+ i 1) (+ s i)) s)))
+(define (jit-len lis)
+  (let loop ([lis lis] [n 0])
+    (if (null? lis) n (loop (cdr lis) (+ n 1)))))
+(define (jit-count-below lis k)
+  (let loop ([lis lis] [n 0])
+    (cond [(null? lis) n]
+          [(< (car lis) k) (loop (cdr lis) (+ n 1))]
+          [else (loop (cdr lis) n)])))
+(define (jit-cadr x) (cadr x))
+(define (jit-memq x lis)
+  (cond [(null? lis) #f] [(eq? x (car lis)) lis] [else (jit-memq x (cdr lis))]))
+
+(test* "fib" 6765 (hot jit-fib 20))
+(test* "compiled" ((with-module gauche.vm.code vm-jit-available?))
+       ((with-module gauche.vm.code compiled-code-native?)
+        (closure-code jit-fib)))
+(test* "fixnum add" 5 (hot jit-add 2 3))
+(test* "overflow" (+ (greatest-fixnum) 1)
+       (with-jit (^[] (jit-add (greatest-fixnum) 1))))
+(test* "underflow" (- (least-fixnum) 1)
+       (begin (hot jit-sub 3 1)
+              (with-jit (^[] (jit-sub (least-fixnum) 1)))))
+(test* "addi overflow" (+ (greatest-fixnum) 1)
+       (begin (hot jit-inc 1)
+              (with-jit (^[] (jit-inc (greatest-fixnum))))))
+(test* "flonum" 3.5 (with-jit (^[] (jit-add 1.5 2))))
+(test* "type error" (test-error) (with-jit (^[] (jit-add 'a 1))))
+(test* "compare" '(#t #f #t)
+       (begin (hot jit-lt 1 2)
+              (with-jit (^[] (list (jit-lt 1 2) (jit-lt 2 1) (jit-lt 1.0 2))))))
+(test* "loop" 4950 (hot jit-sum 100))
+(test* "list" 5 (hot jit-len '(a b c d e)))
+;; a side exit in the middle of the loop, which goes back to the native code
+(test* "loop after exit" 4 (hot jit-count-below '(1 2.5 3 10 4) 5))
+(test* "improper list" (test-error) (with-jit (^[] (jit-len '(a b . c)))))
+(test* "cadr" 'b (hot jit-cadr '(a b c)))
+(test* "cadr error" (test-error) (with-jit (^[] (jit-cadr '(a)))))
+(test* "memq" '(c d) (hot jit-memq 'c '(a b c d)))
+
 (test-end)
 
@@ -0,0 +1,43 @@
+;;
+;; Parallel sort benchmark
+;;
+
+;; Run as 'gosh psort-performance.scm'.  Each benchmark sorts the same
+;; data by psort with 1, 2, 4 and 8 threads.  The 1-thread run is the
+;; plain stable-sort, so the ratios show how psort scales.  The numbers
+;; are meaningful only up to the number of cores of the machine.
+
+(use gauche.time)
+(use gauche.uvector)
+(use control.psort)
+
+(define (lcg-list n seed proc)
+  (let loop ([i 0] [x seed] [r '()])
+    (if (= i n)
+      r
+      (let1 x (modulo (+ (* x 1103515245) 12345) 2147483648)
+        (loop (+ i 1) x (cons (proc x) r))))))
+
+(define (bench name n seq . args)
+  (print name)
+  (time-these/report n
+                     (map (^k (cons (string->symbol #"threads=~k")
+                                    (^[] (parameterize ([psort-threads k])
+                                           (apply psort seq args)))))
+                          '(1 2 4 8))))
+
+(define (main args)
+  (print "available processors: " (sys-available-processors))
+  (let1 n 1000000
+    (bench "fixnums, default order (1000000)" 3
+           (list->vector (lcg-list n 1 (^x (- x 1073741824)))))
+    (bench "flonums, < (1000000)" 3
+           (list->vector (lcg-list n 2 (^x (/ x 3.0)))) <)
+    (bench "f64vector, < (1000000)" 3
+           (list->f64vector (lcg-list n 3 (^x (/ x 3.0)))) <)
+    (bench "strings, string<? (1000000)" 3
+           (list->vector (lcg-list n 4 (^x (number->string x 36)))) string<?)
+    (bench "records by key, lambda (1000000)" 3
+           (list->vector (lcg-list n 5 (^x (cons x (number->string x)))))
+           (^[a b] (< a b)) car))
+  0)
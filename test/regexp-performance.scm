@@ -0,0 +1,67 @@
+;;
+;; Regexp matching with and without the lazy DFA matcher and
+;; the required literal prefilter, and matching many regexps per line
+;; with and without a regexp set
+;;
+
+;; Run as 'gosh regexp-performance.scm [num-lines|log-file]'.
+;; Without a log file, a log with the given number of lines is generated.
+
+(use gauche.time)
+
+(define %regexp-use-dfa (with-module gauche.internal %regexp-use-dfa))
+(define %regexp-use-prefilter
+  (with-module gauche.internal %regexp-use-prefilter))
+
+(define (make-log n)
+  (string-join
+   (map (^i #"2024-01-~(+ 1 (modulo i 28)) 12:~(modulo i 60):00 \
+              ~(if (= i (- n 1)) \"ERROR\" \"INFO\") \
+              worker-~(modulo i 16) processed request ~i in ~(modulo i 997)ms")
+        (iota n))
+   "\n"))
+
+(define (scan rx text use-dfa? use-prefilter?)
+  (^[] (let ([orig-dfa (%regexp-use-dfa use-dfa?)]
+             [orig-prefilter (%regexp-use-prefilter use-prefilter?)])
+         (rx text)
+         (%regexp-use-dfa orig-dfa)
+         (%regexp-use-prefilter orig-prefilter))))
+
+(define *many-regexps*
+  (append (map (^i (string->regexp #"worker-~i failed")) (iota 100))
+          (map (^i (string->regexp #"request \\d+ in ~|i|\\dms$")) (iota 100))
+          (list #/ERROR worker-(\d+)/ #/(\w+)@(\w+)\.com/)))
+
+(define (match-each-line lines)
+  (^[] (dolist [line lines]
+         (filter-map (^[rx k] (and (rxmatch rx line) k))
+                     *many-regexps* (iota (length *many-regexps*))))))
+
+(define (match-each-line/set lines)
+  (let1 rs (make-regexp-set *many-regexps*)
+    (^[] (dolist [line lines]
+           (regexp-set-match rs line)))))
+
+(define (main args)
+  (define text
+    (cond [(null? (cdr args)) (make-log 100000)]
+          [(string->number (cadr args)) => make-log]
+          [else (call-with-input-file (cadr args) port->string)]))
+  (print #"Log with ~(string-size text) bytes")
+  (dolist [rx (list #/ERROR worker-(\d+)/         ; rare literal prefix
+                    #/request (\d+) in 99\dms$/  ; no match
+                    #/(\w+)@(\w+)\.com/          ; literal in the middle
+                    #/worker-(\d+) failed/)]     ; frequent literal prefix
+    (print rx)
+    ($ time-these/report '(cpu 3)
+       `((backtrack        . ,(scan rx text #f #f))
+         (backtrack+filter . ,(scan rx text #f #t))
+         (dfa              . ,(scan rx text #t #f))
+         (dfa+filter       . ,(scan rx text #t #t)))))
+  (let1 lines (take (string-split text #\newline) 2000)
+    (print #"~(length *many-regexps*) regexps for each of ~(length lines) lines")
+    ($ time-these/report '(cpu 3)
+       `((rxmatch-loop . ,(match-each-line lines))
+         (regexp-set   . ,(match-each-line/set lines)))))
+  0)
@@ -11,9 +11,19 @@
 ;; Some test examples are taken from the test suite of Henry Spencer's
 ;; regexp package and PCRE.
 
+;; If the regexp can be run by the lazy DFA matcher, we also check
+;; the backtracking matcher yields the same result.
+(define %regexp-dfa? (with-module gauche.internal %regexp-dfa?))
+(define %regexp-use-dfa (with-module gauche.internal %regexp-use-dfa))
+
 (define (test-re re str expect)
   (test* (write-to-string `(,re ,str)) expect
-         (rxmatch-substrings (rxmatch re str))))
+         (rxmatch-substrings (rxmatch re str)))
+  (when (%regexp-dfa? re)
+    (test* (write-to-string `(,re ,str :no-dfa)) expect
+           (let1 orig (%regexp-use-dfa #f)
+             (unwind-protect (rxmatch-substrings (rxmatch re str))
+               (%regexp-use-dfa orig))))))
 
 (define (test-before re str expect . opts)
   (test* (write-to-string `(rxmatch-before (,re ,str))) expect
@@ -183,6 +193,27 @@
 (test-regexp-laset "(abc)*(bcd)*ef" #[abe])
 (test-regexp-laset "([^\"]|\"\")+" (char-set-complement #[]))
 
+(define %regexp-must-match (with-module gauche.internal %regexp-must-match))
+(define-syntax test-regexp-must-match
+  (syntax-rules ()
+    [(_ pat exp)
+     (test* #"regexp-must-match \"~|pat|\"" exp
+            (%regexp-must-match (string->regexp pat)))]))
+
+(test-regexp-must-match "abc" "abc")
+(test-regexp-must-match "a(?:bc)(d)" "abcd")
+(test-regexp-must-match "x+ERROR: (\\d+)" "ERROR: ")
+(test-regexp-must-match "(abc|abd)e" "e")
+(test-regexp-must-match "a[bc]de" "de")
+(test-regexp-must-match "(?:abc)+d" "abc")
+(test-regexp-must-match "^foo\\bbar" "foobar")
+(test-regexp-must-match "(?i:ab)cd" "cd")
+(test-regexp-must-match "ab$" "ab")
+(test-regexp-must-match "猫(?=犬)" "猫")
+(test-regexp-must-match "a*" #f)
+(test* "regexp-must-match (case-fold)" #f
+       (%regexp-must-match (string->regexp "abc" :case-fold #t)))
+
 ;;-------------------------------------------------------------------------
 (test-section "boundary")
 
@@ -938,6 +969,118 @@
 (test* "#/(?i:abc)/" "#/(?i:abc)/"
        (write-to-string (string->regexp "abc" :case-fold #t)))
 
+;;-------------------------------------------------------------------------
+(test-section "lazy DFA matcher")
+
+(let ()
+  (define (t pat expect)
+    (test* #"DFA eligibility \"~|pat|\"" expect
+           (%regexp-dfa? (string->regexp pat))))
+  (t "abc" #t)
+  (t "(a|b)*c{2,3}" #t)
+  (t "^\\bfoo\\B.$" #t)
+  (t "(?i:[a-z]+)x" #t)
+  (t "(a)\\1" #f)
+  (t "a(?=b)" #f)
+  (t "(?<=a)b" #f)
+  (t "(?>a+)b" #f)
+  (t "a++b" #f)
+  (t "(a)?(?(1)b|c)" #f))
+
+;; leftmost-first, not leftmost-longest
+(test-re #/a|ab/ "xab" '("a"))
+(test-re #/(a|ab)(c|bcd)/ "abcd" '("abcd" "a" "bcd"))
+(test-re #/(a*?)(a*)/ "aaa" '("aaa" "" "aaa"))
+(test-re #/(a+|b+)*c/ "ababc" '("ababc" "b"))
+(test-re #/$a/ "x$a" '("$a"))
+(test-re #/\bb|a\B/ "ab b" '("a"))
+(test-re #/\bb|b\b/ "ab b" '("b"))
+(test-re #/(?i:a(é|b))c/ "xAéc" '("Aéc" "é"))
+(test-re #/[^a]+猫/ "あい猫ねこ" '("あい猫"))
+
+;; Inputs that makes the backtracking matcher suffer
+(test* "long input" 20000
+       (rxmatch-end (#/(a|b)*c/ (string-append (make-string 20000 #\a) "c"))
+                    1))
+(test* "exponential backtracking" #f
+       (rxmatch #/(a*)*b/ (make-string 10000 #\a)))
+(test* "many states" #t
+       (boolean
+        (rxmatch #/[ab]*a[ab]{15}$/
+                 (list->string (map (^i (if (odd? (* i i 7)) #\a #\b))
+                                    (iota 3001))))))
+
+;;-------------------------------------------------------------------------
+(test-section "required literal")
+
+(define %regexp-use-prefilter (with-module gauche.internal %regexp-use-prefilter))
+
+;; Run the tests with and without the lazy DFA matcher, so that both
+;; matchers are tested with the prefilter.
+(define (test-prefilter re str expect)
+  (test-re re str expect)
+  (let1 orig (%regexp-use-prefilter #f)
+    (unwind-protect
+        (test* (write-to-string `(,re ,str :no-prefilter)) expect
+               (rxmatch-substrings (rxmatch re str)))
+      (%regexp-use-prefilter orig))))
+
+(test-prefilter #/ERROR: (\d+)/ "INFO: 1\nERROR 2\nERROR: 3" '("ERROR: 3" "3"))
+(test-prefilter #/ERROR: (\d+)/ "INFO: 1\nERROR 2\nERROR: x" #f)
+(test-prefilter #/abc(?=d)/ "abcabcd" '("abc"))
+(test-prefilter #/(?<=x)abc/ "abcxabc" '("abc"))
+(test-prefilter #/\babc/ "xabc abc" '("abc"))
+(test-prefilter #/(abc)\1/ "abcabdabcabc" '("abcabc" "abc"))
+(test-prefilter #/[a-z]+ERROR/ "ERRORxERROR" '("xERROR"))
+(test-prefilter #/a+ERROR/ "aaERRORaERROR" '("aaERROR"))
+(test-prefilter #/猫+ね/ "猫ねこ猫猫ね" '("猫ね"))
+(test-prefilter #/ね.こ/ "ねねねこ" '("ねねこ"))
+
+;;-------------------------------------------------------------------------
+(test-section "regexp set")
+
+(let ([rs (make-regexp-set (list #/ERROR (\d+)/
+                                 "^INFO"
+                                 #/\bwarn(ing)?\b/i
+                                 #/timeout$/
+                                 #/[0-9]{3}ms/
+                                 #/猫+/))])
+  (define (t str expect)
+    (test* #"regexp-set-match ~|str|" expect (regexp-set-match rs str))
+    (test* #"regexp-set-match ~|str| (port)" expect
+           (call-with-input-string str (cut regexp-set-match rs <>)))
+    ;; must agree with rxmatch on each regexp
+    (test* #"regexp-set-match ~|str| (rxmatch)" expect
+           (filter-map (^[rx k] (and (rxmatch rx str) k))
+                       (regexp-set-regexps rs) (iota 6))))
+  (test* "regexp-set?" '(#t #f) (list (regexp-set? rs) (regexp-set? #/a/)))
+  (test* "regexp-set-regexps" 6 (length (regexp-set-regexps rs)))
+  (t "" '())
+  (t "INFO all good" '(1))
+  (t "xINFO all good" '())
+  (t "ERROR 42 after 500ms timeout" '(0 3 4))
+  (t "Warning: 猫 timeout" '(2 3 5))
+  (t "warnings 12ms" '())
+  (t "INFO: ERROR 1 warn 100ms 猫猫 timeout" '(0 1 2 3 4 5))
+  (test* "regexp-set-rxmatch" '("WARN" 2)
+         (receive (m k) (regexp-set-rxmatch rs "no ERROR but WARN 1234ms")
+           (list (and m (rxmatch-substring m)) k)))
+  (test* "regexp-set-rxmatch" '(#f #f)
+         (receive (m k) (regexp-set-rxmatch rs "nothing")
+           (list m k)))
+  (test* "regexp-set-rxmatch (groups)" '("ERROR 7" "7")
+         (receive (m k) (regexp-set-rxmatch rs "ERROR 7 12ms")
+           (list (m 0) (m 1)))))
+
+(test* "empty regexp set" '()
+       (regexp-set-match (make-regexp-set '()) "abc"))
+(test* "regexp set stops reading port" #t
+       (call-with-input-string "abc rest"
+         (^p (regexp-set-match (make-regexp-set '(#/b/ #/c/)) p)
+             (string? (read-line p)))))
+(test* "regexp set with backtracking regexp" (test-error)
+       (make-regexp-set (list #/a/ #/(a)\1/)))
+
 ;;-------------------------------------------------------------------------
 (test-section "regexp from AST")
 
@@ -119,6 +119,55 @@
              (process-output->string '("./gosh" "-ftest" "test.o")))
          (delete-files "test.o")))
 
+;; The library prints "expand" when its macro is expanded, which doesn't
+;; happen when it is restored from the image.
+(define (write-image-test-library val)
+  (with-output-to-file "test.o.d/image-test.scm"
+    (^[]
+      (write '(define-module image-test (export image-val)))
+      (write '(select-module image-test))
+      (write '(define-macro (noisy x) (print "expand") x))
+      (write `(define image-val (noisy ,val))))))
+
+(define (run-image-test . opts)
+  (process-output->string `("./gosh" "-ftest" ,@opts "-Itest.o.d"
+                            "-uimage-test" "-e(print image-val)" "-e(exit)")
+                          :error :null))
+
+(test* "--dump-image and --image" '("expand" "2" "expand 30" "expand 30")
+       (wrap-with-test-directory
+        (^[]
+          (write-image-test-library 2)
+          (let* ([dump (process-output->string
+                        '("./gosh" "-ftest" "-Itest.o.d" "-uimage-test"
+                          "--dump-image=test.o.d/test.img"))]
+                 [restored (run-image-test "--image=test.o.d/test.img")])
+            ;; A stale image is ignored.
+            (write-image-test-library 30)
+            (list dump restored
+                  (run-image-test "--image=test.o.d/test.img")
+                  (run-image-test))))
+        '("test.o.d")))
+
+;; Restoring from the image must not leave the source files open.
+(when (file-is-directory? "/proc/self/fd")
+  (test* "--image doesn't leak descriptors" #t
+         (wrap-with-test-directory
+          (^[]
+            (write-image-test-library 2)
+            (process-output->string
+             '("./gosh" "-ftest" "-Itest.o.d" "-uimage-test"
+               "--dump-image=test.o.d/test.img"))
+            (let1 nfds
+                (^ opts
+                  (process-output->string
+                   `("./gosh" "-ftest" ,@opts "-Itest.o.d" "-uimage-test"
+                     "-e(print (length (sys-readdir \"/proc/self/fd\")))"
+                     "-e(exit)")
+                   :error :null))
+              (equal? (nfds "--image=test.o.d/test.img") (nfds))))
+          '("test.o.d"))))
+
 ;;=======================================================================
 (test-section "gauche-config")
 
@@ -0,0 +1,50 @@
+;;
+;; Cost of a selector wakeup as the number of watched descriptors grows,
+;; with select, poll and epoll backends
+;;
+
+;; Run as 'gosh selector-performance.scm [max-pipes]'.
+;; Each wakeup makes one of N pipes readable and dispatches its handler,
+;; while the other pipes stay idle.  Each pipe uses two descriptors, so
+;; raise the limit ('ulimit -n') for large N.  The select backend is
+;; skipped when descriptors exceed FD_SETSIZE.
+
+(use gauche.time)
+(use gauche.selector)
+
+(define *backends*
+  (cond-expand
+   [gauche.sys.epoll '(select poll epoll)]
+   [gauche.sys.poll  '(select poll)]
+   [else             '(select)]))
+
+(define (make-pipes n)
+  (map (^_ (receive (in out) (sys-pipe :buffering :none) (cons in out)))
+       (iota n)))
+
+(define (wakeup-bench backend pipes)
+  (let ([sel (make <selector> :backend backend)]
+        [vec (list->vector pipes)]
+        [k 0])
+    (dolist [p pipes]
+      (selector-add! sel (car p) (^[port flag] (read-byte port)) '(r)))
+    (^[] (let1 p (vector-ref vec k)
+           (set! k (modulo (+ k 7919) (vector-length vec)))
+           (write-byte 1 (cdr p))
+           (selector-select sel 0)))))
+
+(define (main args)
+  (define max-pipes
+    (if (null? (cdr args)) 4000 (string->number (cadr args))))
+  (let loop ([n 10])
+    (when (<= n max-pipes)
+      (let* ([pipes (make-pipes n)]
+             [max-fd (apply max (map (^p (port-file-number (cdr p))) pipes))]
+             [backends (if (>= max-fd 1024) (delete 'select *backends*)
+                           *backends*)])
+        (print #"~n pipes")
+        ($ time-these/report '(cpu 2)
+           (map (^b (cons b (wakeup-bench b pipes))) backends))
+        (dolist [p pipes] (close-port (car p)) (close-port (cdr p))))
+      (loop (* n 4))))
+  0)
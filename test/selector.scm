@@ -14,87 +14,203 @@
 (use gauche.selector)
 (test-module 'gauche.selector)
 
-(define *sel* #f)
-(define-values (*p0* *p1*) (sys-pipe))
-(define-values (*q0* *q1*) (sys-pipe))
-
-(define *x* #f)
-(define *y* #f)
-
-(define (set-x port flags)
-  (case flags
-    ((r) (set! *x* (read port)))
-    ((w) (write '(xxx) port) (flush port))))
-
-  
-(define (set-y port flags)
-  (case flags
-    ((r) (set! *y* (read port)))
-    ((w) (write '(yyy) port) (flush port))))
-
-(test* "make" #t
-       (begin (set! *sel* (make <selector>))
-              (is-a? *sel* <selector>)))
-
-(test* "selector-add!" #f
-       (begin
-         (selector-add! *sel* *p0* set-x '(r))
-         *x*))
-
-(test* "selector-select" '(foo)
-       (begin
-         (write '(foo) *p1*)
-         (flush *p1*)
-         (selector-select *sel*)
-         *x*))
-
-(test* "selector-add!" #f
-       (begin
-         (selector-add! *sel* *q0* set-y '(r))
-         *y*))
-
-(test* "selector-select" '(bar baz)
-       (begin
-         (write '(bar baz) *q1*)
-         (flush *q1*)
-         (selector-select *sel* '(1 0))
-         *y*))
-
-(test* "selector-delete! (by port)" '(foo)
-       (begin
-         (selector-delete! *sel* *p0* #f #f)
-         (write '(zzz) *p1*)
-         (flush *p1*)
-         (selector-select *sel* 0)
-         *x*))
-
-(test* "selector-delete! (by proc)" '(bar baz)
-       (begin
-         (selector-delete! *sel* #f set-y #f)
-         (write '(yyy) *q1*)
-         (flush *q1*)
-         (selector-select *sel* 0)
-         *y*))
-
-(test* "selector-select (flags)" '(((zzz) (yyy))
-                                   ((xxx) (yyy)))
-       (begin
-         (selector-add! *sel* *p0* set-x '(r))
-         (selector-add! *sel* *q0* set-y '(r))
-         (selector-add! *sel* *p1* set-x '(w))
-         (selector-add! *sel* *q1* set-y '(w))
-         (selector-select *sel*)
-         (let ((a (list *x* *y*)))
+;; Runs the same tests for each backend.
+(define (test-backend backend)
+  (define *sel* #f)
+  (define-values (*p0* *p1*) (sys-pipe))
+  (define-values (*q0* *q1*) (sys-pipe))
+
+  (define *x* #f)
+  (define *y* #f)
+
+  (define (set-x port flags)
+    (case flags
+      ((r) (set! *x* (read port)))
+      ((w) (write '(xxx) port) (flush port))))
+
+
+  (define (set-y port flags)
+    (case flags
+      ((r) (set! *y* (read port)))
+      ((w) (write '(yyy) port) (flush port))))
+
+  (test* #"make (~backend)" #t
+         (begin (set! *sel* (make <selector> :backend backend))
+                (is-a? *sel* <selector>)))
+
+  (test* "selector-add!" #f
+         (begin
+           (selector-add! *sel* *p0* set-x '(r))
+           *x*))
+
+  (test* "selector-select" '(foo)
+         (begin
+           (write '(foo) *p1*)
+           (flush *p1*)
            (selector-select *sel*)
+           *x*))
+
+  (test* "selector-add!" #f
+         (begin
+           (selector-add! *sel* *q0* set-y '(r))
+           *y*))
+
+  (test* "selector-select" '(bar baz)
+         (begin
+           (write '(bar baz) *q1*)
+           (flush *q1*)
+           (selector-select *sel* '(1 0))
+           *y*))
+
+  (test* "selector-delete! (by port)" '(foo)
+         (begin
+           (selector-delete! *sel* *p0* #f #f)
+           (write '(zzz) *p1*)
+           (flush *p1*)
            (selector-select *sel* 0)
-           (list a (list *x* *y*)))))
-
-(test* "selector-delete! (flags)" '((xxx) (yyy))
-       (begin
-         (write '(aaa) *p1*) (flush *p1*)
-         (write '(bbb) *q1*) (flush *q1*)
-         (selector-delete! *sel* #f #f '(r))
-         (selector-select *sel* 0)
-         (list *x* *y*)))
+           *x*))
+
+  (test* "selector-delete! (by proc)" '(bar baz)
+         (begin
+           (selector-delete! *sel* #f set-y #f)
+           (write '(yyy) *q1*)
+           (flush *q1*)
+           (selector-select *sel* 0)
+           *y*))
+
+  (test* "selector-select (flags)" '(((zzz) (yyy))
+                                     ((xxx) (yyy)))
+         (begin
+           (selector-add! *sel* *p0* set-x '(r))
+           (selector-add! *sel* *q0* set-y '(r))
+           (selector-add! *sel* *p1* set-x '(w))
+           (selector-add! *sel* *q1* set-y '(w))
+           (selector-select *sel*)
+           (let ((a (list *x* *y*)))
+             (selector-select *sel*)
+             (selector-select *sel* 0)
+             (list a (list *x* *y*)))))
+
+  (test* "selector-delete! (flags)" '((xxx) (yyy))
+         (begin
+           (write '(aaa) *p1*) (flush *p1*)
+           (write '(bbb) *q1*) (flush *q1*)
+           (selector-delete! *sel* #f #f '(r))
+           (selector-select *sel* 0)
+           (list *x* *y*)))
+
+  (test* #"selector-add! replaces handler (~backend)" '(second)
+         (let ([sel (make <selector> :backend backend)]
+               [called '()])
+           (receive (in out) (sys-pipe)
+             (selector-add! sel in (^[port flag] (push! called 'first)) '(r))
+             (selector-add! sel in (^[port flag] (push! called 'second)) '(r))
+             (write-char #\a out) (flush out)
+             (selector-select sel 0)
+             (close-port in)
+             (close-port out)
+             called))))
+
+(define (test-edge-triggered backend)
+  (define-values (p0 p1) (sys-pipe))
+  (define count 0)
+  (define sel (make <selector> :backend backend :edge-triggered #t))
+  (define (count-select)
+    (set! count 0)
+    (selector-select sel 0)
+    count)
+  (selector-add! sel p0 (^[port flag] (inc! count)) '(r))
+  ;; the data is left unread, so the second select doesn't see a new edge
+  (test* #"edge-triggered (~backend)" '(1 0)
+         (begin
+           (write-char #\a p1) (flush p1)
+           (let1 a (count-select)
+             (list a (count-select)))))
+  (test* #"edge-triggered after drained (~backend)" 1
+         (begin
+           (read-char p0)
+           (count-select)
+           (write-char #\b p1) (flush p1)
+           (count-select)))
+  ;; #\b is still pending, but was reported already; the wait must not
+  ;; return until the timeout.
+  (test* #"edge-triggered blocks until timeout (~backend)" '(0 #t)
+         (let1 start (receive (s u) (sys-gettimeofday) (+ s (/. u 1e6)))
+           (list (selector-select sel '(0 500000))
+                 (>= (- (receive (s u) (sys-gettimeofday) (+ s (/. u 1e6)))
+                        start)
+                     0.4)))))
+
+;; epoll doesn't accept regular files; they must be reported ready anyway.
+(define (test-regular-file backend)
+  (with-output-to-file "test.o" (^[] (display "abc")))
+  (call-with-input-file "test.o"
+    (^[in]
+      (let ([sel (make <selector> :backend backend)]
+            [flag #f])
+        (test* #"regular file (~backend)" 'r
+               (begin
+                 (selector-add! sel in (^[port f] (set! flag f)) '(r))
+                 (selector-select sel 0)
+                 flag)))))
+  (sys-unlink "test.o"))
+
+;; Closing fd drops it from epoll.  If the fd number is reused and set
+;; again with the same flags, it must be registered again.
+(define (test-fd-reuse backend)
+  (define sel (make <selector> :backend backend))
+  (define got #f)
+  (define (handler port flag) (set! got (read port)))
+  (receive (p0 p1) (sys-pipe)
+    (selector-add! sel p0 handler '(r))
+    (let1 fd (port-file-number p0)
+      (close-port p0)
+      (close-port p1)
+      (receive (q0 q1) (sys-pipe)
+        (when (eqv? fd (port-file-number q0))
+          (test* #"reused fd (~backend)" '(reused)
+                 (begin
+                   (selector-add! sel q0 handler '(r))
+                   (write '(reused) q1)
+                   (flush q1)
+                   (selector-select sel '(1 0))
+                   got)))
+        (close-port q0)
+        (close-port q1)))))
+
+(test-backend 'select)
+(test-regular-file 'select)
+(cond-expand
+ [gauche.sys.poll
+  (test-backend 'poll)
+  (test-edge-triggered 'poll)
+  (test-regular-file 'poll)
+  (test-fd-reuse 'poll)]
+ [else])
+(cond-expand
+ [gauche.sys.epoll
+  (test-backend 'epoll)
+  (test-edge-triggered 'epoll)
+  (test-regular-file 'epoll)
+  (test-fd-reuse 'epoll)]
+ [else])
+
+(test* "many descriptors" (iota 300)
+       (let ([sel (make <selector>)]
+             [pipes (map (^_ (receive (i o) (sys-pipe) (cons i o)))
+                         (iota 300))]
+             [result '()])
+         (for-each (^[p k]
+                     (selector-add! sel (car p)
+                                    (^[port flag]
+                                      (read-char port)
+                                      (push! result k))
+                                    '(r)))
+                   pipes (iota 300))
+         (for-each (^p (write-char #\z (cdr p)) (flush (cdr p))) pipes)
+         (until (= (length result) 300)
+           (selector-select sel '(1 0)))
+         (for-each (^p (close-port (car p)) (close-port (cdr p))) pipes)
+         (sort result)))
 
 (test-end)
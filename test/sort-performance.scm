@@ -0,0 +1,52 @@
+;;
+;; Sort benchmark
+;;
+
+;; Run as 'gosh sort-performance.scm'.  Each benchmark sorts the same
+;; data with the default order, with the builtin '<', and with a
+;; comparison procedure that the sort routine can't see through.  The
+;; former two take the specialized paths for homogeneous fixnum, flonum
+;; and string sequences (see Scm_SortArray and radix-sort! in
+;; lib/gauche/sortutil.scm), while the last one runs the general merge
+;; sort.
+
+(use gauche.time)
+
+(define (lcg-list n seed proc)
+  (let loop ([i 0] [x seed] [r '()])
+    (if (= i n)
+      r
+      (let1 x (modulo (+ (* x 1103515245) 12345) 2147483648)
+        (loop (+ i 1) x (cons (proc x) r))))))
+
+(define (bench name n data less)
+  (print name)
+  (let1 v (list->vector data)
+    (time-these/report n
+                       `((default  . ,(^[] (sort v)))
+                         (builtin  . ,(^[] (sort v less)))
+                         (lambda   . ,(^[] (sort v (^[a b] (less a b)))))
+                         (list     . ,(^[] (sort data less)))))))
+
+(define (bench-key name n data less key)
+  (print name)
+  (let1 v (list->vector data)
+    (time-these/report n
+                       `((builtin . ,(^[] (sort v less key)))
+                         (lambda  . ,(^[] (sort v (^[a b] (less a b)) key)))))))
+
+(define (main args)
+  (let1 n 100000
+    (bench "fixnums (100000)" 5
+           (lcg-list n 1 (^x (- x 1073741824))) <)
+    (bench "small fixnums (100000)" 5
+           (lcg-list n 2 (^x (modulo x 1000))) <)
+    (bench "flonums (100000)" 5
+           (lcg-list n 3 (^x (/ x 3.0))) <)
+    (bench "strings (100000)" 5
+           (lcg-list n 4 (^x (number->string x 36))) string<?)
+    (bench-key "records by fixnum key (100000)" 5
+               (lcg-list n 5 (^x (cons x (number->string x)))) < car)
+    (bench-key "records by string key (100000)" 5
+               (lcg-list n 6 (^x (cons x (number->string x)))) string<? cdr))
+  0)
@@ -169,4 +169,57 @@
  boolean<?
  '((1 3 1 2 4 2) (1 3 1 2 4 2)))
 
+;; Large inputs take the specialized paths (radix sort of fixnums,
+;; inlined comparison of flonums and strings).  We compare the results
+;; with the ones by a general comparison procedure.
+
+(test-section "specialized sort")
+
+(define (lcg-list n seed proc)
+  (let loop ([i 0] [x seed] [r '()])
+    (if (= i n)
+      r
+      (let1 x (modulo (+ (* x 1103515245) 12345) 2147483648)
+        (loop (+ i 1) x (cons (proc x) r))))))
+
+(define (sort-large-test name cmp key in)
+  (let1 exp (stable-sort in (if cmp
+                              (^[a b] (cmp a b))
+                              (^[a b] (< (compare a b) 0)))
+                         key)
+    (test* #"~name (list)" exp (sort in cmp key))
+    (test* #"~name (vector)" exp
+           (vector->list (sort (list->vector in) cmp key)))
+    (test* #"~name (list) !" exp (sort! (list-copy in) cmp key))
+    (test* #"~name (vector) !" exp
+           (vector->list (sort! (list->vector in) cmp key)))))
+
+(let ([small  (lcg-list 3000 1 (^x (- (modulo x 200) 100)))]
+      [large  (lcg-list 3000 2 (^x (- (* x 4096) (greatest-fixnum))))]
+      [flos   (lcg-list 3000 3 (^x (/ (- x 1e9) 7.0)))]
+      [strs   (lcg-list 3000 4 (^x (number->string x 36)))]
+      [mixed  (lcg-list 3000 5 (^x (if (even? x) (modulo x 1000) (/ x 7))))])
+  (dolist [in `(("small fixnums" . ,small)
+                ("large fixnums" . ,large)
+                ("flonums" . ,flos)
+                ("strings" . ,strs)
+                ("mixed numbers" . ,mixed))]
+    (let1 exp (stable-sort (cdr in) (^[a b] (< (compare a b) 0)))
+      (test* #"sort - nocmp ~(car in)" exp (sort (cdr in)))
+      (test* #"sort - nocmp ~(car in) (vector)" exp
+             (vector->list (sort (list->vector (cdr in)))))))
+  (sort-large-test "sort <" < identity small)
+  (sort-large-test "sort >" > identity large)
+  (sort-large-test "sort < mixed" < identity mixed)
+  ;; stability with fixnum keys
+  (let1 recs (map cons small (iota (length small)))
+    (sort-large-test "sort < car" < car recs)
+    (sort-large-test "sort > car" > car recs)
+    (sort-large-test "sort #f car" #f car recs))
+  ;; key is called once per element, even if it isn't a fixnum
+  (let* ([count 0]
+         [key (^x (inc! count) (if (zero? (modulo count 1000)) 0.5 x))])
+    (sort small < key)
+    (test* "sort key call count" (length small) count)))
+
 (test-end)
@@ -0,0 +1,44 @@
+;;
+;; Startup time of gosh loading libraries, with and without an image
+;;
+
+;; Run as 'gosh startup-performance.scm [gosh] [module ...]'.
+;; Each run starts gosh that loads the modules with -u options and
+;; exits.  The image is dumped into a temporary file with --dump-image
+;; and given with --image.  We run each a fixed number of times, for
+;; the time spent in the child processes isn't counted as our cpu time.
+;; Set GAUCHE_CODE_CACHE_DIR to compare with the code cache, too.
+
+(use gauche.time)
+(use gauche.process)
+(use file.util)
+
+(define *default-modules*
+  '("gauche.process" "gauche.generator" "gauche.parseopt"
+    "text.csv" "data.queue" "util.match" "rfc.json"))
+
+(define (gosh-command gosh modules . opts)
+  `(,gosh ,@opts ,@(map (^m #"-u~m") modules)))
+
+(define (startup-bench command)
+  (let1 command `(,@command "-e(exit)")
+    (^[] (process-wait (run-process command :output :null :error :null)))))
+
+(define (main args)
+  (let* ([gosh (if (null? (cdr args)) "gosh" (cadr args))]
+         [modules (if (or (null? (cdr args)) (null? (cddr args)))
+                    *default-modules*
+                    (cddr args))]
+         [image (build-path (temporary-directory)
+                            #"gosh-startup-~(sys-getpid).img")])
+    (unwind-protect
+        (begin
+          (do-process! (gosh-command gosh modules #"--dump-image=~image"))
+          (print #"~(length modules) modules")
+          ($ time-these/report 50
+             `((plain . ,(startup-bench (gosh-command gosh modules)))
+               (image . ,(startup-bench
+                          (gosh-command gosh modules #"--image=~image")))
+               (bare  . ,(startup-bench (gosh-command gosh '()))))))
+      (remove-files image)))
+  0)
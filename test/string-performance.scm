@@ -0,0 +1,42 @@
+;;
+;; Random access to multibyte strings
+;;
+
+;; Run as 'gosh string-performance.scm [num-chars]'.
+;; Compares string-ref/substring with and without the character index.
+
+(use gauche.time)
+
+(define *unit* "吾輩は猫である。名前はまだ無い。どこで生れたかとんと見当がつかぬ。")
+
+(define (make-text n)
+  (let* ([k (quotient n (string-length *unit*))])
+    (string-join (make-list (+ k 1) *unit*) "")))
+
+(define (random-refs text count interval)
+  (^[] (let ([orig (string-character-index-interval interval)]
+             [s (string-append text "")]   ;fresh body without index
+             [len (string-length text)])
+         (dotimes [i count]
+           (string-ref s (modulo (* i 7919) len)))
+         (string-character-index-interval orig))))
+
+(define (random-substrings text count interval)
+  (^[] (let ([orig (string-character-index-interval interval)]
+             [s (string-append text "")]
+             [len (- (string-length text) 10)])
+         (dotimes [i count]
+           (let1 k (modulo (* i 7919) len)
+             (substring s k (+ k 10))))
+         (string-character-index-interval orig))))
+
+(define (main args)
+  (define n (if (null? (cdr args)) 100000 (string->number (cadr args))))
+  (define text (make-text n))
+  (print #"Text with ~(string-length text) characters")
+  ($ time-these/report '(cpu 3)
+     `((ref/noindex     . ,(random-refs text 1000 0))
+       (ref/index       . ,(random-refs text 1000 32))
+       (substr/noindex  . ,(random-substrings text 1000 0))
+       (substr/index    . ,(random-substrings text 1000 32))))
+  0)
@@ -125,6 +125,55 @@
         (list (string-pointer-substring sp)
               (string-pointer-substring sp :after #t))))
 
+;;-------------------------------------------------------------------
+(test-section "character index")
+
+(let* ([unit "いろはにほへとabcちりぬるを"]
+       [n    1000]
+       [len  (* n (string-length unit))]
+       [long (string-join (make-list n unit) "")]
+       [ref  (^i (string-ref unit (modulo i (string-length unit))))])
+  (test* "string-fast-indexable? (ascii)" #t (string-fast-indexable? "abcde"))
+  (test* "string-fast-indexable? (before)" #f (string-fast-indexable? long))
+  (test* "string-ref (sequential)" #t
+         (every (^i (eqv? (string-ref long i) (ref i))) (iota len)))
+  (test* "string-ref (backward)" #t
+         (every (^i (eqv? (string-ref long i) (ref i)))
+                (reverse (iota len))))
+  (test* "substring" (string-copy unit 3)
+         (substring long (- len (string-length unit) -3) len))
+  (test* "substring" (string-append (string-copy unit 10) (string-copy unit 0 2))
+         (substring long (+ (* 500 (string-length unit)) 10)
+                    (+ (* 501 (string-length unit)) 2)))
+  (test* "string-build-index!" long (string-build-index! long))
+  (test* "string-fast-indexable? (after)" #t (string-fast-indexable? long))
+  (test* "string-ref (indexed)" #t
+         (every (^i (eqv? (string-ref long i) (ref i)))
+                (iota 100 0 (quotient len 100))))
+  (test* "string-pointer-set!" '(#\ち #\ぬ #\ち)
+         (let1 sp (make-string-pointer long)
+           (string-pointer-set! sp (+ (* 700 (string-length unit)) 10))
+           (let* ([a (string-pointer-next! sp)]
+                  [_ (string-pointer-set! sp (+ (* 700 (string-length unit)) 12))]
+                  [b (string-pointer-next! sp)]
+                  [_ (string-pointer-set! sp (+ (* 3 (string-length unit)) 10))]
+                  [c (string-pointer-next! sp)])
+             (list a b c))))
+  (test* "string-character-index-interval" '(64 0)
+         (let* ([orig (string-character-index-interval 50)]
+                [a (string-character-index-interval 0)]
+                [b (string-character-index-interval orig)])
+           (list a b)))
+  (test* "string-ref (no automatic index)" #t
+         (let ([orig (string-character-index-interval 0)]
+               [s (string-append long "")])
+           (unwind-protect
+               (and (every (^i (eqv? (string-ref s i) (ref i)))
+                           (iota 50 0 (quotient len 50)))
+                    (not (string-fast-indexable? s)))
+             (string-character-index-interval orig))))
+  )
+
 ;;-------------------------------------------------------------------
 (test-section "incomplete strings")
 
@@ -0,0 +1,60 @@
+;;
+;; Uniform vector arithmetic benchmark
+;;
+
+;; Run as 'gosh uvector-performance.scm'.  Shows the throughput
+;; (million elements per second) of the element-wise arithmetic,
+;; the dot product and the reductions of u8, s32, f32 and f64 vectors,
+;; for each instruction set level the CPU supports (see
+;; ext/uvector/uvsimd.c).  Level 0 is the generic C code.
+
+(use gauche.time)
+(use gauche.uvector)
+
+(define-constant *size* (* 1024 1024))
+
+(define simd-set! (with-module gauche.uvector %uvector-simd-set!))
+
+(define (melem/s thunk)
+  (let1 r (time-this 5 thunk)
+    (/. (* *size* (time-result-count r))
+        (* 1e6 (max (time-result-real r) 1e-6)))))
+
+(define (proc tag name)
+  (global-variable-ref (find-module 'gauche.uvector)
+                       (string->symbol #"~|tag|vector-~name")))
+
+(define (make-data tag base)
+  (rlet1 v ((global-variable-ref (find-module 'gauche.uvector)
+                                 (string->symbol #"make-~|tag|vector"))
+            *size*)
+    (let1 set (global-variable-ref (find-module 'gauche.uvector)
+                                   (string->symbol #"~|tag|vector-set!"))
+      (dotimes [i *size*]
+        ;; keep the results in range, so that the kernels don't stop
+        (set v i (case tag
+                   [(u8) (+ base (logand i 7))]
+                   [(s32) (+ base (- (logand (* i 7) 1023) 512))]
+                   [else (+ base (/. (- (logand i 1023) 512) 64))]))))))
+
+(define (bench tag)
+  (let ([x (make-data tag 8)]
+        [y (make-data tag 0)])
+    (format #t "~3a" tag)
+    (dolist [op '(add sub mul)]
+      (let1 f (proc tag op)
+        (format #t " ~a ~7,1f" op (melem/s (^[] (f x y))))))
+    (format #t " dot ~7,1f" (melem/s (^[] ((proc tag 'dot) x y))))
+    (dolist [op '(sum max argmax)]
+      (let1 f (proc tag op)
+        (format #t " ~a ~7,1f" op (melem/s (^[] (f x))))))
+    (newline)))
+
+(define (main args)
+  (let1 best (simd-set! 2)
+    (dotimes [level (+ best 1)]
+      (simd-set! level)
+      (format #t "level ~a (~a), M elements/s\n"
+              level (list-ref '("generic" "SSE2" "AVX2") level))
+      (for-each bench '(u8 s32 f32 f64))))
+  0)